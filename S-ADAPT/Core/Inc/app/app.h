@@ -2,12 +2,19 @@
 #define APP_H
 
 #include "stm32l4xx_hal.h"
+#include "sensors/ultrasonic.h"
+
+/* Ultrasonic presence zones (build flag). Zone 0 is the sensor facing the seat; extra zones cover the sides
+ * so leaning out of the main cone does not read as leaving. Each zone needs its own TRIG pin, echo capture
+ * channel and TRIG-end compare channel (see main.c). */
+#ifndef APP_US_ZONE_COUNT
+#define APP_US_ZONE_COUNT 1U
+#endif
 
 typedef struct
 {
     ADC_HandleTypeDef *ldr_adc;
-    TIM_HandleTypeDef *echo_tim;
-    uint32_t echo_channel;
+    ultrasonic_hw_t us_zones[APP_US_ZONE_COUNT];
     TIM_HandleTypeDef *main_led_tim;
     uint32_t main_led_channel;
 } app_hw_config_t;
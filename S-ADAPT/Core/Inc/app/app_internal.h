@@ -3,28 +3,53 @@
 
 #include "app/app.h"
 #include "app/app_settings.h"
+#include "app/presence_engine.h"
+#include "app/presence_shadow.h"
 
 #include "support/debug_print.h"
+#include "support/distance_tracker.h"
+#include "support/filter_block.h"
 #include "support/filter_utils.h"
+#include "support/lux_curve.h"
 #include "support/settings_store.h"
 #include "bsp/display.h"
 #include "bsp/main_led.h"
 #include "bsp/status_led.h"
 #include "input/encoder_input.h"
+#include "input/gesture_input.h"
 #include "input/switch_input.h"
 #include "input/input_utils.h"
 #include "sensors/ldr.h"
+#include "sensors/mcu_temp.h"
 #include "sensors/ultrasonic.h"
+#include "sensors/ultrasonic_burst.h"
+#include "sensors/ultrasonic_zones.h"
+
+/* Output levels share the lux-curve and main_led unit: percent in Q8. */
+#define APP_OUTPUT_LEVEL_FULL               MAIN_LED_LEVEL_FULL
+#define APP_OUTPUT_LEVEL_FROM_PERCENT(p)    ((uint16_t)((uint32_t)(p) << 8))
+#define APP_OUTPUT_LEVEL_TO_PERCENT(level)  ((uint8_t)(((uint32_t)(level) + 128U) >> 8))
 
 typedef struct
 {
     uint32_t control_tick_ms;
     uint32_t ldr_sample_ms;
     uint32_t us_sample_ms;
+    uint32_t us_sample_stable_ms;
+    uint32_t us_sample_idle_ms;
+    uint32_t gesture_sample_ms;
+    uint32_t temp_sample_ms;
     uint32_t log_ms;
+    uint32_t shadow_log_ms;
     uint32_t ui_min_redraw_ms;
 } app_timing_cfg_t;
 
+typedef enum
+{
+    APP_LDR_SMOOTHING_MA = 0U,
+    APP_LDR_SMOOTHING_ONE_EURO
+} app_ldr_smoothing_t;
+
 typedef struct
 {
     uint32_t boot_setup_ms;
@@ -32,26 +57,78 @@ typedef struct
     int32_t offset_step;
     int32_t offset_min;
     int32_t offset_max;
-    uint32_t distance_error_cm;
+    uint32_t distance_error_mm;
     uint32_t us_timeout_us;
+    uint8_t us_burst_ping_count;
+    uint32_t us_burst_dead_time_ms;
+    uint32_t us_burst_agree_band_us;
+    uint8_t us_min_confidence_percent;
+    int32_t us_temp_fallback_deci_c;
+    uint32_t us_zone_guard_ms;
+    uint8_t dist_median_window_size;
+    filter_median_warmup_t dist_median_warmup;
+    distance_tracker_cfg_t dist_tracker;
+    uint8_t presence_use_tracker;
+    uint32_t presence_flat_velocity_mm_s;
+    uint32_t presence_motion_velocity_mm_s;
+    uint8_t presence_motion_sigma;
+    uint8_t ldr_median_window_size;
+    app_ldr_smoothing_t ldr_smoothing;
     uint8_t ldr_ma_window_size;
+    filter_one_euro_cfg_t ldr_one_euro;
+    uint8_t ldr_watch_margin_percent;
+    uint16_t ldr_watch_min_margin_raw;
+    uint32_t ldr_watch_settle_ms;
+    uint32_t ldr_watch_refresh_ms;
+    uint32_t lamp_cal_settle_ms;
+    uint8_t lamp_cal_samples;
+    uint32_t lamp_cal_step_timeout_ms;
+    uint16_t lamp_cal_drift_max_raw;
     uint8_t output_hysteresis_band_percent;
+    uint8_t output_hysteresis_band_comp_percent;
     uint8_t output_ramp_step_percent;
     uint8_t output_ramp_step_on_percent;
     uint8_t output_ramp_step_off_percent;
-    uint32_t presence_ref_fallback_cm;
-    uint32_t presence_body_margin_cm;
+    uint32_t presence_ref_fallback_mm;
+    uint32_t presence_body_margin_mm;
     uint32_t presence_return_band_cm;
     uint32_t presence_return_confirm_ms;
     uint32_t presence_away_timeout_ms;
-    uint32_t presence_flat_band_cm;
-    uint32_t presence_motion_delta_cm;
+    uint32_t presence_flat_band_mm;
+    uint32_t presence_motion_delta_mm;
     uint32_t presence_stale_timeout_ms;
     uint32_t presence_resume_motion_ms;
+    uint32_t presence_streak_max_dt_ms;
+    presence_classifier_t presence_classifier;
+    presence_hmm_model_t presence_hmm;
+    uint16_t presence_hmm_candidate_permille;
+    uint16_t presence_hmm_clear_permille;
+    uint16_t presence_hmm_recover_permille;
+    uint16_t presence_ldr_shadow_delta_raw;
+    uint8_t presence_learn_background;
+    presence_background_cfg_t presence_background;
+    uint32_t presence_min_away_margin_mm;
+    uint32_t presence_zone_seat_max_mm;
+    uint32_t presence_arrival_velocity_mm_s;
+    uint32_t presence_arrival_horizon_ms;
+    uint32_t presence_arrival_confirm_ms;
+    uint8_t presence_arrival_preramp_percent;
+    uint8_t presence_shadow_count;
+    presence_shadow_policy_t presence_shadow[PRESENCE_SHADOW_MAX];
+    uint32_t presence_shadow_budget_cycles;
     uint8_t presence_preoff_dim_percent;
     uint32_t presence_preoff_dim_ms;
     uint32_t ui_overlay_timeout_ms;
     uint32_t ui_refresh_ms;
+    uint8_t gesture_enabled;
+    uint32_t gesture_zone_min_mm;
+    uint32_t gesture_zone_max_mm;
+    uint32_t gesture_hold_ms;
+    uint32_t gesture_hold_band_mm;
+    uint32_t gesture_step_mm;
+    uint32_t gesture_session_timeout_ms;
+    uint32_t gesture_session_max_ms;
+    uint32_t gesture_ping_timeout_us;
 } app_policy_cfg_t;
 
 typedef struct
@@ -60,44 +137,57 @@ typedef struct
     uint32_t last_control_tick_ms;
     uint32_t last_ldr_sample_ms;
     uint32_t last_us_sample_ms;
+    uint32_t us_interval_ms;
+    uint32_t last_temp_sample_ms;
     uint32_t last_log_ms;
+    uint32_t last_shadow_log_ms;
     uint32_t last_ui_draw_ms;
     uint32_t last_ui_refresh_ms;
 } app_timing_state_t;
 
-typedef enum
+/* Presence fused over the ultrasonic zones, one engine per zone. A zone holds the user while its engine is
+ * present without a candidate and its distance is within the seat range; the fused state proposes no-user
+ * only when no zone holds and some zone has a candidate, and returns as soon as any zone holds again. */
+typedef struct
 {
-    APP_NO_USER_REASON_NONE = 0U,
-    APP_NO_USER_REASON_AWAY = 1U,
-    APP_NO_USER_REASON_FLAT = 2U
-} app_no_user_reason_t;
+    presence_engine_t zone[APP_US_ZONE_COUNT];
+    uint32_t zone_step_ms[APP_US_ZONE_COUNT];
+    uint8_t present;
+    uint8_t candidate_no_user;
+    presence_no_user_reason_t no_user_reason;
+    uint8_t holding_mask;               /* bit n: zone n holds the user */
+    uint8_t lead_zone;                  /* zone shown in the UI and log */
+    uint8_t arrival_predicted;          /* not present, and a zone sees the user coming back */
+    /* Shadow policies run on the seat zone's samples; the live seat engine gets the same accounting. */
+    presence_shadow_set_t shadow;
+    presence_shadow_track_t live_track;
+} app_presence_state_t;
 
 typedef struct
 {
     uint16_t last_ldr_raw;
     uint16_t last_ldr_filtered;
     ldr_status_t last_ldr_status;
+    uint8_t ldr_flicker_hz;
+    uint16_t ldr_ripple_pp_raw;
+    uint8_t ldr_watch_armed;
+    uint32_t ldr_watch_since_ms;
+    uint32_t ldr_watch_events;
 
-    uint32_t last_distance_raw_cm;
-    uint32_t last_distance_filtered_cm;
-    uint32_t last_valid_distance_cm;
+    ultrasonic_t us[APP_US_ZONE_COUNT];
+    ultrasonic_burst_t us_burst[APP_US_ZONE_COUNT];
+    ultrasonic_zones_t us_zones;
     ultrasonic_status_t last_us_status;
-    uint8_t last_valid_presence;
-    uint32_t ref_distance_cm;
-    uint8_t ref_valid;
-    uint8_t ref_pending_capture;
-    uint8_t using_fallback_ref;
-    uint32_t prev_valid_distance_cm;
-    uint8_t prev_valid_distance_ready;
-    uint32_t away_streak_ms;
-    uint32_t flat_streak_ms;
-    uint32_t motion_streak_ms;
-    uint32_t near_ref_streak_ms;
-    app_no_user_reason_t no_user_reason;
-    uint8_t presence_candidate_no_user;
+    uint8_t last_us_zone;
+    uint8_t last_us_confidence_percent;
+    uint8_t last_us_valid_pings;
+    int32_t mcu_temp_deci_c;
+    mcu_temp_status_t last_mcu_temp_status;
+    app_presence_state_t presence;
 
+    filter_median_u16_t ldr_median;
     filter_moving_average_u16_t ldr_ma;
-    filter_median3_u32_t dist_median3;
+    filter_one_euro_u16_t ldr_one_euro;
 } app_sensor_state_t;
 
 typedef struct
@@ -105,11 +195,18 @@ typedef struct
     uint8_t light_enabled;
     int32_t manual_offset;
     uint8_t auto_percent;
-    uint8_t target_output_percent;
-    uint8_t hysteresis_output_percent;
-    uint8_t ramped_output_percent;
+    uint16_t ambient_log_lux_mdec;
+    uint16_t ambient_raw;
+    uint16_t lamp_comp_raw;
+    lux_curve_t lux_curve;
+    /* Output path levels: perceived lightness in percent Q8 (APP_OUTPUT_LEVEL_FULL = 100 %). */
+    uint16_t auto_level;
+    uint16_t target_output_level;
+    uint16_t hysteresis_output_level;
+    uint16_t ramped_output_level;
+    uint16_t output_level;
+    uint16_t last_applied_output_level;
     uint8_t output_percent;
-    uint8_t last_applied_output_percent;
     uint8_t output_hysteresis_initialized;
     uint8_t ramp_initialized;
     uint8_t ramp_fast_on_active;
@@ -117,7 +214,8 @@ typedef struct
     uint8_t fatal_fault;
     uint8_t preoff_active;
     uint32_t preoff_start_ms;
-    uint8_t preoff_dim_target_percent;
+    uint16_t preoff_dim_target_level;
+    uint8_t arrival_preramp_active;
 } app_control_state_t;
 
 typedef struct
@@ -165,6 +263,38 @@ typedef struct
     uint8_t render_dirty;
 } app_ui_state_t;
 
+typedef struct
+{
+    uint8_t active;
+    uint8_t burst_profile_fast;
+    uint8_t entry_armed;        /* a valid return beyond the zone was seen since the last session started */
+    uint32_t last_hand_ms;
+    uint32_t session_start_ms;
+} app_gesture_state_t;
+
+typedef enum
+{
+    APP_LAMP_CAL_RESULT_NONE = 0U,
+    APP_LAMP_CAL_RESULT_OK,
+    APP_LAMP_CAL_RESULT_SENSOR_ERR,
+    APP_LAMP_CAL_RESULT_DRIFT_ERR,
+    APP_LAMP_CAL_RESULT_SAVE_ERR
+} app_lamp_cal_result_t;
+
+/* Sweep: 0, 20, ... 100 % then 0 % again; the repeat brackets ambient drift over the run. */
+#define APP_LAMP_CAL_STEPS (APP_LAMP_COMP_POINTS + 1U)
+
+typedef struct
+{
+    uint8_t active;
+    uint8_t step;
+    uint32_t step_start_ms;
+    uint32_t sample_sum;
+    uint8_t sample_count;
+    uint16_t level_raw[APP_LAMP_CAL_STEPS];
+    app_lamp_cal_result_t result;
+} app_lamp_cal_state_t;
+
 typedef struct
 {
     uint8_t display_ready;
@@ -179,6 +309,8 @@ typedef struct
     app_ui_state_t ui;
     app_settings_runtime_t settings;
     app_settings_ui_state_t settings_ui;
+    app_gesture_state_t gesture;
+    app_lamp_cal_state_t lamp_cal;
     app_platform_state_t platform;
 } app_ctx_t;
 
@@ -188,15 +320,35 @@ extern app_ctx_t s_app;
 
 status_led_state_t app_evaluate_state(uint32_t now_ms);
 void app_handle_encoder_event(const encoder_event_t *event);
+void app_handle_gesture_event(const gesture_event_t *event);
+void app_process_gesture_events(void);
 void app_process_switch_events(uint32_t now_ms);
 void app_process_encoder_events(uint32_t now_ms);
 void app_sample_ldr_if_due(uint32_t now_ms);
+void app_sample_mcu_temp_if_due(uint32_t now_ms);
 void app_sample_ultrasonic_if_due(uint32_t now_ms);
+void app_configure_ultrasonic_burst(uint8_t gesture_profile);
+void app_presence_engine_cfg(presence_engine_cfg_t *cfg);
+void app_presence_init(uint32_t now_ms);
+void app_presence_arm(void);
+void app_presence_disarm(void);
+void app_presence_confirm_no_user(void);
+const presence_engine_t *app_presence_lead(void);
 uint8_t app_control_tick_due(uint32_t now_ms);
 void app_update_output_control(uint32_t now_ms);
+void app_rebuild_lux_curve(void);
+uint8_t app_auto_percent_from_raw(uint16_t raw);
 void app_update_rgb(uint32_t now_ms);
+void app_lamp_cal_start(uint32_t now_ms);
+void app_lamp_cal_on_ldr_sample(uint32_t now_ms, uint16_t raw);
+void app_lamp_cal_step(uint32_t now_ms);
+uint8_t app_lamp_cal_active(void);
+uint8_t app_lamp_cal_progress_percent(void);
+const char *app_lamp_cal_result_to_string(app_lamp_cal_result_t result);
 void app_update_oled_if_due(uint32_t now_ms);
 void app_log_summary_if_due(uint32_t now_ms);
+void app_log_shadow_if_due(uint32_t now_ms);
+void app_presence_shadow_apply_budget(const uint32_t *avg_cycles);
 const char *status_led_state_to_string(status_led_state_t state);
 void app_settings_apply_build_defaults(app_settings_t *cfg);
 
@@ -24,6 +24,32 @@
 #define APP_SETTINGS_RETURN_BAND_CM_MIN          5U
 #define APP_SETTINGS_RETURN_BAND_CM_MAX          30U
 
+/* LDR calibration: raw ADC -> log-lux breakpoints (from tools/ldr_lut_gen.py) and the log-lux -> AUTO output
+ * transfer curve. log_lux_mdec is 1000 * log10(lux), clamped at 0 (1 lux) and APP_LDR_LOG_LUX_MAX_MDEC. */
+#define APP_LDR_CAL_POINTS                       8U
+#define APP_LUX_TRANSFER_POINTS                  6U
+#define APP_LDR_LOG_LUX_MAX_MDEC                 5000U
+
+typedef struct
+{
+    uint16_t raw[APP_LDR_CAL_POINTS];                           /* strictly ascending ADC counts */
+    uint16_t log_lux_mdec[APP_LDR_CAL_POINTS];                  /* non-decreasing */
+    uint16_t transfer_log_lux_mdec[APP_LUX_TRANSFER_POINTS];    /* strictly ascending */
+    uint8_t transfer_percent[APP_LUX_TRANSFER_POINTS];          /* 0..100 */
+} app_ldr_cal_t;
+
+/* Lamp self-illumination model learned by the calibration sweep: LDR raw increase over lamp-off at
+ * output 0, 20, .., 100 %. Only used while valid. */
+#define APP_LAMP_COMP_POINTS                     6U
+#define APP_LAMP_COMP_STEP_PERCENT               20U
+
+typedef struct
+{
+    uint8_t valid;
+    uint8_t reserved;
+    uint16_t delta_raw[APP_LAMP_COMP_POINTS];                   /* [0] is 0, non-decreasing */
+} app_lamp_comp_t;
+
 typedef struct
 {
     uint8_t away_mode_enabled;
@@ -32,9 +58,14 @@ typedef struct
     uint16_t stale_timeout_s;
     uint16_t preoff_dim_s;
     uint8_t return_band_cm;
+    app_ldr_cal_t ldr_cal;
+    app_lamp_comp_t lamp_comp;
 } app_settings_t;
 
 void app_settings_set_defaults(app_settings_t *cfg);
+void app_settings_set_ldr_cal_defaults(app_ldr_cal_t *cal);
+uint8_t app_settings_ldr_cal_is_valid(const app_ldr_cal_t *cal);
+uint8_t app_settings_lamp_comp_is_valid(const app_lamp_comp_t *comp);
 uint8_t app_settings_validate(app_settings_t *cfg);
 
 #endif /* APP_SETTINGS_H */
@@ -0,0 +1,54 @@
+#ifndef PRESENCE_BACKGROUND_H
+#define PRESENCE_BACKGROUND_H
+
+#include <stdint.h>
+
+/* Learned distance background for the presence engine: two fixed-size, exponentially decaying histograms of
+ * the filtered distance. "User" collects samples while someone is seated and not about to be switched off;
+ * its mode is the seated position. "Scene" collects samples while no-user is confirmed; its modes are the
+ * static returns (empty chair, desk edge, wall) the sensor sees without the user. Bins are weighted by time
+ * so the adaptive ultrasonic cadence does not bias them, and decay runs on a fixed period so old positions
+ * fade out over minutes. Memory is 2 x PRESENCE_BACKGROUND_BINS x 2 bytes. */
+#define PRESENCE_BACKGROUND_BINS        64U
+/* One bin count is this many milliseconds of samples. */
+#define PRESENCE_BACKGROUND_WEIGHT_MS   16U
+
+typedef enum
+{
+    PRESENCE_BACKGROUND_SAMPLE_NONE = 0U,   /* decay only */
+    PRESENCE_BACKGROUND_SAMPLE_USER,
+    PRESENCE_BACKGROUND_SAMPLE_SCENE
+} presence_background_sample_t;
+
+typedef struct
+{
+    uint16_t bin_mm;                    /* distances past BINS x bin_mm land in the last (overflow) bin */
+    uint32_t decay_period_ms;
+    uint8_t decay_shift;                /* per period, weight -= weight >> shift */
+    uint32_t sample_max_dt_ms;          /* one long gap adds at most this much weight */
+    uint32_t user_min_ms;               /* seated time in the mode before it replaces the captured reference */
+    uint32_t scene_min_ms;              /* absent time in a scene mode before it narrows the away margin */
+} presence_background_cfg_t;
+
+typedef struct
+{
+    presence_background_cfg_t cfg;
+    uint16_t user[PRESENCE_BACKGROUND_BINS];
+    uint16_t scene[PRESENCE_BACKGROUND_BINS];
+    uint32_t decay_elapsed_ms;
+} presence_background_t;
+
+void presence_background_init(presence_background_t *b, const presence_background_cfg_t *cfg);
+/* Adds dt_ms of weight at distance_mm to the chosen histogram (none: time only) and applies any decay periods
+ * that completed. Returns 1 when a decay period completed, the point at which callers re-derive the modes. */
+uint8_t presence_background_update(presence_background_t *b,
+                                   presence_background_sample_t sample,
+                                   uint32_t distance_mm,
+                                   uint32_t dt_ms);
+/* Seated position: centroid of the strongest in-range user bin and its neighbours. Returns 0 until that
+ * neighbourhood holds user_min_ms of samples. */
+uint8_t presence_background_user_mode_mm(const presence_background_t *b, uint32_t *mode_mm);
+/* Nearest scene mode strictly beyond from_mm holding at least scene_min_ms. Returns 0 when there is none. */
+uint8_t presence_background_scene_mode_beyond_mm(const presence_background_t *b, uint32_t from_mm, uint32_t *mode_mm);
+
+#endif /* PRESENCE_BACKGROUND_H */
@@ -0,0 +1,186 @@
+#ifndef PRESENCE_ENGINE_H
+#define PRESENCE_ENGINE_H
+
+#include <stdint.h>
+
+#include "app/presence_background.h"
+#include "app/presence_hmm.h"
+#include "support/distance_tracker.h"
+#include "support/filter_utils.h"
+
+/* Presence decisions from fused ultrasonic distance samples: running median, optional Kalman tracker,
+ * reference capture or learned background, and the away / flat / return / motion streak rules. No HAL and no globals: all state
+ * is in presence_engine_t and time only advances through dt_ms, so the same code runs on the target
+ * (one step per burst result) and on a host (presence_engine_replay over a recorded trace).
+ *
+ * The engine proposes "no user" (candidate_no_user); the caller confirms it after its pre-off dim with
+ * presence_engine_confirm_no_user().
+ *
+ * With classifier PRESENCE_CLASSIFIER_HMM the streak rules are replaced by a four-state HMM
+ * (app/presence_hmm.h) that also takes LDR shadow changes as evidence: the candidate is raised and cleared
+ * on the posterior probability of "absent", and recovery needs the posterior of "present". The away and
+ * stale timeouts become the leaving -> absent and still -> absent transition rates.
+ *
+ * With learn_background set, the reference stops depending on the one sample captured at turn-on: once the
+ * seated-position histogram (app/presence_background.h) is confident its mode is the reference, and a static
+ * scene return (empty chair, wall) learned closer than ref + body_margin_mm pulls the away margin in to
+ * halfway between the two.
+ *
+ * With arrival_velocity_mm_s set, a tracked approach toward the return band after an away no-user raises
+ * arrival_predicted before the return is confirmed, so the caller can start bringing the lamp up early. The
+ * prediction is only a hint: present still follows the return rule, and the prediction drops when the
+ * approach reverses or stalls outside the band. */
+typedef enum
+{
+    PRESENCE_NO_USER_REASON_NONE = 0U,
+    PRESENCE_NO_USER_REASON_AWAY = 1U,
+    PRESENCE_NO_USER_REASON_FLAT = 2U
+} presence_no_user_reason_t;
+
+typedef enum
+{
+    PRESENCE_CLASSIFIER_RULES = 0U,
+    PRESENCE_CLASSIFIER_HMM = 1U
+} presence_classifier_t;
+
+typedef struct
+{
+    uint32_t distance_error_mm;         /* reported distance before the first valid sample */
+    uint8_t median_window_size;
+    filter_median_warmup_t median_warmup;
+    distance_tracker_cfg_t tracker;
+    uint8_t use_tracker;                /* 0: step-delta flat/motion rules on the median output */
+    uint32_t flat_velocity_mm_s;
+    uint32_t motion_velocity_mm_s;
+    uint8_t motion_sigma;
+    uint32_t flat_band_mm;
+    uint32_t motion_delta_mm;
+    uint32_t ref_fallback_mm;
+    uint32_t body_margin_mm;            /* away margin beyond the reference until the background narrows it */
+    uint32_t return_confirm_ms;
+    uint32_t streak_max_dt_ms;          /* one long gap between valid samples cannot complete a timeout */
+    presence_classifier_t classifier;
+    presence_hmm_model_t hmm;
+    uint16_t hmm_candidate_permille;    /* p(absent) that raises the no-user candidate */
+    uint16_t hmm_clear_permille;        /* p(absent) below which a pending candidate is dropped */
+    uint16_t hmm_recover_permille;      /* p(present) that ends a confirmed no-user state */
+    uint16_t ldr_shadow_delta_raw;      /* fast/slow LDR EMA split that counts as a shadow change */
+    uint8_t learn_background;
+    presence_background_cfg_t background;
+    uint32_t min_away_margin_mm;        /* the learned margin never drops below the user's own sway */
+    uint32_t arrival_velocity_mm_s;     /* approach speed that predicts a return; 0 disables the prediction */
+    uint32_t arrival_horizon_ms;        /* predicted time to reach the return band; also the stall limit */
+    uint32_t arrival_confirm_ms;        /* approach time before the prediction is raised */
+} presence_engine_cfg_t;
+
+/* User settings, read on every step so edits apply immediately. */
+typedef struct
+{
+    uint8_t away_mode_enabled;
+    uint8_t flat_mode_enabled;
+    uint32_t away_timeout_ms;
+    uint32_t stale_timeout_ms;
+    uint32_t return_band_mm;
+    uint32_t preoff_dim_ms;             /* replay only: candidate age at which no-user is confirmed */
+} presence_engine_settings_t;
+
+typedef struct
+{
+    uint32_t distance_mm;
+    uint8_t valid;                      /* 0: dropped or low-confidence burst */
+    uint16_t ldr_raw;                   /* lamp-compensated ambient, HMM evidence only */
+    uint8_t ldr_valid;
+} presence_sample_t;
+
+/* t_ms is on the engine clock: milliseconds since presence_engine_init. */
+typedef struct
+{
+    uint32_t t_ms;
+    presence_sample_t sample;
+} presence_timed_sample_t;
+
+typedef struct
+{
+    uint8_t present;
+    uint8_t candidate_no_user;
+    presence_no_user_reason_t no_user_reason;
+    uint8_t arrival_predicted;
+    uint8_t updated;                    /* 1 when the sample was valid and ran the rules */
+    uint32_t distance_mm;
+    int32_t velocity_mm_s;
+    distance_tracker_status_t track_status;
+    uint32_t ref_distance_mm;
+    uint32_t away_margin_mm;
+    uint16_t present_permille;          /* HMM posterior; the rules report 1000 or 0 from present */
+    presence_hmm_state_t hmm_state;     /* most likely HMM state; rules report active or absent */
+} presence_decision_t;
+
+/* Fields are readable by callers (UI, logs); change them only through the functions below. */
+typedef struct
+{
+    presence_engine_cfg_t cfg;
+    filter_median_u32_t median;
+    distance_tracker_t tracker;
+    uint32_t now_ms;
+    uint8_t armed;
+
+    uint32_t raw_mm;
+    uint32_t filtered_mm;
+    int32_t velocity_mm_s;
+    distance_tracker_status_t track_status;
+
+    uint8_t present;
+    uint32_t ref_distance_mm;
+    uint8_t ref_valid;
+    uint8_t ref_pending_capture;
+    uint8_t using_fallback_ref;
+    uint8_t ref_learned;
+    uint32_t away_margin_mm;
+    uint32_t prev_valid_mm;
+    uint32_t prev_valid_ms;
+    uint8_t prev_valid_ready;
+    uint32_t away_streak_ms;
+    uint32_t flat_streak_ms;
+    uint32_t motion_streak_ms;
+    uint32_t near_ref_streak_ms;
+    presence_no_user_reason_t no_user_reason;
+    uint8_t candidate_no_user;
+    uint32_t candidate_since_ms;
+    uint32_t arrival_streak_ms;
+    uint32_t arrival_stall_ms;
+    uint32_t arrival_recede_ms;
+    uint8_t arrival_predicted;
+
+    presence_hmm_t hmm;
+    presence_hmm_state_t hmm_state;
+    uint16_t present_permille;
+    filter_ema_u16_t ldr_fast;
+    filter_ema_u16_t ldr_slow;
+
+    presence_background_t background;
+} presence_engine_t;
+
+void presence_engine_init(presence_engine_t *e, const presence_engine_cfg_t *cfg);
+/* Light on: start from the learned reference when the background is confident, otherwise from the fallback
+ * and capture the real one on the next valid sample. */
+void presence_engine_arm(presence_engine_t *e);
+/* Light off: streaks and candidate are cleared and stay cleared; samples still update the distance. */
+void presence_engine_disarm(presence_engine_t *e);
+void presence_engine_confirm_no_user(presence_engine_t *e);
+void presence_engine_step(presence_engine_t *e,
+                          const presence_sample_t *sample,
+                          uint32_t dt_ms,
+                          const presence_engine_settings_t *settings,
+                          presence_decision_t *decision);
+/* Steps through count samples in time order and confirms no-user once a candidate is settings->preoff_dim_ms
+ * old (the target does this in its output control). decisions may be NULL or hold count entries. Returns the
+ * number of present <-> not-present transitions. */
+uint32_t presence_engine_replay(presence_engine_t *e,
+                                const presence_timed_sample_t *samples,
+                                uint32_t count,
+                                const presence_engine_settings_t *settings,
+                                presence_decision_t *decisions);
+void presence_engine_get_decision(const presence_engine_t *e, presence_decision_t *decision);
+const char *presence_no_user_reason_to_string(presence_no_user_reason_t reason);
+
+#endif /* PRESENCE_ENGINE_H */
@@ -0,0 +1,121 @@
+#ifndef PRESENCE_HMM_H
+#define PRESENCE_HMM_H
+
+#include <stdint.h>
+
+/* Four-state hidden Markov model of the user, filtered forward one sample at a time. Belief is Q16
+ * (65536 = 1.0). Transitions are rates in per mille per second, scaled by the sample interval, so the
+ * irregular ultrasonic cadence needs no resampling. Observations are discretized (distance band, motion
+ * class, LDR shadow change) and combined naive-Bayes style from per-state likelihood tables in per mille;
+ * a missing feature contributes no evidence. One update is a few dozen multiplies and four 64-bit divides. */
+typedef enum
+{
+    PRESENCE_HMM_ACTIVE = 0U,
+    PRESENCE_HMM_STILL,
+    PRESENCE_HMM_LEAVING,
+    PRESENCE_HMM_ABSENT,
+    PRESENCE_HMM_STATE_COUNT
+} presence_hmm_state_t;
+
+typedef enum
+{
+    PRESENCE_HMM_DIST_NEAR = 0U,        /* at the reference (chair) distance */
+    PRESENCE_HMM_DIST_FAR,              /* beyond it */
+    PRESENCE_HMM_DIST_COUNT,
+    PRESENCE_HMM_DIST_NONE = PRESENCE_HMM_DIST_COUNT
+} presence_hmm_dist_t;
+
+typedef enum
+{
+    PRESENCE_HMM_MOTION_STILL = 0U,
+    PRESENCE_HMM_MOTION_SLOW,
+    PRESENCE_HMM_MOTION_MOVING,
+    PRESENCE_HMM_MOTION_COUNT,
+    PRESENCE_HMM_MOTION_NONE = PRESENCE_HMM_MOTION_COUNT
+} presence_hmm_motion_t;
+
+typedef enum
+{
+    PRESENCE_HMM_LDR_QUIET = 0U,
+    PRESENCE_HMM_LDR_CHANGE,            /* shadow or reflection moved across the sensor */
+    PRESENCE_HMM_LDR_COUNT,
+    PRESENCE_HMM_LDR_NONE = PRESENCE_HMM_LDR_COUNT
+} presence_hmm_ldr_t;
+
+typedef struct
+{
+    presence_hmm_dist_t dist;
+    presence_hmm_motion_t motion;
+    presence_hmm_ldr_t ldr;
+} presence_hmm_obs_t;
+
+/* [from][to] in per mille per second; the diagonal is unused (stay = 1 - sum of leaving). */
+typedef struct
+{
+    uint16_t permille_s[PRESENCE_HMM_STATE_COUNT][PRESENCE_HMM_STATE_COUNT];
+} presence_hmm_rates_t;
+
+typedef struct
+{
+    presence_hmm_rates_t rates;
+    uint16_t dist_permille[PRESENCE_HMM_STATE_COUNT][PRESENCE_HMM_DIST_COUNT];
+    uint16_t motion_permille[PRESENCE_HMM_STATE_COUNT][PRESENCE_HMM_MOTION_COUNT];
+    uint16_t ldr_permille[PRESENCE_HMM_STATE_COUNT][PRESENCE_HMM_LDR_COUNT];
+    uint16_t floor_q16;                 /* minimum belief per state, bounds the time to recover from certainty */
+} presence_hmm_model_t;
+
+/* Defaults for a seated desk user sampled every 100..250 ms. Still -> absent and leaving -> absent are
+ * placeholders: the presence engine derives them from the stale and away timeouts in the user settings.
+ * An empty chair reads near and still like a very still user, so still and absent emit that alike and
+ * only the still -> absent prior moves belief between them; any micro-motion or shadow change is 5..20x
+ * more likely from a user and pulls it back. Leaving emits far and moving; absent is split on distance
+ * because the sensor may see the empty chair or the wall behind it. */
+#define PRESENCE_HMM_MODEL_DEFAULTS                                                                      \
+    {                                                                                                    \
+        .rates = {                                                                                       \
+            .permille_s = {                                                                              \
+                { 0U, 150U, 30U, 0U },                                                                   \
+                { 20U, 0U, 0U, 12U },                                                                    \
+                { 20U, 0U, 0U, 46U },                                                                    \
+                { 20U, 0U, 0U, 0U },                                                                     \
+            },                                                                                           \
+        },                                                                                               \
+        .dist_permille = {                                                                               \
+            { 850U, 150U },                                                                              \
+            { 900U, 100U },                                                                              \
+            { 300U, 700U },                                                                              \
+            { 700U, 300U },                                                                              \
+        },                                                                                               \
+        .motion_permille = {                                                                             \
+            { 300U, 350U, 350U },                                                                        \
+            { 800U, 180U, 20U },                                                                         \
+            { 425U, 300U, 275U },                                                                        \
+            { 990U, 9U, 1U },                                                                            \
+        },                                                                                               \
+        .ldr_permille = {                                                                                \
+            { 800U, 200U },                                                                              \
+            { 950U, 50U },                                                                               \
+            { 970U, 30U },                                                                               \
+            { 990U, 10U },                                                                               \
+        },                                                                                               \
+        .floor_q16 = 16U,                                                                                \
+    }
+
+typedef struct
+{
+    uint32_t belief_q16[PRESENCE_HMM_STATE_COUNT];
+} presence_hmm_t;
+
+/* Belief split evenly between the two present states. */
+void presence_hmm_reset_present(presence_hmm_t *h);
+/* rates NULL uses model->rates. */
+void presence_hmm_step(presence_hmm_t *h,
+                       const presence_hmm_model_t *model,
+                       const presence_hmm_rates_t *rates,
+                       const presence_hmm_obs_t *obs,
+                       uint32_t dt_ms);
+uint32_t presence_hmm_present_q16(const presence_hmm_t *h);
+presence_hmm_state_t presence_hmm_map_state(const presence_hmm_t *h);
+const char *presence_hmm_state_to_string(presence_hmm_state_t state);
+
+#endif /* PRESENCE_HMM_H */
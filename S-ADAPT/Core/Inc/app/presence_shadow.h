@@ -0,0 +1,103 @@
+#ifndef PRESENCE_SHADOW_H
+#define PRESENCE_SHADOW_H
+
+#include <stdint.h>
+
+#include "app/presence_engine.h"
+
+/* Shadow evaluation of alternative presence parameters. Each shadow slot owns a full presence engine that
+ * is fed the same samples as the live engine but never touches the output; it confirms its own no-user
+ * candidates after the pre-off time, as the output control would. Per slot it accounts:
+ *   leaves / detect_*  confirmed no-user events and the time from the last "settled" sample (present, no
+ *                      candidate, no away/flat streak) to the confirmation, i.e. how long leaving took to see;
+ *   false_offs         candidates dropped again before confirmation: a user who was still there (or came
+ *                      back) during the pre-off dim;
+ *   on_ms              time the policy would have kept the lamp on (armed and present).
+ * The same accounting runs on the live engine (presence_shadow_track_update) so the numbers compare.
+ * Everything lives in the caller's set: no allocation, PRESENCE_SHADOW_MAX x sizeof(presence_engine_t). */
+#define PRESENCE_SHADOW_MAX 4U
+
+/* Overrides of the live parameters; 0 keeps the live value (use the *_enabled flags to disable a path). */
+typedef struct
+{
+    uint32_t away_timeout_ms;
+    uint32_t stale_timeout_ms;
+    uint32_t return_band_mm;
+    uint32_t flat_band_mm;              /* step rules (use_tracker = 0) */
+    uint32_t motion_delta_mm;
+    uint32_t flat_velocity_mm_s;        /* tracker rules */
+    uint32_t motion_velocity_mm_s;
+} presence_shadow_policy_t;
+
+typedef struct
+{
+    uint32_t leaves;
+    uint32_t detect_sum_ms;
+    uint32_t detect_max_ms;
+    uint32_t false_offs;
+    uint32_t on_ms;
+} presence_shadow_stats_t;
+
+typedef struct
+{
+    presence_shadow_stats_t stats;
+    uint32_t settled_ms;                /* engine clock of the last settled sample */
+    uint8_t was_present;
+    uint8_t had_candidate;
+} presence_shadow_track_t;
+
+/* Cost of one policy step in the caller's clock (DWT cycles on target); count = steps measured. */
+typedef struct
+{
+    uint32_t count;
+    uint32_t sum;
+    uint32_t max;
+} presence_shadow_cost_t;
+
+typedef struct
+{
+    presence_shadow_policy_t policy;
+    presence_engine_t engine;
+    presence_shadow_track_t track;
+    presence_shadow_cost_t cost;
+} presence_shadow_slot_t;
+
+/* Returns a free-running cycle (or any tick) count; differences must be wrap-safe in uint32_t. */
+typedef uint32_t (*presence_shadow_clock_t)(void);
+
+typedef struct
+{
+    presence_shadow_slot_t slot[PRESENCE_SHADOW_MAX];
+    uint8_t count;
+} presence_shadow_set_t;
+
+/* Builds one engine per policy from the live configuration; count is clamped to PRESENCE_SHADOW_MAX. */
+void presence_shadow_init(presence_shadow_set_t *set,
+                          const presence_engine_cfg_t *live_cfg,
+                          const presence_shadow_policy_t *policies,
+                          uint8_t count);
+void presence_shadow_arm(presence_shadow_set_t *set);
+void presence_shadow_disarm(presence_shadow_set_t *set);
+/* Steps every slot with the live settings (with preoff_dim_ms set to the real pre-off time) patched by its
+ * policy. clock may be NULL; otherwise each slot's step, confirmation and accounting is timed with it. */
+void presence_shadow_step(presence_shadow_set_t *set,
+                          const presence_sample_t *sample,
+                          uint32_t dt_ms,
+                          const presence_engine_settings_t *live_settings,
+                          presence_shadow_clock_t clock);
+/* Patches settings with a policy's overrides; also gives the effective values for reporting. */
+void presence_shadow_apply_settings(presence_engine_settings_t *settings, const presence_shadow_policy_t *policy);
+/* Drops slots from the end until count remain, e.g. when their measured cost exceeds the budget. */
+void presence_shadow_limit(presence_shadow_set_t *set, uint8_t count);
+
+/* Copies a slot's step cost since the last call into out and restarts the window (keeps the sums small). */
+void presence_shadow_take_cost(presence_shadow_set_t *set, uint8_t index, presence_shadow_cost_t *out);
+
+void presence_shadow_track_reset(presence_shadow_track_t *track, const presence_engine_t *e);
+/* Re-baselines after the engine was armed or disarmed, keeping the statistics. */
+void presence_shadow_track_sync(presence_shadow_track_t *track, const presence_engine_t *e);
+/* Accounts one step of any engine: call after the step (and after a confirmation, if any) with its dt. */
+void presence_shadow_track_update(presence_shadow_track_t *track, const presence_engine_t *e, uint32_t dt_ms);
+uint32_t presence_shadow_detect_avg_ms(const presence_shadow_stats_t *stats);
+
+#endif /* PRESENCE_SHADOW_H */
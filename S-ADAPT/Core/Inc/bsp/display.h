@@ -34,6 +34,7 @@ typedef enum
     DISPLAY_SETTINGS_ROW_FLAT_TIMEOUT,
     DISPLAY_SETTINGS_ROW_PREOFF_DIM,
     DISPLAY_SETTINGS_ROW_RETURN_BAND,
+    DISPLAY_SETTINGS_ROW_LAMP_CAL,
     DISPLAY_SETTINGS_ROW_SAVE,
     DISPLAY_SETTINGS_ROW_RESET,
     DISPLAY_SETTINGS_ROW_EXIT,
@@ -48,6 +49,14 @@ typedef enum
     DISPLAY_SETTINGS_STATUS_RESET
 } display_settings_status_t;
 
+typedef enum
+{
+    DISPLAY_LAMP_CAL_NONE = 0,
+    DISPLAY_LAMP_CAL_RUNNING,
+    DISPLAY_LAMP_CAL_OK,
+    DISPLAY_LAMP_CAL_ERR
+} display_lamp_cal_t;
+
 typedef struct
 {
     display_mode_t mode;
@@ -74,6 +83,8 @@ typedef struct
     uint16_t stale_timeout_s;
     uint16_t preoff_dim_s;
     uint8_t return_band_cm;
+    display_lamp_cal_t lamp_cal;
+    uint8_t lamp_cal_progress_percent;
     display_settings_status_t status;
 } display_settings_view_t;
 
@@ -3,19 +3,56 @@
 
 #include "stm32l4xx_hal.h"
 
+/* Lamp PWM timebase, set up at start from the timer clock: MAIN_LED_PWM_COUNTS ticks per period at
+ * MAIN_LED_PWM_HZ. Frequency and resolution trade off against the 32 MHz clock (32000 counts at 1 kHz,
+ * 4000 at 8 kHz). The synced LDR backend converts once per period, so its averaging window scales with it. */
+#ifndef MAIN_LED_PWM_HZ
+#define MAIN_LED_PWM_HZ      1000U
+#endif
+
+#ifndef MAIN_LED_PWM_COUNTS
+#define MAIN_LED_PWM_COUNTS  32000U
+#endif
+
+/* Temporal dithering: the compare value cycles through 2^BITS PWM periods by DMA on the timer update, so a
+ * level between two counts is shown as a mix of both. 0 writes the nearest count directly. */
+#ifndef MAIN_LED_DITHER_BITS
+#define MAIN_LED_DITHER_BITS 4U
+#endif
+
+#if (MAIN_LED_PWM_COUNTS < 100U) || (MAIN_LED_PWM_COUNTS > 65535U)
+#error "MAIN_LED_PWM_COUNTS must be 100..65535"
+#endif
+#if MAIN_LED_DITHER_BITS > 6U
+#error "MAIN_LED_DITHER_BITS must be 0..6"
+#endif
+
+/* Output level: perceived lightness in percent Q8, mapped to duty through the CIE curve. */
+#define MAIN_LED_LEVEL_FULL  (100U << 8)
+
 typedef enum
 {
     MAIN_LED_STATUS_OK = 0,
     MAIN_LED_STATUS_NOT_INIT,
     MAIN_LED_STATUS_NULL_PTR,
     MAIN_LED_STATUS_INVALID_PERCENT,
-    MAIN_LED_STATUS_HAL_START_ERROR
+    MAIN_LED_STATUS_HAL_START_ERROR,
+    MAIN_LED_STATUS_INVALID_CONFIG
 } main_led_status_t;
 
 void main_led_init(TIM_HandleTypeDef *htim, uint32_t channel);
 main_led_status_t main_led_start(void);
+main_led_status_t main_led_set_level(uint16_t level_q8);
 main_led_status_t main_led_set_percent(uint8_t percent);
+uint16_t main_led_get_level(void);
 uint8_t main_led_get_percent(void);
+/* Timebase actually programmed (the prescaler rounds MAIN_LED_PWM_HZ to the timer clock). */
+uint32_t main_led_get_pwm_hz(void);
+uint32_t main_led_get_pwm_counts(void);
+/* 1 when the update DMA is cycling the dither frame. */
+uint8_t main_led_dither_active(void);
+/* 1 when TIM1 TRGO2 (OC4REF) is pulsing at the LDR sample phase inside the PWM off-window. */
+uint8_t main_led_adc_sync_active(void);
 main_led_status_t main_led_set_enabled(uint8_t enabled);
 const char *main_led_status_to_string(main_led_status_t status);
 
@@ -0,0 +1,37 @@
+#ifndef GESTURE_INPUT_H
+#define GESTURE_INPUT_H
+
+#include "stm32l4xx_hal.h"
+
+typedef enum
+{
+    GESTURE_EVENT_HOVER_HOLD = 0,
+    GESTURE_EVENT_STEP_UP,
+    GESTURE_EVENT_STEP_DOWN
+} gesture_event_type_t;
+
+typedef struct
+{
+    gesture_event_type_t type;
+    uint32_t timestamp_ms;
+} gesture_event_t;
+
+typedef struct
+{
+    uint32_t zone_min_mm;
+    uint32_t zone_max_mm;
+    uint32_t hold_ms;
+    uint32_t hold_band_mm;
+    uint32_t step_mm;
+} gesture_input_cfg_t;
+
+/* Hand-gesture recognizer on the ultrasonic distance stream (O(1) per sample).
+ * Hover-hold: hand stays within hold_band_mm for hold_ms. Step up/down: hand moves step_mm toward/away from
+ * the sensor; after a step the hover-hold is suppressed until the hand leaves the zone. */
+void gesture_input_init(const gesture_input_cfg_t *cfg);
+void gesture_input_reset(void);
+void gesture_input_push_sample(uint32_t now_ms, uint32_t distance_mm, uint8_t valid);
+uint8_t gesture_input_hand_present(void);
+uint8_t gesture_input_pop_event(gesture_event_t *out_event);
+
+#endif /* GESTURE_INPUT_H */
@@ -3,6 +3,32 @@
 
 #include "stm32l4xx_hal.h"
 
+/* Backend selection (build flag). POLLED: start/poll/stop one conversion per read.
+ * DMA: ADC1 converts continuously through the hardware oversampler into a circular DMA word; reads are a load.
+ * FLICKER: TIM6-paced 6 kHz bursts integrated over whole mains-flicker periods (100/120 Hz, auto-detected),
+ * for desks lit by mains lamps; also reports the flicker amplitude. */
+#define LDR_BACKEND_POLLED 0U
+#define LDR_BACKEND_DMA 1U
+#define LDR_BACKEND_FLICKER 2U
+
+#ifndef LDR_BACKEND
+#define LDR_BACKEND LDR_BACKEND_DMA
+#endif
+
+/* DMA backend only: trigger each conversion from TIM1 TRGO2 (lamp PWM off-window, see main_led) instead of
+ * free-running, so lamp ripple is sampled at a fixed phase. */
+#ifndef LDR_PWM_SYNC
+#define LDR_PWM_SYNC 1U
+#endif
+
+/* DMA backend only: ADC1 analog watchdog 1 watches the oversampled LDR value and interrupts once it leaves an
+ * armed window, so the app can stop polling while ambient light is steady. */
+#ifndef LDR_AWD_EVENTS
+#define LDR_AWD_EVENTS 1U
+#endif
+
+#define LDR_WATCH_SUPPORTED ((LDR_BACKEND == LDR_BACKEND_DMA) && (LDR_AWD_EVENTS != 0U))
+
 typedef enum
 {
     LDR_STATUS_OK = 0,
@@ -11,11 +37,34 @@ typedef enum
     LDR_STATUS_START_ERROR,
     LDR_STATUS_POLL_ERROR,
     LDR_STATUS_TIMEOUT,
-    LDR_STATUS_STOP_ERROR
+    LDR_STATUS_STOP_ERROR,
+    LDR_STATUS_OVERRUN,
+    LDR_STATUS_UNSUPPORTED
 } ldr_status_t;
 
+typedef struct
+{
+    uint16_t mean_raw;          /* average over whole flicker periods (what ldr_read_raw() returns) */
+    uint16_t ripple_pp_raw;     /* peak-to-peak within those periods */
+    uint8_t flicker_hz;         /* 100 or 120; 0 while the ripple is below the detection floor */
+} ldr_flicker_t;
+
 void ldr_init(ADC_HandleTypeDef *hadc);
 ldr_status_t ldr_read_raw(uint16_t *out_raw);
+
+/* Level watch: arm() sets an inclusive raw window; the first value outside it latches one event and disables
+ * the interrupt until the next arm(). take_event() returns and clears the latch. */
+ldr_status_t ldr_watch_arm(uint16_t low_raw, uint16_t high_raw);
+uint8_t ldr_watch_take_event(void);
+void ldr_on_awd_isr(ADC_HandleTypeDef *hadc);
+
+/* DMA backend with LDR_PWM_SYNC: switch to free-running conversions when TIM1 TRGO2 is not available (lamp
+ * timer failed to start or has no sync channel). Until then ldr_read_raw() returns NOT_INIT, never a stale 0.
+ * No-op on other builds. */
+ldr_status_t ldr_use_free_running(void);
+
+/* FLICKER backend only; other backends return LDR_STATUS_UNSUPPORTED. */
+ldr_status_t ldr_get_flicker(ldr_flicker_t *out);
 const char *ldr_status_to_string(ldr_status_t status);
 
 #endif /* LDR_H */
@@ -0,0 +1,21 @@
+#ifndef MCU_TEMP_H
+#define MCU_TEMP_H
+
+#include "stm32l4xx_hal.h"
+
+typedef enum
+{
+    MCU_TEMP_STATUS_OK = 0,
+    MCU_TEMP_STATUS_NOT_INIT,
+    MCU_TEMP_STATUS_NULL_PTR,
+    MCU_TEMP_STATUS_CONFIG_ERROR,
+    MCU_TEMP_STATUS_START_ERROR,
+    MCU_TEMP_STATUS_TIMEOUT
+} mcu_temp_status_t;
+
+/* Internal temperature sensor on an ADC1 injected channel, so the regular (LDR) sequence is untouched. */
+void mcu_temp_init(ADC_HandleTypeDef *hadc);
+mcu_temp_status_t mcu_temp_read_deci_c(int32_t *out_deci_c);
+const char *mcu_temp_status_to_string(mcu_temp_status_t status);
+
+#endif /* MCU_TEMP_H */
@@ -3,6 +3,25 @@
 
 #include "stm32l4xx_hal.h"
 
+/* Backend selection (build flag). CAPTURE_IT: firmware fires TRIG and times the echo in the TIM2 ISR.
+ * HW_TIMED: TIM2 CH1 PWM generates TRIG periodically and CH2 captures both echo edges into DMA. */
+#define ULTRASONIC_BACKEND_CAPTURE_IT 0U
+#define ULTRASONIC_BACKEND_HW_TIMED 1U
+
+#ifndef ULTRASONIC_BACKEND
+#define ULTRASONIC_BACKEND ULTRASONIC_BACKEND_CAPTURE_IT
+#endif
+
+/* Ping period of the HW_TIMED backend; the timer runs free at this rate independent of the app cadence. */
+#ifndef ULTRASONIC_HW_PERIOD_US
+#define ULTRASONIC_HW_PERIOD_US 100000U
+#endif
+
+/* Instances the ISR dispatch can hold; each CAPTURE_IT instance needs one capture and one compare channel. */
+#ifndef ULTRASONIC_MAX_INSTANCES
+#define ULTRASONIC_MAX_INSTANCES 4U
+#endif
+
 typedef enum
 {
     ULTRASONIC_STATUS_OK = 0,
@@ -11,13 +30,57 @@ typedef enum
     ULTRASONIC_STATUS_TIMEOUT_RISING,
     ULTRASONIC_STATUS_TIMEOUT_FALLING,
     ULTRASONIC_STATUS_OVERCAPTURE_RISING,
-    ULTRASONIC_STATUS_OVERCAPTURE_FALLING
+    ULTRASONIC_STATUS_OVERCAPTURE_FALLING,
+    ULTRASONIC_STATUS_BUSY
 } ultrasonic_status_t;
 
-void ultrasonic_init(TIM_HandleTypeDef *tim, uint32_t channel);
-uint32_t ultrasonic_read_echo_us(uint32_t timeout_us);
-uint32_t ultrasonic_read_distance_cm(uint32_t timeout_us, uint32_t error_value_cm);
-ultrasonic_status_t ultrasonic_get_last_status(void);
+/* Wiring of one HC-SR04. Several instances may share a timer as long as their channels differ. The
+ * HW_TIMED backend supports a single instance with ECHO on TIM2 CH2 and TRIG on TIM2 CH1 (PA0). */
+typedef struct
+{
+    TIM_HandleTypeDef *tim;
+    uint32_t echo_channel;              /* input capture, both edges of ECHO */
+    uint32_t trig_cc_channel;           /* internal compare (no pin) that ends the TRIG pulse */
+    GPIO_TypeDef *trig_port;
+    uint16_t trig_pin;
+} ultrasonic_hw_t;
+
+/* One sensor channel. Fields are owned by the driver (and its ISRs); read them only through the functions. */
+typedef struct
+{
+    ultrasonic_hw_t hw;
+    volatile ultrasonic_status_t last_status;
+    volatile uint8_t phase;
+    volatile uint32_t phase_start_tick;
+    volatile uint32_t rise_tick;
+    volatile uint32_t echo_us;
+    uint32_t timeout_us;
+} ultrasonic_t;
+
+/* Registers the instance for ISR dispatch; re-initialising an instance keeps its slot. */
+void ultrasonic_init(ultrasonic_t *us, const ultrasonic_hw_t *hw);
+
+/* Non-blocking ranging: start() fires TRIG, capture interrupts time the echo, poll() collects the result.
+ * With the HW_TIMED backend start() only updates the timeout and poll() returns each completed hardware ping. */
+ultrasonic_status_t ultrasonic_start(ultrasonic_t *us, uint32_t timeout_us);
+uint8_t ultrasonic_poll(ultrasonic_t *us, uint32_t *out_echo_us);
+uint8_t ultrasonic_is_busy(const ultrasonic_t *us);
+/* HW_TIMED: reprograms the free-running ping period (ULTRASONIC_HW_PERIOD_US at init); it takes effect at the
+ * next period boundary. Values must leave room for the TRIG pulse and the echo timeout. No-op on CAPTURE_IT. */
+ultrasonic_status_t ultrasonic_set_period_us(ultrasonic_t *us, uint32_t period_us);
+/* HAL callback entry points: dispatch to whichever registered instance owns the timer channel. */
+void ultrasonic_on_capture_isr(TIM_HandleTypeDef *tim);
+void ultrasonic_on_compare_isr(TIM_HandleTypeDef *tim);
+
+/* Blocking wrappers kept for bring-up code; they spin on ultrasonic_poll(). */
+uint32_t ultrasonic_read_echo_us(ultrasonic_t *us, uint32_t timeout_us);
+uint32_t ultrasonic_read_distance_cm(ultrasonic_t *us, uint32_t timeout_us, uint32_t error_value_cm);
+uint32_t ultrasonic_echo_us_to_cm(uint32_t echo_us);
+/* Fixed-point millimetre conversion: scale is mm per echo microsecond in Q16 (~11253 at 20 degC),
+ * computed once per temperature (0.1 degC) so each echo costs one multiply-shift. */
+uint32_t ultrasonic_mm_per_us_q16(int32_t temp_deci_c);
+uint32_t ultrasonic_echo_us_to_mm(uint32_t echo_us, uint32_t mm_per_us_q16);
+ultrasonic_status_t ultrasonic_get_last_status(const ultrasonic_t *us);
 const char *ultrasonic_status_to_string(ultrasonic_status_t status);
 
 #endif /* ULTRASONIC_H */
@@ -0,0 +1,52 @@
+#ifndef ULTRASONIC_BURST_H
+#define ULTRASONIC_BURST_H
+
+#include "sensors/ultrasonic.h"
+
+#define ULTRASONIC_BURST_MAX_PINGS 5U
+
+typedef struct
+{
+    uint8_t ping_count;
+    uint32_t ping_timeout_us;
+    uint32_t dead_time_ms;
+    uint32_t agree_band_us;
+} ultrasonic_burst_cfg_t;
+
+typedef struct
+{
+    ultrasonic_status_t status;
+    uint32_t echo_us;
+    uint32_t distance_mm;
+    uint8_t valid_pings;
+    uint8_t agreeing_pings;
+    uint8_t confidence_percent;
+    uint8_t beyond_range;       /* 1: no echo within ping_timeout_us; distance_mm is the range limit */
+} ultrasonic_burst_result_t;
+
+typedef struct
+{
+    ultrasonic_t *us;
+    ultrasonic_burst_cfg_t cfg;
+    uint8_t phase;
+    uint32_t echo_us[ULTRASONIC_BURST_MAX_PINGS];
+    uint8_t valid_count;
+    uint8_t beyond_count;
+    uint8_t pings_done;
+    ultrasonic_status_t last_error;
+    uint32_t dead_start_ms;
+    uint32_t mm_per_us_q16;
+} ultrasonic_burst_t;
+
+/* Burst ranging on top of ultrasonic_start()/ultrasonic_poll(): N pings per slot separated by an echo
+ * dead-time, fused by median + agreement band, reported in mm. Confidence = agreeing pings / pings fired.
+ * A burst whose pings all outlast the timeout reports the range limit with beyond_range set.
+ * One burst object per sensor instance; us must outlive it. */
+void ultrasonic_burst_init(ultrasonic_burst_t *b, ultrasonic_t *us, const ultrasonic_burst_cfg_t *cfg);
+/* Changes the profile (e.g. gesture vs presence); call while the burst is idle. */
+void ultrasonic_burst_configure(ultrasonic_burst_t *b, const ultrasonic_burst_cfg_t *cfg);
+ultrasonic_status_t ultrasonic_burst_start(ultrasonic_burst_t *b, int32_t temp_deci_c);
+uint8_t ultrasonic_burst_poll(ultrasonic_burst_t *b, uint32_t now_ms, ultrasonic_burst_result_t *out_result);
+uint8_t ultrasonic_burst_is_busy(const ultrasonic_burst_t *b);
+
+#endif /* ULTRASONIC_BURST_H */
@@ -0,0 +1,38 @@
+#ifndef ULTRASONIC_ZONES_H
+#define ULTRASONIC_ZONES_H
+
+#include "sensors/ultrasonic_burst.h"
+
+/* Round-robin ping scheduler for several ultrasonic sensors covering adjacent zones. A round fires the
+ * selected zones one after another, never two at once: an HC-SR04 cannot tell its own echo from a
+ * neighbour's, so a different zone waits guard_ms after the previous burst ends for late reflections to
+ * die out. Zones run back to back inside a round, so N zones cost N bursts per interval instead of N intervals. */
+#define ULTRASONIC_ZONES_MAX   4U
+#define ULTRASONIC_ZONES_NONE  0xFFU
+
+typedef struct
+{
+    ultrasonic_burst_t *bursts;
+    uint8_t count;
+    uint32_t guard_ms;
+    uint8_t pending_mask;       /* zones still to fire in this round */
+    uint8_t active_zone;        /* burst in flight, or ULTRASONIC_ZONES_NONE */
+    uint8_t next_zone;
+    uint8_t last_zone;          /* zone whose burst ended last; its own re-ping needs no guard */
+    uint32_t last_done_ms;
+    int32_t temp_deci_c;
+} ultrasonic_zones_t;
+
+/* bursts[count] must already be initialised with their sensor instances. */
+void ultrasonic_zones_init(ultrasonic_zones_t *z, ultrasonic_burst_t *bursts, uint8_t count, uint32_t guard_ms);
+/* Queues one burst per zone in zone_mask (bit n = zone n). Returns BUSY while a round is still running. */
+ultrasonic_status_t ultrasonic_zones_start_round(ultrasonic_zones_t *z, uint8_t zone_mask, int32_t temp_deci_c);
+/* Advances the round; returns 1 with the zone index when one zone's burst finished. A zone whose burst
+ * cannot start reports that status with no valid pings. */
+uint8_t ultrasonic_zones_poll(ultrasonic_zones_t *z,
+                              uint32_t now_ms,
+                              uint8_t *out_zone,
+                              ultrasonic_burst_result_t *out_result);
+uint8_t ultrasonic_zones_is_busy(const ultrasonic_zones_t *z);
+
+#endif /* ULTRASONIC_ZONES_H */
@@ -58,6 +58,8 @@ void SysTick_Handler(void);
 /* USER CODE BEGIN EFP */
 void EXTI1_IRQHandler(void);
 void EXTI15_10_IRQHandler(void);
+void TIM2_IRQHandler(void);
+void ADC1_IRQHandler(void);
 
 /* USER CODE END EFP */
 
@@ -0,0 +1,27 @@
+#ifndef CIE_LIGHTNESS_H
+#define CIE_LIGHTNESS_H
+
+#include <stdint.h>
+
+/* CIE 1976 lightness -> relative luminance, so equal output steps look equal. Lightness is percent in Q8
+ * (0..25600, the lux-curve unit) on a 1 % grid; luminance is a fraction of full scale in Q24. */
+#define CIE_LIGHTNESS_SHIFT      8U
+#define CIE_LIGHTNESS_FULL_Q8    (100U << CIE_LIGHTNESS_SHIFT)
+#define CIE_LIGHTNESS_ENTRIES    101U
+#define CIE_LUMINANCE_ONE_Q24    (1UL << 24)
+
+typedef struct
+{
+    uint32_t luminance_q24[CIE_LIGHTNESS_ENTRIES];
+} cie_lightness_t;
+
+/* Build time (driver init): integer evaluation of the CIE curve at each grid point. */
+void cie_lightness_build(cie_lightness_t *table);
+
+/* Output path: one table step, one multiply and a shift. */
+uint32_t cie_lightness_to_luminance(const cie_lightness_t *table, uint16_t lightness_q8);
+
+/* Settings migration: nearest whole lightness percent for a linear (duty) percent. No table needed. */
+uint8_t cie_lightness_percent_from_luminance(uint8_t luminance_percent);
+
+#endif /* CIE_LIGHTNESS_H */
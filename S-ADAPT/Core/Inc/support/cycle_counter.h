@@ -0,0 +1,20 @@
+#ifndef CYCLE_COUNTER_H
+#define CYCLE_COUNTER_H
+
+#include "stm32l4xx_hal.h"
+
+/* DWT cycle counter for on-target cost measurements (32 MHz: 1 cycle = 31.25 ns, wraps after ~134 s).
+ * Differences of two reads are wrap-safe in uint32_t. */
+static inline void cycle_counter_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t cycle_counter_now(void)
+{
+    return DWT->CYCCNT;
+}
+
+#endif /* CYCLE_COUNTER_H */
@@ -0,0 +1,65 @@
+#ifndef DISTANCE_TRACKER_H
+#define DISTANCE_TRACKER_H
+
+#include <stdint.h>
+
+/* Constant-velocity Kalman tracker for the fused ultrasonic distance. State is position (mm, Q8) and
+ * velocity (mm/s, Q8); covariance is kept in integer mm^2, mm^2/s and (mm/s)^2. Missing or gated samples
+ * only run the prediction, so the estimate keeps moving and its variance grows instead of freezing. */
+typedef enum
+{
+    DISTANCE_TRACKER_STATUS_NOT_INIT = 0U,
+    DISTANCE_TRACKER_STATUS_TRACKING,
+    DISTANCE_TRACKER_STATUS_COASTING,
+    DISTANCE_TRACKER_STATUS_GATED,
+    DISTANCE_TRACKER_STATUS_REINIT,
+    DISTANCE_TRACKER_STATUS_LOST
+} distance_tracker_status_t;
+
+typedef struct
+{
+    uint16_t accel_noise_mm_s2;     /* process noise: 1-sigma unmodelled acceleration */
+    uint16_t meas_noise_mm;         /* measurement noise: 1-sigma of one fused sample */
+    uint16_t init_velocity_mm_s;    /* 1-sigma velocity uncertainty on (re)start */
+    uint8_t gate_sigma;             /* innovations beyond this many sigma are not applied */
+    uint8_t max_gated;              /* consecutive gated samples before re-initializing on the measurement */
+    uint32_t max_coast_ms;          /* prediction-only time before the track is dropped */
+} distance_tracker_cfg_t;
+
+typedef struct
+{
+    distance_tracker_cfg_t cfg;
+    int32_t pos_q8;
+    int32_t vel_q8;
+    int64_t p00;
+    int64_t p01;
+    int64_t p11;
+    int32_t innovation_mm;
+    uint32_t innovation_var_mm2;
+    uint32_t last_ms;
+    uint32_t coast_ms;
+    uint8_t gated_count;
+    distance_tracker_status_t status;
+} distance_tracker_t;
+
+typedef struct
+{
+    uint32_t distance_mm;
+    int32_t velocity_mm_s;
+    uint32_t distance_var_mm2;
+    uint32_t velocity_var_mm2_s2;
+    int32_t innovation_mm;
+    uint32_t innovation_var_mm2;
+    distance_tracker_status_t status;
+} distance_tracker_estimate_t;
+
+void distance_tracker_init(distance_tracker_t *t, const distance_tracker_cfg_t *cfg);
+void distance_tracker_reset(distance_tracker_t *t);
+/* valid == 0 marks a dropped or low-confidence sample: prediction only. */
+distance_tracker_status_t distance_tracker_update(distance_tracker_t *t, uint32_t now_ms, uint32_t distance_mm, uint8_t valid);
+void distance_tracker_get(const distance_tracker_t *t, distance_tracker_estimate_t *out);
+/* 1 when |velocity| exceeds both min_mm_s and sigma standard deviations of its own estimate. */
+uint8_t distance_tracker_is_moving(const distance_tracker_t *t, uint32_t min_mm_s, uint8_t sigma);
+const char *distance_tracker_status_to_string(distance_tracker_status_t status);
+
+#endif /* DISTANCE_TRACKER_H */
@@ -0,0 +1,77 @@
+#ifndef FILTER_BLOCK_H
+#define FILTER_BLOCK_H
+
+#include <stdint.h>
+
+/* Block kernels for Q15 sample buffers (DMA bursts, ping series). On the Cortex-M4 they use the dual 16-bit
+ * MAC/SIMD instructions (__SMLAD, __SSUB16); everywhere else, and under the _ref names on every build, they
+ * are plain C with identical results, so host builds can check the target path bit-exactly.
+ *
+ * All kernels are "valid-mode": in holds len + taps - 1 (or len + window - 1) samples, the oldest first,
+ * and history across blocks is the caller's tail copy. FIR coefficients are applied in correlation order:
+ * coeffs[0] weights the oldest sample of each window (symmetric filters are unaffected).
+ *
+ * Range contract, which keeps the 32-bit accumulators exact on both paths:
+ * - FIR: sum(|coeffs|) <= 32768 (unity gain in Q15); output is rounded and saturated to Q15.
+ * - Sums: |x| <= 16383 (12-bit ADC counts and Q14 fit), len/window <= 65535. */
+#ifndef FILTER_BLOCK_USE_SIMD
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define FILTER_BLOCK_USE_SIMD 1U
+#else
+#define FILTER_BLOCK_USE_SIMD 0U
+#endif
+#endif
+
+int32_t filter_block_sum_q15(const int16_t *in, uint16_t len);
+void filter_block_fir_q15(const int16_t *in, uint16_t len, const int16_t *coeffs, uint16_t taps, int16_t *out);
+/* out[m] = FIR window starting at in[m * factor], m = 0 .. out_len - 1; in holds (out_len - 1) * factor + taps samples. */
+void filter_block_fir_decimate_q15(const int16_t *in,
+                                   uint16_t out_len,
+                                   uint8_t factor,
+                                   const int16_t *coeffs,
+                                   uint16_t taps,
+                                   int16_t *out);
+/* out[n] = in[n] + .. + in[n + window - 1], n = 0 .. len - 1. */
+void filter_block_moving_sum_q15(const int16_t *in, uint16_t len, uint16_t window, int32_t *out);
+
+int32_t filter_block_sum_q15_ref(const int16_t *in, uint16_t len);
+void filter_block_fir_q15_ref(const int16_t *in, uint16_t len, const int16_t *coeffs, uint16_t taps, int16_t *out);
+void filter_block_fir_decimate_q15_ref(const int16_t *in,
+                                       uint16_t out_len,
+                                       uint8_t factor,
+                                       const int16_t *coeffs,
+                                       uint16_t taps,
+                                       int16_t *out);
+void filter_block_moving_sum_q15_ref(const int16_t *in, uint16_t len, uint16_t window, int32_t *out);
+
+/* On-target cycle counts of each kernel against its _ref version over one FILTER_BLOCK_BENCH_LEN block
+ * (DWT CYCCNT, interrupts left enabled, so take the minimum of a few runs). Build with FILTER_BLOCK_BENCH=1. */
+#ifndef FILTER_BLOCK_BENCH
+#define FILTER_BLOCK_BENCH 0U
+#endif
+
+#define FILTER_BLOCK_BENCH_LEN  128U
+#define FILTER_BLOCK_BENCH_TAPS 16U
+
+typedef enum
+{
+    FILTER_BLOCK_BENCH_SUM = 0U,
+    FILTER_BLOCK_BENCH_FIR,
+    FILTER_BLOCK_BENCH_FIR_DECIMATE4,
+    FILTER_BLOCK_BENCH_MOVING_SUM,
+    FILTER_BLOCK_BENCH_COUNT
+} filter_block_bench_kernel_t;
+
+typedef struct
+{
+    uint32_t simd_cycles[FILTER_BLOCK_BENCH_COUNT];
+    uint32_t ref_cycles[FILTER_BLOCK_BENCH_COUNT];
+    uint8_t bit_exact[FILTER_BLOCK_BENCH_COUNT];
+} filter_block_bench_result_t;
+
+#if FILTER_BLOCK_BENCH
+void filter_block_bench_run(filter_block_bench_result_t *out);
+const char *filter_block_bench_kernel_to_string(filter_block_bench_kernel_t kernel);
+#endif
+
+#endif /* FILTER_BLOCK_H */
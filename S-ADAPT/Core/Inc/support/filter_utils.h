@@ -1,7 +1,8 @@
 #ifndef FILTER_UTILS_H
 #define FILTER_UTILS_H
 
-#include "stm32l4xx_hal.h"
+#include <stddef.h>
+#include <stdint.h>
 
 #define FILTER_MA_U16_MAX_WINDOW 16U
 
@@ -19,16 +20,83 @@ uint16_t filter_moving_average_u16_push(filter_moving_average_u16_t *f, uint16_t
 uint16_t filter_moving_average_u16_get(const filter_moving_average_u16_t *f);
 uint8_t filter_moving_average_u16_is_ready(const filter_moving_average_u16_t *f);
 
+/* Exponential moving average, y += (x - y) / 2^shift, state in Q8 so small steps are not lost to
+ * truncation. Divide-free; shift 0 passes samples through. */
+#define FILTER_EMA_MAX_SHIFT 12U
+
+typedef struct
+{
+    int32_t acc_q8;
+    uint8_t shift;
+    uint8_t initialized;
+} filter_ema_u16_t;
+
+void filter_ema_u16_init(filter_ema_u16_t *f, uint8_t shift);
+uint16_t filter_ema_u16_push(filter_ema_u16_t *f, uint16_t sample);
+uint16_t filter_ema_u16_get(const filter_ema_u16_t *f);
+
+/* One-Euro style adaptive EMA: the smoothing factor rises with the filtered rate of change,
+ * alpha = min(1, min_alpha + beta * |dx|) with dx in counts per sample. This is the first-order form of
+ * the One-Euro cutoff law (alpha ~ 2*pi*fc*Te, fc = fc_min + beta*|dx|), saturating at pass-through, so
+ * the hot path needs only multiplies and shifts. Steady input sits at min_alpha; a step drives alpha
+ * to 1 within a few samples. */
+typedef struct
+{
+    uint16_t min_alpha_q16;     /* smoothing at rest, 65535 ~ 1.0 */
+    uint16_t beta_q16;          /* alpha added per count/sample of speed */
+    uint8_t derivative_shift;   /* EMA shift applied to the per-sample change */
+} filter_one_euro_cfg_t;
+
+typedef struct
+{
+    filter_one_euro_cfg_t cfg;
+    int32_t value_q8;
+    int32_t speed_q8;
+    uint16_t last_sample;
+    uint16_t alpha_q16;
+    uint8_t initialized;
+} filter_one_euro_u16_t;
+
+void filter_one_euro_u16_init(filter_one_euro_u16_t *f, const filter_one_euro_cfg_t *cfg);
+uint16_t filter_one_euro_u16_push(filter_one_euro_u16_t *f, uint16_t sample);
+uint16_t filter_one_euro_u16_get(const filter_one_euro_u16_t *f);
+
+/* Running median over the last window_size samples (1..FILTER_MEDIAN_MAX_WINDOW). Samples are kept twice:
+ * in arrival order (ring) and sorted; a push slides the evicted slot to the new value's rank, so each update
+ * is one O(N) pass with no re-sort. Even counts return the mean of the two middle samples. */
+#define FILTER_MEDIAN_MAX_WINDOW 31U
+
+typedef enum
+{
+    FILTER_MEDIAN_WARMUP_PARTIAL = 0U,  /* median of the samples seen so far */
+    FILTER_MEDIAN_WARMUP_PREFILL,       /* first sample fills the window; later ones must outvote it */
+    FILTER_MEDIAN_WARMUP_PASSTHROUGH    /* newest sample unfiltered until the window is full */
+} filter_median_warmup_t;
+
 typedef struct
 {
-    uint32_t samples[3];
+    uint32_t ring[FILTER_MEDIAN_MAX_WINDOW];
+    uint32_t sorted[FILTER_MEDIAN_MAX_WINDOW];
+    uint8_t window_size;
     uint8_t count;
     uint8_t index;
-} filter_median3_u32_t;
+    filter_median_warmup_t warmup;
+} filter_median_u32_t;
+
+void filter_median_u32_init(filter_median_u32_t *f, uint8_t window_size, filter_median_warmup_t warmup);
+uint32_t filter_median_u32_push(filter_median_u32_t *f, uint32_t sample);
+uint32_t filter_median_u32_get(const filter_median_u32_t *f);
+uint8_t filter_median_u32_is_ready(const filter_median_u32_t *f);
+
+/* 16-bit samples share the u32 core; the values are widened on push and narrowed on read. */
+typedef struct
+{
+    filter_median_u32_t core;
+} filter_median_u16_t;
 
-void filter_median3_u32_init(filter_median3_u32_t *f);
-void filter_median3_u32_push(filter_median3_u32_t *f, uint32_t sample);
-uint32_t filter_median3_u32_get(const filter_median3_u32_t *f);
-uint8_t filter_median3_u32_is_ready(const filter_median3_u32_t *f);
+void filter_median_u16_init(filter_median_u16_t *f, uint8_t window_size, filter_median_warmup_t warmup);
+uint16_t filter_median_u16_push(filter_median_u16_t *f, uint16_t sample);
+uint16_t filter_median_u16_get(const filter_median_u16_t *f);
+uint8_t filter_median_u16_is_ready(const filter_median_u16_t *f);
 
 #endif /* FILTER_UTILS_H */
@@ -0,0 +1,29 @@
+#ifndef LUX_CURVE_H
+#define LUX_CURVE_H
+
+#include <stdint.h>
+
+#include "app/app_settings.h"
+
+/* Precomputed tables built from an app_ldr_cal_t. Lookups are two loads, two multiplies and a shift:
+ * raw ADC -> log-lux on a 64-count grid, log-lux -> output (percent in Q8) on a 128 mdec grid. */
+#define LUX_CURVE_RAW_SHIFT     6U
+#define LUX_CURVE_RAW_ENTRIES   ((4096U >> LUX_CURVE_RAW_SHIFT) + 1U)
+#define LUX_CURVE_LOG_SHIFT     7U
+#define LUX_CURVE_LOG_ENTRIES   ((APP_LDR_LOG_LUX_MAX_MDEC >> LUX_CURVE_LOG_SHIFT) + 2U)
+
+typedef struct
+{
+    uint16_t log_lux_mdec[LUX_CURVE_RAW_ENTRIES];
+    uint16_t percent_q8[LUX_CURVE_LOG_ENTRIES];
+} lux_curve_t;
+
+/* Build time (settings load/save): piecewise-linear interpolation of the calibration breakpoints. */
+void lux_curve_build(lux_curve_t *curve, const app_ldr_cal_t *cal);
+
+/* Control path: divide-free table interpolation. */
+uint16_t lux_curve_raw_to_log_lux(const lux_curve_t *curve, uint16_t raw);
+uint16_t lux_curve_log_lux_to_percent_q8(const lux_curve_t *curve, uint16_t log_lux_mdec);
+uint8_t lux_curve_log_lux_to_percent(const lux_curve_t *curve, uint16_t log_lux_mdec);
+
+#endif /* LUX_CURVE_H */
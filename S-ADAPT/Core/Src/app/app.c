@@ -1,9 +1,89 @@
 #include "app/app_internal.h"
 
+#include <string.h>
+
 #ifndef APP_ENABLE_DISPLAY
 #define APP_ENABLE_DISPLAY 1U
 #endif
 
+/* The hardware oversampler already averages ~21-32 ms per LDR value, so the software window can be short;
+ * flicker-period integration cancels mains ripple outright, so no software averaging is needed.
+ * PWM-synchronized sampling removes lamp ripple from the reading, so the output deadband can shrink too. */
+#if LDR_BACKEND == LDR_BACKEND_FLICKER
+#define APP_LDR_MA_WINDOW_SIZE 1U
+#elif LDR_BACKEND == LDR_BACKEND_DMA
+#define APP_LDR_MA_WINDOW_SIZE 2U
+#else
+#define APP_LDR_MA_WINDOW_SIZE 8U
+#endif
+
+/* Default LDR smoothing is the adaptive One-Euro filter: heavy smoothing while ambient is steady, pass-through
+ * within ~2 samples of a room-light switch. APP_LDR_SMOOTHING_MA restores the fixed moving average above. */
+#ifndef APP_LDR_SMOOTHING
+#define APP_LDR_SMOOTHING APP_LDR_SMOOTHING_ONE_EURO
+#endif
+
+#if ((LDR_BACKEND == LDR_BACKEND_DMA) && LDR_PWM_SYNC) || (LDR_BACKEND == LDR_BACKEND_FLICKER)
+#define APP_OUTPUT_HYSTERESIS_BAND_PERCENT 3U
+#else
+#define APP_OUTPUT_HYSTERESIS_BAND_PERCENT 5U
+#endif
+/* Used once a lamp calibration model is stored: self-illumination no longer needs to be absorbed by the band. */
+#define APP_OUTPUT_HYSTERESIS_BAND_COMP_PERCENT 2U
+
+/* Running-median windows. Distance: 5 rejects up to two consecutive multipath spikes for one extra sample
+ * (~100 ms) of lag over a 3-window; warm-up uses the partial median so presence starts on the first burst.
+ * LDR: 1 (bypass) by default; odd windows above 1 drop isolated spikes ahead of the moving average. */
+#ifndef APP_DIST_MEDIAN_WINDOW
+#define APP_DIST_MEDIAN_WINDOW 5U
+#endif
+#ifndef APP_LDR_MEDIAN_WINDOW
+#define APP_LDR_MEDIAN_WINDOW 1U
+#endif
+
+/* Presence flat/motion decisions from the Kalman velocity (1) or the per-sample step delta (0). */
+#ifndef APP_PRESENCE_USE_TRACKER
+#define APP_PRESENCE_USE_TRACKER 1U
+#endif
+
+/* Presence no-user decisions from the streak rules (PRESENCE_CLASSIFIER_RULES) or the HMM posterior that
+ * also uses LDR shadow changes (PRESENCE_CLASSIFIER_HMM). */
+#ifndef APP_PRESENCE_CLASSIFIER
+#define APP_PRESENCE_CLASSIFIER PRESENCE_CLASSIFIER_RULES
+#endif
+
+/* Learn the seated position and static scene returns instead of trusting the sample captured at turn-on. */
+#ifndef APP_PRESENCE_LEARN_BACKGROUND
+#define APP_PRESENCE_LEARN_BACKGROUND 1U
+#endif
+
+/* Start bringing the lamp up when the tracker sees the user walking back, before the return is confirmed. */
+#ifndef APP_PRESENCE_ARRIVAL_PRERAMP
+#define APP_PRESENCE_ARRIVAL_PRERAMP 1U
+#endif
+
+/* Zone count lives in app/app.h (main.c sizes the wiring table with it). The HW_TIMED backend owns a fixed
+ * TIM2 pin and DMA mapping, so it can drive only the seat zone. */
+#if (APP_US_ZONE_COUNT == 0U) || (APP_US_ZONE_COUNT > ULTRASONIC_ZONES_MAX)
+#error "APP_US_ZONE_COUNT must be 1..ULTRASONIC_ZONES_MAX"
+#endif
+#if (APP_US_ZONE_COUNT > 1U) && (ULTRASONIC_BACKEND == ULTRASONIC_BACKEND_HW_TIMED)
+#error "ULTRASONIC_BACKEND_HW_TIMED supports a single ultrasonic zone"
+#endif
+
+/* Alternative presence parameter sets evaluated in shadow next to the live one (0 = off). */
+#ifndef APP_PRESENCE_SHADOW_COUNT
+#define APP_PRESENCE_SHADOW_COUNT 2U
+#endif
+#if APP_PRESENCE_SHADOW_COUNT > PRESENCE_SHADOW_MAX
+#error "APP_PRESENCE_SHADOW_COUNT must be 0..PRESENCE_SHADOW_MAX"
+#endif
+
+/* Ultrasonic hand gestures (hover-hold toggles the lamp, hand up/down steps the offset). */
+#ifndef APP_ENABLE_GESTURES
+#define APP_ENABLE_GESTURES 1U
+#endif
+
 /* Bring-up aid: when enabled, shorten presence/pre-off timers for faster hardware testing. */
 /* Set to 0U for production timing behavior. */
 #ifndef APP_PRESENCE_DEBUG_TIMERS
@@ -25,8 +105,14 @@
 const app_timing_cfg_t s_timing_cfg = {
     .control_tick_ms = 33U,
     .ldr_sample_ms = 50U,
+    /* Adaptive ultrasonic cadence: fast while a presence transition is pending, stable while present, idle when light is off. */
     .us_sample_ms = 100U,
+    .us_sample_stable_ms = 250U,
+    .us_sample_idle_ms = 1000U,
+    .gesture_sample_ms = 33U,
+    .temp_sample_ms = 5000U,
     .log_ms = 1000U,
+    .shadow_log_ms = 10000U,
     .ui_min_redraw_ms = 66U,
 };
 
@@ -36,26 +122,131 @@ const app_policy_cfg_t s_policy_cfg = {
     .offset_step = 5,
     .offset_min = -50,
     .offset_max = 50,
-    .distance_error_cm = 999U,
-    .us_timeout_us = 30000U,
-    .ldr_ma_window_size = 8U,
-    .output_hysteresis_band_percent = 5U,
+    .distance_error_mm = 9990U,
+    /* Per ping: 15 ms (~2.5 m) keeps a 3-ping burst plus dead-times inside the 100 ms slot. A deeper room
+     * behind the seat reads as a beyond-range burst at ~2.5 m, which is still past ref + margin. */
+    .us_timeout_us = 15000U,
+    .us_burst_ping_count = 3U,
+    .us_burst_dead_time_ms = 10U,
+    .us_burst_agree_band_us = 290U,
+    .us_min_confidence_percent = 50U,
+    /* Die temperature stands in for air temperature; this is used until the first reading. */
+    .us_temp_fallback_deci_c = 200,
+    /* Quiet time before another zone fires: a 10 ms dead-time already covers late multipath within a zone. */
+    .us_zone_guard_ms = 10U,
+    .dist_median_window_size = APP_DIST_MEDIAN_WINDOW,
+    .dist_median_warmup = FILTER_MEDIAN_WARMUP_PARTIAL,
+    /* Seated-user motion (~0.4 g peaks) over ~8 mm fused-sample noise. A 4-sigma gate rides through
+     * leftover spikes; three gated samples in a row (a real jump) restart the track. 3 s of coasting spans
+     * the 1 s idle cadence plus two dropped bursts. */
+    .dist_tracker = {
+        .accel_noise_mm_s2 = 400U,
+        .meas_noise_mm = 8U,
+        .init_velocity_mm_s = 300U,
+        .gate_sigma = 4U,
+        .max_gated = 2U,
+        .max_coast_ms = 3000U,
+    },
+    .presence_use_tracker = APP_PRESENCE_USE_TRACKER,
+    .ldr_median_window_size = APP_LDR_MEDIAN_WINDOW,
+    .ldr_smoothing = APP_LDR_SMOOTHING,
+    .ldr_ma_window_size = APP_LDR_MA_WINDOW_SIZE,
+    /* At 50 ms: ~0.3 Hz cutoff at rest (alpha 0.086); alpha reaches 1 at ~45 counts/sample, about ten
+     * times the oversampled ADC noise, so noise alone barely moves it. */
+    .ldr_one_euro = {
+        .min_alpha_q16 = 5640U,
+        .beta_q16 = 1311U,
+        .derivative_shift = 1U,
+    },
+    /* Window spans the raw range whose AUTO output stays within 2% (below the output hysteresis band), so
+     * in-window drift could not have changed the lamp anyway; the floor keeps steep curve regions off the
+     * ADC noise. Settle before re-arming; refresh as a safety net for a lost event. */
+    .ldr_watch_margin_percent = 2U,
+    .ldr_watch_min_margin_raw = 16U,
+    .ldr_watch_settle_ms = 500U,
+    .ldr_watch_refresh_ms = 10000U,
+    /* Lamp calibration: CdS response settles well inside 600 ms; 8 reads average over 400 ms. A step that
+     * gets no readings within 3 s aborts, and lamp-off levels that moved more than 24 counts mean the room
+     * light changed during the sweep. */
+    .lamp_cal_settle_ms = 600U,
+    .lamp_cal_samples = 8U,
+    .lamp_cal_step_timeout_ms = 3000U,
+    .lamp_cal_drift_max_raw = 24U,
+    .output_hysteresis_band_percent = APP_OUTPUT_HYSTERESIS_BAND_PERCENT,
+    .output_hysteresis_band_comp_percent = APP_OUTPUT_HYSTERESIS_BAND_COMP_PERCENT,
     .output_ramp_step_percent = 1U,
     .output_ramp_step_on_percent = 3U,
     .output_ramp_step_off_percent = 5U,
-    .presence_ref_fallback_cm = 60U,
-    .presence_body_margin_cm = 20U,
+    .presence_ref_fallback_mm = 600U,
+    .presence_body_margin_mm = 200U,
     .presence_return_band_cm = 10U,
     .presence_return_confirm_ms = 1500U,
     .presence_away_timeout_ms = APP_PRESENCE_AWAY_TIMEOUT_MS,
-    .presence_flat_band_cm = 1U,
-    .presence_motion_delta_cm = 2U,
+    /* Millimetre bands; the old 1/2 cm values sat on the /58 quantization step. */
+    .presence_flat_band_mm = 6U,
+    .presence_motion_delta_mm = 15U,
+    /* Tracker thresholds: 25 mm/s is the old 6 mm band per 250 ms sample; motion needs 60 mm/s and a
+     * velocity at least 2 sigma of its own estimate. */
+    .presence_flat_velocity_mm_s = 25U,
+    .presence_motion_velocity_mm_s = 60U,
+    .presence_motion_sigma = 2U,
     .presence_stale_timeout_ms = APP_PRESENCE_STALE_TIMEOUT_MS,
     .presence_resume_motion_ms = APP_PRESENCE_RESUME_MOTION_MS,
+    .presence_streak_max_dt_ms = 500U,
+    .presence_classifier = APP_PRESENCE_CLASSIFIER,
+    .presence_hmm = PRESENCE_HMM_MODEL_DEFAULTS,
+    /* Candidate at 75 % absent (the timeout rates are scaled for it), dropped again below 50 %; recovery
+     * needs 70 % present. A shadow is a 24-count split between the fast and slow ambient averages, about
+     * three times the filtered ADC noise. */
+    .presence_hmm_candidate_permille = 750U,
+    .presence_hmm_clear_permille = 500U,
+    .presence_hmm_recover_permille = 700U,
+    .presence_ldr_shadow_delta_raw = 24U,
+    .presence_learn_background = APP_PRESENCE_LEARN_BACKGROUND,
+    /* 25 mm bins cover 0..1.6 m. Weight decays by 1/32 every 10 s (time constant ~5 min), so a new chair
+     * position takes over within minutes. The seat mode needs 30 s of sitting before it replaces the
+     * captured reference; a scene return needs 10 s of confirmed absence. */
+    .presence_background = {
+        .bin_mm = 25U,
+        .decay_period_ms = 10000U,
+        .decay_shift = 5U,
+        .sample_max_dt_ms = 500U,
+        .user_min_ms = 30000U,
+        .scene_min_ms = 10000U,
+    },
+    .presence_min_away_margin_mm = 80U,
+    /* Side zones looking past the user see the room; only returns this close count as someone seated. */
+    .presence_zone_seat_max_mm = 1200U,
+    /* An approach of 150 mm/s (well above seated sway) that reaches the return band within 1 s, held for
+     * 300 ms, predicts the return; the lamp pre-ramps to at most 35 % until it is confirmed. */
+    .presence_arrival_velocity_mm_s = (APP_PRESENCE_ARRIVAL_PRERAMP != 0U) ? 150U : 0U,
+    .presence_arrival_horizon_ms = 1000U,
+    .presence_arrival_confirm_ms = 300U,
+    .presence_arrival_preramp_percent = 35U,
+    /* A quicker policy (15 s away, 1 min stale) and a patient one (1 min away, 5 min stale, 15 cm return
+     * band); unset fields follow the live settings. All shadows together may take 16000 cycles (0.5 ms) per
+     * seat-zone sample; over that, policies are dropped from the end. */
+    .presence_shadow_count = APP_PRESENCE_SHADOW_COUNT,
+    .presence_shadow = {
+        { .away_timeout_ms = 15000U, .stale_timeout_ms = 60000U },
+        { .away_timeout_ms = 60000U, .stale_timeout_ms = 300000U, .return_band_mm = 150U },
+    },
+    .presence_shadow_budget_cycles = 16000U,
     .presence_preoff_dim_percent = 15U,
     .presence_preoff_dim_ms = APP_PRESENCE_PREOFF_DIM_MS,
     .ui_overlay_timeout_ms = 1200U,
     .ui_refresh_ms = 1000U,
+    .gesture_enabled = APP_ENABLE_GESTURES,
+    .gesture_zone_min_mm = 30U,
+    .gesture_zone_max_mm = 250U,
+    .gesture_hold_ms = 800U,
+    .gesture_hold_band_mm = 15U,
+    .gesture_step_mm = 40U,
+    .gesture_session_timeout_ms = 1500U,
+    /* Longest session; an object parked in the zone is then ignored until something moves out and back in. */
+    .gesture_session_max_ms = 6000U,
+    /* Single ping per slot at ~30 Hz; 6 ms (~1 m) covers the hand zone with margin. */
+    .gesture_ping_timeout_us = 6000U,
 };
 
 app_ctx_t s_app;
@@ -74,6 +265,25 @@ void app_settings_apply_build_defaults(app_settings_t *cfg)
     (void)app_settings_validate(cfg);
 }
 
+#if FILTER_BLOCK_BENCH
+static void app_log_filter_block_bench(void)
+{
+    filter_block_bench_result_t bench;
+    uint8_t kernel;
+
+    filter_block_bench_run(&bench);
+    for (kernel = 0U; kernel < FILTER_BLOCK_BENCH_COUNT; kernel++) {
+        debug_logln(DEBUG_PRINT_INFO,
+                    "dbg filter_bench kernel=%s len=%u simd_cyc=%lu ref_cyc=%lu exact=%u",
+                    filter_block_bench_kernel_to_string((filter_block_bench_kernel_t)kernel),
+                    (unsigned int)FILTER_BLOCK_BENCH_LEN,
+                    (unsigned long)bench.simd_cycles[kernel],
+                    (unsigned long)bench.ref_cycles[kernel],
+                    (unsigned int)bench.bit_exact[kernel]);
+    }
+}
+#endif
+
 void app_set_fatal_fault(uint8_t enabled)
 {
     s_app.control.fatal_fault = (enabled != 0U) ? 1U : 0U;
@@ -88,8 +298,9 @@ uint8_t app_init(const app_hw_config_t *hw)
     app_settings_t loaded_settings;
     uint8_t used_defaults = 0U;
     settings_store_status_t settings_status;
+    uint8_t zone;
 
-    if ((hw == NULL) || (hw->ldr_adc == NULL) || (hw->echo_tim == NULL) || (hw->main_led_tim == NULL)) {
+    if ((hw == NULL) || (hw->ldr_adc == NULL) || (hw->us_zones[0].tim == NULL) || (hw->main_led_tim == NULL)) {
         s_app.control.fatal_fault = 1U;
         debug_logln(DEBUG_PRINT_ERROR, "app init invalid hw config");
         return 0U;
@@ -99,43 +310,47 @@ uint8_t app_init(const app_hw_config_t *hw)
     s_app.timing.last_control_tick_ms = now_ms;
     s_app.timing.last_ldr_sample_ms = now_ms;
     s_app.timing.last_us_sample_ms = now_ms;
+    s_app.timing.us_interval_ms = s_timing_cfg.us_sample_idle_ms;
+    s_app.timing.last_temp_sample_ms = now_ms;
     s_app.timing.last_log_ms = now_ms;
+    s_app.timing.last_shadow_log_ms = now_ms;
     s_app.timing.last_ui_draw_ms = now_ms;
     s_app.timing.last_ui_refresh_ms = now_ms;
 
     s_app.sensors.last_ldr_raw = 0U;
     s_app.sensors.last_ldr_filtered = 0U;
     s_app.sensors.last_ldr_status = LDR_STATUS_NOT_INIT;
+    s_app.sensors.ldr_flicker_hz = 0U;
+    s_app.sensors.ldr_ripple_pp_raw = 0U;
+    s_app.sensors.ldr_watch_armed = 0U;
+    s_app.sensors.ldr_watch_since_ms = now_ms;
+    s_app.sensors.ldr_watch_events = 0U;
 
-    s_app.sensors.last_distance_raw_cm = s_policy_cfg.distance_error_cm;
-    s_app.sensors.last_distance_filtered_cm = s_policy_cfg.distance_error_cm;
-    s_app.sensors.last_valid_distance_cm = s_policy_cfg.distance_error_cm;
     s_app.sensors.last_us_status = ULTRASONIC_STATUS_NOT_INIT;
-    s_app.sensors.last_valid_presence = 1U;
-    s_app.sensors.ref_distance_cm = s_policy_cfg.presence_ref_fallback_cm;
-    s_app.sensors.ref_valid = 0U;
-    s_app.sensors.ref_pending_capture = 0U;
-    s_app.sensors.using_fallback_ref = 1U;
-    s_app.sensors.prev_valid_distance_cm = 0U;
-    s_app.sensors.prev_valid_distance_ready = 0U;
-    s_app.sensors.away_streak_ms = 0U;
-    s_app.sensors.flat_streak_ms = 0U;
-    s_app.sensors.motion_streak_ms = 0U;
-    s_app.sensors.near_ref_streak_ms = 0U;
-    s_app.sensors.no_user_reason = APP_NO_USER_REASON_NONE;
-    s_app.sensors.presence_candidate_no_user = 0U;
-
+    s_app.sensors.last_us_confidence_percent = 0U;
+    s_app.sensors.last_us_valid_pings = 0U;
+    s_app.sensors.mcu_temp_deci_c = s_policy_cfg.us_temp_fallback_deci_c;
+    s_app.sensors.last_mcu_temp_status = MCU_TEMP_STATUS_NOT_INIT;
+    s_app.sensors.last_us_zone = 0U;
+    app_presence_init(now_ms);
+
+    filter_median_u16_init(&s_app.sensors.ldr_median, s_policy_cfg.ldr_median_window_size, FILTER_MEDIAN_WARMUP_PASSTHROUGH);
     filter_moving_average_u16_init(&s_app.sensors.ldr_ma, s_policy_cfg.ldr_ma_window_size);
-    filter_median3_u32_init(&s_app.sensors.dist_median3);
+    filter_one_euro_u16_init(&s_app.sensors.ldr_one_euro, &s_policy_cfg.ldr_one_euro);
 
     s_app.control.light_enabled = 0U;
     s_app.control.manual_offset = 0;
     s_app.control.auto_percent = 0U;
-    s_app.control.target_output_percent = 0U;
-    s_app.control.hysteresis_output_percent = 0U;
-    s_app.control.ramped_output_percent = 0U;
+    s_app.control.auto_level = 0U;
+    s_app.control.ambient_log_lux_mdec = 0U;
+    s_app.control.ambient_raw = 0U;
+    s_app.control.lamp_comp_raw = 0U;
+    s_app.control.target_output_level = 0U;
+    s_app.control.hysteresis_output_level = 0U;
+    s_app.control.ramped_output_level = 0U;
+    s_app.control.output_level = 0U;
     s_app.control.output_percent = 0U;
-    s_app.control.last_applied_output_percent = 0U;
+    s_app.control.last_applied_output_level = 0U;
     s_app.control.output_hysteresis_initialized = 0U;
     s_app.control.ramp_initialized = 0U;
     s_app.control.ramp_fast_on_active = 0U;
@@ -143,7 +358,8 @@ uint8_t app_init(const app_hw_config_t *hw)
     s_app.control.rgb_state = STATUS_LED_STATE_BOOT_SETUP;
     s_app.control.preoff_active = 0U;
     s_app.control.preoff_start_ms = 0U;
-    s_app.control.preoff_dim_target_percent = 0U;
+    s_app.control.preoff_dim_target_level = 0U;
+    s_app.control.arrival_preramp_active = 0U;
 
     s_app.click.last_press_ms = now_ms;
     s_app.click.last_release_ms = now_ms;
@@ -170,6 +386,21 @@ uint8_t app_init(const app_hw_config_t *hw)
     s_app.settings_ui.toast_until_ms = 0U;
     s_app.settings_ui.toast = APP_SETTINGS_TOAST_NONE;
 
+    s_app.gesture.active = 0U;
+    s_app.gesture.burst_profile_fast = 0U;
+    /* Not armed at boot: whatever is already in the zone has not entered it. */
+    s_app.gesture.entry_armed = 0U;
+    s_app.gesture.last_hand_ms = now_ms;
+    s_app.gesture.session_start_ms = now_ms;
+
+    s_app.lamp_cal.active = 0U;
+    s_app.lamp_cal.step = 0U;
+    s_app.lamp_cal.step_start_ms = now_ms;
+    s_app.lamp_cal.sample_sum = 0U;
+    s_app.lamp_cal.sample_count = 0U;
+    memset(s_app.lamp_cal.level_raw, 0, sizeof(s_app.lamp_cal.level_raw));
+    s_app.lamp_cal.result = APP_LAMP_CAL_RESULT_NONE;
+
     s_app.platform.display_ready = 0U;
 
     app_settings_apply_build_defaults(&loaded_settings);
@@ -185,6 +416,7 @@ uint8_t app_init(const app_hw_config_t *hw)
     s_app.settings.active = loaded_settings;
     s_app.settings.draft = loaded_settings;
     s_app.settings.dirty = 0U;
+    app_rebuild_lux_curve();
     debug_logln(DEBUG_PRINT_INFO,
                 "dbg cfg load status=%u defaults=%u away_en=%u flat_en=%u away_s=%u flat_s=%u preoff_s=%u ret_cm=%u",
                 (unsigned int)settings_status,
@@ -196,18 +428,64 @@ uint8_t app_init(const app_hw_config_t *hw)
                 (unsigned int)s_app.settings.active.preoff_dim_s,
                 (unsigned int)s_app.settings.active.return_band_cm);
 
+    /* Injected (temperature) setup first: the DMA LDR backend starts continuous conversions in ldr_init. */
+    mcu_temp_init(hw->ldr_adc);
     ldr_init(hw->ldr_adc);
-    ultrasonic_init(hw->echo_tim, hw->echo_channel);
+    {
+        int32_t temp_deci_c;
+
+        s_app.sensors.last_mcu_temp_status = mcu_temp_read_deci_c(&temp_deci_c);
+        if (s_app.sensors.last_mcu_temp_status == MCU_TEMP_STATUS_OK) {
+            s_app.sensors.mcu_temp_deci_c = temp_deci_c;
+        }
+        debug_logln(DEBUG_PRINT_INFO, "dbg mcu_temp status=%s deci_c=%ld",
+                    mcu_temp_status_to_string(s_app.sensors.last_mcu_temp_status),
+                    (long)s_app.sensors.mcu_temp_deci_c);
+    }
+    for (zone = 0U; zone < APP_US_ZONE_COUNT; zone++) {
+        ultrasonic_init(&s_app.sensors.us[zone], &hw->us_zones[zone]);
+        ultrasonic_burst_init(&s_app.sensors.us_burst[zone], &s_app.sensors.us[zone], NULL);
+        if (ultrasonic_get_last_status(&s_app.sensors.us[zone]) != ULTRASONIC_STATUS_OK) {
+            debug_logln(DEBUG_PRINT_ERROR, "dbg us zone=%u init=%s", (unsigned int)zone,
+                        ultrasonic_status_to_string(ultrasonic_get_last_status(&s_app.sensors.us[zone])));
+        }
+    }
+    ultrasonic_zones_init(&s_app.sensors.us_zones, s_app.sensors.us_burst, APP_US_ZONE_COUNT,
+                          s_policy_cfg.us_zone_guard_ms);
+    app_configure_ultrasonic_burst(0U);
+    {
+        gesture_input_cfg_t gesture_cfg = {
+            .zone_min_mm = s_policy_cfg.gesture_zone_min_mm,
+            .zone_max_mm = s_policy_cfg.gesture_zone_max_mm,
+            .hold_ms = s_policy_cfg.gesture_hold_ms,
+            .hold_band_mm = s_policy_cfg.gesture_hold_band_mm,
+            .step_mm = s_policy_cfg.gesture_step_mm,
+        };
+
+        gesture_input_init(&gesture_cfg);
+    }
     switch_input_init();
     encoder_input_init();
     status_led_init();
 
     main_led_init(hw->main_led_tim, hw->main_led_channel);
     main_led_status = main_led_start();
-    debug_logln(DEBUG_PRINT_INFO, "dbg main_led start=%s", main_led_status_to_string(main_led_status));
+    debug_logln(DEBUG_PRINT_INFO, "dbg main_led start=%s pwm_hz=%lu counts=%lu dither=%u adc_sync=%u",
+                main_led_status_to_string(main_led_status),
+                (unsigned long)main_led_get_pwm_hz(),
+                (unsigned long)main_led_get_pwm_counts(),
+                (unsigned int)main_led_dither_active(),
+                (unsigned int)main_led_adc_sync_active());
     if (main_led_status != MAIN_LED_STATUS_OK) {
         ok = 0U;
     }
+    if (main_led_adc_sync_active() == 0U) {
+        ldr_status_t ldr_status = ldr_use_free_running();
+
+        if (ldr_status != LDR_STATUS_OK) {
+            debug_logln(DEBUG_PRINT_ERROR, "dbg ldr free_running=%s", ldr_status_to_string(ldr_status));
+        }
+    }
 
     main_led_status = main_led_set_enabled(1U);
     debug_logln(DEBUG_PRINT_INFO, "dbg main_led enable=%s", main_led_status_to_string(main_led_status));
@@ -242,6 +520,10 @@ uint8_t app_init(const app_hw_config_t *hw)
     debug_logln(DEBUG_PRINT_INFO, "dbg oled=disabled");
 #endif
 
+#if FILTER_BLOCK_BENCH
+    app_log_filter_block_bench();
+#endif
+
     s_app.control.rgb_state = app_evaluate_state(now_ms);
     status_led_set_state(s_app.control.rgb_state);
     debug_logln(DEBUG_PRINT_INFO, "dbg rgb_state=%s", status_led_state_to_string(s_app.control.rgb_state));
@@ -257,7 +539,10 @@ void app_step(void)
     app_process_switch_events(now_ms);
     app_process_encoder_events(now_ms);
     app_sample_ldr_if_due(now_ms);
+    app_sample_mcu_temp_if_due(now_ms);
     app_sample_ultrasonic_if_due(now_ms);
+    app_process_gesture_events();
+    app_lamp_cal_step(now_ms);
 
     if (app_control_tick_due(now_ms) == 0U) {
         return;
@@ -267,4 +552,5 @@ void app_step(void)
     app_update_rgb(now_ms);
     app_update_oled_if_due(now_ms);
     app_log_summary_if_due(now_ms);
+    app_log_shadow_if_due(now_ms);
 }
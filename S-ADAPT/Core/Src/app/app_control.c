@@ -1,100 +1,145 @@
 #include "app/app_internal.h"
 
-static uint8_t clamp_percent_i32(int32_t value)
+static uint16_t clamp_level_i32(int32_t value)
 {
     if (value <= 0) {
         return 0U;
     }
-    if (value >= 100) {
-        return 100U;
+    if (value >= (int32_t)APP_OUTPUT_LEVEL_FULL) {
+        return APP_OUTPUT_LEVEL_FULL;
     }
 
-    return (uint8_t)value;
+    return (uint16_t)value;
 }
 
-static uint8_t min_u8(uint8_t a, uint8_t b)
+static uint16_t min_u16(uint16_t a, uint16_t b)
 {
     return (a < b) ? a : b;
 }
 
-static uint8_t compute_auto_percent_from_ldr(uint16_t filtered_raw)
+/* Lamp contribution to the LDR at the output currently applied, from the calibration sweep model. */
+static uint16_t lamp_comp_raw_at(uint16_t output_level)
 {
-    uint32_t scaled = ((uint32_t)filtered_raw * 100U) / 4095U;
+    const app_lamp_comp_t *comp = &s_app.settings.active.lamp_comp;
+    const uint32_t step_level = APP_OUTPUT_LEVEL_FROM_PERCENT(APP_LAMP_COMP_STEP_PERCENT);
+    uint8_t index;
+    uint32_t frac;
 
-    if (scaled > 100U) {
-        scaled = 100U;
+    if ((comp->valid == 0U) || (output_level == 0U)) {
+        return 0U;
+    }
+
+    index = (uint8_t)(output_level / step_level);
+    if (index >= (APP_LAMP_COMP_POINTS - 1U)) {
+        return comp->delta_raw[APP_LAMP_COMP_POINTS - 1U];
     }
 
-    return (uint8_t)(100U - scaled);
+    frac = (uint32_t)output_level - ((uint32_t)index * step_level);
+    return (uint16_t)(comp->delta_raw[index] +
+                      ((((uint32_t)comp->delta_raw[index + 1U] - comp->delta_raw[index]) * frac) +
+                       (step_level / 2U)) / step_level);
+}
+
+/* Ambient-only reading: the LDR sees room light plus the lamp's own spill. */
+static uint16_t ambient_raw_from_ldr(uint16_t raw)
+{
+    uint16_t comp_raw = lamp_comp_raw_at(s_app.control.output_level);
+
+    return (raw > comp_raw) ? (uint16_t)(raw - comp_raw) : 0U;
+}
+
+/* raw -> log-lux through the calibration LUT, then the configured lux -> output transfer curve. */
+uint8_t app_auto_percent_from_raw(uint16_t raw)
+{
+    return lux_curve_log_lux_to_percent(&s_app.control.lux_curve,
+                                        lux_curve_raw_to_log_lux(&s_app.control.lux_curve, ambient_raw_from_ldr(raw)));
+}
+
+static uint16_t compute_auto_level_from_ldr(uint16_t filtered_raw)
+{
+    s_app.control.lamp_comp_raw = lamp_comp_raw_at(s_app.control.output_level);
+    s_app.control.ambient_raw = ambient_raw_from_ldr(filtered_raw);
+    s_app.control.ambient_log_lux_mdec = lux_curve_raw_to_log_lux(&s_app.control.lux_curve, s_app.control.ambient_raw);
+    return lux_curve_log_lux_to_percent_q8(&s_app.control.lux_curve, s_app.control.ambient_log_lux_mdec);
 }
 
-static uint8_t apply_output_hysteresis(uint8_t target_percent)
+static uint16_t apply_output_hysteresis(uint16_t target_level)
 {
-    uint8_t diff;
+    uint16_t diff;
+    uint16_t band = APP_OUTPUT_LEVEL_FROM_PERCENT(s_policy_cfg.output_hysteresis_band_percent);
+
+    /* With the lamp's own light subtracted, output changes no longer feed back into the reading, so the
+     * band only has to cover ambient noise. */
+    if (s_app.settings.active.lamp_comp.valid != 0U) {
+        band = APP_OUTPUT_LEVEL_FROM_PERCENT(s_policy_cfg.output_hysteresis_band_comp_percent);
+    }
 
     if (s_app.control.output_hysteresis_initialized == 0U) {
-        s_app.control.last_applied_output_percent = target_percent;
+        s_app.control.last_applied_output_level = target_level;
         s_app.control.output_hysteresis_initialized = 1U;
-        return target_percent;
+        return target_level;
     }
 
-    if (target_percent > s_app.control.last_applied_output_percent) {
-        diff = (uint8_t)(target_percent - s_app.control.last_applied_output_percent);
+    if (target_level > s_app.control.last_applied_output_level) {
+        diff = (uint16_t)(target_level - s_app.control.last_applied_output_level);
     } else {
-        diff = (uint8_t)(s_app.control.last_applied_output_percent - target_percent);
+        diff = (uint16_t)(s_app.control.last_applied_output_level - target_level);
     }
 
-    if ((target_percent == 0U) || (diff >= s_policy_cfg.output_hysteresis_band_percent)) {
-        s_app.control.last_applied_output_percent = target_percent;
+    if ((target_level == 0U) || (diff >= band)) {
+        s_app.control.last_applied_output_level = target_level;
     }
 
-    return s_app.control.last_applied_output_percent;
+    return s_app.control.last_applied_output_level;
 }
 
-static uint8_t apply_output_ramp(uint8_t desired_percent)
+/* Steps are whole percent per tick, but the ramp runs in Q8 so it lands exactly on a fractional target. */
+static uint16_t apply_output_ramp(uint16_t desired_level)
 {
-    uint8_t current;
-    uint8_t step;
+    uint16_t current;
+    uint8_t step_percent;
+    uint16_t step;
 
     if (s_app.control.ramp_initialized == 0U) {
-        s_app.control.ramped_output_percent = desired_percent;
+        s_app.control.ramped_output_level = desired_level;
         s_app.control.ramp_initialized = 1U;
-        return desired_percent;
+        return desired_level;
     }
 
-    current = s_app.control.ramped_output_percent;
-    step = s_policy_cfg.output_ramp_step_percent;
-    if ((s_app.control.ramp_fast_on_active != 0U) && (desired_percent > current)) {
-        step = s_policy_cfg.output_ramp_step_on_percent;
-    } else if ((desired_percent == 0U) && (current > 0U)) {
-        step = s_policy_cfg.output_ramp_step_off_percent;
+    current = s_app.control.ramped_output_level;
+    step_percent = s_policy_cfg.output_ramp_step_percent;
+    if ((s_app.control.ramp_fast_on_active != 0U) && (desired_level > current)) {
+        step_percent = s_policy_cfg.output_ramp_step_on_percent;
+    } else if ((desired_level == 0U) && (current > 0U)) {
+        step_percent = s_policy_cfg.output_ramp_step_off_percent;
     }
-    if (step == 0U) {
-        step = 1U;
+    if (step_percent == 0U) {
+        step_percent = 1U;
     }
+    step = APP_OUTPUT_LEVEL_FROM_PERCENT(step_percent);
 
-    if (desired_percent > current) {
-        uint8_t delta = (uint8_t)(desired_percent - current);
+    if (desired_level > current) {
+        uint16_t delta = (uint16_t)(desired_level - current);
         if (delta > step) {
-            current = (uint8_t)(current + step);
+            current = (uint16_t)(current + step);
         } else {
-            current = desired_percent;
+            current = desired_level;
         }
-    } else if (desired_percent < current) {
-        uint8_t delta = (uint8_t)(current - desired_percent);
+    } else if (desired_level < current) {
+        uint16_t delta = (uint16_t)(current - desired_level);
         if (delta > step) {
-            current = (uint8_t)(current - step);
+            current = (uint16_t)(current - step);
         } else {
-            current = desired_percent;
+            current = desired_level;
         }
     }
 
     if ((s_app.control.ramp_fast_on_active != 0U) &&
-        ((desired_percent == 0U) || (current >= desired_percent))) {
+        ((desired_level == 0U) || (current >= desired_level))) {
         s_app.control.ramp_fast_on_active = 0U;
     }
 
-    s_app.control.ramped_output_percent = current;
+    s_app.control.ramped_output_level = current;
     return current;
 }
 
@@ -112,7 +157,7 @@ status_led_state_t app_evaluate_state(uint32_t now_ms)
         return STATUS_LED_STATE_LIGHT_OFF;
     }
 
-    if (s_app.sensors.last_valid_presence == 0U) {
+    if (s_app.sensors.presence.present == 0U) {
         return STATUS_LED_STATE_NO_USER;
     }
 
@@ -123,6 +168,11 @@ status_led_state_t app_evaluate_state(uint32_t now_ms)
     return STATUS_LED_STATE_AUTO;
 }
 
+void app_rebuild_lux_curve(void)
+{
+    lux_curve_build(&s_app.control.lux_curve, &s_app.settings.active.ldr_cal);
+}
+
 uint8_t app_control_tick_due(uint32_t now_ms)
 {
     if (input_has_elapsed_ms(now_ms, s_app.timing.last_control_tick_ms, s_timing_cfg.control_tick_ms) == 0U) {
@@ -133,50 +183,83 @@ uint8_t app_control_tick_due(uint32_t now_ms)
     return 1U;
 }
 
+/* Not present: off, unless a zone predicts the user coming back. Then the lamp rises at the fast-on rate up
+ * to the pre-ramp level and waits for the return to be confirmed; a dropped prediction backs out at the off
+ * rate. */
+static void app_update_arrival_preramp(void)
+{
+    if (s_app.sensors.presence.arrival_predicted == 0U) {
+        s_app.control.arrival_preramp_active = 0U;
+        s_app.control.target_output_level = 0U;
+        return;
+    }
+
+    if (s_app.control.arrival_preramp_active == 0U) {
+        s_app.control.arrival_preramp_active = 1U;
+        s_app.control.ramp_fast_on_active = 1U;
+    }
+    s_app.control.target_output_level =
+        min_u16(s_app.control.target_output_level,
+                APP_OUTPUT_LEVEL_FROM_PERCENT(s_policy_cfg.presence_arrival_preramp_percent));
+}
+
 void app_update_output_control(uint32_t now_ms)
 {
-    int32_t target_percent_i32;
+    int32_t target_level_i32;
     uint32_t preoff_dim_ms = (uint32_t)s_app.settings.active.preoff_dim_s * 1000U;
 
-    s_app.control.auto_percent = compute_auto_percent_from_ldr(s_app.sensors.last_ldr_filtered);
+    /* The calibration sweep owns the lamp until it finishes. */
+    if (app_lamp_cal_active() != 0U) {
+        return;
+    }
+
+    s_app.control.auto_level = compute_auto_level_from_ldr(s_app.sensors.last_ldr_filtered);
+    s_app.control.auto_percent = APP_OUTPUT_LEVEL_TO_PERCENT(s_app.control.auto_level);
 
-    target_percent_i32 = (int32_t)s_app.control.auto_percent + s_app.control.manual_offset;
-    s_app.control.target_output_percent = clamp_percent_i32(target_percent_i32);
+    target_level_i32 = (int32_t)s_app.control.auto_level +
+                       ((int32_t)APP_OUTPUT_LEVEL_FROM_PERCENT(1U) * s_app.control.manual_offset);
+    s_app.control.target_output_level = clamp_level_i32(target_level_i32);
 
     if (s_app.control.light_enabled == 0U) {
         s_app.control.preoff_active = 0U;
-        s_app.sensors.presence_candidate_no_user = 0U;
-        s_app.control.target_output_percent = 0U;
+        s_app.control.arrival_preramp_active = 0U;
+        s_app.control.target_output_level = 0U;
     } else {
         if ((s_app.control.preoff_active == 0U) &&
-            (s_app.sensors.last_valid_presence != 0U) &&
-            (s_app.sensors.presence_candidate_no_user != 0U)) {
+            (s_app.sensors.presence.present != 0U) &&
+            (s_app.sensors.presence.candidate_no_user != 0U)) {
             s_app.control.preoff_active = 1U;
             s_app.control.preoff_start_ms = now_ms;
-            s_app.control.preoff_dim_target_percent = min_u8(s_app.control.output_percent, s_policy_cfg.presence_preoff_dim_percent);
+            s_app.control.preoff_dim_target_level =
+                min_u16(s_app.control.output_level,
+                        APP_OUTPUT_LEVEL_FROM_PERCENT(s_policy_cfg.presence_preoff_dim_percent));
         }
 
         if (s_app.control.preoff_active != 0U) {
-            if (s_app.sensors.presence_candidate_no_user == 0U) {
+            if (s_app.sensors.presence.candidate_no_user == 0U) {
                 s_app.control.preoff_active = 0U;
             } else if (input_has_elapsed_ms(now_ms, s_app.control.preoff_start_ms, preoff_dim_ms) != 0U) {
                 s_app.control.preoff_active = 0U;
-                s_app.sensors.last_valid_presence = 0U;
-                s_app.sensors.presence_candidate_no_user = 0U;
+                app_presence_confirm_no_user();
             }
         }
 
         if (s_app.control.preoff_active != 0U) {
-            s_app.control.target_output_percent = s_app.control.preoff_dim_target_percent;
-        } else if (s_app.sensors.last_valid_presence == 0U) {
-            s_app.control.target_output_percent = 0U;
+            s_app.control.target_output_level = s_app.control.preoff_dim_target_level;
+        } else if (s_app.sensors.presence.present == 0U) {
+            app_update_arrival_preramp();
+        } else if (s_app.control.arrival_preramp_active != 0U) {
+            /* Confirmed: carry on from the pre-ramp level at the same rate. */
+            s_app.control.arrival_preramp_active = 0U;
+            s_app.control.ramp_fast_on_active = 1U;
         }
     }
 
-    s_app.control.hysteresis_output_percent = apply_output_hysteresis(s_app.control.target_output_percent);
-    s_app.control.ramped_output_percent = apply_output_ramp(s_app.control.hysteresis_output_percent);
-    s_app.control.output_percent = s_app.control.ramped_output_percent;
-    (void)main_led_set_percent(s_app.control.output_percent);
+    s_app.control.hysteresis_output_level = apply_output_hysteresis(s_app.control.target_output_level);
+    s_app.control.ramped_output_level = apply_output_ramp(s_app.control.hysteresis_output_level);
+    s_app.control.output_level = s_app.control.ramped_output_level;
+    s_app.control.output_percent = APP_OUTPUT_LEVEL_TO_PERCENT(s_app.control.output_level);
+    (void)main_led_set_level(s_app.control.output_level);
 }
 
 void app_update_rgb(uint32_t now_ms)
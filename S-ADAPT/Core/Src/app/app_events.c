@@ -1,5 +1,7 @@
 #include "app/app_internal.h"
 
+#include <string.h>
+
 #define APP_SETTINGS_LONG_PRESS_MS 1000U
 #define APP_SETTINGS_TOAST_MS      1500U
 
@@ -24,6 +26,20 @@ static const char *encoder_event_name(encoder_event_type_t type)
     }
 }
 
+static const char *gesture_event_name(gesture_event_type_t type)
+{
+    switch (type) {
+        case GESTURE_EVENT_HOVER_HOLD:
+            return "hover_hold";
+        case GESTURE_EVENT_STEP_UP:
+            return "step_up";
+        case GESTURE_EVENT_STEP_DOWN:
+            return "step_down";
+        default:
+            return "unknown";
+    }
+}
+
 static int32_t clamp_offset(int32_t offset)
 {
     if (offset < s_policy_cfg.offset_min) {
@@ -90,6 +106,12 @@ static uint8_t settings_are_equal(const app_settings_t *lhs, const app_settings_
     if (lhs->return_band_cm != rhs->return_band_cm) {
         return 0U;
     }
+    if (memcmp(&lhs->ldr_cal, &rhs->ldr_cal, sizeof(lhs->ldr_cal)) != 0) {
+        return 0U;
+    }
+    if (memcmp(&lhs->lamp_comp, &rhs->lamp_comp, sizeof(lhs->lamp_comp)) != 0) {
+        return 0U;
+    }
 
     return 1U;
 }
@@ -195,15 +217,18 @@ static void app_settings_cycle_row(int8_t direction)
 
 static void reset_presence_runtime_state(void)
 {
-    s_app.sensors.away_streak_ms = 0U;
-    s_app.sensors.flat_streak_ms = 0U;
-    s_app.sensors.motion_streak_ms = 0U;
-    s_app.sensors.near_ref_streak_ms = 0U;
-    s_app.sensors.no_user_reason = APP_NO_USER_REASON_NONE;
-    s_app.sensors.presence_candidate_no_user = 0U;
     s_app.control.preoff_active = 0U;
     s_app.control.preoff_start_ms = 0U;
-    s_app.control.preoff_dim_target_percent = 0U;
+    s_app.control.preoff_dim_target_level = 0U;
+    s_app.control.arrival_preramp_active = 0U;
+}
+
+static void app_show_offset_overlay(uint32_t now_ms)
+{
+    s_app.ui.overlay_active = 1U;
+    s_app.ui.overlay_until_ms = now_ms + s_policy_cfg.ui_overlay_timeout_ms;
+    s_app.ui.overlay_offset = s_app.control.manual_offset;
+    s_app.ui.render_dirty = 1U;
 }
 
 static void app_toggle_light_enabled(void)
@@ -216,15 +241,11 @@ static void app_toggle_light_enabled(void)
     if ((was_light_enabled == 0U) && (s_app.control.light_enabled != 0U)) {
         s_app.control.ramp_fast_on_active = 1U;
         reset_presence_runtime_state();
-        s_app.sensors.ref_distance_cm = s_policy_cfg.presence_ref_fallback_cm;
-        s_app.sensors.ref_valid = 1U;
-        s_app.sensors.ref_pending_capture = 1U;
-        s_app.sensors.using_fallback_ref = 1U;
-        s_app.sensors.prev_valid_distance_ready = 0U;
-        s_app.sensors.last_valid_presence = 1U;
+        app_presence_arm();
     } else if ((was_light_enabled != 0U) && (s_app.control.light_enabled == 0U)) {
         s_app.control.ramp_fast_on_active = 0U;
         reset_presence_runtime_state();
+        app_presence_disarm();
     }
 
     s_app.ui.render_dirty = 1U;
@@ -298,6 +319,9 @@ void app_handle_encoder_event(const encoder_event_t *event)
             case DISPLAY_SETTINGS_ROW_RETURN_BAND:
                 s_app.settings_ui.editing_value = 1U;
                 break;
+            case DISPLAY_SETTINGS_ROW_LAMP_CAL:
+                app_lamp_cal_start(event->timestamp_ms);
+                break;
             case DISPLAY_SETTINGS_ROW_SAVE:
             {
                 settings_store_status_t save_status;
@@ -307,6 +331,7 @@ void app_handle_encoder_event(const encoder_event_t *event)
                 save_status = settings_store_save(&validated);
                 if (save_status == SETTINGS_STORE_OK) {
                     s_app.settings.active = validated;
+                    app_rebuild_lux_curve();
                     s_app.settings.draft = validated;
                     s_app.settings.dirty = 0U;
                     app_set_settings_toast(APP_SETTINGS_TOAST_SAVED, event->timestamp_ms);
@@ -318,11 +343,17 @@ void app_handle_encoder_event(const encoder_event_t *event)
                 break;
             }
             case DISPLAY_SETTINGS_ROW_RESET:
+            {
+                /* The lamp model is a measurement of this installation, not a preference; keep it. */
+                app_lamp_comp_t lamp_comp = s_app.settings.draft.lamp_comp;
+
                 app_settings_apply_build_defaults(&s_app.settings.draft);
+                s_app.settings.draft.lamp_comp = lamp_comp;
                 app_refresh_settings_dirty();
                 app_set_settings_toast(APP_SETTINGS_TOAST_RESET, event->timestamp_ms);
                 debug_logln(DEBUG_PRINT_INFO, "dbg settings=reset draft");
                 break;
+            }
             case DISPLAY_SETTINGS_ROW_EXIT:
                 app_exit_settings_mode_discard(event->timestamp_ms);
                 break;
@@ -368,10 +399,33 @@ void app_handle_encoder_event(const encoder_event_t *event)
 
     if (((event->type == ENCODER_EVENT_CW) || (event->type == ENCODER_EVENT_CCW)) &&
         (s_app.control.light_enabled != 0U)) {
-        s_app.ui.overlay_active = 1U;
-        s_app.ui.overlay_until_ms = event->timestamp_ms + s_policy_cfg.ui_overlay_timeout_ms;
-        s_app.ui.overlay_offset = s_app.control.manual_offset;
-        s_app.ui.render_dirty = 1U;
+        app_show_offset_overlay(event->timestamp_ms);
+    }
+}
+
+void app_handle_gesture_event(const gesture_event_t *event)
+{
+    if ((event == NULL) || (s_app.settings_ui.mode_active != 0U)) {
+        return;
+    }
+
+    switch (event->type) {
+        case GESTURE_EVENT_HOVER_HOLD:
+            app_toggle_light_enabled();
+            break;
+
+        case GESTURE_EVENT_STEP_UP:
+        case GESTURE_EVENT_STEP_DOWN:
+            if (s_app.control.light_enabled != 0U) {
+                int32_t step = (event->type == GESTURE_EVENT_STEP_UP) ? s_policy_cfg.offset_step : -s_policy_cfg.offset_step;
+
+                s_app.control.manual_offset = clamp_offset(s_app.control.manual_offset + step);
+                app_show_offset_overlay(event->timestamp_ms);
+            }
+            break;
+
+        default:
+            break;
     }
 }
 
@@ -434,3 +488,13 @@ void app_process_encoder_events(uint32_t now_ms)
 
     app_handle_encoder_long_press(now_ms);
 }
+
+void app_process_gesture_events(void)
+{
+    gesture_event_t gesture_event;
+
+    while (gesture_input_pop_event(&gesture_event) != 0U) {
+        debug_logln(DEBUG_PRINT_DEBUG, "dbg event=gesture type=%s", gesture_event_name(gesture_event.type));
+        app_handle_gesture_event(&gesture_event);
+    }
+}
@@ -0,0 +1,170 @@
+#include "app/app_internal.h"
+
+static uint8_t app_lamp_cal_step_percent(uint8_t step)
+{
+    if (step >= APP_LAMP_COMP_POINTS) {
+        return 0U;
+    }
+
+    return (uint8_t)(step * APP_LAMP_COMP_STEP_PERCENT);
+}
+
+static void app_lamp_cal_enter_step(uint8_t step, uint32_t now_ms)
+{
+    s_app.lamp_cal.step = step;
+    s_app.lamp_cal.step_start_ms = now_ms;
+    s_app.lamp_cal.sample_sum = 0U;
+    s_app.lamp_cal.sample_count = 0U;
+    (void)main_led_set_percent(app_lamp_cal_step_percent(step));
+    s_app.ui.render_dirty = 1U;
+}
+
+static void app_lamp_cal_finish(app_lamp_cal_result_t result)
+{
+    s_app.lamp_cal.active = 0U;
+    s_app.lamp_cal.result = result;
+    /* Control resumes from the pre-sweep ramp state on the next tick. */
+    (void)main_led_set_level(s_app.control.output_level);
+    s_app.ui.render_dirty = 1U;
+    debug_logln((result == APP_LAMP_CAL_RESULT_OK) ? DEBUG_PRINT_INFO : DEBUG_PRINT_ERROR,
+                "dbg lamp_cal=%s off_raw=%u/%u",
+                app_lamp_cal_result_to_string(result),
+                (unsigned int)s_app.lamp_cal.level_raw[0],
+                (unsigned int)s_app.lamp_cal.level_raw[APP_LAMP_CAL_STEPS - 1U]);
+}
+
+/* Lamp-on levels minus a lamp-off baseline interpolated between the opening and closing 0 % steps,
+ * so slow ambient drift during the sweep is not learned as lamp light. */
+static void app_lamp_cal_build_model(app_lamp_comp_t *comp)
+{
+    int32_t base_start = (int32_t)s_app.lamp_cal.level_raw[0];
+    int32_t base_end = (int32_t)s_app.lamp_cal.level_raw[APP_LAMP_CAL_STEPS - 1U];
+    uint16_t running_max = 0U;
+    uint8_t i;
+
+    comp->valid = 1U;
+    comp->reserved = 0U;
+    comp->delta_raw[0] = 0U;
+    for (i = 1U; i < APP_LAMP_COMP_POINTS; i++) {
+        int32_t base = base_start + (((base_end - base_start) * (int32_t)i) / (int32_t)(APP_LAMP_CAL_STEPS - 1U));
+        int32_t delta = (int32_t)s_app.lamp_cal.level_raw[i] - base;
+
+        /* Noise can make a step read below its neighbour; the model must stay non-decreasing. */
+        if ((delta > 0) && ((uint16_t)delta > running_max)) {
+            running_max = (uint16_t)delta;
+        }
+        comp->delta_raw[i] = running_max;
+    }
+}
+
+static void app_lamp_cal_complete(void)
+{
+    app_lamp_comp_t comp;
+    uint16_t base_start = s_app.lamp_cal.level_raw[0];
+    uint16_t base_end = s_app.lamp_cal.level_raw[APP_LAMP_CAL_STEPS - 1U];
+    uint16_t drift = (base_start > base_end) ? (uint16_t)(base_start - base_end) : (uint16_t)(base_end - base_start);
+
+    if (drift > s_policy_cfg.lamp_cal_drift_max_raw) {
+        app_lamp_cal_finish(APP_LAMP_CAL_RESULT_DRIFT_ERR);
+        return;
+    }
+
+    app_lamp_cal_build_model(&comp);
+    s_app.settings.active.lamp_comp = comp;
+    s_app.settings.draft.lamp_comp = comp;
+    if (settings_store_save(&s_app.settings.active) != SETTINGS_STORE_OK) {
+        /* Model stays in use until reboot; only persistence failed. */
+        app_lamp_cal_finish(APP_LAMP_CAL_RESULT_SAVE_ERR);
+        return;
+    }
+
+    debug_logln(DEBUG_PRINT_INFO,
+                "dbg lamp_cal delta_raw=%u,%u,%u,%u,%u,%u",
+                (unsigned int)comp.delta_raw[0],
+                (unsigned int)comp.delta_raw[1],
+                (unsigned int)comp.delta_raw[2],
+                (unsigned int)comp.delta_raw[3],
+                (unsigned int)comp.delta_raw[4],
+                (unsigned int)comp.delta_raw[5]);
+    app_lamp_cal_finish(APP_LAMP_CAL_RESULT_OK);
+}
+
+void app_lamp_cal_start(uint32_t now_ms)
+{
+    if (s_app.lamp_cal.active != 0U) {
+        return;
+    }
+
+    s_app.lamp_cal.active = 1U;
+    s_app.lamp_cal.result = APP_LAMP_CAL_RESULT_NONE;
+    debug_logln(DEBUG_PRINT_INFO, "dbg lamp_cal=start");
+    app_lamp_cal_enter_step(0U, now_ms);
+}
+
+void app_lamp_cal_on_ldr_sample(uint32_t now_ms, uint16_t raw)
+{
+    if ((s_app.lamp_cal.active == 0U) || (s_app.lamp_cal.sample_count >= s_policy_cfg.lamp_cal_samples)) {
+        return;
+    }
+
+    /* Readings before the settle time still carry the LDR's response to the previous step. */
+    if (input_has_elapsed_ms(now_ms, s_app.lamp_cal.step_start_ms, s_policy_cfg.lamp_cal_settle_ms) == 0U) {
+        return;
+    }
+
+    s_app.lamp_cal.sample_sum += raw;
+    s_app.lamp_cal.sample_count++;
+}
+
+void app_lamp_cal_step(uint32_t now_ms)
+{
+    uint8_t count = s_policy_cfg.lamp_cal_samples;
+
+    if (s_app.lamp_cal.active == 0U) {
+        return;
+    }
+
+    if (s_app.lamp_cal.sample_count < count) {
+        if (input_has_elapsed_ms(now_ms, s_app.lamp_cal.step_start_ms, s_policy_cfg.lamp_cal_step_timeout_ms) != 0U) {
+            app_lamp_cal_finish(APP_LAMP_CAL_RESULT_SENSOR_ERR);
+        }
+        return;
+    }
+
+    s_app.lamp_cal.level_raw[s_app.lamp_cal.step] =
+        (uint16_t)((s_app.lamp_cal.sample_sum + (count / 2U)) / count);
+    if ((uint8_t)(s_app.lamp_cal.step + 1U) < APP_LAMP_CAL_STEPS) {
+        app_lamp_cal_enter_step((uint8_t)(s_app.lamp_cal.step + 1U), now_ms);
+        return;
+    }
+
+    app_lamp_cal_complete();
+}
+
+uint8_t app_lamp_cal_active(void)
+{
+    return s_app.lamp_cal.active;
+}
+
+uint8_t app_lamp_cal_progress_percent(void)
+{
+    return (uint8_t)(((uint32_t)s_app.lamp_cal.step * 100U) / APP_LAMP_CAL_STEPS);
+}
+
+const char *app_lamp_cal_result_to_string(app_lamp_cal_result_t result)
+{
+    switch (result) {
+        case APP_LAMP_CAL_RESULT_NONE:
+            return "none";
+        case APP_LAMP_CAL_RESULT_OK:
+            return "ok";
+        case APP_LAMP_CAL_RESULT_SENSOR_ERR:
+            return "sensor_err";
+        case APP_LAMP_CAL_RESULT_DRIFT_ERR:
+            return "drift_err";
+        case APP_LAMP_CAL_RESULT_SAVE_ERR:
+            return "save_err";
+        default:
+            return "unknown";
+    }
+}
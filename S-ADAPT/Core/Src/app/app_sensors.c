@@ -1,151 +1,548 @@
 #include "app/app_internal.h"
 
+#include "support/cycle_counter.h"
+
+#if LDR_WATCH_SUPPORTED
 static uint32_t abs_diff_u32(uint32_t a, uint32_t b)
 {
     return (a > b) ? (a - b) : (b - a);
 }
 
+/* Returns 1 while the analog watchdog is armed and quiet, i.e. ambient light is still inside the window. */
+static uint8_t app_ldr_watch_quiet(uint32_t now_ms)
+{
+    if (s_app.sensors.ldr_watch_armed == 0U) {
+        return 0U;
+    }
+
+    /* The lamp calibration sweep needs every reading, so it drops the watch like an event would. */
+    if ((ldr_watch_take_event() == 0U) && (app_lamp_cal_active() == 0U) &&
+        (input_has_elapsed_ms(now_ms, s_app.sensors.ldr_watch_since_ms, s_policy_cfg.ldr_watch_refresh_ms) == 0U)) {
+        /* Hold the sample phase so polling resumes one period after the watch drops, not with a catch-up run. */
+        s_app.timing.last_ldr_sample_ms = now_ms;
+        return 1U;
+    }
+
+    /* Left the window (or safety refresh): sample now and keep polling until the level settles. */
+    s_app.sensors.ldr_watch_armed = 0U;
+    s_app.sensors.ldr_watch_since_ms = now_ms;
+    s_app.sensors.ldr_watch_events++;
+    s_app.timing.last_ldr_sample_ms = now_ms - s_timing_cfg.ldr_sample_ms;
+    return 0U;
+}
+
+/* Walk the LUT grid away from center while AUTO output stays within the margin; the curve is only
+ * piecewise-linear on that grid, so the last in-margin grid point bounds the window. */
+static uint16_t app_ldr_watch_edge(uint16_t center, int32_t direction)
+{
+    uint8_t center_percent = app_auto_percent_from_raw(center);
+    uint32_t step = 1UL << LUX_CURVE_RAW_SHIFT;
+    uint32_t edge = center;
+
+    for (;;) {
+        uint32_t next;
+        uint8_t percent;
+
+        if (direction > 0) {
+            next = ((edge >> LUX_CURVE_RAW_SHIFT) + 1UL) * step;
+            if (next > 4095U) {
+                return 4095U;
+            }
+        } else {
+            if (edge < step) {
+                return 0U;
+            }
+            next = ((edge - 1UL) >> LUX_CURVE_RAW_SHIFT) * step;
+        }
+
+        percent = app_auto_percent_from_raw((uint16_t)next);
+        if ((uint32_t)abs_diff_u32(percent, center_percent) > s_policy_cfg.ldr_watch_margin_percent) {
+            return (uint16_t)edge;
+        }
+        edge = next;
+    }
+}
+
+static void app_ldr_watch_rearm_if_settled(uint32_t now_ms)
+{
+    uint16_t center = s_app.sensors.last_ldr_filtered;
+    uint16_t margin = s_policy_cfg.ldr_watch_min_margin_raw;
+    uint16_t low_raw;
+    uint16_t high_raw;
+
+    if ((s_app.sensors.ldr_watch_armed != 0U) || (s_app.sensors.last_ldr_status != LDR_STATUS_OK) ||
+        (app_lamp_cal_active() != 0U) ||
+        (input_has_elapsed_ms(now_ms, s_app.sensors.ldr_watch_since_ms, s_policy_cfg.ldr_watch_settle_ms) == 0U)) {
+        return;
+    }
+
+    /* Still moving: arming now would only trip again on the next result. */
+    if (abs_diff_u32(s_app.sensors.last_ldr_raw, center) > margin) {
+        return;
+    }
+
+    low_raw = app_ldr_watch_edge(center, -1);
+    high_raw = app_ldr_watch_edge(center, 1);
+    if (((uint32_t)center - low_raw) < margin) {
+        low_raw = (center > margin) ? (uint16_t)(center - margin) : 0U;
+    }
+    if (((uint32_t)high_raw - center) < margin) {
+        high_raw = (((uint32_t)center + margin) < 4095U) ? (uint16_t)(center + margin) : 4095U;
+    }
+    if (ldr_watch_arm(low_raw, high_raw) == LDR_STATUS_OK) {
+        s_app.sensors.ldr_watch_armed = 1U;
+        s_app.sensors.ldr_watch_since_ms = now_ms;
+    }
+}
+#endif
+
+static uint16_t app_ldr_smooth(uint16_t raw)
+{
+    if (s_policy_cfg.ldr_smoothing == APP_LDR_SMOOTHING_ONE_EURO) {
+        return filter_one_euro_u16_push(&s_app.sensors.ldr_one_euro, raw);
+    }
+
+    return filter_moving_average_u16_push(&s_app.sensors.ldr_ma, raw);
+}
+
 void app_sample_ldr_if_due(uint32_t now_ms)
 {
+#if LDR_WATCH_SUPPORTED
+    /* Event mode: no reads while the ADC watchdog is armed; the held filtered value keeps auto_percent steady. */
+    if (app_ldr_watch_quiet(now_ms) != 0U) {
+        return;
+    }
+#endif
+
     if (input_has_elapsed_ms(now_ms, s_app.timing.last_ldr_sample_ms, s_timing_cfg.ldr_sample_ms) != 0U) {
         s_app.timing.last_ldr_sample_ms += s_timing_cfg.ldr_sample_ms;
         s_app.sensors.last_ldr_status = ldr_read_raw(&s_app.sensors.last_ldr_raw);
         if (s_app.sensors.last_ldr_status == LDR_STATUS_OK) {
+            ldr_flicker_t flicker;
+
             s_app.sensors.last_ldr_filtered =
-                filter_moving_average_u16_push(&s_app.sensors.ldr_ma, s_app.sensors.last_ldr_raw);
+                app_ldr_smooth(filter_median_u16_push(&s_app.sensors.ldr_median, s_app.sensors.last_ldr_raw));
+            app_lamp_cal_on_ldr_sample(now_ms, s_app.sensors.last_ldr_raw);
+            if (ldr_get_flicker(&flicker) == LDR_STATUS_OK) {
+                s_app.sensors.ldr_flicker_hz = flicker.flicker_hz;
+                s_app.sensors.ldr_ripple_pp_raw = flicker.ripple_pp_raw;
+            }
         }
+#if LDR_WATCH_SUPPORTED
+        app_ldr_watch_rearm_if_settled(now_ms);
+#endif
     }
 }
 
-void app_sample_ultrasonic_if_due(uint32_t now_ms)
+void app_sample_mcu_temp_if_due(uint32_t now_ms)
 {
-    if (input_has_elapsed_ms(now_ms, s_app.timing.last_us_sample_ms, s_timing_cfg.us_sample_ms) != 0U) {
-        uint32_t distance_cm;
-
-        s_app.timing.last_us_sample_ms += s_timing_cfg.us_sample_ms;
-        distance_cm = ultrasonic_read_distance_cm(s_policy_cfg.us_timeout_us, s_policy_cfg.distance_error_cm);
-        s_app.sensors.last_us_status = ultrasonic_get_last_status();
-
-        if ((distance_cm != s_policy_cfg.distance_error_cm) && (s_app.sensors.last_us_status == ULTRASONIC_STATUS_OK)) {
-            uint32_t ref_distance_cm;
-            uint32_t abs_step_delta_cm = 0U;
-            uint32_t away_timeout_ms = (uint32_t)s_app.settings.active.away_timeout_s * 1000U;
-            uint32_t stale_timeout_ms = (uint32_t)s_app.settings.active.stale_timeout_s * 1000U;
-            uint8_t prev_ready;
-            uint8_t away_condition;
-            uint8_t flat_condition;
-            uint8_t motion_condition;
-            uint8_t away_mode_enabled;
-            uint8_t flat_mode_enabled;
-
-            s_app.sensors.last_distance_raw_cm = distance_cm;
-            filter_median3_u32_push(&s_app.sensors.dist_median3, distance_cm);
-            s_app.sensors.last_distance_filtered_cm = filter_median3_u32_get(&s_app.sensors.dist_median3);
-            s_app.sensors.last_valid_distance_cm = s_app.sensors.last_distance_filtered_cm;
-
-            if (s_app.sensors.ref_pending_capture != 0U) {
-                s_app.sensors.ref_distance_cm = s_app.sensors.last_distance_filtered_cm;
-                s_app.sensors.ref_valid = 1U;
-                s_app.sensors.ref_pending_capture = 0U;
-                s_app.sensors.using_fallback_ref = 0U;
-            }
+    if (input_has_elapsed_ms(now_ms, s_app.timing.last_temp_sample_ms, s_timing_cfg.temp_sample_ms) != 0U) {
+        int32_t temp_deci_c;
+
+        s_app.timing.last_temp_sample_ms += s_timing_cfg.temp_sample_ms;
+        s_app.sensors.last_mcu_temp_status = mcu_temp_read_deci_c(&temp_deci_c);
+        if (s_app.sensors.last_mcu_temp_status == MCU_TEMP_STATUS_OK) {
+            s_app.sensors.mcu_temp_deci_c = temp_deci_c;
+        }
+    }
+}
+
+void app_presence_engine_cfg(presence_engine_cfg_t *cfg)
+{
+    cfg->distance_error_mm = s_policy_cfg.distance_error_mm;
+    cfg->median_window_size = s_policy_cfg.dist_median_window_size;
+    cfg->median_warmup = s_policy_cfg.dist_median_warmup;
+    cfg->tracker = s_policy_cfg.dist_tracker;
+    cfg->use_tracker = s_policy_cfg.presence_use_tracker;
+    cfg->flat_velocity_mm_s = s_policy_cfg.presence_flat_velocity_mm_s;
+    cfg->motion_velocity_mm_s = s_policy_cfg.presence_motion_velocity_mm_s;
+    cfg->motion_sigma = s_policy_cfg.presence_motion_sigma;
+    cfg->flat_band_mm = s_policy_cfg.presence_flat_band_mm;
+    cfg->motion_delta_mm = s_policy_cfg.presence_motion_delta_mm;
+    cfg->ref_fallback_mm = s_policy_cfg.presence_ref_fallback_mm;
+    cfg->body_margin_mm = s_policy_cfg.presence_body_margin_mm;
+    cfg->return_confirm_ms = s_policy_cfg.presence_return_confirm_ms;
+    cfg->streak_max_dt_ms = s_policy_cfg.presence_streak_max_dt_ms;
+    cfg->classifier = s_policy_cfg.presence_classifier;
+    cfg->hmm = s_policy_cfg.presence_hmm;
+    cfg->hmm_candidate_permille = s_policy_cfg.presence_hmm_candidate_permille;
+    cfg->hmm_clear_permille = s_policy_cfg.presence_hmm_clear_permille;
+    cfg->hmm_recover_permille = s_policy_cfg.presence_hmm_recover_permille;
+    cfg->ldr_shadow_delta_raw = s_policy_cfg.presence_ldr_shadow_delta_raw;
+    cfg->learn_background = s_policy_cfg.presence_learn_background;
+    cfg->background = s_policy_cfg.presence_background;
+    cfg->min_away_margin_mm = s_policy_cfg.presence_min_away_margin_mm;
+    cfg->arrival_velocity_mm_s = s_policy_cfg.presence_arrival_velocity_mm_s;
+    cfg->arrival_horizon_ms = s_policy_cfg.presence_arrival_horizon_ms;
+    cfg->arrival_confirm_ms = s_policy_cfg.presence_arrival_confirm_ms;
+}
+
+static void app_presence_settings(presence_engine_settings_t *settings)
+{
+    settings->away_mode_enabled = s_app.settings.active.away_mode_enabled;
+    settings->flat_mode_enabled = s_app.settings.active.flat_mode_enabled;
+    settings->away_timeout_ms = (uint32_t)s_app.settings.active.away_timeout_s * 1000U;
+    settings->stale_timeout_ms = (uint32_t)s_app.settings.active.stale_timeout_s * 1000U;
+    settings->return_band_mm = (uint32_t)s_app.settings.active.return_band_cm * 10U;
+    /* Pre-off confirmation is done by the output control loop, not per sample. */
+    settings->preoff_dim_ms = 0U;
+}
+
+void app_presence_init(uint32_t now_ms)
+{
+    presence_engine_cfg_t cfg;
+    uint8_t zone;
+
+    app_presence_engine_cfg(&cfg);
+    for (zone = 0U; zone < APP_US_ZONE_COUNT; zone++) {
+        presence_engine_init(&s_app.sensors.presence.zone[zone], &cfg);
+        s_app.sensors.presence.zone_step_ms[zone] = now_ms;
+    }
+    s_app.sensors.presence.present = 1U;
+    s_app.sensors.presence.candidate_no_user = 0U;
+    s_app.sensors.presence.no_user_reason = PRESENCE_NO_USER_REASON_NONE;
+    s_app.sensors.presence.holding_mask = 0U;
+    s_app.sensors.presence.lead_zone = 0U;
+
+    presence_shadow_init(&s_app.sensors.presence.shadow, &cfg, s_policy_cfg.presence_shadow,
+                         s_policy_cfg.presence_shadow_count);
+    presence_shadow_track_reset(&s_app.sensors.presence.live_track, &s_app.sensors.presence.zone[0]);
+    if (s_app.sensors.presence.shadow.count != 0U) {
+        cycle_counter_init();
+    }
+}
+
+static uint32_t app_cycle_now(void)
+{
+    return cycle_counter_now();
+}
+
+/* The seat zone's sample, again for every shadow policy; the live settings get the real pre-off time since
+ * the shadows confirm their own candidates. */
+static void app_presence_shadow_step(const presence_sample_t *sample, uint32_t dt_ms,
+                                     const presence_engine_settings_t *live_settings)
+{
+    presence_engine_settings_t settings = *live_settings;
+
+    presence_shadow_track_update(&s_app.sensors.presence.live_track, &s_app.sensors.presence.zone[0], dt_ms);
+    if (s_app.sensors.presence.shadow.count == 0U) {
+        return;
+    }
+
+    settings.preoff_dim_ms = (uint32_t)s_app.settings.active.preoff_dim_s * 1000U;
+    presence_shadow_step(&s_app.sensors.presence.shadow, sample, dt_ms, &settings, app_cycle_now);
+}
+
+/* Budget on the per-window average cost, not single samples: a step stretched by a preempting ISR (capture,
+ * DMA, SysTick) must not cost a policy. Policies are dropped from the end until the rest fit. */
+void app_presence_shadow_apply_budget(const uint32_t *avg_cycles)
+{
+    presence_shadow_set_t *set = &s_app.sensors.presence.shadow;
+    uint32_t total = 0U;
+    uint8_t i;
+
+    for (i = 0U; i < set->count; i++) {
+        total += avg_cycles[i];
+    }
+
+    while ((set->count != 0U) && (total > s_policy_cfg.presence_shadow_budget_cycles)) {
+        uint8_t last = (uint8_t)(set->count - 1U);
+
+        total -= avg_cycles[last];
+        presence_shadow_limit(set, last);
+        debug_logln(DEBUG_PRINT_INFO, "dbg shadow over_budget drop=%u cyc_avg=%lu budget=%lu policies=%u",
+                    (unsigned int)last,
+                    (unsigned long)avg_cycles[last],
+                    (unsigned long)s_policy_cfg.presence_shadow_budget_cycles,
+                    (unsigned int)set->count);
+    }
+}
+
+/* A lone sensor keeps the single-zone behaviour: its engine decides alone, at any distance. */
+static uint8_t app_zone_holds_user(const presence_engine_t *zone)
+{
+    if ((zone->present == 0U) || (zone->candidate_no_user != 0U)) {
+        return 0U;
+    }
+    if (APP_US_ZONE_COUNT == 1U) {
+        return 1U;
+    }
+
+    return ((zone->filtered_mm != zone->cfg.distance_error_mm) &&
+            (zone->filtered_mm <= s_policy_cfg.presence_zone_seat_max_mm)) ? 1U : 0U;
+}
+
+static void app_presence_fuse(void)
+{
+    app_presence_state_t *p = &s_app.sensors.presence;
+    uint8_t candidates = 0U;
+    uint8_t away_candidate = 0U;
+    uint8_t arrival = 0U;
+    uint32_t lead_mm = 0xFFFFFFFFUL;
+    uint8_t zone;
+
+    p->holding_mask = 0U;
+    for (zone = 0U; zone < APP_US_ZONE_COUNT; zone++) {
+        const presence_engine_t *e = &p->zone[zone];
 
-            if (s_app.control.light_enabled == 0U) {
-                s_app.sensors.away_streak_ms = 0U;
-                s_app.sensors.flat_streak_ms = 0U;
-                s_app.sensors.motion_streak_ms = 0U;
-                s_app.sensors.near_ref_streak_ms = 0U;
-                s_app.sensors.presence_candidate_no_user = 0U;
-            } else {
-                ref_distance_cm = s_app.sensors.ref_valid != 0U ? s_app.sensors.ref_distance_cm : s_policy_cfg.presence_ref_fallback_cm;
-                prev_ready = s_app.sensors.prev_valid_distance_ready;
-                away_mode_enabled = s_app.settings.active.away_mode_enabled;
-                flat_mode_enabled = s_app.settings.active.flat_mode_enabled;
-                if (prev_ready != 0U) {
-                    abs_step_delta_cm = abs_diff_u32(s_app.sensors.last_distance_filtered_cm, s_app.sensors.prev_valid_distance_cm);
-                }
-
-                away_condition = ((away_mode_enabled != 0U) &&
-                                  (s_app.sensors.last_distance_filtered_cm >
-                                   (ref_distance_cm + s_policy_cfg.presence_body_margin_cm))) ? 1U : 0U;
-                flat_condition = ((flat_mode_enabled != 0U) &&
-                                  (prev_ready != 0U) &&
-                                  (abs_step_delta_cm <= s_policy_cfg.presence_flat_band_cm)) ? 1U : 0U;
-                motion_condition = ((prev_ready != 0U) && (abs_step_delta_cm >= s_policy_cfg.presence_motion_delta_cm)) ? 1U : 0U;
-
-                if (s_app.sensors.last_valid_presence != 0U) {
-                    if (away_condition != 0U) {
-                        s_app.sensors.away_streak_ms += s_timing_cfg.us_sample_ms;
-                    } else {
-                        s_app.sensors.away_streak_ms = 0U;
-                    }
-
-                    if (flat_condition != 0U) {
-                        s_app.sensors.flat_streak_ms += s_timing_cfg.us_sample_ms;
-                    } else {
-                        s_app.sensors.flat_streak_ms = 0U;
-                    }
-                } else {
-                    s_app.sensors.away_streak_ms = 0U;
-                    s_app.sensors.flat_streak_ms = 0U;
-                }
-
-                /* Motion streak is only meaningful for recovery from flat no-user state. */
-                if ((s_app.sensors.last_valid_presence == 0U) &&
-                    (s_app.sensors.no_user_reason == APP_NO_USER_REASON_FLAT)) {
-                    if (motion_condition != 0U) {
-                        s_app.sensors.motion_streak_ms += s_timing_cfg.us_sample_ms;
-                    } else {
-                        if (s_app.sensors.motion_streak_ms > (s_timing_cfg.us_sample_ms / 2U)) {
-                            s_app.sensors.motion_streak_ms -= (s_timing_cfg.us_sample_ms / 2U);
-                        } else {
-                            s_app.sensors.motion_streak_ms = 0U;
-                        }
-                    }
-                } else {
-                    s_app.sensors.motion_streak_ms = 0U;
-                }
-
-                if ((s_app.sensors.last_valid_presence == 0U) &&
-                    (s_app.sensors.no_user_reason == APP_NO_USER_REASON_AWAY) &&
-                    (s_app.sensors.last_distance_filtered_cm <=
-                     (ref_distance_cm + (uint32_t)s_app.settings.active.return_band_cm))) {
-                    s_app.sensors.near_ref_streak_ms += s_timing_cfg.us_sample_ms;
-                } else {
-                    s_app.sensors.near_ref_streak_ms = 0U;
-                }
-
-                s_app.sensors.presence_candidate_no_user = 0U;
-                if (s_app.sensors.last_valid_presence != 0U) {
-                    s_app.sensors.no_user_reason = APP_NO_USER_REASON_NONE;
-                    if ((away_mode_enabled != 0U) && (s_app.sensors.away_streak_ms >= away_timeout_ms)) {
-                        s_app.sensors.presence_candidate_no_user = 1U;
-                        s_app.sensors.no_user_reason = APP_NO_USER_REASON_AWAY;
-                    } else if ((flat_mode_enabled != 0U) && (s_app.sensors.flat_streak_ms >= stale_timeout_ms)) {
-                        s_app.sensors.presence_candidate_no_user = 1U;
-                        s_app.sensors.no_user_reason = APP_NO_USER_REASON_FLAT;
-                    }
-                } else {
-                    if ((s_app.sensors.no_user_reason == APP_NO_USER_REASON_AWAY) &&
-                        (s_app.sensors.near_ref_streak_ms >= s_policy_cfg.presence_return_confirm_ms)) {
-                        s_app.sensors.last_valid_presence = 1U;
-                        s_app.sensors.near_ref_streak_ms = 0U;
-                        s_app.sensors.away_streak_ms = 0U;
-                        s_app.sensors.flat_streak_ms = 0U;
-                        s_app.sensors.no_user_reason = APP_NO_USER_REASON_NONE;
-                    } else if ((s_app.sensors.no_user_reason == APP_NO_USER_REASON_FLAT) &&
-                               (motion_condition != 0U)) {
-                        s_app.sensors.last_valid_presence = 1U;
-                        s_app.sensors.motion_streak_ms = 0U;
-                        s_app.sensors.away_streak_ms = 0U;
-                        s_app.sensors.flat_streak_ms = 0U;
-                        s_app.sensors.no_user_reason = APP_NO_USER_REASON_NONE;
-                    }
-                }
+        arrival |= e->arrival_predicted;
+
+        if (app_zone_holds_user(e) != 0U) {
+            p->holding_mask |= (uint8_t)(1U << zone);
+            /* The nearest holding zone is where the user is. */
+            if (e->filtered_mm < lead_mm) {
+                lead_mm = e->filtered_mm;
+                p->lead_zone = zone;
+            }
+        } else if ((e->present != 0U) && (e->candidate_no_user != 0U)) {
+            candidates++;
+            if (e->no_user_reason == PRESENCE_NO_USER_REASON_AWAY) {
+                away_candidate = 1U;
             }
+        }
+    }
+
+    if (p->holding_mask != 0U) {
+        p->present = 1U;
+        p->candidate_no_user = 0U;
+        p->no_user_reason = PRESENCE_NO_USER_REASON_NONE;
+        p->arrival_predicted = 0U;
+        return;
+    }
+    p->arrival_predicted = (p->present == 0U) ? arrival : 0U;
+
+    /* Nobody is held: the seat zone reports until a zone takes over again. */
+    if (lead_mm == 0xFFFFFFFFUL) {
+        p->lead_zone = 0U;
+    }
+    if (p->present != 0U) {
+        p->candidate_no_user = (candidates != 0U) ? 1U : 0U;
+        p->no_user_reason = (candidates == 0U) ? PRESENCE_NO_USER_REASON_NONE
+                                                : ((away_candidate != 0U) ? PRESENCE_NO_USER_REASON_AWAY
+                                                                         : PRESENCE_NO_USER_REASON_FLAT);
+    }
+}
+
+void app_presence_arm(void)
+{
+    uint8_t zone;
+
+    for (zone = 0U; zone < APP_US_ZONE_COUNT; zone++) {
+        presence_engine_arm(&s_app.sensors.presence.zone[zone]);
+    }
+    presence_shadow_arm(&s_app.sensors.presence.shadow);
+    presence_shadow_track_sync(&s_app.sensors.presence.live_track, &s_app.sensors.presence.zone[0]);
+    s_app.sensors.presence.present = 1U;
+    s_app.sensors.presence.candidate_no_user = 0U;
+    s_app.sensors.presence.no_user_reason = PRESENCE_NO_USER_REASON_NONE;
+    s_app.sensors.presence.arrival_predicted = 0U;
+}
+
+void app_presence_disarm(void)
+{
+    uint8_t zone;
+
+    for (zone = 0U; zone < APP_US_ZONE_COUNT; zone++) {
+        presence_engine_disarm(&s_app.sensors.presence.zone[zone]);
+    }
+    presence_shadow_disarm(&s_app.sensors.presence.shadow);
+    presence_shadow_track_sync(&s_app.sensors.presence.live_track, &s_app.sensors.presence.zone[0]);
+    s_app.sensors.presence.candidate_no_user = 0U;
+    s_app.sensors.presence.arrival_predicted = 0U;
+}
+
+/* Every zone proposing no-user goes with it; zones that only see the room stay as they are and never hold. */
+void app_presence_confirm_no_user(void)
+{
+    uint8_t zone;
+
+    for (zone = 0U; zone < APP_US_ZONE_COUNT; zone++) {
+        if (s_app.sensors.presence.zone[zone].candidate_no_user != 0U) {
+            presence_engine_confirm_no_user(&s_app.sensors.presence.zone[zone]);
+        }
+    }
+    s_app.sensors.presence.present = 0U;
+    s_app.sensors.presence.candidate_no_user = 0U;
+}
+
+const presence_engine_t *app_presence_lead(void)
+{
+    return &s_app.sensors.presence.zone[s_app.sensors.presence.lead_zone];
+}
+
+static void app_process_ultrasonic_result(uint32_t now_ms, uint8_t zone, const ultrasonic_burst_result_t *result)
+{
+    presence_engine_settings_t settings;
+    presence_sample_t sample;
+    uint32_t dt_ms;
+
+    s_app.sensors.last_us_status = result->status;
+    s_app.sensors.last_us_zone = zone;
+    s_app.sensors.last_us_confidence_percent = result->confidence_percent;
+    s_app.sensors.last_us_valid_pings = result->valid_pings;
+    /* Low-agreement bursts are dropped here so they never occupy a median slot. */
+    sample.distance_mm = result->distance_mm;
+    sample.valid = ((result->status == ULTRASONIC_STATUS_OK) &&
+                    (result->confidence_percent >= s_policy_cfg.us_min_confidence_percent) &&
+                    (result->distance_mm != s_policy_cfg.distance_error_mm)) ? 1U : 0U;
+    /* Lamp-compensated ambient, so the lamp's own ramps do not read as shadows. */
+    sample.ldr_raw = s_app.control.ambient_raw;
+    sample.ldr_valid = (s_app.sensors.last_ldr_status == LDR_STATUS_OK) ? 1U : 0U;
+
+    app_presence_settings(&settings);
+    dt_ms = now_ms - s_app.sensors.presence.zone_step_ms[zone];
+    presence_engine_step(&s_app.sensors.presence.zone[zone], &sample, dt_ms, &settings, NULL);
+    s_app.sensors.presence.zone_step_ms[zone] = now_ms;
+    if (zone == 0U) {
+        app_presence_shadow_step(&sample, dt_ms, &settings);
+    }
+    app_presence_fuse();
+}
+
+void app_configure_ultrasonic_burst(uint8_t gesture_profile)
+{
+    ultrasonic_burst_cfg_t burst_cfg = {
+        .ping_count = s_policy_cfg.us_burst_ping_count,
+        .ping_timeout_us = s_policy_cfg.us_timeout_us,
+        .dead_time_ms = s_policy_cfg.us_burst_dead_time_ms,
+        .agree_band_us = s_policy_cfg.us_burst_agree_band_us,
+    };
+    uint32_t period_us = ULTRASONIC_HW_PERIOD_US;
+    uint8_t zone;
+
+    if (gesture_profile != 0U) {
+        burst_cfg.ping_count = 1U;
+        burst_cfg.ping_timeout_us = s_policy_cfg.gesture_ping_timeout_us;
+        burst_cfg.dead_time_ms = 0U;
+        period_us = s_timing_cfg.gesture_sample_ms * 1000U;
+    }
+
+    for (zone = 0U; zone < APP_US_ZONE_COUNT; zone++) {
+        ultrasonic_burst_configure(&s_app.sensors.us_burst[zone], &burst_cfg);
+        /* HW_TIMED pings on its own timer, so the session cadence has to be programmed there too. */
+        (void)ultrasonic_set_period_us(&s_app.sensors.us[zone], period_us);
+    }
+    s_app.gesture.burst_profile_fast = (gesture_profile != 0U) ? 1U : 0U;
+}
+
+/* Returns 1 when the sample belongs to a gesture session and must not reach the presence engine. */
+static uint8_t app_route_gesture_sample(uint32_t now_ms, const ultrasonic_burst_result_t *result)
+{
+    uint8_t valid;
+    uint8_t in_zone;
+
+    if ((s_policy_cfg.gesture_enabled == 0U) || (s_app.settings_ui.mode_active != 0U)) {
+        return 0U;
+    }
+
+    valid = ((result->status == ULTRASONIC_STATUS_OK) &&
+             (result->confidence_percent >= s_policy_cfg.us_min_confidence_percent)) ? 1U : 0U;
+    in_zone = ((valid != 0U) &&
+               (result->distance_mm >= s_policy_cfg.gesture_zone_min_mm) &&
+               (result->distance_mm <= s_policy_cfg.gesture_zone_max_mm)) ? 1U : 0U;
+
+    /* A session needs an entry: a valid return beyond the zone, then one inside it. A static object or a
+     * user leaning in stays in the zone and cannot reopen a session once it has ended. */
+    if ((valid != 0U) && (result->distance_mm > s_policy_cfg.gesture_zone_max_mm)) {
+        s_app.gesture.entry_armed = 1U;
+    }
+
+    if (in_zone != 0U) {
+        if (s_app.gesture.active != 0U) {
+            s_app.gesture.last_hand_ms = now_ms;
+        } else if (s_app.gesture.entry_armed != 0U) {
+            s_app.gesture.active = 1U;
+            s_app.gesture.entry_armed = 0U;
+            s_app.gesture.last_hand_ms = now_ms;
+            s_app.gesture.session_start_ms = now_ms;
+            gesture_input_reset();
+            debug_logln(DEBUG_PRINT_DEBUG, "dbg gesture=session_start dist_mm=%lu", (unsigned long)result->distance_mm);
+        }
+    }
+
+    if (s_app.gesture.active == 0U) {
+        return 0U;
+    }
+
+    gesture_input_push_sample(now_ms, result->distance_mm, valid);
+    return 1U;
+}
+
+static void app_update_gesture_session(uint32_t now_ms)
+{
+    uint8_t expired;
+
+    if (s_app.gesture.active == 0U) {
+        return;
+    }
+
+    expired = input_has_elapsed_ms(now_ms, s_app.gesture.session_start_ms, s_policy_cfg.gesture_session_max_ms);
+    if ((s_app.settings_ui.mode_active != 0U) || (expired != 0U) ||
+        ((gesture_input_hand_present() == 0U) &&
+         (input_has_elapsed_ms(now_ms, s_app.gesture.last_hand_ms, s_policy_cfg.gesture_session_timeout_ms) != 0U))) {
+        s_app.gesture.active = 0U;
+        gesture_input_reset();
+        debug_logln(DEBUG_PRINT_DEBUG, "dbg gesture=session_end%s", (expired != 0U) ? " max_len" : "");
+    }
+}
+
+static uint32_t app_ultrasonic_interval_ms(void)
+{
+    uint8_t zone;
+
+    if (s_app.gesture.active != 0U) {
+        return s_timing_cfg.gesture_sample_ms;
+    }
+
+    if (s_app.control.light_enabled == 0U) {
+        return s_timing_cfg.us_sample_idle_ms;
+    }
+
+    /* Fast while a decision is pending: no-user candidate, pre-off dim, return confirmation or ref capture. */
+    if ((s_app.sensors.presence.candidate_no_user != 0U) ||
+        (s_app.control.preoff_active != 0U) ||
+        (s_app.sensors.presence.present == 0U)) {
+        return s_timing_cfg.us_sample_ms;
+    }
+    for (zone = 0U; zone < APP_US_ZONE_COUNT; zone++) {
+        if (s_app.sensors.presence.zone[zone].ref_pending_capture != 0U) {
+            return s_timing_cfg.us_sample_ms;
+        }
+    }
+
+    return s_timing_cfg.us_sample_stable_ms;
+}
+
+void app_sample_ultrasonic_if_due(uint32_t now_ms)
+{
+    ultrasonic_burst_result_t result;
+    uint8_t zone;
+
+    /* Never blocks: collect a finished zone burst first, then start the next round when due. Gestures are
+     * read by the seat zone only. */
+    if (ultrasonic_zones_poll(&s_app.sensors.us_zones, now_ms, &zone, &result) != 0U) {
+        if ((zone != 0U) || (app_route_gesture_sample(now_ms, &result) == 0U)) {
+            app_process_ultrasonic_result(now_ms, zone, &result);
+        }
+    }
+    app_update_gesture_session(now_ms);
+
+    s_app.timing.us_interval_ms = app_ultrasonic_interval_ms();
+    if ((input_has_elapsed_ms(now_ms, s_app.timing.last_us_sample_ms, s_app.timing.us_interval_ms) != 0U) &&
+        (ultrasonic_zones_is_busy(&s_app.sensors.us_zones) == 0U)) {
+        ultrasonic_status_t start_status;
+        /* A gesture session pings only the seat zone, at the gesture cadence. */
+        uint8_t zone_mask = (s_app.gesture.active != 0U) ? 1U : (uint8_t)((1U << APP_US_ZONE_COUNT) - 1U);
+
+        if (s_app.gesture.burst_profile_fast != s_app.gesture.active) {
+            app_configure_ultrasonic_burst(s_app.gesture.active);
+        }
+        start_status = ultrasonic_zones_start_round(&s_app.sensors.us_zones, zone_mask, s_app.sensors.mcu_temp_deci_c);
 
-            s_app.sensors.prev_valid_distance_cm = s_app.sensors.last_distance_filtered_cm;
-            s_app.sensors.prev_valid_distance_ready = 1U;
+        /* Interval is measured between round starts; streaks use sample timestamps, so no catch-up is needed. */
+        s_app.timing.last_us_sample_ms = now_ms;
+        if (start_status != ULTRASONIC_STATUS_OK) {
+            s_app.sensors.last_us_status = start_status;
         }
     }
 }
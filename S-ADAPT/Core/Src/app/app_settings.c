@@ -1,5 +1,14 @@
 #include "app/app_settings.h"
 #include <stddef.h>
+#include <string.h>
+
+/* Generated by tools/ldr_lut_gen.py from tools/ldr_cal_points.csv (13 measured points). */
+static const app_ldr_cal_t s_ldr_cal_default = {
+    .raw = { 681U, 1381U, 2279U, 3109U, 3635U, 3894U, 4012U, 4063U},
+    .log_lux_mdec = {   0U,  571U, 1143U, 1714U, 2286U, 2857U, 3429U, 4000U},
+    .transfer_log_lux_mdec = {   0U, 1000U, 2000U, 2700U, 3000U, 5000U},
+    .transfer_percent = {100U,  94U,  79U,  52U,   0U,   0U},
+};
 
 static uint16_t clamp_u16(uint16_t value, uint16_t min_value, uint16_t max_value)
 {
@@ -43,6 +52,64 @@ void app_settings_set_defaults(app_settings_t *cfg)
     cfg->stale_timeout_s = APP_SETTINGS_STALE_TIMEOUT_S_DEFAULT;
     cfg->preoff_dim_s = APP_SETTINGS_PREOFF_DIM_S_DEFAULT;
     cfg->return_band_cm = APP_SETTINGS_RETURN_BAND_CM_DEFAULT;
+    app_settings_set_ldr_cal_defaults(&cfg->ldr_cal);
+    /* No self-illumination model until the lamp calibration sweep has run. */
+    memset(&cfg->lamp_comp, 0, sizeof(cfg->lamp_comp));
+}
+
+void app_settings_set_ldr_cal_defaults(app_ldr_cal_t *cal)
+{
+    if (cal == NULL) {
+        return;
+    }
+
+    *cal = s_ldr_cal_default;
+}
+
+uint8_t app_settings_ldr_cal_is_valid(const app_ldr_cal_t *cal)
+{
+    uint8_t i;
+
+    if (cal == NULL) {
+        return 0U;
+    }
+
+    for (i = 0U; i < APP_LDR_CAL_POINTS; i++) {
+        if ((cal->raw[i] > 4095U) || (cal->log_lux_mdec[i] > APP_LDR_LOG_LUX_MAX_MDEC)) {
+            return 0U;
+        }
+        if ((i > 0U) &&
+            ((cal->raw[i] <= cal->raw[i - 1U]) || (cal->log_lux_mdec[i] < cal->log_lux_mdec[i - 1U]))) {
+            return 0U;
+        }
+    }
+    for (i = 0U; i < APP_LUX_TRANSFER_POINTS; i++) {
+        if ((cal->transfer_log_lux_mdec[i] > APP_LDR_LOG_LUX_MAX_MDEC) || (cal->transfer_percent[i] > 100U)) {
+            return 0U;
+        }
+        if ((i > 0U) && (cal->transfer_log_lux_mdec[i] <= cal->transfer_log_lux_mdec[i - 1U])) {
+            return 0U;
+        }
+    }
+
+    return 1U;
+}
+
+uint8_t app_settings_lamp_comp_is_valid(const app_lamp_comp_t *comp)
+{
+    uint8_t i;
+
+    if ((comp == NULL) || (comp->valid > 1U) || (comp->delta_raw[0] != 0U)) {
+        return 0U;
+    }
+
+    for (i = 1U; i < APP_LAMP_COMP_POINTS; i++) {
+        if ((comp->delta_raw[i] > 4095U) || (comp->delta_raw[i] < comp->delta_raw[i - 1U])) {
+            return 0U;
+        }
+    }
+
+    return 1U;
 }
 
 uint8_t app_settings_validate(app_settings_t *cfg)
@@ -69,5 +136,12 @@ uint8_t app_settings_validate(app_settings_t *cfg)
                                                   APP_SETTINGS_RETURN_BAND_CM_MIN,
                                                   APP_SETTINGS_RETURN_BAND_CM_MAX,
                                                   APP_SETTINGS_RETURN_BAND_CM_STEP);
+    /* Breakpoints cannot be clamped one by one without breaking monotonicity; fall back to the build table. */
+    if (app_settings_ldr_cal_is_valid(&cfg->ldr_cal) == 0U) {
+        app_settings_set_ldr_cal_defaults(&cfg->ldr_cal);
+    }
+    if (app_settings_lamp_comp_is_valid(&cfg->lamp_comp) == 0U) {
+        memset(&cfg->lamp_comp, 0, sizeof(cfg->lamp_comp));
+    }
     return 1U;
 }
@@ -22,24 +22,12 @@ static uint8_t s_overlay_reach_latched = 0U;
 #define APP_UI_OVERLAY_ANIM_DIVISOR     2
 #define APP_UI_OVERLAY_POST_HOLD_MS     750U
 
-static const char *no_user_reason_to_string(app_no_user_reason_t reason)
-{
-    switch (reason) {
-        case APP_NO_USER_REASON_AWAY:
-            return "away";
-        case APP_NO_USER_REASON_FLAT:
-            return "flat";
-        default:
-            return "none";
-    }
-}
-
 static display_mode_t app_to_display_mode(void)
 {
     if (s_app.control.light_enabled == 0U) {
         return DISPLAY_MODE_OFF;
     }
-    if (s_app.sensors.last_valid_presence == 0U) {
+    if (s_app.sensors.presence.present == 0U) {
         return DISPLAY_MODE_SLEEP;
     }
     return DISPLAY_MODE_ON;
@@ -47,10 +35,10 @@ static display_mode_t app_to_display_mode(void)
 
 static display_reason_t app_to_display_reason(void)
 {
-    switch (s_app.sensors.no_user_reason) {
-        case APP_NO_USER_REASON_AWAY:
+    switch (s_app.sensors.presence.no_user_reason) {
+        case PRESENCE_NO_USER_REASON_AWAY:
             return DISPLAY_REASON_AWAY;
-        case APP_NO_USER_REASON_FLAT:
+        case PRESENCE_NO_USER_REASON_FLAT:
             return DISPLAY_REASON_FLAT;
         default:
             return DISPLAY_REASON_NONE;
@@ -68,22 +56,25 @@ static uint8_t app_compute_ldr_percent(uint16_t ldr_filtered_raw)
 
 static display_badge_t app_select_main_badge(void)
 {
+    const presence_engine_t *lead = app_presence_lead();
+
     if (s_app.control.preoff_active != 0U) {
         return DISPLAY_BADGE_DIM;
     }
 
-    if (s_app.sensors.last_valid_presence == 0U) {
-        switch (s_app.sensors.no_user_reason) {
-            case APP_NO_USER_REASON_AWAY:
+    if (s_app.sensors.presence.present == 0U) {
+        switch (s_app.sensors.presence.no_user_reason) {
+            case PRESENCE_NO_USER_REASON_AWAY:
                 return DISPLAY_BADGE_AWAY;
-            case APP_NO_USER_REASON_FLAT:
+            case PRESENCE_NO_USER_REASON_FLAT:
                 return DISPLAY_BADGE_IDLE;
             default:
                 break;
         }
     }
 
-    if (s_app.sensors.away_streak_ms > 0U) {
+    if ((lead->away_streak_ms > 0U) ||
+        ((lead->cfg.classifier == PRESENCE_CLASSIFIER_HMM) && (lead->hmm_state == PRESENCE_HMM_LEAVING))) {
         return DISPLAY_BADGE_LEAVE;
     }
 
@@ -107,6 +98,8 @@ static display_settings_status_t app_to_display_settings_status(void)
 
 static void app_compose_display_view(display_view_t *view)
 {
+    const presence_engine_t *lead = app_presence_lead();
+
     if (view == NULL) {
         return;
     }
@@ -115,14 +108,35 @@ static void app_compose_display_view(display_view_t *view)
     view->ldr_percent = app_compute_ldr_percent(s_app.sensors.last_ldr_filtered);
     view->output_percent = s_app.control.output_percent;
     view->manual_offset = s_app.control.manual_offset;
-    view->distance_cm = s_app.sensors.last_valid_distance_cm;
+    view->distance_cm = lead->prev_valid_mm / 10U;
     view->ldr_filtered_raw = s_app.sensors.last_ldr_filtered;
-    view->ref_cm = s_app.sensors.ref_distance_cm;
-    view->present = s_app.sensors.last_valid_presence;
+    view->ref_cm = lead->ref_distance_mm / 10U;
+    view->present = s_app.sensors.presence.present;
     view->reason = app_to_display_reason();
     view->badge = app_select_main_badge();
 }
 
+static display_lamp_cal_t app_to_display_lamp_cal(void)
+{
+    if (app_lamp_cal_active() != 0U) {
+        return DISPLAY_LAMP_CAL_RUNNING;
+    }
+
+    switch (s_app.lamp_cal.result) {
+        case APP_LAMP_CAL_RESULT_OK:
+            return DISPLAY_LAMP_CAL_OK;
+        case APP_LAMP_CAL_RESULT_SENSOR_ERR:
+        case APP_LAMP_CAL_RESULT_DRIFT_ERR:
+        case APP_LAMP_CAL_RESULT_SAVE_ERR:
+            return DISPLAY_LAMP_CAL_ERR;
+        default:
+            break;
+    }
+
+    /* No sweep this boot: report the stored model. */
+    return (s_app.settings.active.lamp_comp.valid != 0U) ? DISPLAY_LAMP_CAL_OK : DISPLAY_LAMP_CAL_NONE;
+}
+
 static void app_compose_settings_view(display_settings_view_t *view)
 {
     if (view == NULL) {
@@ -139,6 +153,8 @@ static void app_compose_settings_view(display_settings_view_t *view)
     view->stale_timeout_s = s_app.settings.draft.stale_timeout_s;
     view->preoff_dim_s = s_app.settings.draft.preoff_dim_s;
     view->return_band_cm = s_app.settings.draft.return_band_cm;
+    view->lamp_cal = app_to_display_lamp_cal();
+    view->lamp_cal_progress_percent = app_lamp_cal_progress_percent();
     view->status = app_to_display_settings_status();
 }
 
@@ -390,6 +406,7 @@ void app_update_oled_if_due(uint32_t now_ms)
 void app_log_summary_if_due(uint32_t now_ms)
 {
     if (input_has_elapsed_ms(now_ms, s_app.timing.last_log_ms, s_timing_cfg.log_ms) != 0U) {
+        const presence_engine_t *lead = app_presence_lead();
         uint32_t preoff_ms = 0U;
 
         s_app.timing.last_log_ms = now_ms;
@@ -398,29 +415,52 @@ void app_log_summary_if_due(uint32_t now_ms)
         }
 
         debug_logln(DEBUG_PRINT_INFO,
-                    "dbg summary ldr_raw=%u ldr_filt=%u ldr_status=%s dist_cm_raw_last_valid=%lu dist_cm_filt=%lu us_status=%s present=%u light_on=%u offset=%ld auto=%u target_out=%u hyst_out=%u applied_out=%u ref_cm=%lu ref_src=%s away_ms=%lu flat_ms=%lu motion_ms=%lu no_user_reason=%s preoff=%u preoff_ms=%lu preoff_target=%u rgb=%s cfg_away_en=%u cfg_flat_en=%u cfg_away_s=%u cfg_flat_s=%u cfg_preoff_s=%u cfg_ret_cm=%u settings_mode=%u settings_dirty=%u",
+                    "dbg summary ldr_raw=%u ldr_filt=%u lux_mdec=%u amb_raw=%u lamp_comp=%u ldr_status=%s flicker_hz=%u ripple_pp=%u ldr_watch=%u ldr_wakes=%lu dist_mm_raw_last_valid=%lu dist_mm_filt=%lu dist_vel=%ld track=%s zone=%u zones_held=0x%x us_zone=%u us_status=%s us_conf=%u us_valid=%u us_int_ms=%lu temp_dc=%ld present=%u light_on=%u offset=%ld auto=%u target_out=%u hyst_out=%u applied_out=%u out_q8=%u ref_mm=%lu ref_src=%s away_margin_mm=%lu away_ms=%lu flat_ms=%lu motion_ms=%lu no_user_reason=%s p_present=%u hmm=%s arrival=%u preramp=%u preoff=%u preoff_ms=%lu preoff_target=%u rgb=%s cfg_away_en=%u cfg_flat_en=%u cfg_away_s=%u cfg_flat_s=%u cfg_preoff_s=%u cfg_ret_cm=%u settings_mode=%u settings_dirty=%u",
                     (unsigned int)s_app.sensors.last_ldr_raw,
                     (unsigned int)s_app.sensors.last_ldr_filtered,
+                    (unsigned int)s_app.control.ambient_log_lux_mdec,
+                    (unsigned int)s_app.control.ambient_raw,
+                    (unsigned int)s_app.control.lamp_comp_raw,
                     ldr_status_to_string(s_app.sensors.last_ldr_status),
-                    (unsigned long)s_app.sensors.last_distance_raw_cm,
-                    (unsigned long)s_app.sensors.last_distance_filtered_cm,
+                    (unsigned int)s_app.sensors.ldr_flicker_hz,
+                    (unsigned int)s_app.sensors.ldr_ripple_pp_raw,
+                    (unsigned int)s_app.sensors.ldr_watch_armed,
+                    (unsigned long)s_app.sensors.ldr_watch_events,
+                    (unsigned long)lead->raw_mm,
+                    (unsigned long)lead->filtered_mm,
+                    (long)lead->velocity_mm_s,
+                    distance_tracker_status_to_string(lead->track_status),
+                    (unsigned int)s_app.sensors.presence.lead_zone,
+                    (unsigned int)s_app.sensors.presence.holding_mask,
+                    (unsigned int)s_app.sensors.last_us_zone,
                     ultrasonic_status_to_string(s_app.sensors.last_us_status),
-                    (unsigned int)s_app.sensors.last_valid_presence,
+                    (unsigned int)s_app.sensors.last_us_confidence_percent,
+                    (unsigned int)s_app.sensors.last_us_valid_pings,
+                    (unsigned long)s_app.timing.us_interval_ms,
+                    (long)s_app.sensors.mcu_temp_deci_c,
+                    (unsigned int)s_app.sensors.presence.present,
                     (unsigned int)s_app.control.light_enabled,
                     (long)s_app.control.manual_offset,
                     (unsigned int)s_app.control.auto_percent,
-                    (unsigned int)s_app.control.target_output_percent,
-                    (unsigned int)s_app.control.hysteresis_output_percent,
+                    (unsigned int)APP_OUTPUT_LEVEL_TO_PERCENT(s_app.control.target_output_level),
+                    (unsigned int)APP_OUTPUT_LEVEL_TO_PERCENT(s_app.control.hysteresis_output_level),
                     (unsigned int)s_app.control.output_percent,
-                    (unsigned long)s_app.sensors.ref_distance_cm,
-                    (s_app.sensors.using_fallback_ref != 0U) ? "fallback" : "captured",
-                    (unsigned long)s_app.sensors.away_streak_ms,
-                    (unsigned long)s_app.sensors.flat_streak_ms,
-                    (unsigned long)s_app.sensors.motion_streak_ms,
-                    no_user_reason_to_string(s_app.sensors.no_user_reason),
+                    (unsigned int)s_app.control.output_level,
+                    (unsigned long)lead->ref_distance_mm,
+                    (lead->ref_learned != 0U) ? "learned"
+                        : ((lead->using_fallback_ref != 0U) ? "fallback" : "captured"),
+                    (unsigned long)lead->away_margin_mm,
+                    (unsigned long)lead->away_streak_ms,
+                    (unsigned long)lead->flat_streak_ms,
+                    (unsigned long)lead->motion_streak_ms,
+                    presence_no_user_reason_to_string(s_app.sensors.presence.no_user_reason),
+                    (unsigned int)lead->present_permille,
+                    presence_hmm_state_to_string(lead->hmm_state),
+                    (unsigned int)s_app.sensors.presence.arrival_predicted,
+                    (unsigned int)s_app.control.arrival_preramp_active,
                     (unsigned int)s_app.control.preoff_active,
                     (unsigned long)preoff_ms,
-                    (unsigned int)s_app.control.preoff_dim_target_percent,
+                    (unsigned int)APP_OUTPUT_LEVEL_TO_PERCENT(s_app.control.preoff_dim_target_level),
                     status_led_state_to_string(s_app.control.rgb_state),
                     (unsigned int)s_app.settings.active.away_mode_enabled,
                     (unsigned int)s_app.settings.active.flat_mode_enabled,
@@ -432,3 +472,70 @@ void app_log_summary_if_due(uint32_t now_ms)
                     (unsigned int)s_app.settings.dirty);
     }
 }
+
+static void app_log_shadow_stats(const char *policy,
+                                 uint32_t away_ms,
+                                 uint32_t stale_ms,
+                                 uint32_t return_band_mm,
+                                 const presence_shadow_stats_t *stats,
+                                 const presence_shadow_cost_t *cost)
+{
+    uint32_t cyc_avg = 0U;
+    uint32_t cyc_max = 0U;
+
+    if (cost != NULL) {
+        cyc_avg = (cost->count != 0U) ? (cost->sum / cost->count) : 0U;
+        cyc_max = cost->max;
+    }
+
+    debug_logln(DEBUG_PRINT_INFO,
+                "dbg shadow policy=%s away_s=%lu stale_s=%lu ret_cm=%lu leaves=%lu detect_avg_ms=%lu detect_max_ms=%lu false_offs=%lu on_s=%lu cyc_avg=%lu cyc_max=%lu",
+                policy,
+                (unsigned long)(away_ms / 1000U),
+                (unsigned long)(stale_ms / 1000U),
+                (unsigned long)(return_band_mm / 10U),
+                (unsigned long)stats->leaves,
+                (unsigned long)presence_shadow_detect_avg_ms(stats),
+                (unsigned long)stats->detect_max_ms,
+                (unsigned long)stats->false_offs,
+                (unsigned long)(stats->on_ms / 1000U),
+                (unsigned long)cyc_avg,
+                (unsigned long)cyc_max);
+}
+
+/* Shadow comparison: the live seat-zone policy first, then each shadow with its effective parameters and the
+ * cycles it cost since the previous report. Counters are cumulative since boot. */
+void app_log_shadow_if_due(uint32_t now_ms)
+{
+    const presence_shadow_set_t *set = &s_app.sensors.presence.shadow;
+    presence_engine_settings_t live = {0};
+    uint32_t avg_cycles[PRESENCE_SHADOW_MAX];
+    uint8_t i;
+
+    if ((set->count == 0U) ||
+        (input_has_elapsed_ms(now_ms, s_app.timing.last_shadow_log_ms, s_timing_cfg.shadow_log_ms) == 0U)) {
+        return;
+    }
+    s_app.timing.last_shadow_log_ms = now_ms;
+
+    live.away_timeout_ms = (uint32_t)s_app.settings.active.away_timeout_s * 1000U;
+    live.stale_timeout_ms = (uint32_t)s_app.settings.active.stale_timeout_s * 1000U;
+    live.return_band_mm = (uint32_t)s_app.settings.active.return_band_cm * 10U;
+    app_log_shadow_stats("live", live.away_timeout_ms, live.stale_timeout_ms, live.return_band_mm,
+                         &s_app.sensors.presence.live_track.stats, NULL);
+    for (i = 0U; i < set->count; i++) {
+        presence_engine_settings_t effective = live;
+        presence_shadow_cost_t cost;
+        char name[4];
+
+        presence_shadow_take_cost(&s_app.sensors.presence.shadow, i, &cost);
+        avg_cycles[i] = (cost.count != 0U) ? (cost.sum / cost.count) : 0U;
+        presence_shadow_apply_settings(&effective, &set->slot[i].policy);
+        name[0] = (char)('0' + i);
+        name[1] = '\0';
+        app_log_shadow_stats(name, effective.away_timeout_ms, effective.stale_timeout_ms, effective.return_band_mm,
+                             &set->slot[i].track.stats, &cost);
+    }
+
+    app_presence_shadow_apply_budget(avg_cycles);
+}
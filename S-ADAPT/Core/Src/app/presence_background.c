@@ -0,0 +1,162 @@
+#include "app/presence_background.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/* After a gap this long only the decay matters; the remaining periods are dropped instead of looped. */
+#define PRESENCE_BACKGROUND_MAX_DECAYS  64U
+/* The overflow bin holds "beyond range", not a position, so modes are only searched below it. */
+#define PRESENCE_BACKGROUND_LAST_IN_RANGE (PRESENCE_BACKGROUND_BINS - 2U)
+
+static void decay(uint16_t *bins, uint8_t shift)
+{
+    uint32_t round = ((uint32_t)1U << shift) - 1U;
+    uint8_t i;
+
+    /* Rounding up makes every non-empty bin lose at least one count, so nothing lingers at a small
+     * floor forever. */
+    for (i = 0U; i < PRESENCE_BACKGROUND_BINS; i++) {
+        bins[i] = (uint16_t)(bins[i] - ((bins[i] + round) >> shift));
+    }
+}
+
+static uint32_t neighbourhood_sum(const uint16_t *bins, uint8_t center)
+{
+    uint32_t sum = bins[center];
+
+    if (center > 0U) {
+        sum += bins[center - 1U];
+    }
+    if (center < PRESENCE_BACKGROUND_LAST_IN_RANGE) {
+        sum += bins[center + 1U];
+    }
+
+    return sum;
+}
+
+static uint32_t neighbourhood_centroid_mm(const uint16_t *bins, uint8_t center, uint16_t bin_mm)
+{
+    uint32_t sum = 0U;
+    uint32_t moment = 0U;
+    uint8_t first = (center > 0U) ? (uint8_t)(center - 1U) : 0U;
+    uint8_t last = (center < PRESENCE_BACKGROUND_LAST_IN_RANGE) ? (uint8_t)(center + 1U) : center;
+    uint8_t i;
+
+    for (i = first; i <= last; i++) {
+        sum += bins[i];
+        moment += (uint32_t)bins[i] * (((uint32_t)i * bin_mm) + (bin_mm / 2U));
+    }
+
+    return (sum != 0U) ? (moment / sum) : (((uint32_t)center * bin_mm) + (bin_mm / 2U));
+}
+
+void presence_background_init(presence_background_t *b, const presence_background_cfg_t *cfg)
+{
+    if ((b == NULL) || (cfg == NULL)) {
+        return;
+    }
+
+    b->cfg = *cfg;
+    if (b->cfg.bin_mm == 0U) {
+        b->cfg.bin_mm = 1U;
+    }
+    if (b->cfg.decay_shift == 0U) {
+        b->cfg.decay_shift = 1U;
+    }
+    if (b->cfg.decay_shift > 15U) {
+        b->cfg.decay_shift = 15U;
+    }
+    memset(b->user, 0, sizeof(b->user));
+    memset(b->scene, 0, sizeof(b->scene));
+    b->decay_elapsed_ms = 0U;
+}
+
+uint8_t presence_background_update(presence_background_t *b,
+                                   presence_background_sample_t sample,
+                                   uint32_t distance_mm,
+                                   uint32_t dt_ms)
+{
+    uint8_t decays = 0U;
+
+    if (b == NULL) {
+        return 0U;
+    }
+
+    if (sample != PRESENCE_BACKGROUND_SAMPLE_NONE) {
+        uint16_t *bins = (sample == PRESENCE_BACKGROUND_SAMPLE_USER) ? b->user : b->scene;
+        uint32_t index = distance_mm / b->cfg.bin_mm;
+        uint32_t weight = ((dt_ms < b->cfg.sample_max_dt_ms) ? dt_ms : b->cfg.sample_max_dt_ms) /
+                          PRESENCE_BACKGROUND_WEIGHT_MS;
+
+        if (index >= PRESENCE_BACKGROUND_BINS) {
+            index = PRESENCE_BACKGROUND_BINS - 1U;
+        }
+        weight += bins[index];
+        bins[index] = (uint16_t)((weight > 0xFFFFU) ? 0xFFFFU : weight);
+    }
+
+    if (b->cfg.decay_period_ms == 0U) {
+        return 0U;
+    }
+
+    b->decay_elapsed_ms += dt_ms;
+    while ((b->decay_elapsed_ms >= b->cfg.decay_period_ms) && (decays < PRESENCE_BACKGROUND_MAX_DECAYS)) {
+        b->decay_elapsed_ms -= b->cfg.decay_period_ms;
+        decay(b->user, b->cfg.decay_shift);
+        decay(b->scene, b->cfg.decay_shift);
+        decays++;
+    }
+    if (b->decay_elapsed_ms >= b->cfg.decay_period_ms) {
+        b->decay_elapsed_ms %= b->cfg.decay_period_ms;
+    }
+
+    return (decays != 0U) ? 1U : 0U;
+}
+
+uint8_t presence_background_user_mode_mm(const presence_background_t *b, uint32_t *mode_mm)
+{
+    uint8_t peak = 0U;
+    uint8_t i;
+
+    if ((b == NULL) || (mode_mm == NULL)) {
+        return 0U;
+    }
+
+    for (i = 1U; i <= PRESENCE_BACKGROUND_LAST_IN_RANGE; i++) {
+        if (b->user[i] > b->user[peak]) {
+            peak = i;
+        }
+    }
+    if ((neighbourhood_sum(b->user, peak) * PRESENCE_BACKGROUND_WEIGHT_MS) < b->cfg.user_min_ms) {
+        return 0U;
+    }
+
+    *mode_mm = neighbourhood_centroid_mm(b->user, peak, b->cfg.bin_mm);
+    return 1U;
+}
+
+uint8_t presence_background_scene_mode_beyond_mm(const presence_background_t *b, uint32_t from_mm, uint32_t *mode_mm)
+{
+    uint32_t first;
+    uint8_t i;
+
+    if ((b == NULL) || (mode_mm == NULL)) {
+        return 0U;
+    }
+
+    first = (from_mm / b->cfg.bin_mm) + 1U;
+    for (i = (uint8_t)((first < PRESENCE_BACKGROUND_BINS) ? first : PRESENCE_BACKGROUND_BINS);
+         i <= PRESENCE_BACKGROUND_LAST_IN_RANGE;
+         i++) {
+        uint8_t local_max = ((b->scene[i] >= b->scene[i - 1U]) &&
+                             ((i == PRESENCE_BACKGROUND_LAST_IN_RANGE) || (b->scene[i] >= b->scene[i + 1U]))) ? 1U : 0U;
+
+        if ((local_max != 0U) && (b->scene[i] != 0U) &&
+            ((neighbourhood_sum(b->scene, i) * PRESENCE_BACKGROUND_WEIGHT_MS) >= b->cfg.scene_min_ms)) {
+            *mode_mm = neighbourhood_centroid_mm(b->scene, i, b->cfg.bin_mm);
+            return 1U;
+        }
+    }
+
+    return 0U;
+}
@@ -0,0 +1,625 @@
+#include "app/presence_engine.h"
+
+#include <stddef.h>
+
+/* LDR shadow detector: ~1 and ~16 sample time constants on the ultrasonic cadence. */
+#define PRESENCE_LDR_FAST_SHIFT 1U
+#define PRESENCE_LDR_SLOW_SHIFT 4U
+
+static uint32_t abs_diff_u32(uint32_t a, uint32_t b)
+{
+    return (a > b) ? (a - b) : (b - a);
+}
+
+static uint32_t reference_mm(const presence_engine_t *e)
+{
+    return (e->ref_valid != 0U) ? e->ref_distance_mm : e->cfg.ref_fallback_mm;
+}
+
+static void reset_runtime(presence_engine_t *e)
+{
+    e->away_streak_ms = 0U;
+    e->flat_streak_ms = 0U;
+    e->motion_streak_ms = 0U;
+    e->near_ref_streak_ms = 0U;
+    e->no_user_reason = PRESENCE_NO_USER_REASON_NONE;
+    e->candidate_no_user = 0U;
+    e->candidate_since_ms = e->now_ms;
+    e->arrival_streak_ms = 0U;
+    e->arrival_stall_ms = 0U;
+    e->arrival_recede_ms = 0U;
+    e->arrival_predicted = 0U;
+}
+
+/* Median output feeds the tracker; dropped and low-confidence bursts advance it as missing measurements.
+ * The tracker position becomes the filtered distance the presence rules see. */
+static void update_tracker(presence_engine_t *e, const presence_sample_t *sample)
+{
+    distance_tracker_estimate_t estimate;
+    uint32_t median_mm = 0U;
+
+    if (sample->valid != 0U) {
+        median_mm = filter_median_u32_push(&e->median, sample->distance_mm);
+    }
+
+    e->track_status = distance_tracker_update(&e->tracker, e->now_ms, median_mm, sample->valid);
+    distance_tracker_get(&e->tracker, &estimate);
+    e->velocity_mm_s = estimate.velocity_mm_s;
+    if ((estimate.status != DISTANCE_TRACKER_STATUS_NOT_INIT) && (estimate.status != DISTANCE_TRACKER_STATUS_LOST)) {
+        e->filtered_mm = estimate.distance_mm;
+    }
+}
+
+static void update_streaks(presence_engine_t *e, const presence_engine_settings_t *settings)
+{
+    const presence_engine_cfg_t *cfg = &e->cfg;
+    uint32_t ref_distance_mm = reference_mm(e);
+    uint32_t abs_step_delta_mm = 0U;
+    uint32_t dt_ms = 0U;
+    uint8_t away_condition;
+    uint8_t flat_condition;
+    uint8_t motion_condition;
+
+    if (e->prev_valid_ready != 0U) {
+        abs_step_delta_mm = abs_diff_u32(e->filtered_mm, e->prev_valid_mm);
+        /* Streaks accumulate real time between valid samples; the clamp keeps one long gap from
+         * completing a timeout on its own. */
+        dt_ms = e->now_ms - e->prev_valid_ms;
+        if (dt_ms > cfg->streak_max_dt_ms) {
+            dt_ms = cfg->streak_max_dt_ms;
+        }
+    }
+
+    away_condition = ((settings->away_mode_enabled != 0U) &&
+                      (e->filtered_mm > (ref_distance_mm + e->away_margin_mm))) ? 1U : 0U;
+    if (cfg->use_tracker != 0U) {
+        /* Velocity decides on a single sample: a lone noisy step barely moves it, and slow drift
+         * shows up as a persistent non-zero velocity instead of a run of sub-band steps. */
+        flat_condition = ((settings->flat_mode_enabled != 0U) &&
+                          (e->track_status == DISTANCE_TRACKER_STATUS_TRACKING) &&
+                          (distance_tracker_is_moving(&e->tracker, cfg->flat_velocity_mm_s, 0U) == 0U)) ? 1U : 0U;
+        motion_condition = distance_tracker_is_moving(&e->tracker, cfg->motion_velocity_mm_s, cfg->motion_sigma);
+    } else {
+        flat_condition = ((settings->flat_mode_enabled != 0U) &&
+                          (e->prev_valid_ready != 0U) &&
+                          (abs_step_delta_mm <= cfg->flat_band_mm)) ? 1U : 0U;
+        motion_condition = ((e->prev_valid_ready != 0U) &&
+                            (abs_step_delta_mm >= cfg->motion_delta_mm)) ? 1U : 0U;
+    }
+
+    if (e->present != 0U) {
+        e->away_streak_ms = (away_condition != 0U) ? (e->away_streak_ms + dt_ms) : 0U;
+        e->flat_streak_ms = (flat_condition != 0U) ? (e->flat_streak_ms + dt_ms) : 0U;
+    } else {
+        e->away_streak_ms = 0U;
+        e->flat_streak_ms = 0U;
+    }
+
+    /* Motion streak is only meaningful for recovery from flat no-user state. */
+    if ((e->present == 0U) && (e->no_user_reason == PRESENCE_NO_USER_REASON_FLAT)) {
+        if (motion_condition != 0U) {
+            e->motion_streak_ms += dt_ms;
+        } else if (e->motion_streak_ms > (dt_ms / 2U)) {
+            e->motion_streak_ms -= (dt_ms / 2U);
+        } else {
+            e->motion_streak_ms = 0U;
+        }
+    } else {
+        e->motion_streak_ms = 0U;
+    }
+
+    if ((e->present == 0U) &&
+        (e->no_user_reason == PRESENCE_NO_USER_REASON_AWAY) &&
+        (e->filtered_mm <= (ref_distance_mm + settings->return_band_mm))) {
+        e->near_ref_streak_ms += dt_ms;
+    } else {
+        e->near_ref_streak_ms = 0U;
+    }
+
+    if (e->present != 0U) {
+        uint8_t was_candidate = e->candidate_no_user;
+
+        e->candidate_no_user = 0U;
+        e->no_user_reason = PRESENCE_NO_USER_REASON_NONE;
+        if ((settings->away_mode_enabled != 0U) && (e->away_streak_ms >= settings->away_timeout_ms)) {
+            e->candidate_no_user = 1U;
+            e->no_user_reason = PRESENCE_NO_USER_REASON_AWAY;
+        } else if ((settings->flat_mode_enabled != 0U) && (e->flat_streak_ms >= settings->stale_timeout_ms)) {
+            e->candidate_no_user = 1U;
+            e->no_user_reason = PRESENCE_NO_USER_REASON_FLAT;
+        }
+        if ((was_candidate == 0U) && (e->candidate_no_user != 0U)) {
+            e->candidate_since_ms = e->now_ms;
+        }
+        return;
+    }
+
+    e->candidate_no_user = 0U;
+    if (((e->no_user_reason == PRESENCE_NO_USER_REASON_AWAY) &&
+         (e->near_ref_streak_ms >= cfg->return_confirm_ms)) ||
+        ((e->no_user_reason == PRESENCE_NO_USER_REASON_FLAT) && (motion_condition != 0U))) {
+        e->present = 1U;
+        e->near_ref_streak_ms = 0U;
+        e->motion_streak_ms = 0U;
+        e->away_streak_ms = 0U;
+        e->flat_streak_ms = 0U;
+        e->no_user_reason = PRESENCE_NO_USER_REASON_NONE;
+    }
+}
+
+/* After an away no-user: a tracked approach that reaches the return band within the horizon, held for
+ * arrival_confirm_ms, or a jump straight into the band raises the prediction. It stays up until present
+ * returns, and drops on a receding or lost track, or an approach that stalls outside the band for a whole
+ * horizon. */
+static void update_arrival(presence_engine_t *e, const presence_engine_settings_t *settings)
+{
+    const presence_engine_cfg_t *cfg = &e->cfg;
+    uint32_t band_mm = reference_mm(e) + settings->return_band_mm;
+    uint32_t dt_ms = 0U;
+    uint8_t tracking;
+    uint8_t approaching = 0U;
+
+    if ((cfg->arrival_velocity_mm_s == 0U) || (cfg->use_tracker == 0U) || (e->present != 0U) ||
+        (e->no_user_reason != PRESENCE_NO_USER_REASON_AWAY)) {
+        e->arrival_streak_ms = 0U;
+        e->arrival_stall_ms = 0U;
+        e->arrival_recede_ms = 0U;
+        e->arrival_predicted = 0U;
+        return;
+    }
+
+    if (e->prev_valid_ready != 0U) {
+        dt_ms = e->now_ms - e->prev_valid_ms;
+        if (dt_ms > cfg->streak_max_dt_ms) {
+            dt_ms = cfg->streak_max_dt_ms;
+        }
+    }
+
+    tracking = ((e->track_status == DISTANCE_TRACKER_STATUS_TRACKING) ||
+                (e->track_status == DISTANCE_TRACKER_STATUS_GATED)) ? 1U : 0U;
+    if ((tracking != 0U) && (e->velocity_mm_s <= -(int32_t)cfg->arrival_velocity_mm_s)) {
+        uint32_t speed_mm_s = (uint32_t)(-e->velocity_mm_s);
+        uint32_t gap_mm = (e->filtered_mm > band_mm) ? (e->filtered_mm - band_mm) : 0U;
+
+        approaching = ((((uint64_t)gap_mm * 1000U) / speed_mm_s) <= cfg->arrival_horizon_ms) ? 1U : 0U;
+    }
+
+    /* Stepping into the cone shows up as a jump rather than a trend: a re-init that lands in the band is an
+     * arrival seen in one sample. */
+    if ((e->track_status == DISTANCE_TRACKER_STATUS_REINIT) && (e->filtered_mm <= band_mm)) {
+        e->arrival_predicted = 1U;
+    }
+
+    if (approaching != 0U) {
+        e->arrival_streak_ms += dt_ms;
+        e->arrival_stall_ms = 0U;
+        e->arrival_recede_ms = 0U;
+        if (e->arrival_streak_ms >= cfg->arrival_confirm_ms) {
+            e->arrival_predicted = 1U;
+        }
+        return;
+    }
+
+    e->arrival_streak_ms = 0U;
+    if (e->arrival_predicted == 0U) {
+        return;
+    }
+    /* A re-init is the tracker catching up with the user stopping. A tracker that overshot the seat on gated
+     * or coasted samples rebounds with a positive velocity while the user sits down, so moving away only
+     * counts outside the band and once it has lasted the confirm time. */
+    if ((tracking != 0U) && (e->velocity_mm_s >= (int32_t)(cfg->arrival_velocity_mm_s / 2U)) &&
+        (e->filtered_mm > band_mm) && (e->raw_mm > band_mm)) {
+        e->arrival_recede_ms += dt_ms;
+    } else {
+        e->arrival_recede_ms = 0U;
+    }
+    if ((e->track_status == DISTANCE_TRACKER_STATUS_LOST) || (e->track_status == DISTANCE_TRACKER_STATUS_NOT_INIT) ||
+        (e->arrival_recede_ms >= cfg->arrival_confirm_ms)) {
+        e->arrival_predicted = 0U;
+        e->arrival_stall_ms = 0U;
+        e->arrival_recede_ms = 0U;
+    } else if (e->filtered_mm > band_mm) {
+        e->arrival_stall_ms += dt_ms;
+        if (e->arrival_stall_ms >= cfg->arrival_horizon_ms) {
+            e->arrival_predicted = 0U;
+            e->arrival_stall_ms = 0U;
+        }
+    } else {
+        e->arrival_stall_ms = 0U;
+    }
+}
+
+/* Distance band and motion class of a valid sample, on the same thresholds the streak rules use. Leaving
+ * needs the body margin; coming back needs the tighter return band. */
+static void observe_valid(const presence_engine_t *e,
+                          const presence_engine_settings_t *settings,
+                          presence_hmm_obs_t *obs)
+{
+    const presence_engine_cfg_t *cfg = &e->cfg;
+    uint32_t near_limit_mm = reference_mm(e) + ((e->present != 0U) ? e->away_margin_mm : settings->return_band_mm);
+
+    obs->dist = (e->filtered_mm <= near_limit_mm) ? PRESENCE_HMM_DIST_NEAR : PRESENCE_HMM_DIST_FAR;
+
+    if (cfg->use_tracker != 0U) {
+        if (e->track_status == DISTANCE_TRACKER_STATUS_REINIT) {
+            /* The target jumped further than the gate allows: someone moved, not sensor noise. */
+            obs->motion = PRESENCE_HMM_MOTION_MOVING;
+        } else if (e->track_status != DISTANCE_TRACKER_STATUS_TRACKING) {
+            obs->motion = PRESENCE_HMM_MOTION_NONE;
+        } else if (distance_tracker_is_moving(&e->tracker, cfg->motion_velocity_mm_s, cfg->motion_sigma) != 0U) {
+            obs->motion = PRESENCE_HMM_MOTION_MOVING;
+        } else if (distance_tracker_is_moving(&e->tracker, cfg->flat_velocity_mm_s, 0U) != 0U) {
+            obs->motion = PRESENCE_HMM_MOTION_SLOW;
+        } else {
+            obs->motion = PRESENCE_HMM_MOTION_STILL;
+        }
+    } else if (e->prev_valid_ready != 0U) {
+        uint32_t abs_step_delta_mm = abs_diff_u32(e->filtered_mm, e->prev_valid_mm);
+
+        if (abs_step_delta_mm >= cfg->motion_delta_mm) {
+            obs->motion = PRESENCE_HMM_MOTION_MOVING;
+        } else if (abs_step_delta_mm > cfg->flat_band_mm) {
+            obs->motion = PRESENCE_HMM_MOTION_SLOW;
+        } else {
+            obs->motion = PRESENCE_HMM_MOTION_STILL;
+        }
+    }
+}
+
+/* Under uninformative evidence a state drains into absent as 1 - exp(-rate * t); rate = ln 4 / timeout
+ * crosses the default 75 % candidate threshold after about one timeout. Disabled modes never drain. */
+static uint16_t timeout_rate_permille_s(uint8_t enabled, uint32_t timeout_ms)
+{
+    uint32_t rate;
+
+    if (enabled == 0U) {
+        return 0U;
+    }
+    if (timeout_ms < 1386U) {
+        return 1000U;
+    }
+    rate = 1386000UL / timeout_ms;
+
+    return (uint16_t)((rate == 0U) ? 1U : rate);
+}
+
+static void update_hmm(presence_engine_t *e,
+                       const presence_sample_t *sample,
+                       presence_hmm_obs_t *obs,
+                       uint32_t dt_ms,
+                       const presence_engine_settings_t *settings)
+{
+    const presence_engine_cfg_t *cfg = &e->cfg;
+    presence_hmm_rates_t rates;
+    uint32_t present_q16;
+    uint16_t absent_permille;
+
+    if (sample->ldr_valid != 0U) {
+        uint16_t fast = filter_ema_u16_push(&e->ldr_fast, sample->ldr_raw);
+        uint16_t slow = filter_ema_u16_push(&e->ldr_slow, sample->ldr_raw);
+
+        obs->ldr = (abs_diff_u32(fast, slow) >= cfg->ldr_shadow_delta_raw) ? PRESENCE_HMM_LDR_CHANGE
+                                                                           : PRESENCE_HMM_LDR_QUIET;
+    }
+
+    if (e->armed == 0U) {
+        presence_hmm_reset_present(&e->hmm);
+    } else {
+        rates = cfg->hmm.rates;
+        rates.permille_s[PRESENCE_HMM_STILL][PRESENCE_HMM_ABSENT] =
+            timeout_rate_permille_s(settings->flat_mode_enabled, settings->stale_timeout_ms);
+        rates.permille_s[PRESENCE_HMM_LEAVING][PRESENCE_HMM_ABSENT] =
+            timeout_rate_permille_s(settings->away_mode_enabled, settings->away_timeout_ms);
+        presence_hmm_step(&e->hmm, &cfg->hmm, &rates, obs, dt_ms);
+    }
+
+    present_q16 = presence_hmm_present_q16(&e->hmm);
+    e->present_permille = (uint16_t)(((present_q16 * 1000U) + 32768U) >> 16);
+    e->hmm_state = presence_hmm_map_state(&e->hmm);
+    if (e->armed == 0U) {
+        return;
+    }
+
+    /* Only the absent state counts: leaving is the user walking off or standing up, and flows on to absent at
+     * the away-timeout rate unless they come back. */
+    absent_permille = (uint16_t)(((e->hmm.belief_q16[PRESENCE_HMM_ABSENT] * 1000U) + 32768U) >> 16);
+    if (e->present != 0U) {
+        if ((e->candidate_no_user == 0U) && (absent_permille >= cfg->hmm_candidate_permille)) {
+            presence_no_user_reason_t reason = (e->filtered_mm > (reference_mm(e) + e->away_margin_mm))
+                                                   ? PRESENCE_NO_USER_REASON_AWAY
+                                                   : PRESENCE_NO_USER_REASON_FLAT;
+
+            if (((reason == PRESENCE_NO_USER_REASON_AWAY) && (settings->away_mode_enabled != 0U)) ||
+                ((reason == PRESENCE_NO_USER_REASON_FLAT) && (settings->flat_mode_enabled != 0U))) {
+                e->candidate_no_user = 1U;
+                e->no_user_reason = reason;
+                e->candidate_since_ms = e->now_ms;
+            }
+        } else if ((e->candidate_no_user != 0U) && (absent_permille < cfg->hmm_clear_permille)) {
+            e->candidate_no_user = 0U;
+            e->no_user_reason = PRESENCE_NO_USER_REASON_NONE;
+        }
+        return;
+    }
+
+    e->candidate_no_user = 0U;
+    if (e->present_permille >= cfg->hmm_recover_permille) {
+        /* Restart from certainty like arm does; otherwise the absent belief left over from the empty chair
+         * would count against the stale timeout of the user who just sat down. */
+        e->present = 1U;
+        e->no_user_reason = PRESENCE_NO_USER_REASON_NONE;
+        e->arrival_predicted = 0U;
+        presence_hmm_reset_present(&e->hmm);
+    }
+}
+
+/* Takes the reference and away margin from the background once it is confident. Left alone while a
+ * no-user decision is pending or made, so the return band keeps pointing at the seat the user left. */
+static void refresh_learned_reference(presence_engine_t *e)
+{
+    const presence_engine_cfg_t *cfg = &e->cfg;
+    uint32_t mode_mm;
+    uint32_t scene_mm;
+    uint32_t margin_mm = cfg->body_margin_mm;
+
+    if ((cfg->learn_background == 0U) ||
+        (presence_background_user_mode_mm(&e->background, &mode_mm) == 0U)) {
+        return;
+    }
+
+    /* A static return inside the body margin would hide the user leaving; split the gap instead, unless it
+     * is too close to the seat to tell apart from sway (the flat path covers that case). */
+    if (presence_background_scene_mode_beyond_mm(&e->background, mode_mm, &scene_mm) != 0U) {
+        uint32_t gap_mm = scene_mm - mode_mm;
+
+        if ((gap_mm < (2U * cfg->body_margin_mm)) && (gap_mm > (2U * cfg->min_away_margin_mm))) {
+            margin_mm = gap_mm / 2U;
+        }
+    }
+
+    e->ref_distance_mm = mode_mm;
+    e->ref_valid = 1U;
+    e->ref_pending_capture = 0U;
+    e->using_fallback_ref = 0U;
+    e->ref_learned = 1U;
+    e->away_margin_mm = margin_mm;
+}
+
+/* Seated samples teach the user histogram and samples after a confirmed no-user teach the scene one. Samples
+ * beyond the away threshold are the user walking off, not sitting, and a pending candidate is undecided. */
+static void update_background(presence_engine_t *e, const presence_sample_t *sample, uint32_t dt_ms)
+{
+    presence_background_sample_t kind = PRESENCE_BACKGROUND_SAMPLE_NONE;
+
+    if (e->cfg.learn_background == 0U) {
+        return;
+    }
+
+    if ((sample->valid != 0U) && (e->armed != 0U)) {
+        if (e->present == 0U) {
+            kind = PRESENCE_BACKGROUND_SAMPLE_SCENE;
+        } else if ((e->candidate_no_user == 0U) &&
+                   (e->filtered_mm <= (reference_mm(e) + e->away_margin_mm))) {
+            kind = PRESENCE_BACKGROUND_SAMPLE_USER;
+        }
+    }
+
+    if ((presence_background_update(&e->background, kind, e->filtered_mm, dt_ms) != 0U) &&
+        (e->armed != 0U) && (e->present != 0U) && (e->candidate_no_user == 0U)) {
+        refresh_learned_reference(e);
+    }
+}
+
+static void process_valid(presence_engine_t *e,
+                          uint32_t distance_mm,
+                          const presence_engine_settings_t *settings,
+                          presence_hmm_obs_t *obs)
+{
+    e->raw_mm = distance_mm;
+    if (e->cfg.use_tracker == 0U) {
+        e->filtered_mm = filter_median_u32_push(&e->median, distance_mm);
+    }
+
+    if (e->ref_pending_capture != 0U) {
+        e->ref_distance_mm = e->filtered_mm;
+        e->ref_valid = 1U;
+        e->ref_pending_capture = 0U;
+        e->using_fallback_ref = 0U;
+    }
+
+    if (e->armed == 0U) {
+        reset_runtime(e);
+    } else if (e->cfg.classifier == PRESENCE_CLASSIFIER_HMM) {
+        observe_valid(e, settings, obs);
+    } else {
+        update_streaks(e, settings);
+    }
+    if (e->armed != 0U) {
+        update_arrival(e, settings);
+    }
+
+    e->prev_valid_mm = e->filtered_mm;
+    e->prev_valid_ms = e->now_ms;
+    e->prev_valid_ready = 1U;
+}
+
+void presence_engine_init(presence_engine_t *e, const presence_engine_cfg_t *cfg)
+{
+    if ((e == NULL) || (cfg == NULL)) {
+        return;
+    }
+
+    e->cfg = *cfg;
+    filter_median_u32_init(&e->median, cfg->median_window_size, cfg->median_warmup);
+    distance_tracker_init(&e->tracker, &cfg->tracker);
+    e->now_ms = 0U;
+    e->armed = 0U;
+
+    e->raw_mm = cfg->distance_error_mm;
+    e->filtered_mm = cfg->distance_error_mm;
+    e->velocity_mm_s = 0;
+    e->track_status = DISTANCE_TRACKER_STATUS_NOT_INIT;
+
+    e->present = 1U;
+    e->ref_distance_mm = cfg->ref_fallback_mm;
+    e->ref_valid = 0U;
+    e->ref_pending_capture = 0U;
+    e->using_fallback_ref = 1U;
+    e->ref_learned = 0U;
+    e->away_margin_mm = cfg->body_margin_mm;
+    e->prev_valid_mm = cfg->distance_error_mm;
+    e->prev_valid_ms = 0U;
+    e->prev_valid_ready = 0U;
+    reset_runtime(e);
+
+    presence_hmm_reset_present(&e->hmm);
+    e->hmm_state = PRESENCE_HMM_ACTIVE;
+    e->present_permille = 1000U;
+    filter_ema_u16_init(&e->ldr_fast, PRESENCE_LDR_FAST_SHIFT);
+    filter_ema_u16_init(&e->ldr_slow, PRESENCE_LDR_SLOW_SHIFT);
+    presence_background_init(&e->background, &cfg->background);
+}
+
+void presence_engine_arm(presence_engine_t *e)
+{
+    if (e == NULL) {
+        return;
+    }
+
+    reset_runtime(e);
+    e->armed = 1U;
+    e->ref_distance_mm = e->cfg.ref_fallback_mm;
+    e->ref_valid = 1U;
+    e->ref_pending_capture = 1U;
+    e->using_fallback_ref = 1U;
+    e->ref_learned = 0U;
+    e->away_margin_mm = e->cfg.body_margin_mm;
+    e->prev_valid_ready = 0U;
+    e->present = 1U;
+    presence_hmm_reset_present(&e->hmm);
+    refresh_learned_reference(e);
+}
+
+void presence_engine_disarm(presence_engine_t *e)
+{
+    if (e == NULL) {
+        return;
+    }
+
+    reset_runtime(e);
+    e->armed = 0U;
+}
+
+void presence_engine_confirm_no_user(presence_engine_t *e)
+{
+    if (e == NULL) {
+        return;
+    }
+
+    e->present = 0U;
+    e->candidate_no_user = 0U;
+}
+
+void presence_engine_step(presence_engine_t *e,
+                          const presence_sample_t *sample,
+                          uint32_t dt_ms,
+                          const presence_engine_settings_t *settings,
+                          presence_decision_t *decision)
+{
+    presence_hmm_obs_t obs = { PRESENCE_HMM_DIST_NONE, PRESENCE_HMM_MOTION_NONE, PRESENCE_HMM_LDR_NONE };
+
+    if ((e == NULL) || (sample == NULL) || (settings == NULL)) {
+        return;
+    }
+
+    e->now_ms += dt_ms;
+    if (e->cfg.use_tracker != 0U) {
+        update_tracker(e, sample);
+    }
+    if (sample->valid != 0U) {
+        process_valid(e, sample->distance_mm, settings, &obs);
+    }
+    /* The HMM also steps on dropped bursts: time still passes, and the LDR may still have seen something. */
+    if (e->cfg.classifier == PRESENCE_CLASSIFIER_HMM) {
+        update_hmm(e, sample, &obs, dt_ms, settings);
+    } else {
+        e->present_permille = (e->present != 0U) ? 1000U : 0U;
+        e->hmm_state = (e->present != 0U) ? PRESENCE_HMM_ACTIVE : PRESENCE_HMM_ABSENT;
+    }
+    update_background(e, sample, dt_ms);
+
+    presence_engine_get_decision(e, decision);
+    if (decision != NULL) {
+        decision->updated = sample->valid;
+    }
+}
+
+uint32_t presence_engine_replay(presence_engine_t *e,
+                                const presence_timed_sample_t *samples,
+                                uint32_t count,
+                                const presence_engine_settings_t *settings,
+                                presence_decision_t *decisions)
+{
+    uint32_t transitions = 0U;
+    uint32_t i;
+
+    if ((e == NULL) || (samples == NULL) || (settings == NULL)) {
+        return 0U;
+    }
+
+    for (i = 0U; i < count; i++) {
+        uint32_t dt_ms = samples[i].t_ms - e->now_ms;
+        uint8_t was_present = e->present;
+
+        /* Out-of-order timestamps do not move the clock backwards. */
+        if ((int32_t)dt_ms < 0) {
+            dt_ms = 0U;
+        }
+        presence_engine_step(e, &samples[i].sample, dt_ms, settings, NULL);
+        if ((e->present != 0U) && (e->candidate_no_user != 0U) &&
+            ((e->now_ms - e->candidate_since_ms) >= settings->preoff_dim_ms)) {
+            presence_engine_confirm_no_user(e);
+        }
+        if (decisions != NULL) {
+            presence_engine_get_decision(e, &decisions[i]);
+            decisions[i].updated = samples[i].sample.valid;
+        }
+        if (e->present != was_present) {
+            transitions++;
+        }
+    }
+
+    return transitions;
+}
+
+void presence_engine_get_decision(const presence_engine_t *e, presence_decision_t *decision)
+{
+    if ((e == NULL) || (decision == NULL)) {
+        return;
+    }
+
+    decision->present = e->present;
+    decision->candidate_no_user = e->candidate_no_user;
+    decision->no_user_reason = e->no_user_reason;
+    decision->arrival_predicted = e->arrival_predicted;
+    decision->updated = 0U;
+    decision->distance_mm = e->filtered_mm;
+    decision->velocity_mm_s = e->velocity_mm_s;
+    decision->track_status = e->track_status;
+    decision->ref_distance_mm = reference_mm(e);
+    decision->away_margin_mm = e->away_margin_mm;
+    decision->present_permille = e->present_permille;
+    decision->hmm_state = e->hmm_state;
+}
+
+const char *presence_no_user_reason_to_string(presence_no_user_reason_t reason)
+{
+    switch (reason) {
+        case PRESENCE_NO_USER_REASON_AWAY:
+            return "away";
+        case PRESENCE_NO_USER_REASON_FLAT:
+            return "flat";
+        default:
+            return "none";
+    }
+}
@@ -0,0 +1,168 @@
+#include "app/presence_hmm.h"
+
+#include <stddef.h>
+
+#define PRESENCE_HMM_ONE_Q16        65536UL
+/* Longer gaps are treated as this long: the linearized transition is only valid while rate * dt is small. */
+#define PRESENCE_HMM_MAX_DT_MS      2000U
+/* No state may hand more than half its belief to others in one step. */
+#define PRESENCE_HMM_MAX_LEAVE_Q16  32768UL
+
+void presence_hmm_reset_present(presence_hmm_t *h)
+{
+    if (h == NULL) {
+        return;
+    }
+
+    h->belief_q16[PRESENCE_HMM_ACTIVE] = PRESENCE_HMM_ONE_Q16 / 2U;
+    h->belief_q16[PRESENCE_HMM_STILL] = PRESENCE_HMM_ONE_Q16 / 2U;
+    h->belief_q16[PRESENCE_HMM_LEAVING] = 0U;
+    h->belief_q16[PRESENCE_HMM_ABSENT] = 0U;
+}
+
+/* p(i -> j) over dt = rate * dt, as Q16: permille/s * ms = 1e-6 units, and 65536 / 1e6 ~ 4295 / 2^16. */
+static void predict(presence_hmm_t *h, const presence_hmm_rates_t *rates, uint32_t dt_ms)
+{
+    uint64_t next[PRESENCE_HMM_STATE_COUNT] = { 0U };
+    uint8_t i;
+    uint8_t j;
+
+    for (i = 0U; i < PRESENCE_HMM_STATE_COUNT; i++) {
+        uint32_t leave_total = 0U;
+
+        for (j = 0U; j < PRESENCE_HMM_STATE_COUNT; j++) {
+            uint32_t p_q16;
+
+            if (i == j) {
+                continue;
+            }
+            p_q16 = (uint32_t)(((uint64_t)rates->permille_s[i][j] * dt_ms * 4295U) >> 16);
+            if ((leave_total + p_q16) > PRESENCE_HMM_MAX_LEAVE_Q16) {
+                p_q16 = PRESENCE_HMM_MAX_LEAVE_Q16 - leave_total;
+            }
+            leave_total += p_q16;
+            next[j] += (uint64_t)h->belief_q16[i] * p_q16;
+        }
+        next[i] += (uint64_t)h->belief_q16[i] * (PRESENCE_HMM_ONE_Q16 - leave_total);
+    }
+
+    for (j = 0U; j < PRESENCE_HMM_STATE_COUNT; j++) {
+        h->belief_q16[j] = (uint32_t)(next[j] >> 16);
+    }
+}
+
+static uint32_t likelihood(const presence_hmm_model_t *model, const presence_hmm_obs_t *obs, uint8_t state)
+{
+    uint32_t l = 1000U;
+
+    if (obs->dist < PRESENCE_HMM_DIST_COUNT) {
+        l = model->dist_permille[state][obs->dist];
+    }
+    if (obs->motion < PRESENCE_HMM_MOTION_COUNT) {
+        l = (l * model->motion_permille[state][obs->motion]) / 1000U;
+    }
+    if (obs->ldr < PRESENCE_HMM_LDR_COUNT) {
+        l = (l * model->ldr_permille[state][obs->ldr]) / 1000U;
+    }
+
+    /* Zero would make the state unreachable for good; the floor below only applies after normalizing. */
+    return (l == 0U) ? 1U : l;
+}
+
+static void apply_floor(presence_hmm_t *h, uint32_t floor_q16)
+{
+    uint32_t deficit = 0U;
+    uint8_t top = 0U;
+    uint8_t j;
+
+    for (j = 0U; j < PRESENCE_HMM_STATE_COUNT; j++) {
+        if (h->belief_q16[j] < floor_q16) {
+            deficit += floor_q16 - h->belief_q16[j];
+            h->belief_q16[j] = floor_q16;
+        }
+        if (h->belief_q16[j] > h->belief_q16[top]) {
+            top = j;
+        }
+    }
+    h->belief_q16[top] -= deficit;
+}
+
+void presence_hmm_step(presence_hmm_t *h,
+                       const presence_hmm_model_t *model,
+                       const presence_hmm_rates_t *rates,
+                       const presence_hmm_obs_t *obs,
+                       uint32_t dt_ms)
+{
+    uint64_t weighted[PRESENCE_HMM_STATE_COUNT];
+    uint64_t total = 0U;
+    uint8_t j;
+
+    if ((h == NULL) || (model == NULL) || (obs == NULL)) {
+        return;
+    }
+    if (rates == NULL) {
+        rates = &model->rates;
+    }
+    if (dt_ms > PRESENCE_HMM_MAX_DT_MS) {
+        dt_ms = PRESENCE_HMM_MAX_DT_MS;
+    }
+
+    predict(h, rates, dt_ms);
+
+    for (j = 0U; j < PRESENCE_HMM_STATE_COUNT; j++) {
+        weighted[j] = (uint64_t)h->belief_q16[j] * likelihood(model, obs, j);
+        total += weighted[j];
+    }
+    if (total == 0U) {
+        presence_hmm_reset_present(h);
+        return;
+    }
+
+    for (j = 0U; j < PRESENCE_HMM_STATE_COUNT; j++) {
+        h->belief_q16[j] = (uint32_t)((weighted[j] << 16) / total);
+    }
+    apply_floor(h, model->floor_q16);
+}
+
+uint32_t presence_hmm_present_q16(const presence_hmm_t *h)
+{
+    if (h == NULL) {
+        return 0U;
+    }
+
+    return h->belief_q16[PRESENCE_HMM_ACTIVE] + h->belief_q16[PRESENCE_HMM_STILL];
+}
+
+presence_hmm_state_t presence_hmm_map_state(const presence_hmm_t *h)
+{
+    presence_hmm_state_t best = PRESENCE_HMM_ACTIVE;
+    uint8_t j;
+
+    if (h == NULL) {
+        return best;
+    }
+
+    for (j = 1U; j < PRESENCE_HMM_STATE_COUNT; j++) {
+        if (h->belief_q16[j] > h->belief_q16[best]) {
+            best = (presence_hmm_state_t)j;
+        }
+    }
+
+    return best;
+}
+
+const char *presence_hmm_state_to_string(presence_hmm_state_t state)
+{
+    switch (state) {
+        case PRESENCE_HMM_ACTIVE:
+            return "active";
+        case PRESENCE_HMM_STILL:
+            return "still";
+        case PRESENCE_HMM_LEAVING:
+            return "leaving";
+        case PRESENCE_HMM_ABSENT:
+            return "absent";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,209 @@
+#include "app/presence_shadow.h"
+
+#include <stddef.h>
+
+static uint32_t override_u32(uint32_t shadow_value, uint32_t live_value)
+{
+    return (shadow_value != 0U) ? shadow_value : live_value;
+}
+
+static void apply_policy_cfg(presence_engine_cfg_t *cfg, const presence_shadow_policy_t *policy)
+{
+    cfg->flat_band_mm = override_u32(policy->flat_band_mm, cfg->flat_band_mm);
+    cfg->motion_delta_mm = override_u32(policy->motion_delta_mm, cfg->motion_delta_mm);
+    cfg->flat_velocity_mm_s = override_u32(policy->flat_velocity_mm_s, cfg->flat_velocity_mm_s);
+    cfg->motion_velocity_mm_s = override_u32(policy->motion_velocity_mm_s, cfg->motion_velocity_mm_s);
+}
+
+void presence_shadow_apply_settings(presence_engine_settings_t *settings, const presence_shadow_policy_t *policy)
+{
+    settings->away_timeout_ms = override_u32(policy->away_timeout_ms, settings->away_timeout_ms);
+    settings->stale_timeout_ms = override_u32(policy->stale_timeout_ms, settings->stale_timeout_ms);
+    settings->return_band_mm = override_u32(policy->return_band_mm, settings->return_band_mm);
+}
+
+void presence_shadow_track_reset(presence_shadow_track_t *track, const presence_engine_t *e)
+{
+    if ((track == NULL) || (e == NULL)) {
+        return;
+    }
+
+    track->stats.leaves = 0U;
+    track->stats.detect_sum_ms = 0U;
+    track->stats.detect_max_ms = 0U;
+    track->stats.false_offs = 0U;
+    track->stats.on_ms = 0U;
+    presence_shadow_track_sync(track, e);
+}
+
+void presence_shadow_track_sync(presence_shadow_track_t *track, const presence_engine_t *e)
+{
+    if ((track == NULL) || (e == NULL)) {
+        return;
+    }
+
+    track->settled_ms = e->now_ms;
+    track->was_present = e->present;
+    track->had_candidate = e->candidate_no_user;
+}
+
+void presence_shadow_track_update(presence_shadow_track_t *track, const presence_engine_t *e, uint32_t dt_ms)
+{
+    if ((track == NULL) || (e == NULL)) {
+        return;
+    }
+
+    /* The lamp state held over the interval that just ended. */
+    if ((e->armed != 0U) && (track->was_present != 0U)) {
+        track->stats.on_ms += dt_ms;
+    }
+
+    if ((e->present != 0U) && (e->candidate_no_user == 0U) &&
+        (e->away_streak_ms == 0U) && (e->flat_streak_ms == 0U)) {
+        track->settled_ms = e->now_ms;
+    }
+
+    if ((track->was_present != 0U) && (e->present == 0U)) {
+        uint32_t detect_ms = e->now_ms - track->settled_ms;
+
+        track->stats.leaves++;
+        track->stats.detect_sum_ms += detect_ms;
+        if (detect_ms > track->stats.detect_max_ms) {
+            track->stats.detect_max_ms = detect_ms;
+        }
+    } else if ((track->had_candidate != 0U) && (e->candidate_no_user == 0U) && (e->present != 0U) &&
+               (e->armed != 0U)) {
+        track->stats.false_offs++;
+    }
+
+    track->was_present = e->present;
+    track->had_candidate = e->candidate_no_user;
+}
+
+uint32_t presence_shadow_detect_avg_ms(const presence_shadow_stats_t *stats)
+{
+    if ((stats == NULL) || (stats->leaves == 0U)) {
+        return 0U;
+    }
+
+    return stats->detect_sum_ms / stats->leaves;
+}
+
+void presence_shadow_init(presence_shadow_set_t *set,
+                          const presence_engine_cfg_t *live_cfg,
+                          const presence_shadow_policy_t *policies,
+                          uint8_t count)
+{
+    uint8_t i;
+
+    if (set == NULL) {
+        return;
+    }
+
+    set->count = 0U;
+    if ((live_cfg == NULL) || (policies == NULL)) {
+        return;
+    }
+
+    set->count = (count > PRESENCE_SHADOW_MAX) ? PRESENCE_SHADOW_MAX : count;
+    for (i = 0U; i < set->count; i++) {
+        presence_shadow_slot_t *slot = &set->slot[i];
+        presence_engine_cfg_t cfg = *live_cfg;
+
+        slot->policy = policies[i];
+        apply_policy_cfg(&cfg, &slot->policy);
+        presence_engine_init(&slot->engine, &cfg);
+        presence_shadow_track_reset(&slot->track, &slot->engine);
+        slot->cost.count = 0U;
+        slot->cost.sum = 0U;
+        slot->cost.max = 0U;
+    }
+}
+
+void presence_shadow_arm(presence_shadow_set_t *set)
+{
+    uint8_t i;
+
+    if (set == NULL) {
+        return;
+    }
+
+    for (i = 0U; i < set->count; i++) {
+        presence_engine_arm(&set->slot[i].engine);
+        presence_shadow_track_sync(&set->slot[i].track, &set->slot[i].engine);
+    }
+}
+
+void presence_shadow_disarm(presence_shadow_set_t *set)
+{
+    uint8_t i;
+
+    if (set == NULL) {
+        return;
+    }
+
+    for (i = 0U; i < set->count; i++) {
+        presence_engine_disarm(&set->slot[i].engine);
+        presence_shadow_track_sync(&set->slot[i].track, &set->slot[i].engine);
+    }
+}
+
+void presence_shadow_step(presence_shadow_set_t *set,
+                          const presence_sample_t *sample,
+                          uint32_t dt_ms,
+                          const presence_engine_settings_t *live_settings,
+                          presence_shadow_clock_t clock)
+{
+    uint8_t i;
+
+    if ((set == NULL) || (sample == NULL) || (live_settings == NULL)) {
+        return;
+    }
+
+    for (i = 0U; i < set->count; i++) {
+        presence_shadow_slot_t *slot = &set->slot[i];
+        presence_engine_t *e = &slot->engine;
+        presence_engine_settings_t settings = *live_settings;
+        uint32_t start = (clock != NULL) ? clock() : 0U;
+
+        presence_shadow_apply_settings(&settings, &slot->policy);
+        presence_engine_step(e, sample, dt_ms, &settings, NULL);
+        /* Stand-in for the output control: confirm once the candidate has outlived the pre-off dim. */
+        if ((e->present != 0U) && (e->candidate_no_user != 0U) &&
+            ((e->now_ms - e->candidate_since_ms) >= settings.preoff_dim_ms)) {
+            presence_engine_confirm_no_user(e);
+        }
+        presence_shadow_track_update(&slot->track, e, dt_ms);
+
+        if (clock != NULL) {
+            uint32_t cost = clock() - start;
+
+            slot->cost.count++;
+            slot->cost.sum += cost;
+            if (cost > slot->cost.max) {
+                slot->cost.max = cost;
+            }
+        }
+    }
+}
+
+void presence_shadow_take_cost(presence_shadow_set_t *set, uint8_t index, presence_shadow_cost_t *out)
+{
+    if ((set == NULL) || (index >= PRESENCE_SHADOW_MAX)) {
+        return;
+    }
+
+    if (out != NULL) {
+        *out = set->slot[index].cost;
+    }
+    set->slot[index].cost.count = 0U;
+    set->slot[index].cost.sum = 0U;
+    set->slot[index].cost.max = 0U;
+}
+
+void presence_shadow_limit(presence_shadow_set_t *set, uint8_t count)
+{
+    if ((set != NULL) && (count < set->count)) {
+        set->count = count;
+    }
+}
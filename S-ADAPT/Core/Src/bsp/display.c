@@ -355,6 +355,18 @@ static void settings_fill_row_content(const display_settings_view_t *view,
             (void)snprintf(out_value_text, out_value_size, "%u", (unsigned int)view->return_band_cm);
             unit = "cm";
             break;
+        case DISPLAY_SETTINGS_ROW_LAMP_CAL:
+            label = "Lamp Cal:";
+            if (view->lamp_cal == DISPLAY_LAMP_CAL_RUNNING) {
+                (void)snprintf(out_value_text, out_value_size, "%u%%", (unsigned int)view->lamp_cal_progress_percent);
+            } else if (view->lamp_cal == DISPLAY_LAMP_CAL_OK) {
+                (void)snprintf(out_value_text, out_value_size, "%s", "OK");
+            } else if (view->lamp_cal == DISPLAY_LAMP_CAL_ERR) {
+                (void)snprintf(out_value_text, out_value_size, "%s", "ERR");
+            } else {
+                (void)snprintf(out_value_text, out_value_size, "%s", "--");
+            }
+            break;
         case DISPLAY_SETTINGS_ROW_SAVE:
             label = "Save";
             break;
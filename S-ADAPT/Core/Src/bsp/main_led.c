@@ -1,29 +1,230 @@
 #include "bsp/main_led.h"
 
+#include "support/cie_lightness.h"
+
+/* Internal compare channel (no pin): OC4REF rises once per PWM period and is routed to TRGO2 to trigger LDR
+ * conversions at a fixed phase. The conversion window (~14 us) is centered in the lamp off-window; when the
+ * off-window is shorter than MIN_OFF_US (duty near 100 %, lamp effectively DC) it falls back to mid-period. */
+#define MAIN_LED_ADC_SYNC_CHANNEL        TIM_CHANNEL_4
+#define MAIN_LED_ADC_SYNC_CONV_US        14U
+#define MAIN_LED_ADC_SYNC_MIN_OFF_US     30U
+
+#if MAIN_LED_DITHER_BITS
+/* TIM1_UP is DMA1 channel 5, request 7: one halfword into the compare register per update event. */
+#define MAIN_LED_DITHER_DMA_INSTANCE     DMA1_Channel5
+#define MAIN_LED_DITHER_DMA_REQUEST      DMA_REQUEST_7
+#define MAIN_LED_DITHER_FRAME            (1U << MAIN_LED_DITHER_BITS)
+#endif
+
 static TIM_HandleTypeDef *s_main_led_tim = NULL;
 static uint32_t s_main_led_channel = 0U;
 static uint8_t s_main_led_started = 0U;
 static uint8_t s_main_led_enabled = 0U;
-static uint8_t s_main_led_percent = 0U;
+static uint16_t s_main_led_level = 0U;
+static uint8_t s_main_led_adc_sync = 0U;
+static uint32_t s_main_led_pwm_hz = 0U;
+static uint32_t s_sync_conv_ticks = 0U;
+static uint32_t s_sync_min_off_ticks = 0U;
+static cie_lightness_t s_lightness;
+
+#if MAIN_LED_DITHER_BITS
+static DMA_HandleTypeDef s_dither_dma;
+static uint16_t s_dither_frame[MAIN_LED_DITHER_FRAME];
+/* Bit-reversed slot order, so the extra counts of a partial level are spread evenly over the frame. */
+static uint8_t s_dither_rank[MAIN_LED_DITHER_FRAME];
+static uint8_t s_main_led_dither = 0U;
+#endif
+
+static void apply_adc_sync_phase(uint32_t pulse, uint32_t full_scale)
+{
+    uint32_t off_ticks = full_scale - pulse;
+    uint32_t phase;
+
+    if (s_main_led_adc_sync == 0U) {
+        return;
+    }
+
+    if (off_ticks >= s_sync_min_off_ticks) {
+        phase = pulse + ((off_ticks - s_sync_conv_ticks) / 2U);
+    } else {
+        phase = full_scale / 2U;
+    }
+
+    /* PWM2 on the sync channel: OC4REF rises at CNT == phase; phase must stay inside 1..ARR. */
+    __HAL_TIM_SET_COMPARE(s_main_led_tim, MAIN_LED_ADC_SYNC_CHANNEL, phase);
+}
+
+static void configure_adc_sync(void)
+{
+    TIM_OC_InitTypeDef oc = {0};
+    TIM_MasterConfigTypeDef master = {0};
+
+    s_main_led_adc_sync = 0U;
+    if ((!IS_TIM_TRGO2_INSTANCE(s_main_led_tim->Instance)) || (s_main_led_channel == MAIN_LED_ADC_SYNC_CHANNEL)) {
+        return;
+    }
+
+    oc.OCMode = TIM_OCMODE_PWM2;
+    oc.Pulse = (__HAL_TIM_GET_AUTORELOAD(s_main_led_tim) + 1U) / 2U;
+    oc.OCPolarity = TIM_OCPOLARITY_HIGH;
+    oc.OCFastMode = TIM_OCFAST_DISABLE;
+    oc.OCIdleState = TIM_OCIDLESTATE_RESET;
+    oc.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+    oc.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+    master.MasterOutputTrigger = TIM_TRGO_RESET;
+    master.MasterOutputTrigger2 = TIM_TRGO2_OC4REF;
+    master.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if ((HAL_TIM_PWM_ConfigChannel(s_main_led_tim, &oc, MAIN_LED_ADC_SYNC_CHANNEL) != HAL_OK) ||
+        (HAL_TIMEx_MasterConfigSynchronization(s_main_led_tim, &master) != HAL_OK)) {
+        return;
+    }
+
+    s_main_led_adc_sync = 1U;
+}
+
+/* Prescaler for MAIN_LED_PWM_COUNTS ticks per period at MAIN_LED_PWM_HZ, from the running clock tree. */
+static main_led_status_t configure_timebase(void)
+{
+    uint32_t clk_hz = HAL_RCC_GetPCLK2Freq();
+    uint32_t tick_hz = MAIN_LED_PWM_HZ * MAIN_LED_PWM_COUNTS;
+    uint32_t prescaler;
+
+    /* APB2 timers run at twice PCLK2 whenever the bus is divided. */
+    if ((RCC->CFGR & RCC_CFGR_PPRE2_2) != 0U) {
+        clk_hz *= 2U;
+    }
+    if ((tick_hz == 0U) || (clk_hz < tick_hz)) {
+        return MAIN_LED_STATUS_INVALID_CONFIG;
+    }
+    prescaler = ((clk_hz + (tick_hz / 2U)) / tick_hz) - 1U;
+    if (prescaler > 0xFFFFU) {
+        return MAIN_LED_STATUS_INVALID_CONFIG;
+    }
 
-static main_led_status_t apply_percent(uint8_t percent)
+    s_main_led_tim->Init.Prescaler = prescaler;
+    s_main_led_tim->Init.Period = MAIN_LED_PWM_COUNTS - 1U;
+    __HAL_TIM_SET_PRESCALER(s_main_led_tim, prescaler);
+    __HAL_TIM_SET_AUTORELOAD(s_main_led_tim, MAIN_LED_PWM_COUNTS - 1U);
+    /* Load the prescaler now rather than at the end of the period running with the CubeMX values. */
+    if (HAL_TIM_GenerateEvent(s_main_led_tim, TIM_EVENTSOURCE_UPDATE) != HAL_OK) {
+        return MAIN_LED_STATUS_HAL_START_ERROR;
+    }
+
+    tick_hz = clk_hz / (prescaler + 1U);
+    s_main_led_pwm_hz = tick_hz / MAIN_LED_PWM_COUNTS;
+    s_sync_conv_ticks = ((MAIN_LED_ADC_SYNC_CONV_US * tick_hz) + 999999U) / 1000000U;
+    s_sync_min_off_ticks = ((MAIN_LED_ADC_SYNC_MIN_OFF_US * tick_hz) + 999999U) / 1000000U;
+    if (s_sync_min_off_ticks < (s_sync_conv_ticks + 2U)) {
+        s_sync_min_off_ticks = s_sync_conv_ticks + 2U;
+    }
+    return MAIN_LED_STATUS_OK;
+}
+
+#if MAIN_LED_DITHER_BITS
+static uint8_t reverse_dither_bits(uint8_t slot)
+{
+    uint8_t rank = 0U;
+    uint8_t bit;
+
+    for (bit = 0U; bit < MAIN_LED_DITHER_BITS; bit++) {
+        rank = (uint8_t)((rank << 1) | ((slot >> bit) & 1U));
+    }
+
+    return rank;
+}
+
+static void configure_dither(void)
+{
+    uint32_t slot;
+
+    s_main_led_dither = 0U;
+    if (s_main_led_tim->Instance != TIM1) {
+        return;
+    }
+
+    for (slot = 0U; slot < MAIN_LED_DITHER_FRAME; slot++) {
+        s_dither_rank[slot] = reverse_dither_bits((uint8_t)slot);
+        s_dither_frame[slot] = (uint16_t)__HAL_TIM_GET_COMPARE(s_main_led_tim, s_main_led_channel);
+    }
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    s_dither_dma.Instance = MAIN_LED_DITHER_DMA_INSTANCE;
+    s_dither_dma.Init.Request = MAIN_LED_DITHER_DMA_REQUEST;
+    s_dither_dma.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    s_dither_dma.Init.PeriphInc = DMA_PINC_DISABLE;
+    s_dither_dma.Init.MemInc = DMA_MINC_ENABLE;
+    s_dither_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    s_dither_dma.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    s_dither_dma.Init.Mode = DMA_CIRCULAR;
+    s_dither_dma.Init.Priority = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&s_dither_dma) != HAL_OK) {
+        return;
+    }
+    __HAL_LINKDMA(s_main_led_tim, hdma[TIM_DMA_ID_UPDATE], s_dither_dma);
+
+    /* CCR1..CCR4 are consecutive; TIM_CHANNEL_n is 4 * (n - 1). Compare preload is on, so each write takes
+     * effect on the period after the update that moved it. */
+    if (HAL_DMA_Start(&s_dither_dma,
+                      (uint32_t)s_dither_frame,
+                      (uint32_t)(&s_main_led_tim->Instance->CCR1 + (s_main_led_channel / 4U)),
+                      MAIN_LED_DITHER_FRAME) != HAL_OK) {
+        return;
+    }
+    __HAL_TIM_ENABLE_DMA(s_main_led_tim, TIM_DMA_UPDATE);
+    s_main_led_dither = 1U;
+}
+#endif
+
+/* level -> CIE luminance (Q24) -> timer counts. The count fraction becomes dither slots when the update DMA
+ * runs, otherwise it rounds to the nearest count. */
+static main_led_status_t apply_level(uint16_t level_q8)
 {
-    uint32_t arr;
     uint32_t full_scale;
+    uint64_t counts_q24;
     uint32_t pulse;
 
     if (s_main_led_tim == NULL) {
         return MAIN_LED_STATUS_NOT_INIT;
     }
 
-    arr = __HAL_TIM_GET_AUTORELOAD(s_main_led_tim);
-    full_scale = arr + 1U;
-    pulse = ((full_scale * (uint32_t)percent) / 100U);
+    full_scale = __HAL_TIM_GET_AUTORELOAD(s_main_led_tim) + 1U;
+    counts_q24 = (uint64_t)cie_lightness_to_luminance(&s_lightness, level_q8) * full_scale;
+    if (level_q8 == 0U) {
+        counts_q24 = 0U;
+    }
+
+#if MAIN_LED_DITHER_BITS
+    if (s_main_led_dither != 0U) {
+        uint32_t extra;
+        uint32_t slot;
+
+        pulse = (uint32_t)(counts_q24 >> 24);
+        extra = ((uint32_t)(counts_q24 & 0xFFFFFFU) + (1UL << (23U - MAIN_LED_DITHER_BITS))) >>
+                (24U - MAIN_LED_DITHER_BITS);
+        if (extra >= MAIN_LED_DITHER_FRAME) {
+            pulse++;
+            extra = 0U;
+        }
+        if (pulse >= full_scale) {
+            pulse = full_scale;
+            extra = 0U;
+        }
+
+        for (slot = 0U; slot < MAIN_LED_DITHER_FRAME; slot++) {
+            s_dither_frame[slot] = (uint16_t)(pulse + ((s_dither_rank[slot] < extra) ? 1U : 0U));
+        }
+        apply_adc_sync_phase((extra != 0U) ? (pulse + 1U) : pulse, full_scale);
+        return MAIN_LED_STATUS_OK;
+    }
+#endif
+
+    pulse = (uint32_t)((counts_q24 + (1UL << 23)) >> 24);
     if (pulse > full_scale) {
         pulse = full_scale;
     }
 
     __HAL_TIM_SET_COMPARE(s_main_led_tim, s_main_led_channel, pulse);
+    apply_adc_sync_phase(pulse, full_scale);
     return MAIN_LED_STATUS_OK;
 }
 
@@ -33,26 +234,43 @@ void main_led_init(TIM_HandleTypeDef *htim, uint32_t channel)
     s_main_led_channel = channel;
     s_main_led_started = 0U;
     s_main_led_enabled = 0U;
-    s_main_led_percent = 0U;
+    s_main_led_level = 0U;
+    s_main_led_adc_sync = 0U;
+    s_main_led_pwm_hz = 0U;
+#if MAIN_LED_DITHER_BITS
+    s_main_led_dither = 0U;
+#endif
+    cie_lightness_build(&s_lightness);
 }
 
 main_led_status_t main_led_start(void)
 {
+    main_led_status_t status;
+
     if (s_main_led_tim == NULL) {
         return MAIN_LED_STATUS_NOT_INIT;
     }
 
+    status = configure_timebase();
+    if (status != MAIN_LED_STATUS_OK) {
+        return status;
+    }
+    __HAL_TIM_SET_COMPARE(s_main_led_tim, s_main_led_channel, 0U);
     if (HAL_TIM_PWM_Start(s_main_led_tim, s_main_led_channel) != HAL_OK) {
         return MAIN_LED_STATUS_HAL_START_ERROR;
     }
+    configure_adc_sync();
+#if MAIN_LED_DITHER_BITS
+    configure_dither();
+#endif
 
     s_main_led_started = 1U;
-    return apply_percent(0U);
+    return apply_level(0U);
 }
 
-main_led_status_t main_led_set_percent(uint8_t percent)
+main_led_status_t main_led_set_level(uint16_t level_q8)
 {
-    if (percent > 100U) {
+    if (level_q8 > MAIN_LED_LEVEL_FULL) {
         return MAIN_LED_STATUS_INVALID_PERCENT;
     }
     if (s_main_led_tim == NULL) {
@@ -62,17 +280,55 @@ main_led_status_t main_led_set_percent(uint8_t percent)
         return MAIN_LED_STATUS_NOT_INIT;
     }
 
-    s_main_led_percent = percent;
+    s_main_led_level = level_q8;
     if (s_main_led_enabled == 0U) {
-        return apply_percent(0U);
+        return apply_level(0U);
     }
 
-    return apply_percent(s_main_led_percent);
+    return apply_level(s_main_led_level);
+}
+
+main_led_status_t main_led_set_percent(uint8_t percent)
+{
+    if (percent > 100U) {
+        return MAIN_LED_STATUS_INVALID_PERCENT;
+    }
+
+    return main_led_set_level((uint16_t)((uint32_t)percent << 8));
+}
+
+uint16_t main_led_get_level(void)
+{
+    return s_main_led_level;
 }
 
 uint8_t main_led_get_percent(void)
 {
-    return s_main_led_percent;
+    return (uint8_t)(((uint32_t)s_main_led_level + 128U) >> 8);
+}
+
+uint32_t main_led_get_pwm_hz(void)
+{
+    return s_main_led_pwm_hz;
+}
+
+uint32_t main_led_get_pwm_counts(void)
+{
+    return MAIN_LED_PWM_COUNTS;
+}
+
+uint8_t main_led_dither_active(void)
+{
+#if MAIN_LED_DITHER_BITS
+    return s_main_led_dither;
+#else
+    return 0U;
+#endif
+}
+
+uint8_t main_led_adc_sync_active(void)
+{
+    return s_main_led_adc_sync;
 }
 
 main_led_status_t main_led_set_enabled(uint8_t enabled)
@@ -86,10 +342,10 @@ main_led_status_t main_led_set_enabled(uint8_t enabled)
 
     s_main_led_enabled = (enabled != 0U) ? 1U : 0U;
     if (s_main_led_enabled == 0U) {
-        return apply_percent(0U);
+        return apply_level(0U);
     }
 
-    return apply_percent(s_main_led_percent);
+    return apply_level(s_main_led_level);
 }
 
 const char *main_led_status_to_string(main_led_status_t status)
@@ -105,6 +361,8 @@ const char *main_led_status_to_string(main_led_status_t status)
             return "invalid_percent";
         case MAIN_LED_STATUS_HAL_START_ERROR:
             return "hal_start_error";
+        case MAIN_LED_STATUS_INVALID_CONFIG:
+            return "invalid_config";
         default:
             return "unknown";
     }
@@ -0,0 +1,158 @@
+#include "input/gesture_input.h"
+
+#define GESTURE_EVENT_QUEUE_SIZE 4U
+/* Consecutive in-zone samples to accept a hand, out-of-zone samples to drop it. */
+#define GESTURE_ENTER_SAMPLES    2U
+#define GESTURE_EXIT_SAMPLES     2U
+
+typedef enum
+{
+    GESTURE_PHASE_IDLE = 0,
+    GESTURE_PHASE_TRACKING,
+    GESTURE_PHASE_LATCHED
+} gesture_phase_t;
+
+static gesture_input_cfg_t s_cfg = {
+    .zone_min_mm = 30U,
+    .zone_max_mm = 250U,
+    .hold_ms = 800U,
+    .hold_band_mm = 15U,
+    .step_mm = 40U,
+};
+static gesture_phase_t s_phase = GESTURE_PHASE_IDLE;
+static uint8_t s_in_zone_count = 0U;
+static uint8_t s_out_zone_count = 0U;
+static uint8_t s_stepped = 0U;
+static uint32_t s_step_anchor_mm = 0U;
+static uint32_t s_hold_anchor_mm = 0U;
+static uint32_t s_hold_start_ms = 0U;
+
+static gesture_event_t s_event_queue[GESTURE_EVENT_QUEUE_SIZE];
+static uint8_t s_queue_head = 0U;
+static uint8_t s_queue_tail = 0U;
+static uint8_t s_queue_count = 0U;
+
+static void queue_push(gesture_event_type_t type, uint32_t now_ms)
+{
+    if (s_queue_count >= GESTURE_EVENT_QUEUE_SIZE) {
+        return;
+    }
+
+    s_event_queue[s_queue_tail].type = type;
+    s_event_queue[s_queue_tail].timestamp_ms = now_ms;
+    s_queue_tail = (uint8_t)((s_queue_tail + 1U) % GESTURE_EVENT_QUEUE_SIZE);
+    s_queue_count++;
+}
+
+static void set_hold_anchor(uint32_t now_ms, uint32_t distance_mm)
+{
+    s_hold_anchor_mm = distance_mm;
+    s_hold_start_ms = now_ms;
+}
+
+static void step_detected(gesture_event_type_t type, uint32_t now_ms, uint32_t distance_mm)
+{
+    queue_push(type, now_ms);
+    s_stepped = 1U;
+    s_step_anchor_mm = distance_mm;
+    set_hold_anchor(now_ms, distance_mm);
+}
+
+void gesture_input_init(const gesture_input_cfg_t *cfg)
+{
+    if (cfg != NULL) {
+        s_cfg = *cfg;
+    }
+
+    s_queue_head = 0U;
+    s_queue_tail = 0U;
+    s_queue_count = 0U;
+    gesture_input_reset();
+}
+
+void gesture_input_reset(void)
+{
+    s_phase = GESTURE_PHASE_IDLE;
+    s_in_zone_count = 0U;
+    s_out_zone_count = 0U;
+    s_stepped = 0U;
+    s_step_anchor_mm = 0U;
+    s_hold_anchor_mm = 0U;
+    s_hold_start_ms = 0U;
+}
+
+void gesture_input_push_sample(uint32_t now_ms, uint32_t distance_mm, uint8_t valid)
+{
+    uint8_t in_zone = ((valid != 0U) &&
+                       (distance_mm >= s_cfg.zone_min_mm) &&
+                       (distance_mm <= s_cfg.zone_max_mm)) ? 1U : 0U;
+
+    if (in_zone == 0U) {
+        s_in_zone_count = 0U;
+        if (s_phase == GESTURE_PHASE_IDLE) {
+            return;
+        }
+        if (s_out_zone_count < GESTURE_EXIT_SAMPLES) {
+            s_out_zone_count++;
+        }
+        if (s_out_zone_count >= GESTURE_EXIT_SAMPLES) {
+            gesture_input_reset();
+        }
+        return;
+    }
+
+    s_out_zone_count = 0U;
+    if (s_phase == GESTURE_PHASE_IDLE) {
+        if (s_in_zone_count < GESTURE_ENTER_SAMPLES) {
+            s_in_zone_count++;
+        }
+        if (s_in_zone_count >= GESTURE_ENTER_SAMPLES) {
+            s_phase = GESTURE_PHASE_TRACKING;
+            s_stepped = 0U;
+            s_step_anchor_mm = distance_mm;
+            set_hold_anchor(now_ms, distance_mm);
+        }
+        return;
+    }
+
+    /* Steps are measured from the last step (or entry) position, so slow deliberate moves still count. */
+    if ((distance_mm + s_cfg.step_mm) <= s_step_anchor_mm) {
+        step_detected(GESTURE_EVENT_STEP_UP, now_ms, distance_mm);
+        return;
+    }
+    if (distance_mm >= (s_step_anchor_mm + s_cfg.step_mm)) {
+        step_detected(GESTURE_EVENT_STEP_DOWN, now_ms, distance_mm);
+        return;
+    }
+
+    if (((distance_mm + s_cfg.hold_band_mm) < s_hold_anchor_mm) ||
+        (distance_mm > (s_hold_anchor_mm + s_cfg.hold_band_mm))) {
+        /* Drifting: restart the hold timer around the new position. */
+        set_hold_anchor(now_ms, distance_mm);
+        return;
+    }
+
+    if ((s_phase == GESTURE_PHASE_TRACKING) &&
+        (s_stepped == 0U) &&
+        ((uint32_t)(now_ms - s_hold_start_ms) >= s_cfg.hold_ms)) {
+        queue_push(GESTURE_EVENT_HOVER_HOLD, now_ms);
+        s_phase = GESTURE_PHASE_LATCHED;
+    }
+}
+
+uint8_t gesture_input_hand_present(void)
+{
+    return (s_phase != GESTURE_PHASE_IDLE) ? 1U : 0U;
+}
+
+uint8_t gesture_input_pop_event(gesture_event_t *out_event)
+{
+    if ((out_event == NULL) || (s_queue_count == 0U)) {
+        return 0U;
+    }
+
+    *out_event = s_event_queue[s_queue_head];
+    s_queue_head = (uint8_t)((s_queue_head + 1U) % GESTURE_EVENT_QUEUE_SIZE);
+    s_queue_count--;
+    return 1U;
+}
@@ -7,6 +7,8 @@
 /* USER CODE BEGIN Includes */
 #include "support/debug_print.h"
 #include "app/app.h"
+#include "sensors/ultrasonic.h"
+#include "sensors/ldr.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -15,6 +17,12 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#if (APP_US_ZONE_COUNT > 1U) && !defined(US2_TRIG_Pin)
+#error "APP_US_ZONE_COUNT > 1 needs the side sensor in CubeMX: a GPIO output labelled US2_TRIG and ECHO on PA3 as TIM2_CH4"
+#endif
+#if APP_US_ZONE_COUNT > 2U
+#error "TIM2 has capture/compare channels for two ultrasonic zones; further zones need another timer"
+#endif
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -90,8 +98,16 @@ int main(void)
   {
     app_hw_config_t hw = {
       .ldr_adc = &hadc1,
-      .echo_tim = &htim2,
-      .echo_channel = TIM_CHANNEL_2,
+      .us_zones = {
+        /* Echo on CH2 (PA1); CC3 has no pin and only times the end of the TRIG pulse. */
+        { .tim = &htim2, .echo_channel = TIM_CHANNEL_2, .trig_cc_channel = TIM_CHANNEL_3,
+          .trig_port = TRIG_GPIO_Port, .trig_pin = TRIG_Pin },
+#if APP_US_ZONE_COUNT > 1U
+        /* Side sensor: echo on CH4 (PA3, AF1), TRIG end on the CH1 compare. */
+        { .tim = &htim2, .echo_channel = TIM_CHANNEL_4, .trig_cc_channel = TIM_CHANNEL_1,
+          .trig_port = US2_TRIG_GPIO_Port, .trig_pin = US2_TRIG_Pin },
+#endif
+      },
       .main_led_tim = &htim1,
       .main_led_channel = TIM_CHANNEL_1
     };
@@ -231,7 +247,9 @@ static void MX_ADC1_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN ADC1_Init 2 */
-
+  /* Only the LDR analog watchdog is enabled as an ADC1 interrupt source (see sensors/ldr_dma.c). */
+  HAL_NVIC_SetPriority(ADC1_IRQn, 2, 0);
+  HAL_NVIC_EnableIRQ(ADC1_IRQn);
   /* USER CODE END ADC1_Init 2 */
 
 }
@@ -412,8 +430,11 @@ static void MX_TIM2_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN TIM2_Init 2 */
-  // Keep 1 MHz timer tick for delay_us()/ultrasonic timing after CubeMX regen
+  // Keep 1 MHz timer tick for ultrasonic timing after CubeMX regen
   __HAL_TIM_SET_PRESCALER(&htim2, 31);
+  /* Echo capture and TRIG pulse end are interrupt-driven (see sensors/ultrasonic.c). */
+  HAL_NVIC_SetPriority(TIM2_IRQn, 1, 0);
+  HAL_NVIC_EnableIRQ(TIM2_IRQn);
   /* USER CODE END TIM2_Init 2 */
 
 }
@@ -527,6 +548,30 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
     encoder_input_on_clk_edge_isr();
   }
 }
+
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM2)
+  {
+    ultrasonic_on_capture_isr(htim);
+  }
+}
+
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM2)
+  {
+    ultrasonic_on_compare_isr(htim);
+  }
+}
+
+void HAL_ADC_LevelOutOfWindowCallback(ADC_HandleTypeDef *hadc)
+{
+  if (hadc->Instance == ADC1)
+  {
+    ldr_on_awd_isr(hadc);
+  }
+}
 /* USER CODE END 4 */
 
 /**
@@ -1,5 +1,7 @@
 #include "sensors/ldr.h"
 
+#if LDR_BACKEND == LDR_BACKEND_POLLED
+
 static ADC_HandleTypeDef *s_ldr_adc = NULL;
 
 void ldr_init(ADC_HandleTypeDef *hadc)
@@ -47,6 +49,44 @@ ldr_status_t ldr_read_raw(uint16_t *out_raw)
     return LDR_STATUS_OK;
 }
 
+#endif /* LDR_BACKEND == LDR_BACKEND_POLLED */
+
+#if !LDR_WATCH_SUPPORTED
+/* Without the DMA backend (or with LDR_AWD_EVENTS off) there is no watchdog; callers keep polling. */
+ldr_status_t ldr_watch_arm(uint16_t low_raw, uint16_t high_raw)
+{
+    (void)low_raw;
+    (void)high_raw;
+    return LDR_STATUS_UNSUPPORTED;
+}
+
+uint8_t ldr_watch_take_event(void)
+{
+    return 0U;
+}
+
+void ldr_on_awd_isr(ADC_HandleTypeDef *hadc)
+{
+    (void)hadc;
+}
+#endif /* !LDR_WATCH_SUPPORTED */
+
+#if LDR_BACKEND != LDR_BACKEND_DMA
+/* Only the DMA backend can be PWM-triggered; the others never wait for the lamp timer. */
+ldr_status_t ldr_use_free_running(void)
+{
+    return LDR_STATUS_OK;
+}
+#endif
+
+#if LDR_BACKEND != LDR_BACKEND_FLICKER
+ldr_status_t ldr_get_flicker(ldr_flicker_t *out)
+{
+    (void)out;
+    return LDR_STATUS_UNSUPPORTED;
+}
+#endif
+
 const char *ldr_status_to_string(ldr_status_t status)
 {
     switch (status) {
@@ -64,6 +104,10 @@ const char *ldr_status_to_string(ldr_status_t status)
             return "timeout";
         case LDR_STATUS_STOP_ERROR:
             return "stop_error";
+        case LDR_STATUS_OVERRUN:
+            return "overrun";
+        case LDR_STATUS_UNSUPPORTED:
+            return "unsupported";
         default:
             return "unknown";
     }
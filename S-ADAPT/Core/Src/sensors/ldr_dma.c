@@ -0,0 +1,241 @@
+#include "sensors/ldr.h"
+
+#if LDR_BACKEND == LDR_BACKEND_DMA
+
+#if LDR_PWM_SYNC
+/* One conversion per lamp PWM period (multi-trigger oversampling): at the default 1 kHz MAIN_LED_PWM_HZ,
+ * 32 periods = 32 ms per value, about three 100/120 Hz mains-flicker periods. A faster PWM shortens the window
+ * in proportion. 92.5 + 12.5 cycles at 8 MHz (~13 us) fits the lamp off-window. */
+#ifndef LDR_OVERSAMPLING_RATIO
+#define LDR_OVERSAMPLING_RATIO ADC_OVERSAMPLING_RATIO_32
+#endif
+
+#ifndef LDR_OVERSAMPLING_SHIFT
+#define LDR_OVERSAMPLING_SHIFT ADC_RIGHTBITSHIFT_5
+#endif
+
+#define LDR_SAMPLING_TIME      ADC_SAMPLETIME_92CYCLES_5
+
+/* ldr_use_free_running(): the non-synced configuration below, for when TIM1 cannot provide TRGO2. */
+#define LDR_FREE_OVERSAMPLING_RATIO LL_ADC_OVS_RATIO_256
+#define LDR_FREE_OVERSAMPLING_SHIFT LL_ADC_OVS_SHIFT_RIGHT_8
+#define LDR_FREE_SAMPLING_TIME      LL_ADC_SAMPLINGTIME_640CYCLES_5
+#else
+/* One oversampled result = RATIO conversions of (640.5 + 12.5) ADC cycles. At 32 MHz / 4 that is ~21 ms,
+ * about two 100/120 Hz mains-flicker periods, so the software moving average can be short. */
+#ifndef LDR_OVERSAMPLING_RATIO
+#define LDR_OVERSAMPLING_RATIO ADC_OVERSAMPLING_RATIO_256
+#endif
+
+#ifndef LDR_OVERSAMPLING_SHIFT
+#define LDR_OVERSAMPLING_SHIFT ADC_RIGHTBITSHIFT_8
+#endif
+
+#define LDR_SAMPLING_TIME      ADC_SAMPLETIME_640CYCLES_5
+#endif
+
+#ifndef LDR_ADC_CLOCK_PRESCALER
+#define LDR_ADC_CLOCK_PRESCALER ADC_CLOCK_ASYNC_DIV4
+#endif
+
+#define LDR_ADC_CHANNEL       ADC_CHANNEL_9
+#define LDR_DMA_INSTANCE      DMA1_Channel1
+#define LDR_DMA_REQUEST       DMA_REQUEST_0
+/* Outside the 12-bit result range: marks the DMA word as not yet written since the last start. */
+#define LDR_RAW_NONE          0xFFFFU
+
+static ADC_HandleTypeDef *s_ldr_adc = NULL;
+static DMA_HandleTypeDef s_ldr_dma;
+static volatile uint16_t s_ldr_latest = 0U;
+static uint8_t s_ldr_running = 0U;
+#if LDR_AWD_EVENTS
+static volatile uint8_t s_watch_event = 0U;
+#endif
+
+static uint8_t start_acquisition(void)
+{
+    s_ldr_running = 0U;
+    s_ldr_latest = LDR_RAW_NONE;
+    if (HAL_ADC_Start_DMA(s_ldr_adc, (uint32_t *)&s_ldr_latest, 1U) != HAL_OK) {
+        return 0U;
+    }
+    /* Overrun is detected by ldr_read_raw(); only the analog watchdog may raise the ADC1 interrupt. */
+    __HAL_ADC_DISABLE_IT(s_ldr_adc, ADC_IT_OVR);
+    s_ldr_running = 1U;
+    return 1U;
+}
+
+void ldr_init(ADC_HandleTypeDef *hadc)
+{
+    ADC_ChannelConfTypeDef channel = {0};
+
+    s_ldr_adc = hadc;
+    s_ldr_running = 0U;
+    if (s_ldr_adc == NULL) {
+        return;
+    }
+
+    /* Re-init the CubeMX single-shot config as oversampled + circular DMA (free-running or PWM-triggered). */
+    s_ldr_adc->Init.ClockPrescaler = LDR_ADC_CLOCK_PRESCALER;
+#if LDR_PWM_SYNC
+    s_ldr_adc->Init.ContinuousConvMode = DISABLE;
+    s_ldr_adc->Init.ExternalTrigConv = ADC_EXTERNALTRIG_T1_TRGO2;
+    s_ldr_adc->Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+    s_ldr_adc->Init.Oversampling.TriggeredMode = ADC_TRIGGEREDMODE_MULTI_TRIGGER;
+#else
+    s_ldr_adc->Init.ContinuousConvMode = ENABLE;
+    s_ldr_adc->Init.Oversampling.TriggeredMode = ADC_TRIGGEREDMODE_SINGLE_TRIGGER;
+#endif
+    s_ldr_adc->Init.DMAContinuousRequests = ENABLE;
+    s_ldr_adc->Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
+    s_ldr_adc->Init.OversamplingMode = ENABLE;
+    s_ldr_adc->Init.Oversampling.Ratio = LDR_OVERSAMPLING_RATIO;
+    s_ldr_adc->Init.Oversampling.RightBitShift = LDR_OVERSAMPLING_SHIFT;
+    /* Injected conversions (MCU temperature) interrupt the accumulation without resetting it. */
+    s_ldr_adc->Init.Oversampling.OversamplingStopReset = ADC_REGOVERSAMPLING_CONTINUED_MODE;
+    if (HAL_ADC_Init(s_ldr_adc) != HAL_OK) {
+        return;
+    }
+
+    channel.Channel = LDR_ADC_CHANNEL;
+    channel.Rank = ADC_REGULAR_RANK_1;
+    channel.SamplingTime = LDR_SAMPLING_TIME;
+    channel.SingleDiff = ADC_SINGLE_ENDED;
+    channel.OffsetNumber = ADC_OFFSET_NONE;
+    channel.Offset = 0U;
+    if (HAL_ADC_ConfigChannel(s_ldr_adc, &channel) != HAL_OK) {
+        return;
+    }
+
+#if LDR_AWD_EVENTS
+    {
+        ADC_AnalogWDGConfTypeDef awd = {0};
+
+        /* Channel selection needs ADSTART low, so it is set here with a full-scale window and no interrupt;
+         * ldr_watch_arm() later only rewrites the thresholds. With oversampling on, AWD1 compares the shifted
+         * oversampled result, i.e. the same 12-bit value the DMA delivers. */
+        awd.WatchdogNumber = ADC_ANALOGWATCHDOG_1;
+        awd.WatchdogMode = ADC_ANALOGWATCHDOG_SINGLE_REG;
+        awd.Channel = LDR_ADC_CHANNEL;
+        awd.ITMode = DISABLE;
+        awd.HighThreshold = 4095U;
+        awd.LowThreshold = 0U;
+        if (HAL_ADC_AnalogWDGConfig(s_ldr_adc, &awd) != HAL_OK) {
+            return;
+        }
+        s_watch_event = 0U;
+    }
+#endif
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    s_ldr_dma.Instance = LDR_DMA_INSTANCE;
+    s_ldr_dma.Init.Request = LDR_DMA_REQUEST;
+    s_ldr_dma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    s_ldr_dma.Init.PeriphInc = DMA_PINC_DISABLE;
+    s_ldr_dma.Init.MemInc = DMA_MINC_DISABLE;
+    s_ldr_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    s_ldr_dma.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    s_ldr_dma.Init.Mode = DMA_CIRCULAR;
+    s_ldr_dma.Init.Priority = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&s_ldr_dma) != HAL_OK) {
+        return;
+    }
+    __HAL_LINKDMA(s_ldr_adc, DMA_Handle, s_ldr_dma);
+
+    (void)HAL_ADCEx_Calibration_Start(s_ldr_adc, ADC_SINGLE_ENDED);
+    (void)start_acquisition();
+}
+
+ldr_status_t ldr_read_raw(uint16_t *out_raw)
+{
+    if (s_ldr_adc == NULL) {
+        return LDR_STATUS_NOT_INIT;
+    }
+    if (out_raw == NULL) {
+        return LDR_STATUS_NULL_PTR;
+    }
+    if (s_ldr_running == 0U) {
+        return (start_acquisition() != 0U) ? LDR_STATUS_NOT_INIT : LDR_STATUS_START_ERROR;
+    }
+
+    /* DMA requests stop on overrun; restart and skip this sample. */
+    if (__HAL_ADC_GET_FLAG(s_ldr_adc, ADC_FLAG_OVR) != RESET) {
+        (void)HAL_ADC_Stop_DMA(s_ldr_adc);
+        __HAL_ADC_CLEAR_FLAG(s_ldr_adc, ADC_FLAG_OVR);
+        (void)start_acquisition();
+        return LDR_STATUS_OVERRUN;
+    }
+
+    /* No trigger yet (or none coming, see ldr_use_free_running()): do not report an unconverted 0 as dark. */
+    if (s_ldr_latest == LDR_RAW_NONE) {
+        return LDR_STATUS_NOT_INIT;
+    }
+
+    *out_raw = s_ldr_latest;
+    return LDR_STATUS_OK;
+}
+
+ldr_status_t ldr_use_free_running(void)
+{
+#if LDR_PWM_SYNC
+    if (s_ldr_adc == NULL) {
+        return LDR_STATUS_NOT_INIT;
+    }
+
+    /* Trigger, continuous, oversampling and sampling-time bits only need ADSTART low; Stop_DMA also disables. */
+    (void)HAL_ADC_Stop_DMA(s_ldr_adc);
+    s_ldr_running = 0U;
+    s_ldr_adc->Init.ContinuousConvMode = ENABLE;
+    s_ldr_adc->Init.ExternalTrigConv = ADC_SOFTWARE_START;
+    s_ldr_adc->Init.Oversampling.TriggeredMode = ADC_TRIGGEREDMODE_SINGLE_TRIGGER;
+    LL_ADC_REG_SetTriggerSource(s_ldr_adc->Instance, LL_ADC_REG_TRIG_SOFTWARE);
+    LL_ADC_REG_SetContinuousMode(s_ldr_adc->Instance, LL_ADC_REG_CONV_CONTINUOUS);
+    LL_ADC_SetOverSamplingDiscont(s_ldr_adc->Instance, LL_ADC_OVS_REG_CONT);
+    LL_ADC_ConfigOverSamplingRatioShift(s_ldr_adc->Instance, LDR_FREE_OVERSAMPLING_RATIO,
+                                        LDR_FREE_OVERSAMPLING_SHIFT);
+    LL_ADC_SetChannelSamplingTime(s_ldr_adc->Instance, LDR_ADC_CHANNEL, LDR_FREE_SAMPLING_TIME);
+    return (start_acquisition() != 0U) ? LDR_STATUS_OK : LDR_STATUS_START_ERROR;
+#else
+    return LDR_STATUS_OK;
+#endif
+}
+
+#if LDR_AWD_EVENTS
+ldr_status_t ldr_watch_arm(uint16_t low_raw, uint16_t high_raw)
+{
+    if ((s_ldr_adc == NULL) || (s_ldr_running == 0U)) {
+        return LDR_STATUS_NOT_INIT;
+    }
+
+    /* TR1 may be rewritten while conversions run; mask the interrupt so a stale window cannot fire. */
+    __HAL_ADC_DISABLE_IT(s_ldr_adc, ADC_IT_AWD1);
+    LL_ADC_ConfigAnalogWDThresholds(s_ldr_adc->Instance, LL_ADC_AWD1, high_raw, low_raw);
+    s_watch_event = 0U;
+    __HAL_ADC_CLEAR_FLAG(s_ldr_adc, ADC_FLAG_AWD1);
+    __HAL_ADC_ENABLE_IT(s_ldr_adc, ADC_IT_AWD1);
+    return LDR_STATUS_OK;
+}
+
+uint8_t ldr_watch_take_event(void)
+{
+    if (s_watch_event == 0U) {
+        return 0U;
+    }
+
+    s_watch_event = 0U;
+    return 1U;
+}
+
+/* AWD1 keeps flagging every out-of-window result, so the first one masks the interrupt until re-armed. */
+void ldr_on_awd_isr(ADC_HandleTypeDef *hadc)
+{
+    if ((hadc == NULL) || (hadc != s_ldr_adc)) {
+        return;
+    }
+
+    __HAL_ADC_DISABLE_IT(hadc, ADC_IT_AWD1);
+    s_watch_event = 1U;
+}
+#endif /* LDR_AWD_EVENTS */
+
+#endif /* LDR_BACKEND == LDR_BACKEND_DMA */
@@ -0,0 +1,237 @@
+#include "sensors/ldr.h"
+
+#include "support/filter_block.h"
+
+#if LDR_BACKEND == LDR_BACKEND_FLICKER
+
+/* TIM6 TRGO paces single conversions at ~6 kHz: 60 samples per 100 Hz flicker period and 50 per 120 Hz.
+ * 32 MHz has no factor of 3, so the closest divider (5333) gives 6000.4 Hz; the 0.007 % period error leaves
+ * a negligible ripple residue. */
+#define LDR_FLICKER_TIM_INSTANCE    TIM6
+#define LDR_FLICKER_TIM_PERIOD      5333U
+#define LDR_FLICKER_PERIOD_100HZ    60U
+#define LDR_FLICKER_PERIOD_120HZ    50U
+/* 20 ms: two 100 Hz periods, or two 120 Hz periods plus 20 spare samples for the period test. */
+#define LDR_FLICKER_BURST_SAMPLES   120U
+/* Peak-to-peak ripple below this is treated as no flicker; the period estimate is then left unchanged. */
+#ifndef LDR_FLICKER_MIN_PP_RAW
+#define LDR_FLICKER_MIN_PP_RAW      16U
+#endif
+
+/* 247.5 + 12.5 cycles at 8 MHz = 32.5 us per conversion, well inside the 167 us trigger period. */
+#define LDR_SAMPLING_TIME           ADC_SAMPLETIME_247CYCLES_5
+#define LDR_ADC_CLOCK_PRESCALER     ADC_CLOCK_ASYNC_DIV4
+#define LDR_ADC_CHANNEL             ADC_CHANNEL_9
+#define LDR_DMA_INSTANCE            DMA1_Channel1
+#define LDR_DMA_REQUEST             DMA_REQUEST_0
+
+static ADC_HandleTypeDef *s_ldr_adc = NULL;
+static DMA_HandleTypeDef s_ldr_dma;
+static TIM_HandleTypeDef s_flicker_tim;
+static uint16_t s_burst[LDR_FLICKER_BURST_SAMPLES];
+static uint8_t s_ldr_running = 0U;
+static uint8_t s_have_result = 0U;
+static uint8_t s_period_samples = LDR_FLICKER_PERIOD_100HZ;
+static ldr_flicker_t s_flicker;
+
+static uint8_t start_burst(void)
+{
+    s_ldr_running = 0U;
+    if (HAL_ADC_Start_DMA(s_ldr_adc, (uint32_t *)s_burst, LDR_FLICKER_BURST_SAMPLES) != HAL_OK) {
+        return 0U;
+    }
+    /* Completion is polled through the DMA counter; keep the ADC1 interrupt free of OVR/DMA sources. */
+    __HAL_ADC_DISABLE_IT(s_ldr_adc, ADC_IT_OVR);
+    s_ldr_running = 1U;
+    return 1U;
+}
+
+/* Average magnitude difference at a lag of one candidate period; smaller means the burst repeats there. */
+static uint32_t period_mismatch(uint8_t lag)
+{
+    uint32_t sum = 0U;
+    uint8_t i;
+
+    for (i = 0U; (uint8_t)(i + lag) < LDR_FLICKER_BURST_SAMPLES; i++) {
+        uint16_t a = s_burst[i];
+        uint16_t b = s_burst[i + lag];
+
+        sum += (a > b) ? (uint32_t)(a - b) : (uint32_t)(b - a);
+    }
+
+    return sum;
+}
+
+static void process_burst(void)
+{
+    uint32_t mismatch_100;
+    uint32_t mismatch_120;
+    uint32_t sum;
+    uint16_t min_raw = 0xFFFFU;
+    uint16_t max_raw = 0U;
+    uint8_t count;
+    uint8_t i;
+
+    for (i = 0U; i < LDR_FLICKER_BURST_SAMPLES; i++) {
+        if (s_burst[i] < min_raw) {
+            min_raw = s_burst[i];
+        }
+        if (s_burst[i] > max_raw) {
+            max_raw = s_burst[i];
+        }
+    }
+
+    /* Pick the lag the signal repeats at. Sums cover 60 and 70 sample pairs, so compare per pair
+     * (x/60 vs y/70 -> 7x vs 6y) and require a 25 % lead to switch. */
+    if ((uint16_t)(max_raw - min_raw) >= LDR_FLICKER_MIN_PP_RAW) {
+        mismatch_100 = period_mismatch(LDR_FLICKER_PERIOD_100HZ) * 7U;
+        mismatch_120 = period_mismatch(LDR_FLICKER_PERIOD_120HZ) * 6U;
+        if ((mismatch_100 * 4U) < (mismatch_120 * 3U)) {
+            s_period_samples = LDR_FLICKER_PERIOD_100HZ;
+        } else if ((mismatch_120 * 4U) < (mismatch_100 * 3U)) {
+            s_period_samples = LDR_FLICKER_PERIOD_120HZ;
+        }
+    }
+
+    /* Integrate whole periods only: 2 x 60 or 2 x 50 samples. 12-bit counts are valid Q15 for the SIMD sum. */
+    count = (uint8_t)(s_period_samples * 2U);
+    sum = (uint32_t)filter_block_sum_q15((const int16_t *)s_burst, count);
+    min_raw = 0xFFFFU;
+    max_raw = 0U;
+    for (i = 0U; i < count; i++) {
+        if (s_burst[i] < min_raw) {
+            min_raw = s_burst[i];
+        }
+        if (s_burst[i] > max_raw) {
+            max_raw = s_burst[i];
+        }
+    }
+
+    s_flicker.mean_raw = (uint16_t)((sum + (count / 2U)) / count);
+    s_flicker.ripple_pp_raw = (uint16_t)(max_raw - min_raw);
+    if (s_flicker.ripple_pp_raw < LDR_FLICKER_MIN_PP_RAW) {
+        s_flicker.flicker_hz = 0U;
+    } else {
+        s_flicker.flicker_hz = (s_period_samples == LDR_FLICKER_PERIOD_100HZ) ? 100U : 120U;
+    }
+    s_have_result = 1U;
+}
+
+void ldr_init(ADC_HandleTypeDef *hadc)
+{
+    ADC_ChannelConfTypeDef channel = {0};
+    TIM_MasterConfigTypeDef master = {0};
+
+    s_ldr_adc = hadc;
+    s_ldr_running = 0U;
+    s_have_result = 0U;
+    s_period_samples = LDR_FLICKER_PERIOD_100HZ;
+    s_flicker.mean_raw = 0U;
+    s_flicker.ripple_pp_raw = 0U;
+    s_flicker.flicker_hz = 0U;
+    if (s_ldr_adc == NULL) {
+        return;
+    }
+
+    /* Single conversions on TIM6 TRGO into a one-shot DMA buffer; each read re-arms the next burst. */
+    s_ldr_adc->Init.ClockPrescaler = LDR_ADC_CLOCK_PRESCALER;
+    s_ldr_adc->Init.ContinuousConvMode = DISABLE;
+    s_ldr_adc->Init.ExternalTrigConv = ADC_EXTERNALTRIG_T6_TRGO;
+    s_ldr_adc->Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+    s_ldr_adc->Init.DMAContinuousRequests = DISABLE;
+    s_ldr_adc->Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
+    s_ldr_adc->Init.OversamplingMode = DISABLE;
+    if (HAL_ADC_Init(s_ldr_adc) != HAL_OK) {
+        return;
+    }
+
+    channel.Channel = LDR_ADC_CHANNEL;
+    channel.Rank = ADC_REGULAR_RANK_1;
+    channel.SamplingTime = LDR_SAMPLING_TIME;
+    channel.SingleDiff = ADC_SINGLE_ENDED;
+    channel.OffsetNumber = ADC_OFFSET_NONE;
+    channel.Offset = 0U;
+    if (HAL_ADC_ConfigChannel(s_ldr_adc, &channel) != HAL_OK) {
+        return;
+    }
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    s_ldr_dma.Instance = LDR_DMA_INSTANCE;
+    s_ldr_dma.Init.Request = LDR_DMA_REQUEST;
+    s_ldr_dma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    s_ldr_dma.Init.PeriphInc = DMA_PINC_DISABLE;
+    s_ldr_dma.Init.MemInc = DMA_MINC_ENABLE;
+    s_ldr_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    s_ldr_dma.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    s_ldr_dma.Init.Mode = DMA_NORMAL;
+    s_ldr_dma.Init.Priority = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&s_ldr_dma) != HAL_OK) {
+        return;
+    }
+    __HAL_LINKDMA(s_ldr_adc, DMA_Handle, s_ldr_dma);
+
+    __HAL_RCC_TIM6_CLK_ENABLE();
+    s_flicker_tim.Instance = LDR_FLICKER_TIM_INSTANCE;
+    s_flicker_tim.Init.Prescaler = 0U;
+    s_flicker_tim.Init.CounterMode = TIM_COUNTERMODE_UP;
+    s_flicker_tim.Init.Period = LDR_FLICKER_TIM_PERIOD - 1U;
+    s_flicker_tim.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    master.MasterOutputTrigger = TIM_TRGO_UPDATE;
+    master.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if ((HAL_TIM_Base_Init(&s_flicker_tim) != HAL_OK) ||
+        (HAL_TIMEx_MasterConfigSynchronization(&s_flicker_tim, &master) != HAL_OK)) {
+        return;
+    }
+
+    (void)HAL_ADCEx_Calibration_Start(s_ldr_adc, ADC_SINGLE_ENDED);
+    if (start_burst() != 0U) {
+        (void)HAL_TIM_Base_Start(&s_flicker_tim);
+    }
+}
+
+ldr_status_t ldr_read_raw(uint16_t *out_raw)
+{
+    if (s_ldr_adc == NULL) {
+        return LDR_STATUS_NOT_INIT;
+    }
+    if (out_raw == NULL) {
+        return LDR_STATUS_NULL_PTR;
+    }
+    if (s_ldr_running == 0U) {
+        if (start_burst() == 0U) {
+            return LDR_STATUS_START_ERROR;
+        }
+        (void)HAL_TIM_Base_Start(&s_flicker_tim);
+        return LDR_STATUS_NOT_INIT;
+    }
+
+    /* Burst complete: integrate it, then re-arm. A 20 ms burst always finishes between 50 ms reads. */
+    if (__HAL_DMA_GET_COUNTER(&s_ldr_dma) == 0U) {
+        (void)HAL_ADC_Stop_DMA(s_ldr_adc);
+        __HAL_ADC_CLEAR_FLAG(s_ldr_adc, ADC_FLAG_OVR);
+        process_burst();
+        (void)start_burst();
+    }
+
+    if (s_have_result == 0U) {
+        return LDR_STATUS_NOT_INIT;
+    }
+
+    *out_raw = s_flicker.mean_raw;
+    return LDR_STATUS_OK;
+}
+
+ldr_status_t ldr_get_flicker(ldr_flicker_t *out)
+{
+    if (out == NULL) {
+        return LDR_STATUS_NULL_PTR;
+    }
+    if (s_have_result == 0U) {
+        return LDR_STATUS_NOT_INIT;
+    }
+
+    *out = s_flicker;
+    return LDR_STATUS_OK;
+}
+
+#endif /* LDR_BACKEND == LDR_BACKEND_FLICKER */
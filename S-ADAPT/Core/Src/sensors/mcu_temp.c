@@ -0,0 +1,98 @@
+#include "sensors/mcu_temp.h"
+
+/* VDDA of the board; TS_CAL values were taken at TEMPSENSOR_CAL_VREFANALOG. */
+#ifndef MCU_TEMP_VDDA_MV
+#define MCU_TEMP_VDDA_MV 3300U
+#endif
+
+static ADC_HandleTypeDef *s_temp_adc = NULL;
+static mcu_temp_status_t s_init_status = MCU_TEMP_STATUS_NOT_INIT;
+
+void mcu_temp_init(ADC_HandleTypeDef *hadc)
+{
+    ADC_InjectionConfTypeDef config = {0};
+
+    s_temp_adc = hadc;
+    s_init_status = MCU_TEMP_STATUS_NOT_INIT;
+    if (s_temp_adc == NULL) {
+        return;
+    }
+
+    /* Sensor needs >= 5 us sampling; 640.5 cycles is ~20 us at the 32 MHz ADC clock. */
+    config.InjectedChannel = ADC_CHANNEL_TEMPSENSOR;
+    config.InjectedRank = ADC_INJECTED_RANK_1;
+    config.InjectedSamplingTime = ADC_SAMPLETIME_640CYCLES_5;
+    config.InjectedSingleDiff = ADC_SINGLE_ENDED;
+    config.InjectedOffsetNumber = ADC_OFFSET_NONE;
+    config.InjectedOffset = 0U;
+    config.InjectedNbrOfConversion = 1U;
+    config.InjectedDiscontinuousConvMode = DISABLE;
+    config.AutoInjectedConv = DISABLE;
+    config.QueueInjectedContext = DISABLE;
+    config.ExternalTrigInjecConv = ADC_INJECTED_SOFTWARE_START;
+    config.ExternalTrigInjecConvEdge = ADC_EXTERNALTRIGINJECCONV_EDGE_NONE;
+    config.InjecOversamplingMode = DISABLE;
+
+    s_init_status = (HAL_ADCEx_InjectedConfigChannel(s_temp_adc, &config) == HAL_OK) ? MCU_TEMP_STATUS_OK
+                                                                                     : MCU_TEMP_STATUS_CONFIG_ERROR;
+}
+
+mcu_temp_status_t mcu_temp_read_deci_c(int32_t *out_deci_c)
+{
+    int32_t raw_at_cal_vref;
+    int32_t cal1;
+    int32_t cal2;
+
+    if (s_temp_adc == NULL) {
+        return MCU_TEMP_STATUS_NOT_INIT;
+    }
+    if (out_deci_c == NULL) {
+        return MCU_TEMP_STATUS_NULL_PTR;
+    }
+    if (s_init_status != MCU_TEMP_STATUS_OK) {
+        return s_init_status;
+    }
+
+    if (HAL_ADCEx_InjectedStart(s_temp_adc) != HAL_OK) {
+        return MCU_TEMP_STATUS_START_ERROR;
+    }
+    if (HAL_ADCEx_InjectedPollForConversion(s_temp_adc, 2U) != HAL_OK) {
+        (void)HAL_ADCEx_InjectedStop(s_temp_adc);
+        return MCU_TEMP_STATUS_TIMEOUT;
+    }
+
+    raw_at_cal_vref = (int32_t)((HAL_ADCEx_InjectedGetValue(s_temp_adc, ADC_INJECTED_RANK_1) * MCU_TEMP_VDDA_MV) /
+                                TEMPSENSOR_CAL_VREFANALOG);
+    (void)HAL_ADCEx_InjectedStop(s_temp_adc);
+
+    /* Two-point factory calibration, interpolated in 0.1 degC. */
+    cal1 = (int32_t)*TEMPSENSOR_CAL1_ADDR;
+    cal2 = (int32_t)*TEMPSENSOR_CAL2_ADDR;
+    if (cal2 <= cal1) {
+        return MCU_TEMP_STATUS_CONFIG_ERROR;
+    }
+    *out_deci_c = (((raw_at_cal_vref - cal1) * (TEMPSENSOR_CAL2_TEMP - TEMPSENSOR_CAL1_TEMP) * 10) / (cal2 - cal1)) +
+                  (TEMPSENSOR_CAL1_TEMP * 10);
+
+    return MCU_TEMP_STATUS_OK;
+}
+
+const char *mcu_temp_status_to_string(mcu_temp_status_t status)
+{
+    switch (status) {
+        case MCU_TEMP_STATUS_OK:
+            return "ok";
+        case MCU_TEMP_STATUS_NOT_INIT:
+            return "not_init";
+        case MCU_TEMP_STATUS_NULL_PTR:
+            return "null_ptr";
+        case MCU_TEMP_STATUS_CONFIG_ERROR:
+            return "config_error";
+        case MCU_TEMP_STATUS_START_ERROR:
+            return "start_error";
+        case MCU_TEMP_STATUS_TIMEOUT:
+            return "timeout";
+        default:
+            return "unknown";
+    }
+}
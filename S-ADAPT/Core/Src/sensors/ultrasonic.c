@@ -1,12 +1,63 @@
 #include "sensors/ultrasonic.h"
 
-#include "main.h"
+#include "input/input_utils.h"
 
-static TIM_HandleTypeDef *s_echo_tim = NULL;
-static uint32_t s_echo_channel = TIM_CHANNEL_2;
-static ultrasonic_status_t s_last_status = ULTRASONIC_STATUS_NOT_INIT;
+/* Clamp for speed-of-sound compensation. */
+#define ULTRASONIC_TEMP_MIN_DECI_C   (-400)
+#define ULTRASONIC_TEMP_MAX_DECI_C   850
+/* 1/58 cm per microsecond in Q16. */
+#define ULTRASONIC_CM_PER_US_Q16     1130U
 
-static uint32_t capture_flag_from_channel(uint32_t channel)
+#if ULTRASONIC_BACKEND == ULTRASONIC_BACKEND_CAPTURE_IT
+
+#define ULTRASONIC_TRIG_PULSE_US     12U
+
+typedef enum
+{
+    ULTRASONIC_PHASE_IDLE = 0,
+    ULTRASONIC_PHASE_TRIGGER,
+    ULTRASONIC_PHASE_WAIT_RISING,
+    ULTRASONIC_PHASE_WAIT_FALLING,
+    ULTRASONIC_PHASE_DONE
+} ultrasonic_phase_t;
+
+/* ISR dispatch table; written only from ultrasonic_init (thread context, before the channel IRQs run). */
+static ultrasonic_t *s_instances[ULTRASONIC_MAX_INSTANCES];
+static uint8_t s_instance_count = 0U;
+
+static uint32_t capture_overcapture_flag_from_channel(uint32_t channel)
+{
+    switch (channel) {
+        case TIM_CHANNEL_1:
+            return TIM_FLAG_CC1OF;
+        case TIM_CHANNEL_2:
+            return TIM_FLAG_CC2OF;
+        case TIM_CHANNEL_3:
+            return TIM_FLAG_CC3OF;
+        case TIM_CHANNEL_4:
+            return TIM_FLAG_CC4OF;
+        default:
+            return 0U;
+    }
+}
+
+static uint32_t compare_it_from_channel(uint32_t channel)
+{
+    switch (channel) {
+        case TIM_CHANNEL_1:
+            return TIM_IT_CC1;
+        case TIM_CHANNEL_2:
+            return TIM_IT_CC2;
+        case TIM_CHANNEL_3:
+            return TIM_IT_CC3;
+        case TIM_CHANNEL_4:
+            return TIM_IT_CC4;
+        default:
+            return 0U;
+    }
+}
+
+static uint32_t compare_flag_from_channel(uint32_t channel)
 {
     switch (channel) {
         case TIM_CHANNEL_1:
@@ -22,147 +73,363 @@ static uint32_t capture_flag_from_channel(uint32_t channel)
     }
 }
 
-static uint32_t capture_overcapture_flag_from_channel(uint32_t channel)
+static HAL_TIM_ActiveChannel active_channel_from_channel(uint32_t channel)
 {
     switch (channel) {
         case TIM_CHANNEL_1:
-            return TIM_FLAG_CC1OF;
+            return HAL_TIM_ACTIVE_CHANNEL_1;
         case TIM_CHANNEL_2:
-            return TIM_FLAG_CC2OF;
+            return HAL_TIM_ACTIVE_CHANNEL_2;
         case TIM_CHANNEL_3:
-            return TIM_FLAG_CC3OF;
+            return HAL_TIM_ACTIVE_CHANNEL_3;
         case TIM_CHANNEL_4:
-            return TIM_FLAG_CC4OF;
+            return HAL_TIM_ACTIVE_CHANNEL_4;
         default:
-            return 0U;
+            return HAL_TIM_ACTIVE_CHANNEL_CLEARED;
     }
 }
 
-static uint8_t wait_for_capture(uint32_t capture_flag, uint32_t timeout_us)
+static uint32_t elapsed_ticks(const ultrasonic_t *us, uint32_t start, uint32_t stop)
 {
-    uint32_t t0;
+    uint32_t period;
 
-    if (s_echo_tim == NULL || capture_flag == 0U) {
-        return 0U;
+    if (stop >= start) {
+        return stop - start;
     }
 
-    t0 = __HAL_TIM_GET_COUNTER(s_echo_tim);
-    while (__HAL_TIM_GET_FLAG(s_echo_tim, capture_flag) == RESET) {
-        if ((uint32_t)(__HAL_TIM_GET_COUNTER(s_echo_tim) - t0) > timeout_us) {
-            return 0U;
+    period = __HAL_TIM_GET_AUTORELOAD(us->hw.tim);
+    return ((period - start) + stop + 1U);
+}
+
+/* Returns 1 when another registered instance already uses one of the channels on the same timer. */
+static uint8_t channels_taken(const ultrasonic_t *us, const ultrasonic_hw_t *hw)
+{
+    uint8_t i;
+
+    for (i = 0U; i < s_instance_count; i++) {
+        const ultrasonic_t *other = s_instances[i];
+
+        if ((other == us) || (other->hw.tim != hw->tim)) {
+            continue;
+        }
+        if ((other->hw.echo_channel == hw->echo_channel) || (other->hw.echo_channel == hw->trig_cc_channel) ||
+            (other->hw.trig_cc_channel == hw->echo_channel) || (other->hw.trig_cc_channel == hw->trig_cc_channel)) {
+            return 1U;
+        }
+    }
+
+    return 0U;
+}
+
+static uint8_t register_instance(ultrasonic_t *us)
+{
+    uint8_t i;
+
+    for (i = 0U; i < s_instance_count; i++) {
+        if (s_instances[i] == us) {
+            return 1U;
         }
     }
+    if (s_instance_count >= ULTRASONIC_MAX_INSTANCES) {
+        return 0U;
+    }
+
+    s_instances[s_instance_count] = us;
+    s_instance_count++;
     return 1U;
 }
 
-static void delay_us(uint32_t us)
+/* Caller holds the IRQ lock or runs in the timer ISR. */
+static void finish_measurement(ultrasonic_t *us, ultrasonic_status_t status, uint32_t echo_us)
+{
+    __HAL_TIM_SET_CAPTUREPOLARITY(us->hw.tim, us->hw.echo_channel, TIM_INPUTCHANNELPOLARITY_RISING);
+    __HAL_TIM_DISABLE_IT(us->hw.tim, compare_it_from_channel(us->hw.trig_cc_channel));
+    HAL_GPIO_WritePin(us->hw.trig_port, us->hw.trig_pin, GPIO_PIN_RESET);
+    us->echo_us = echo_us;
+    us->last_status = status;
+    us->phase = ULTRASONIC_PHASE_DONE;
+}
+
+static void on_compare(ultrasonic_t *us)
 {
-    uint32_t start;
+    __HAL_TIM_DISABLE_IT(us->hw.tim, compare_it_from_channel(us->hw.trig_cc_channel));
+    HAL_GPIO_WritePin(us->hw.trig_port, us->hw.trig_pin, GPIO_PIN_RESET);
 
-    start = __HAL_TIM_GET_COUNTER(s_echo_tim);
-    while ((uint32_t)(__HAL_TIM_GET_COUNTER(s_echo_tim) - start) < us) {
+    if (us->phase == ULTRASONIC_PHASE_TRIGGER) {
+        us->phase_start_tick = __HAL_TIM_GET_COUNTER(us->hw.tim);
+        us->phase = ULTRASONIC_PHASE_WAIT_RISING;
     }
 }
 
-void ultrasonic_init(TIM_HandleTypeDef *tim, uint32_t channel)
+static void on_capture(ultrasonic_t *us)
 {
-    s_echo_tim = tim;
-    s_echo_channel = channel;
+    uint32_t overcapture_flag = capture_overcapture_flag_from_channel(us->hw.echo_channel);
+    uint32_t captured = HAL_TIM_ReadCapturedValue(us->hw.tim, us->hw.echo_channel);
+
+    switch (us->phase) {
+        case ULTRASONIC_PHASE_TRIGGER:
+        case ULTRASONIC_PHASE_WAIT_RISING:
+            if (__HAL_TIM_GET_FLAG(us->hw.tim, overcapture_flag) != RESET) {
+                __HAL_TIM_CLEAR_FLAG(us->hw.tim, overcapture_flag);
+                finish_measurement(us, ULTRASONIC_STATUS_OVERCAPTURE_RISING, 0U);
+                break;
+            }
+            us->rise_tick = captured;
+            us->phase_start_tick = captured;
+            __HAL_TIM_SET_CAPTUREPOLARITY(us->hw.tim, us->hw.echo_channel, TIM_INPUTCHANNELPOLARITY_FALLING);
+            us->phase = ULTRASONIC_PHASE_WAIT_FALLING;
+            break;
+
+        case ULTRASONIC_PHASE_WAIT_FALLING:
+            if (__HAL_TIM_GET_FLAG(us->hw.tim, overcapture_flag) != RESET) {
+                __HAL_TIM_CLEAR_FLAG(us->hw.tim, overcapture_flag);
+                finish_measurement(us, ULTRASONIC_STATUS_OVERCAPTURE_FALLING, 0U);
+                break;
+            }
+            finish_measurement(us, ULTRASONIC_STATUS_OK, elapsed_ticks(us, us->rise_tick, captured));
+            break;
+
+        default:
+            /* Stray edge outside a measurement window; re-arm for the next rising edge. */
+            __HAL_TIM_CLEAR_FLAG(us->hw.tim, overcapture_flag);
+            __HAL_TIM_SET_CAPTUREPOLARITY(us->hw.tim, us->hw.echo_channel, TIM_INPUTCHANNELPOLARITY_RISING);
+            break;
+    }
+}
+
+void ultrasonic_init(ultrasonic_t *us, const ultrasonic_hw_t *hw)
+{
+    TIM_IC_InitTypeDef ic = {0};
+
+    if (us == NULL) {
+        return;
+    }
+
+    us->phase = ULTRASONIC_PHASE_IDLE;
+    us->echo_us = 0U;
+    us->timeout_us = 0U;
+    us->hw.tim = NULL;
+
+    if ((hw == NULL) || (hw->tim == NULL) || (hw->trig_port == NULL)) {
+        us->last_status = ULTRASONIC_STATUS_NOT_INIT;
+        return;
+    }
+
+    if ((capture_overcapture_flag_from_channel(hw->echo_channel) == 0U) ||
+        (compare_it_from_channel(hw->trig_cc_channel) == 0U) ||
+        (hw->echo_channel == hw->trig_cc_channel) ||
+        (channels_taken(us, hw) != 0U) ||
+        (register_instance(us) == 0U)) {
+        us->last_status = ULTRASONIC_STATUS_INVALID_CHANNEL;
+        return;
+    }
 
-    if (s_echo_tim == NULL) {
-        s_last_status = ULTRASONIC_STATUS_NOT_INIT;
+    /* CubeMX only sets up the first sensor's capture channel; configure ours so extra zones need no regen. */
+    ic.ICPolarity = TIM_INPUTCHANNELPOLARITY_RISING;
+    ic.ICSelection = TIM_ICSELECTION_DIRECTTI;
+    ic.ICPrescaler = TIM_ICPSC_DIV1;
+    ic.ICFilter = 0U;
+    if (HAL_TIM_IC_ConfigChannel(hw->tim, &ic, hw->echo_channel) != HAL_OK) {
+        us->last_status = ULTRASONIC_STATUS_NOT_INIT;
         return;
     }
 
-    HAL_TIM_Base_Start(s_echo_tim);
-    HAL_TIM_IC_Start(s_echo_tim, s_echo_channel);
-    s_last_status = ULTRASONIC_STATUS_OK;
+    us->hw = *hw;
+    HAL_GPIO_WritePin(us->hw.trig_port, us->hw.trig_pin, GPIO_PIN_RESET);
+    /* The shared timer may already run for another instance; starting it again is a no-op. */
+    (void)HAL_TIM_Base_Start(us->hw.tim);
+    HAL_TIM_IC_Start_IT(us->hw.tim, us->hw.echo_channel);
+    us->last_status = ULTRASONIC_STATUS_OK;
 }
 
-uint32_t ultrasonic_read_echo_us(uint32_t timeout_us)
+ultrasonic_status_t ultrasonic_start(ultrasonic_t *us, uint32_t timeout_us)
 {
-    uint32_t start;
-    uint32_t stop;
-    uint32_t capture_flag;
-    uint32_t overcapture_flag;
-    uint32_t period;
+    uint32_t primask;
+    uint32_t now_tick;
+    uint32_t cc_flag;
 
-    if (s_echo_tim == NULL) {
-        s_last_status = ULTRASONIC_STATUS_NOT_INIT;
-        return 0U;
+    if ((us == NULL) || (us->hw.tim == NULL)) {
+        if (us != NULL) {
+            us->last_status = ULTRASONIC_STATUS_NOT_INIT;
+        }
+        return ULTRASONIC_STATUS_NOT_INIT;
     }
 
-    capture_flag = capture_flag_from_channel(s_echo_channel);
-    overcapture_flag = capture_overcapture_flag_from_channel(s_echo_channel);
-    if (capture_flag == 0U || overcapture_flag == 0U) {
-        s_last_status = ULTRASONIC_STATUS_INVALID_CHANNEL;
-        return 0U;
+    primask = input_irq_lock();
+    if ((us->phase != ULTRASONIC_PHASE_IDLE) && (us->phase != ULTRASONIC_PHASE_DONE)) {
+        input_irq_unlock(primask);
+        return ULTRASONIC_STATUS_BUSY;
     }
 
-    __HAL_TIM_SET_COUNTER(s_echo_tim, 0U);
-    __HAL_TIM_SET_CAPTUREPOLARITY(s_echo_tim, s_echo_channel, TIM_INPUTCHANNELPOLARITY_RISING);
-    __HAL_TIM_CLEAR_FLAG(s_echo_tim, capture_flag);
-    __HAL_TIM_CLEAR_FLAG(s_echo_tim, overcapture_flag);
+    cc_flag = compare_flag_from_channel(us->hw.trig_cc_channel);
+    us->timeout_us = timeout_us;
+    us->echo_us = 0U;
+    __HAL_TIM_SET_CAPTUREPOLARITY(us->hw.tim, us->hw.echo_channel, TIM_INPUTCHANNELPOLARITY_RISING);
+    __HAL_TIM_CLEAR_FLAG(us->hw.tim, capture_overcapture_flag_from_channel(us->hw.echo_channel));
 
-    HAL_GPIO_WritePin(TRIG_GPIO_Port, TRIG_Pin, GPIO_PIN_RESET);
-    delay_us(2U);
-    HAL_GPIO_WritePin(TRIG_GPIO_Port, TRIG_Pin, GPIO_PIN_SET);
-    delay_us(10U);
-    HAL_GPIO_WritePin(TRIG_GPIO_Port, TRIG_Pin, GPIO_PIN_RESET);
+    now_tick = __HAL_TIM_GET_COUNTER(us->hw.tim);
+    us->phase_start_tick = now_tick;
+    us->phase = ULTRASONIC_PHASE_TRIGGER;
+    HAL_GPIO_WritePin(us->hw.trig_port, us->hw.trig_pin, GPIO_PIN_SET);
+    __HAL_TIM_SET_COMPARE(us->hw.tim, us->hw.trig_cc_channel, now_tick + ULTRASONIC_TRIG_PULSE_US);
+    __HAL_TIM_CLEAR_FLAG(us->hw.tim, cc_flag);
+    __HAL_TIM_ENABLE_IT(us->hw.tim, compare_it_from_channel(us->hw.trig_cc_channel));
+    input_irq_unlock(primask);
 
-    if (!wait_for_capture(capture_flag, timeout_us)) {
-        s_last_status = ULTRASONIC_STATUS_TIMEOUT_RISING;
+    return ULTRASONIC_STATUS_OK;
+}
+
+uint8_t ultrasonic_poll(ultrasonic_t *us, uint32_t *out_echo_us)
+{
+    uint32_t primask;
+    uint32_t echo_us;
+    ultrasonic_phase_t phase;
+
+    if ((us == NULL) || (us->hw.tim == NULL)) {
         return 0U;
     }
-    if (__HAL_TIM_GET_FLAG(s_echo_tim, overcapture_flag) != RESET) {
-        __HAL_TIM_CLEAR_FLAG(s_echo_tim, overcapture_flag);
-        s_last_status = ULTRASONIC_STATUS_OVERCAPTURE_RISING;
+
+    primask = input_irq_lock();
+    phase = (ultrasonic_phase_t)us->phase;
+    if ((phase == ULTRASONIC_PHASE_TRIGGER) ||
+        (phase == ULTRASONIC_PHASE_WAIT_RISING) ||
+        (phase == ULTRASONIC_PHASE_WAIT_FALLING)) {
+        uint32_t waited_us = elapsed_ticks(us, us->phase_start_tick, __HAL_TIM_GET_COUNTER(us->hw.tim));
+
+        if (waited_us > us->timeout_us) {
+            finish_measurement(us,
+                               (phase == ULTRASONIC_PHASE_WAIT_FALLING) ? ULTRASONIC_STATUS_TIMEOUT_FALLING
+                                                                        : ULTRASONIC_STATUS_TIMEOUT_RISING,
+                               0U);
+            phase = ULTRASONIC_PHASE_DONE;
+        }
+    }
+
+    if (phase != ULTRASONIC_PHASE_DONE) {
+        input_irq_unlock(primask);
         return 0U;
     }
-    start = HAL_TIM_ReadCapturedValue(s_echo_tim, s_echo_channel);
 
-    __HAL_TIM_CLEAR_FLAG(s_echo_tim, capture_flag);
-    __HAL_TIM_CLEAR_FLAG(s_echo_tim, overcapture_flag);
-    __HAL_TIM_SET_CAPTUREPOLARITY(s_echo_tim, s_echo_channel, TIM_INPUTCHANNELPOLARITY_FALLING);
+    echo_us = us->echo_us;
+    us->phase = ULTRASONIC_PHASE_IDLE;
+    input_irq_unlock(primask);
+
+    if (out_echo_us != NULL) {
+        *out_echo_us = echo_us;
+    }
+    return 1U;
+}
+
+uint8_t ultrasonic_is_busy(const ultrasonic_t *us)
+{
+    ultrasonic_phase_t phase;
 
-    if (!wait_for_capture(capture_flag, timeout_us)) {
-        __HAL_TIM_SET_CAPTUREPOLARITY(s_echo_tim, s_echo_channel, TIM_INPUTCHANNELPOLARITY_RISING);
-        s_last_status = ULTRASONIC_STATUS_TIMEOUT_FALLING;
+    if (us == NULL) {
         return 0U;
     }
-    if (__HAL_TIM_GET_FLAG(s_echo_tim, overcapture_flag) != RESET) {
-        __HAL_TIM_CLEAR_FLAG(s_echo_tim, overcapture_flag);
-        __HAL_TIM_SET_CAPTUREPOLARITY(s_echo_tim, s_echo_channel, TIM_INPUTCHANNELPOLARITY_RISING);
-        s_last_status = ULTRASONIC_STATUS_OVERCAPTURE_FALLING;
+
+    phase = (ultrasonic_phase_t)us->phase;
+    return ((phase == ULTRASONIC_PHASE_IDLE) || (phase == ULTRASONIC_PHASE_DONE)) ? 0U : 1U;
+}
+
+void ultrasonic_on_compare_isr(TIM_HandleTypeDef *tim)
+{
+    uint8_t i;
+
+    if (tim == NULL) {
+        return;
+    }
+
+    for (i = 0U; i < s_instance_count; i++) {
+        ultrasonic_t *us = s_instances[i];
+
+        if ((us->hw.tim == tim) && (tim->Channel == active_channel_from_channel(us->hw.trig_cc_channel))) {
+            on_compare(us);
+            return;
+        }
+    }
+}
+
+void ultrasonic_on_capture_isr(TIM_HandleTypeDef *tim)
+{
+    uint8_t i;
+
+    if (tim == NULL) {
+        return;
+    }
+
+    for (i = 0U; i < s_instance_count; i++) {
+        ultrasonic_t *us = s_instances[i];
+
+        if ((us->hw.tim == tim) && (tim->Channel == active_channel_from_channel(us->hw.echo_channel))) {
+            on_capture(us);
+            return;
+        }
+    }
+}
+
+ultrasonic_status_t ultrasonic_get_last_status(const ultrasonic_t *us)
+{
+    return (us != NULL) ? us->last_status : ULTRASONIC_STATUS_NOT_INIT;
+}
+
+/* Pings follow start(), so the caller's cadence already is the ping period. */
+ultrasonic_status_t ultrasonic_set_period_us(ultrasonic_t *us, uint32_t period_us)
+{
+    (void)period_us;
+    return (us != NULL) ? ULTRASONIC_STATUS_OK : ULTRASONIC_STATUS_NOT_INIT;
+}
+
+#endif /* ULTRASONIC_BACKEND == ULTRASONIC_BACKEND_CAPTURE_IT */
+
+uint32_t ultrasonic_read_echo_us(ultrasonic_t *us, uint32_t timeout_us)
+{
+    uint32_t echo_us = 0U;
+
+    if (ultrasonic_start(us, timeout_us) != ULTRASONIC_STATUS_OK) {
         return 0U;
     }
-    stop = HAL_TIM_ReadCapturedValue(s_echo_tim, s_echo_channel);
-    __HAL_TIM_SET_CAPTUREPOLARITY(s_echo_tim, s_echo_channel, TIM_INPUTCHANNELPOLARITY_RISING);
 
-    if (stop >= start) {
-        s_last_status = ULTRASONIC_STATUS_OK;
-        return stop - start;
+    while (ultrasonic_poll(us, &echo_us) == 0U) {
     }
 
-    period = __HAL_TIM_GET_AUTORELOAD(s_echo_tim);
-    s_last_status = ULTRASONIC_STATUS_OK;
-    return ((period - start) + stop + 1U);
+    return (ultrasonic_get_last_status(us) == ULTRASONIC_STATUS_OK) ? echo_us : 0U;
 }
 
-uint32_t ultrasonic_read_distance_cm(uint32_t timeout_us, uint32_t error_value_cm)
+uint32_t ultrasonic_read_distance_cm(ultrasonic_t *us, uint32_t timeout_us, uint32_t error_value_cm)
 {
-    uint32_t echo_us = ultrasonic_read_echo_us(timeout_us);
+    uint32_t echo_us = ultrasonic_read_echo_us(us, timeout_us);
 
     if (echo_us == 0U) {
         return error_value_cm;
     }
 
-    return echo_us / 58U;
+    return ultrasonic_echo_us_to_cm(echo_us);
+}
+
+uint32_t ultrasonic_echo_us_to_cm(uint32_t echo_us)
+{
+    return (uint32_t)(((uint64_t)echo_us * ULTRASONIC_CM_PER_US_Q16) >> 16);
+}
+
+uint32_t ultrasonic_mm_per_us_q16(int32_t temp_deci_c)
+{
+    uint32_t speed_dm_s;
+
+    if (temp_deci_c < ULTRASONIC_TEMP_MIN_DECI_C) {
+        temp_deci_c = ULTRASONIC_TEMP_MIN_DECI_C;
+    } else if (temp_deci_c > ULTRASONIC_TEMP_MAX_DECI_C) {
+        temp_deci_c = ULTRASONIC_TEMP_MAX_DECI_C;
+    }
+
+    /* c = 331.3 + 0.606 * T m/s, in dm/s; the echo covers the distance twice. */
+    speed_dm_s = (uint32_t)(3313 + ((606 * temp_deci_c) / 1000));
+    return ((speed_dm_s << 16) + 10000U) / 20000U;
 }
 
-ultrasonic_status_t ultrasonic_get_last_status(void)
+uint32_t ultrasonic_echo_us_to_mm(uint32_t echo_us, uint32_t mm_per_us_q16)
 {
-    return s_last_status;
+    return (uint32_t)((((uint64_t)echo_us * mm_per_us_q16) + 0x8000U) >> 16);
 }
 
 const char *ultrasonic_status_to_string(ultrasonic_status_t status)
@@ -182,6 +449,8 @@ const char *ultrasonic_status_to_string(ultrasonic_status_t status)
             return "overcapture_rising";
         case ULTRASONIC_STATUS_OVERCAPTURE_FALLING:
             return "overcapture_falling";
+        case ULTRASONIC_STATUS_BUSY:
+            return "busy";
         default:
             return "unknown";
     }
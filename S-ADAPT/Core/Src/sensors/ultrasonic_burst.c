@@ -0,0 +1,207 @@
+#include "sensors/ultrasonic_burst.h"
+
+#include "input/input_utils.h"
+
+typedef enum
+{
+    ULTRASONIC_BURST_PHASE_IDLE = 0,
+    ULTRASONIC_BURST_PHASE_PING,
+    ULTRASONIC_BURST_PHASE_DEAD_TIME
+} ultrasonic_burst_phase_t;
+
+static const ultrasonic_burst_cfg_t s_default_cfg = {
+    .ping_count = 1U,
+    .ping_timeout_us = 30000U,
+    .dead_time_ms = 0U,
+    .agree_band_us = 0U,
+};
+
+static void record_ping(ultrasonic_burst_t *b, ultrasonic_status_t status, uint32_t echo_us)
+{
+    b->pings_done++;
+    if ((status == ULTRASONIC_STATUS_OK) && (echo_us != 0U) && (echo_us <= b->cfg.ping_timeout_us)) {
+        uint8_t i = b->valid_count;
+
+        /* Keep the valid widths sorted (insertion) for the median. */
+        while ((i > 0U) && (b->echo_us[i - 1U] > echo_us)) {
+            b->echo_us[i] = b->echo_us[i - 1U];
+            i--;
+        }
+        b->echo_us[i] = echo_us;
+        b->valid_count++;
+    } else {
+        /* The echo started but outlasted the timeout: nothing reflected within range. */
+        if ((status == ULTRASONIC_STATUS_TIMEOUT_FALLING) || (status == ULTRASONIC_STATUS_OK)) {
+            b->beyond_count++;
+        }
+        b->last_error = (status == ULTRASONIC_STATUS_OK) ? ULTRASONIC_STATUS_TIMEOUT_FALLING : status;
+    }
+}
+
+static void fuse_burst(const ultrasonic_burst_t *b, ultrasonic_burst_result_t *out_result)
+{
+    uint32_t median_us;
+    uint32_t sum_us = 0U;
+    uint8_t agreeing = 0U;
+    uint8_t i;
+
+    out_result->valid_pings = b->valid_count;
+    out_result->agreeing_pings = 0U;
+    out_result->confidence_percent = 0U;
+    out_result->echo_us = 0U;
+    out_result->distance_mm = 0U;
+    out_result->beyond_range = 0U;
+
+    /* No width at all but echoes running past the timeout: the room is deeper than the range, which is a
+     * distance (an empty seat facing it), not a failed burst. Reported at the range limit; confidence counts
+     * the pings that agree on it, so a single stray timeout among failed pings stays below the gate. */
+    if ((b->valid_count == 0U) && (b->beyond_count != 0U)) {
+        out_result->status = ULTRASONIC_STATUS_OK;
+        out_result->beyond_range = 1U;
+        out_result->agreeing_pings = b->beyond_count;
+        out_result->confidence_percent = (uint8_t)(((uint32_t)b->beyond_count * 100U) / b->pings_done);
+        out_result->echo_us = b->cfg.ping_timeout_us;
+        out_result->distance_mm = ultrasonic_echo_us_to_mm(out_result->echo_us, b->mm_per_us_q16);
+        return;
+    }
+    if (b->valid_count == 0U) {
+        out_result->status = b->last_error;
+        return;
+    }
+
+    median_us = b->echo_us[(b->valid_count - 1U) / 2U];
+    for (i = 0U; i < b->valid_count; i++) {
+        uint32_t delta_us = (b->echo_us[i] > median_us) ? (b->echo_us[i] - median_us) : (median_us - b->echo_us[i]);
+
+        if (delta_us <= b->cfg.agree_band_us) {
+            sum_us += b->echo_us[i];
+            agreeing++;
+        }
+    }
+
+    out_result->status = ULTRASONIC_STATUS_OK;
+    out_result->agreeing_pings = agreeing;
+    out_result->confidence_percent = (uint8_t)(((uint32_t)agreeing * 100U) / b->pings_done);
+    out_result->echo_us = sum_us / agreeing;
+    out_result->distance_mm = ultrasonic_echo_us_to_mm(out_result->echo_us, b->mm_per_us_q16);
+}
+
+void ultrasonic_burst_configure(ultrasonic_burst_t *b, const ultrasonic_burst_cfg_t *cfg)
+{
+    if (b == NULL) {
+        return;
+    }
+
+    b->cfg = (cfg != NULL) ? *cfg : s_default_cfg;
+#if ULTRASONIC_BACKEND == ULTRASONIC_BACKEND_HW_TIMED
+    /* The hardware owns the ping schedule; one ping per slot. */
+    b->cfg.ping_count = 1U;
+#endif
+    if (b->cfg.ping_count == 0U) {
+        b->cfg.ping_count = 1U;
+    } else if (b->cfg.ping_count > ULTRASONIC_BURST_MAX_PINGS) {
+        b->cfg.ping_count = ULTRASONIC_BURST_MAX_PINGS;
+    }
+}
+
+void ultrasonic_burst_init(ultrasonic_burst_t *b, ultrasonic_t *us, const ultrasonic_burst_cfg_t *cfg)
+{
+    if (b == NULL) {
+        return;
+    }
+
+    b->us = us;
+    ultrasonic_burst_configure(b, cfg);
+    b->phase = ULTRASONIC_BURST_PHASE_IDLE;
+    b->valid_count = 0U;
+    b->beyond_count = 0U;
+    b->pings_done = 0U;
+    b->last_error = ULTRASONIC_STATUS_OK;
+    b->dead_start_ms = 0U;
+    b->mm_per_us_q16 = 0U;
+}
+
+ultrasonic_status_t ultrasonic_burst_start(ultrasonic_burst_t *b, int32_t temp_deci_c)
+{
+    ultrasonic_status_t status;
+
+    if (b == NULL) {
+        return ULTRASONIC_STATUS_NOT_INIT;
+    }
+
+    if (b->phase != ULTRASONIC_BURST_PHASE_IDLE) {
+        return ULTRASONIC_STATUS_BUSY;
+    }
+
+    status = ultrasonic_start(b->us, b->cfg.ping_timeout_us);
+    if (status != ULTRASONIC_STATUS_OK) {
+        return status;
+    }
+
+    b->mm_per_us_q16 = ultrasonic_mm_per_us_q16(temp_deci_c);
+    b->valid_count = 0U;
+    b->beyond_count = 0U;
+    b->pings_done = 0U;
+    b->last_error = ULTRASONIC_STATUS_OK;
+    b->phase = ULTRASONIC_BURST_PHASE_PING;
+    return ULTRASONIC_STATUS_OK;
+}
+
+uint8_t ultrasonic_burst_poll(ultrasonic_burst_t *b, uint32_t now_ms, ultrasonic_burst_result_t *out_result)
+{
+    uint32_t echo_us = 0U;
+
+    if (b == NULL) {
+        return 0U;
+    }
+
+    switch (b->phase) {
+        case ULTRASONIC_BURST_PHASE_PING:
+            if (ultrasonic_poll(b->us, &echo_us) == 0U) {
+                return 0U;
+            }
+            record_ping(b, ultrasonic_get_last_status(b->us), echo_us);
+            if (b->pings_done < b->cfg.ping_count) {
+                /* Let late reflections of this ping die out before the next TRIG. */
+                b->dead_start_ms = now_ms;
+                b->phase = ULTRASONIC_BURST_PHASE_DEAD_TIME;
+                return 0U;
+            }
+            break;
+
+        case ULTRASONIC_BURST_PHASE_DEAD_TIME:
+            if (input_has_elapsed_ms(now_ms, b->dead_start_ms, b->cfg.dead_time_ms) == 0U) {
+                return 0U;
+            }
+            {
+                ultrasonic_status_t status = ultrasonic_start(b->us, b->cfg.ping_timeout_us);
+
+                if (status == ULTRASONIC_STATUS_OK) {
+                    b->phase = ULTRASONIC_BURST_PHASE_PING;
+                    return 0U;
+                }
+                /* Could not fire: close the burst with what was collected. */
+                record_ping(b, status, 0U);
+            }
+            break;
+
+        case ULTRASONIC_BURST_PHASE_IDLE:
+        default:
+            return 0U;
+    }
+
+    b->phase = ULTRASONIC_BURST_PHASE_IDLE;
+    if (out_result != NULL) {
+        fuse_burst(b, out_result);
+    }
+    return 1U;
+}
+
+uint8_t ultrasonic_burst_is_busy(const ultrasonic_burst_t *b)
+{
+    if (b == NULL) {
+        return 0U;
+    }
+
+    return (b->phase != ULTRASONIC_BURST_PHASE_IDLE) ? 1U : 0U;
+}
@@ -0,0 +1,283 @@
+#include "sensors/ultrasonic.h"
+
+#include "input/input_utils.h"
+#include "main.h"
+
+#if ULTRASONIC_BACKEND == ULTRASONIC_BACKEND_HW_TIMED
+
+/* TRIG (PA0) runs as TIM2_CH1 PWM on AF1; echo edges on CH2 are moved by DMA1 channel 7 (request 4 = TIM2_CH2).
+ * TIM2 ticks at 1 MHz, so capture values are microseconds and each period starts with the TRIG pulse. */
+#define ULTRASONIC_HW_TRIG_CHANNEL   TIM_CHANNEL_1
+#define ULTRASONIC_HW_ECHO_CHANNEL   TIM_CHANNEL_2
+#define ULTRASONIC_HW_TRIG_PULSE_US  12U
+#define ULTRASONIC_HW_DMA_INSTANCE   DMA1_Channel7
+#define ULTRASONIC_HW_DMA_REQUEST    DMA_REQUEST_4
+#define ULTRASONIC_HW_EDGE_COUNT     2U
+/* No completed edge pair for this many periods is reported as a timeout. */
+#define ULTRASONIC_HW_STALL_PERIODS  2U
+/* Shortest accepted period: TRIG pulse plus the sensor's trigger-to-burst setup and a near echo. */
+#define ULTRASONIC_HW_MIN_PERIOD_US  10000U
+
+/* The DMA channel and TRIG pin are fixed, so only one instance can own the hardware. */
+static ultrasonic_t *s_owner = NULL;
+static TIM_HandleTypeDef *s_echo_tim = NULL;
+static DMA_HandleTypeDef s_echo_dma;
+static volatile uint32_t s_edge_ticks[ULTRASONIC_HW_EDGE_COUNT];
+static uint8_t s_running = 0U;
+static uint32_t s_last_pair_ms = 0U;
+static uint32_t s_period_us = ULTRASONIC_HW_PERIOD_US;
+
+/* (Re)arm the circular capture buffer so the next edge (a rising one, if ECHO is low) lands in slot 0. */
+static uint8_t start_edge_dma(void)
+{
+    __HAL_TIM_DISABLE_DMA(s_echo_tim, TIM_DMA_CC2);
+    if (HAL_DMA_GetState(&s_echo_dma) == HAL_DMA_STATE_BUSY) {
+        (void)HAL_DMA_Abort(&s_echo_dma);
+    }
+
+    s_edge_ticks[0] = 0U;
+    s_edge_ticks[1] = 0U;
+    (void)HAL_TIM_ReadCapturedValue(s_echo_tim, ULTRASONIC_HW_ECHO_CHANNEL);
+    __HAL_TIM_CLEAR_FLAG(s_echo_tim, TIM_FLAG_CC2 | TIM_FLAG_CC2OF);
+    __HAL_DMA_CLEAR_FLAG(&s_echo_dma, __HAL_DMA_GET_TC_FLAG_INDEX(&s_echo_dma));
+
+    if (HAL_DMA_Start(&s_echo_dma,
+                      (uint32_t)&s_echo_tim->Instance->CCR2,
+                      (uint32_t)s_edge_ticks,
+                      ULTRASONIC_HW_EDGE_COUNT) != HAL_OK) {
+        return 0U;
+    }
+
+    __HAL_TIM_ENABLE_DMA(s_echo_tim, TIM_DMA_CC2);
+    return 1U;
+}
+
+static void realign_if_echo_low(void)
+{
+    if (HAL_GPIO_ReadPin(ECHO_TIM2_CH2_GPIO_Port, ECHO_TIM2_CH2_Pin) == GPIO_PIN_RESET) {
+        (void)start_edge_dma();
+    }
+}
+
+void ultrasonic_init(ultrasonic_t *us, const ultrasonic_hw_t *hw)
+{
+    GPIO_InitTypeDef gpio = {0};
+    TIM_OC_InitTypeDef oc = {0};
+    TIM_IC_InitTypeDef ic = {0};
+
+    if (us == NULL) {
+        return;
+    }
+
+    us->phase = 0U;
+    us->echo_us = 0U;
+    us->timeout_us = ULTRASONIC_HW_PERIOD_US;
+    us->hw.tim = NULL;
+    if ((hw == NULL) || (hw->tim == NULL)) {
+        us->last_status = ULTRASONIC_STATUS_NOT_INIT;
+        return;
+    }
+
+    /* The DMA request and the TRIG pin mapping are fixed to CH2/CH1. */
+    if ((hw->echo_channel != ULTRASONIC_HW_ECHO_CHANNEL) || ((s_owner != NULL) && (s_owner != us))) {
+        us->last_status = ULTRASONIC_STATUS_INVALID_CHANNEL;
+        return;
+    }
+
+    us->hw = *hw;
+    s_owner = us;
+    s_echo_tim = hw->tim;
+    s_running = 0U;
+    s_period_us = ULTRASONIC_HW_PERIOD_US;
+
+    /* ARR preload: ultrasonic_set_period_us() may then change the period mid-ping without a counter overrun. */
+    s_echo_tim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    s_echo_tim->Instance->CR1 |= TIM_CR1_ARPE;
+    s_echo_tim->Init.Period = s_period_us - 1U;
+    __HAL_TIM_SET_AUTORELOAD(s_echo_tim, s_echo_tim->Init.Period);
+    __HAL_TIM_SET_COUNTER(s_echo_tim, 0U);
+
+    /* PWM mode 1: TRIG is high for the first ULTRASONIC_HW_TRIG_PULSE_US ticks of every period. */
+    oc.OCMode = TIM_OCMODE_PWM1;
+    oc.Pulse = ULTRASONIC_HW_TRIG_PULSE_US;
+    oc.OCPolarity = TIM_OCPOLARITY_HIGH;
+    oc.OCFastMode = TIM_OCFAST_DISABLE;
+    ic.ICPolarity = TIM_INPUTCHANNELPOLARITY_BOTHEDGE;
+    ic.ICSelection = TIM_ICSELECTION_DIRECTTI;
+    ic.ICPrescaler = TIM_ICPSC_DIV1;
+    ic.ICFilter = 0U;
+    if ((HAL_TIM_PWM_ConfigChannel(s_echo_tim, &oc, ULTRASONIC_HW_TRIG_CHANNEL) != HAL_OK) ||
+        (HAL_TIM_IC_ConfigChannel(s_echo_tim, &ic, ULTRASONIC_HW_ECHO_CHANNEL) != HAL_OK)) {
+        us->last_status = ULTRASONIC_STATUS_NOT_INIT;
+        return;
+    }
+
+    HAL_GPIO_WritePin(TRIG_GPIO_Port, TRIG_Pin, GPIO_PIN_RESET);
+    gpio.Pin = TRIG_Pin;
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_LOW;
+    gpio.Alternate = GPIO_AF1_TIM2;
+    HAL_GPIO_Init(TRIG_GPIO_Port, &gpio);
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    s_echo_dma.Instance = ULTRASONIC_HW_DMA_INSTANCE;
+    s_echo_dma.Init.Request = ULTRASONIC_HW_DMA_REQUEST;
+    s_echo_dma.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    s_echo_dma.Init.PeriphInc = DMA_PINC_DISABLE;
+    s_echo_dma.Init.MemInc = DMA_MINC_ENABLE;
+    s_echo_dma.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    s_echo_dma.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+    s_echo_dma.Init.Mode = DMA_CIRCULAR;
+    s_echo_dma.Init.Priority = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&s_echo_dma) != HAL_OK) {
+        us->last_status = ULTRASONIC_STATUS_NOT_INIT;
+        return;
+    }
+    __HAL_LINKDMA(s_echo_tim, hdma[TIM_DMA_ID_CC2], s_echo_dma);
+
+    if ((start_edge_dma() == 0U) ||
+        (HAL_TIM_IC_Start(s_echo_tim, ULTRASONIC_HW_ECHO_CHANNEL) != HAL_OK) ||
+        (HAL_TIM_PWM_Start(s_echo_tim, ULTRASONIC_HW_TRIG_CHANNEL) != HAL_OK)) {
+        us->last_status = ULTRASONIC_STATUS_NOT_INIT;
+        return;
+    }
+
+    s_last_pair_ms = HAL_GetTick();
+    s_running = 1U;
+    us->last_status = ULTRASONIC_STATUS_OK;
+}
+
+ultrasonic_status_t ultrasonic_start(ultrasonic_t *us, uint32_t timeout_us)
+{
+    if ((us == NULL) || (us != s_owner)) {
+        if (us != NULL) {
+            us->last_status = ULTRASONIC_STATUS_NOT_INIT;
+        }
+        return ULTRASONIC_STATUS_NOT_INIT;
+    }
+    if (s_running == 0U) {
+        return us->last_status;
+    }
+
+    /* Pings are generated by the timer; only the accepted echo width follows the caller. */
+    us->timeout_us = timeout_us;
+    return ULTRASONIC_STATUS_OK;
+}
+
+uint8_t ultrasonic_poll(ultrasonic_t *us, uint32_t *out_echo_us)
+{
+    uint32_t tc_flag;
+    uint32_t rise_tick;
+    uint32_t fall_tick;
+    uint32_t now_ms;
+    uint32_t stall_ms = ((s_period_us / 1000U) + 1U) * ULTRASONIC_HW_STALL_PERIODS;
+
+    if ((us == NULL) || (us != s_owner) || (s_running == 0U)) {
+        return 0U;
+    }
+
+    now_ms = HAL_GetTick();
+    tc_flag = __HAL_DMA_GET_TC_FLAG_INDEX(&s_echo_dma);
+    if (__HAL_DMA_GET_FLAG(&s_echo_dma, tc_flag) == RESET) {
+        if (input_has_elapsed_ms(now_ms, s_last_pair_ms, stall_ms) == 0U) {
+            return 0U;
+        }
+
+        /* One edge buffered means the echo never fell (or an edge was lost); otherwise nothing came back. */
+        us->last_status = (__HAL_DMA_GET_COUNTER(&s_echo_dma) == ULTRASONIC_HW_EDGE_COUNT)
+                            ? ULTRASONIC_STATUS_TIMEOUT_RISING
+                            : ULTRASONIC_STATUS_TIMEOUT_FALLING;
+        if (us->last_status == ULTRASONIC_STATUS_TIMEOUT_FALLING) {
+            realign_if_echo_low();
+        }
+        s_last_pair_ms = now_ms;
+        if (out_echo_us != NULL) {
+            *out_echo_us = 0U;
+        }
+        return 1U;
+    }
+
+    __HAL_DMA_CLEAR_FLAG(&s_echo_dma, tc_flag);
+    rise_tick = s_edge_ticks[0];
+    fall_tick = s_edge_ticks[1];
+    s_last_pair_ms = now_ms;
+
+    /* A new rising edge overwrote slot 0 while reading; drop this pair, the next period delivers another. */
+    if (__HAL_DMA_GET_COUNTER(&s_echo_dma) != ULTRASONIC_HW_EDGE_COUNT) {
+        return 0U;
+    }
+
+    if (__HAL_TIM_GET_FLAG(s_echo_tim, TIM_FLAG_CC2OF) != RESET) {
+        __HAL_TIM_CLEAR_FLAG(s_echo_tim, TIM_FLAG_CC2OF);
+        realign_if_echo_low();
+        us->last_status = ULTRASONIC_STATUS_OVERCAPTURE_FALLING;
+        if (out_echo_us != NULL) {
+            *out_echo_us = 0U;
+        }
+        return 1U;
+    }
+
+    /* Slot 0 holding a falling edge means the pairing slipped by one; resync and wait for a clean pair. */
+    if ((fall_tick <= rise_tick) || (rise_tick < ULTRASONIC_HW_TRIG_PULSE_US)) {
+        realign_if_echo_low();
+        return 0U;
+    }
+
+    if ((fall_tick - rise_tick) > us->timeout_us) {
+        us->last_status = ULTRASONIC_STATUS_TIMEOUT_FALLING;
+        if (out_echo_us != NULL) {
+            *out_echo_us = 0U;
+        }
+        return 1U;
+    }
+
+    us->last_status = ULTRASONIC_STATUS_OK;
+    if (out_echo_us != NULL) {
+        *out_echo_us = fall_tick - rise_tick;
+    }
+    return 1U;
+}
+
+uint8_t ultrasonic_is_busy(const ultrasonic_t *us)
+{
+    (void)us;
+    return 0U;
+}
+
+ultrasonic_status_t ultrasonic_set_period_us(ultrasonic_t *us, uint32_t period_us)
+{
+    if ((us == NULL) || (us != s_owner) || (s_running == 0U)) {
+        return ULTRASONIC_STATUS_NOT_INIT;
+    }
+    if (period_us < ULTRASONIC_HW_MIN_PERIOD_US) {
+        period_us = ULTRASONIC_HW_MIN_PERIOD_US;
+    }
+    if (period_us == s_period_us) {
+        return ULTRASONIC_STATUS_OK;
+    }
+
+    /* Lands in the preload register; the running ping keeps its period and the capture pairing is untouched. */
+    s_period_us = period_us;
+    s_echo_tim->Init.Period = period_us - 1U;
+    __HAL_TIM_SET_AUTORELOAD(s_echo_tim, s_echo_tim->Init.Period);
+    return ULTRASONIC_STATUS_OK;
+}
+
+/* Nothing to do per edge: the TIM2 interrupt sources stay disabled with this backend. */
+void ultrasonic_on_compare_isr(TIM_HandleTypeDef *tim)
+{
+    (void)tim;
+}
+
+void ultrasonic_on_capture_isr(TIM_HandleTypeDef *tim)
+{
+    (void)tim;
+}
+
+ultrasonic_status_t ultrasonic_get_last_status(const ultrasonic_t *us)
+{
+    return (us != NULL) ? us->last_status : ULTRASONIC_STATUS_NOT_INIT;
+}
+
+#endif /* ULTRASONIC_BACKEND == ULTRASONIC_BACKEND_HW_TIMED */
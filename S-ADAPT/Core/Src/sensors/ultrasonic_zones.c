@@ -0,0 +1,130 @@
+#include "sensors/ultrasonic_zones.h"
+
+#include <stddef.h>
+
+#include "input/input_utils.h"
+
+static void fail_result(ultrasonic_status_t status, ultrasonic_burst_result_t *out_result)
+{
+    if (out_result == NULL) {
+        return;
+    }
+
+    out_result->status = status;
+    out_result->echo_us = 0U;
+    out_result->distance_mm = 0U;
+    out_result->valid_pings = 0U;
+    out_result->agreeing_pings = 0U;
+    out_result->confidence_percent = 0U;
+}
+
+static uint8_t peek_next_zone(const ultrasonic_zones_t *z)
+{
+    uint8_t i;
+
+    for (i = 0U; i < z->count; i++) {
+        uint8_t zone = (uint8_t)((z->next_zone + i) % z->count);
+
+        if ((z->pending_mask & (1U << zone)) != 0U) {
+            return zone;
+        }
+    }
+
+    return ULTRASONIC_ZONES_NONE;
+}
+
+void ultrasonic_zones_init(ultrasonic_zones_t *z, ultrasonic_burst_t *bursts, uint8_t count, uint32_t guard_ms)
+{
+    if (z == NULL) {
+        return;
+    }
+
+    z->bursts = bursts;
+    z->count = (bursts == NULL) ? 0U : ((count > ULTRASONIC_ZONES_MAX) ? ULTRASONIC_ZONES_MAX : count);
+    z->guard_ms = guard_ms;
+    z->pending_mask = 0U;
+    z->active_zone = ULTRASONIC_ZONES_NONE;
+    z->next_zone = 0U;
+    z->last_zone = ULTRASONIC_ZONES_NONE;
+    z->last_done_ms = 0U;
+    z->temp_deci_c = 0;
+}
+
+ultrasonic_status_t ultrasonic_zones_start_round(ultrasonic_zones_t *z, uint8_t zone_mask, int32_t temp_deci_c)
+{
+    if ((z == NULL) || (z->count == 0U)) {
+        return ULTRASONIC_STATUS_NOT_INIT;
+    }
+    if (ultrasonic_zones_is_busy(z) != 0U) {
+        return ULTRASONIC_STATUS_BUSY;
+    }
+
+    z->pending_mask = (uint8_t)(zone_mask & ((1U << z->count) - 1U));
+    z->temp_deci_c = temp_deci_c;
+    /* Each round starts at zone 0 so every zone keeps a fixed slot in the round and a steady cadence. */
+    z->next_zone = 0U;
+    return ULTRASONIC_STATUS_OK;
+}
+
+uint8_t ultrasonic_zones_poll(ultrasonic_zones_t *z,
+                              uint32_t now_ms,
+                              uint8_t *out_zone,
+                              ultrasonic_burst_result_t *out_result)
+{
+    uint8_t zone;
+    ultrasonic_status_t status;
+
+    if ((z == NULL) || (z->count == 0U)) {
+        return 0U;
+    }
+
+    if (z->active_zone != ULTRASONIC_ZONES_NONE) {
+        if (ultrasonic_burst_poll(&z->bursts[z->active_zone], now_ms, out_result) == 0U) {
+            return 0U;
+        }
+        if (out_zone != NULL) {
+            *out_zone = z->active_zone;
+        }
+        z->last_zone = z->active_zone;
+        z->active_zone = ULTRASONIC_ZONES_NONE;
+        z->last_done_ms = now_ms;
+        return 1U;
+    }
+
+    if (z->pending_mask == 0U) {
+        return 0U;
+    }
+    zone = peek_next_zone(z);
+    if (zone == ULTRASONIC_ZONES_NONE) {
+        z->pending_mask = 0U;
+        return 0U;
+    }
+    /* The guard also spans rounds: the first zone of a round may follow the last zone of the previous one. */
+    if ((z->last_zone != ULTRASONIC_ZONES_NONE) && (z->last_zone != zone) &&
+        (input_has_elapsed_ms(now_ms, z->last_done_ms, z->guard_ms) == 0U)) {
+        return 0U;
+    }
+    z->pending_mask &= (uint8_t)~(1U << zone);
+    z->next_zone = (uint8_t)((zone + 1U) % z->count);
+
+    status = ultrasonic_burst_start(&z->bursts[zone], z->temp_deci_c);
+    if (status == ULTRASONIC_STATUS_OK) {
+        z->active_zone = zone;
+        return 0U;
+    }
+
+    fail_result(status, out_result);
+    if (out_zone != NULL) {
+        *out_zone = zone;
+    }
+    return 1U;
+}
+
+uint8_t ultrasonic_zones_is_busy(const ultrasonic_zones_t *z)
+{
+    if (z == NULL) {
+        return 0U;
+    }
+
+    return ((z->active_zone != ULTRASONIC_ZONES_NONE) || (z->pending_mask != 0U)) ? 1U : 0U;
+}
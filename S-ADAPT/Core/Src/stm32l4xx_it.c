@@ -57,6 +57,8 @@
 /* External variables --------------------------------------------------------*/
 
 /* USER CODE BEGIN EV */
+extern TIM_HandleTypeDef htim2;
+extern ADC_HandleTypeDef hadc1;
 
 /* USER CODE END EV */
 
@@ -209,4 +211,14 @@ void EXTI15_10_IRQHandler(void)
   HAL_GPIO_EXTI_IRQHandler(ENCODER_DT_EXTI10_Pin);
 }
 
+void TIM2_IRQHandler(void)
+{
+  HAL_TIM_IRQHandler(&htim2);
+}
+
+void ADC1_IRQHandler(void)
+{
+  HAL_ADC_IRQHandler(&hadc1);
+}
+
 /* USER CODE END 1 */
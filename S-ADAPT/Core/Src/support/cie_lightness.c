@@ -0,0 +1,68 @@
+#include "support/cie_lightness.h"
+
+#include <stddef.h>
+
+/* Y = L / 903.3 up to L = 8, ((L + 16) / 116)^3 above; the two pieces meet at L = 8. */
+static uint32_t luminance_q24_at(uint32_t l)
+{
+    uint64_t y;
+
+    if (l <= 8U) {
+        y = (((uint64_t)l * CIE_LUMINANCE_ONE_Q24 * 10U) + 4516U) / 9033U;
+    } else {
+        uint64_t a = (uint64_t)l + 16U;
+
+        y = ((a * a * a * CIE_LUMINANCE_ONE_Q24) + (1560896U / 2U)) / 1560896U; /* 116^3 */
+    }
+
+    return (y > CIE_LUMINANCE_ONE_Q24) ? CIE_LUMINANCE_ONE_Q24 : (uint32_t)y;
+}
+
+void cie_lightness_build(cie_lightness_t *table)
+{
+    uint32_t l;
+
+    if (table == NULL) {
+        return;
+    }
+
+    for (l = 0U; l < CIE_LIGHTNESS_ENTRIES; l++) {
+        table->luminance_q24[l] = luminance_q24_at(l);
+    }
+}
+
+uint8_t cie_lightness_percent_from_luminance(uint8_t luminance_percent)
+{
+    uint32_t target;
+    uint32_t l = 0U;
+
+    if (luminance_percent >= 100U) {
+        return 100U;
+    }
+
+    target = (uint32_t)(((uint64_t)luminance_percent * CIE_LUMINANCE_ONE_Q24) / 100U);
+    while ((l < 100U) && (luminance_q24_at(l + 1U) <= target)) {
+        l++;
+    }
+    /* l is the last grid point at or below the target; round to the nearer of l and l + 1. */
+    if ((l < 100U) && ((luminance_q24_at(l + 1U) - target) < (target - luminance_q24_at(l)))) {
+        l++;
+    }
+
+    return (uint8_t)l;
+}
+
+uint32_t cie_lightness_to_luminance(const cie_lightness_t *table, uint16_t lightness_q8)
+{
+    uint32_t index;
+    uint32_t frac;
+
+    if (lightness_q8 >= CIE_LIGHTNESS_FULL_Q8) {
+        return table->luminance_q24[CIE_LIGHTNESS_ENTRIES - 1U];
+    }
+
+    index = (uint32_t)lightness_q8 >> CIE_LIGHTNESS_SHIFT;
+    frac = (uint32_t)lightness_q8 & ((1UL << CIE_LIGHTNESS_SHIFT) - 1UL);
+    return table->luminance_q24[index] +
+           (((table->luminance_q24[index + 1U] - table->luminance_q24[index]) * frac) >> CIE_LIGHTNESS_SHIFT);
+}
@@ -0,0 +1,228 @@
+#include "support/distance_tracker.h"
+
+#include <stddef.h>
+
+/* Variances are capped so products with Q16 time terms stay inside int64. */
+#define DISTANCE_TRACKER_VAR_CAP 0x3FFFFFFFLL
+
+static int64_t cap_var(int64_t value)
+{
+    if (value > DISTANCE_TRACKER_VAR_CAP) {
+        return DISTANCE_TRACKER_VAR_CAP;
+    }
+    if (value < -DISTANCE_TRACKER_VAR_CAP) {
+        return -DISTANCE_TRACKER_VAR_CAP;
+    }
+
+    return value;
+}
+
+static uint32_t var_to_u32(int64_t value)
+{
+    return (value <= 0) ? 0U : (uint32_t)value;
+}
+
+static void start_track(distance_tracker_t *t, uint32_t now_ms, uint32_t distance_mm)
+{
+    uint32_t meas = t->cfg.meas_noise_mm;
+    uint32_t vel = t->cfg.init_velocity_mm_s;
+
+    t->pos_q8 = (int32_t)(distance_mm << 8);
+    t->vel_q8 = 0;
+    t->p00 = (int64_t)meas * meas;
+    t->p01 = 0;
+    t->p11 = (int64_t)vel * vel;
+    t->innovation_mm = 0;
+    t->innovation_var_mm2 = var_to_u32(t->p00);
+    t->last_ms = now_ms;
+    t->coast_ms = 0U;
+    t->gated_count = 0U;
+}
+
+/* x += v*T; P = F P F' + Q with piecewise-constant white acceleration. T is seconds in Q16. */
+static void predict(distance_tracker_t *t, uint32_t dt_ms)
+{
+    int64_t accel_var = (int64_t)t->cfg.accel_noise_mm_s2 * t->cfg.accel_noise_mm_s2;
+    int64_t t1 = ((int64_t)dt_ms * 67109) >> 10;    /* dt_ms * 65.536 */
+    int64_t t2 = (t1 * t1) >> 16;
+    int64_t t3 = (t2 * t1) >> 16;
+    int64_t t4 = (t3 * t1) >> 16;
+
+    t->pos_q8 += (int32_t)(((int64_t)t->vel_q8 * t1) >> 16);
+
+    t->p00 = cap_var(t->p00 + ((2 * t1 * t->p01) >> 16) + ((t2 * t->p11) >> 16) + ((t4 * accel_var) >> 18));
+    t->p01 = cap_var(t->p01 + ((t1 * t->p11) >> 16) + ((t3 * accel_var) >> 17));
+    t->p11 = cap_var(t->p11 + ((t2 * accel_var) >> 16));
+}
+
+void distance_tracker_init(distance_tracker_t *t, const distance_tracker_cfg_t *cfg)
+{
+    if ((t == NULL) || (cfg == NULL)) {
+        return;
+    }
+
+    t->cfg = *cfg;
+    if (t->cfg.meas_noise_mm == 0U) {
+        t->cfg.meas_noise_mm = 1U;
+    }
+    distance_tracker_reset(t);
+}
+
+void distance_tracker_reset(distance_tracker_t *t)
+{
+    if (t == NULL) {
+        return;
+    }
+
+    t->pos_q8 = 0;
+    t->vel_q8 = 0;
+    t->p00 = 0;
+    t->p01 = 0;
+    t->p11 = 0;
+    t->innovation_mm = 0;
+    t->innovation_var_mm2 = 0U;
+    t->last_ms = 0U;
+    t->coast_ms = 0U;
+    t->gated_count = 0U;
+    t->status = DISTANCE_TRACKER_STATUS_NOT_INIT;
+}
+
+distance_tracker_status_t distance_tracker_update(distance_tracker_t *t, uint32_t now_ms, uint32_t distance_mm, uint8_t valid)
+{
+    uint32_t dt_ms;
+    int64_t meas_var;
+    int64_t s;
+    int64_t k0_q16;
+    int64_t k1_q16;
+    int64_t p00;
+    int64_t p01;
+    int32_t innovation;
+    uint32_t gate;
+
+    if (t == NULL) {
+        return DISTANCE_TRACKER_STATUS_NOT_INIT;
+    }
+
+    if ((t->status == DISTANCE_TRACKER_STATUS_NOT_INIT) || (t->status == DISTANCE_TRACKER_STATUS_LOST)) {
+        if (valid == 0U) {
+            return t->status;
+        }
+        start_track(t, now_ms, distance_mm);
+        t->status = DISTANCE_TRACKER_STATUS_REINIT;
+        return t->status;
+    }
+
+    dt_ms = now_ms - t->last_ms;
+    t->last_ms = now_ms;
+    if ((t->coast_ms + dt_ms) > t->cfg.max_coast_ms) {
+        if (valid == 0U) {
+            t->status = DISTANCE_TRACKER_STATUS_LOST;
+            return t->status;
+        }
+        start_track(t, now_ms, distance_mm);
+        t->status = DISTANCE_TRACKER_STATUS_REINIT;
+        return t->status;
+    }
+    predict(t, dt_ms);
+
+    if (valid == 0U) {
+        t->coast_ms += dt_ms;
+        t->status = DISTANCE_TRACKER_STATUS_COASTING;
+        return t->status;
+    }
+
+    meas_var = (int64_t)t->cfg.meas_noise_mm * t->cfg.meas_noise_mm;
+    s = t->p00 + meas_var;
+    innovation = (int32_t)distance_mm - ((t->pos_q8 + 128) >> 8);
+    t->innovation_mm = innovation;
+    t->innovation_var_mm2 = var_to_u32(cap_var(s));
+
+    /* Chi-square gate on one degree of freedom: y^2 > g^2 * S. A run of gated samples means the scene
+     * really changed (the user left, a new object), so restart on the measurement. */
+    gate = t->cfg.gate_sigma;
+    if ((t->cfg.gate_sigma != 0U) &&
+        (((int64_t)innovation * innovation) > ((int64_t)gate * gate * s))) {
+        t->gated_count++;
+        if (t->gated_count > t->cfg.max_gated) {
+            start_track(t, now_ms, distance_mm);
+            t->status = DISTANCE_TRACKER_STATUS_REINIT;
+            return t->status;
+        }
+        t->coast_ms += dt_ms;
+        t->status = DISTANCE_TRACKER_STATUS_GATED;
+        return t->status;
+    }
+
+    k0_q16 = (t->p00 << 16) / s;
+    k1_q16 = (t->p01 << 16) / s;
+    t->pos_q8 += (int32_t)((k0_q16 * innovation) >> 8);
+    t->vel_q8 += (int32_t)((k1_q16 * innovation) >> 8);
+
+    p00 = t->p00;
+    p01 = t->p01;
+    t->p00 = cap_var(p00 - ((k0_q16 * p00) >> 16));
+    t->p01 = cap_var(p01 - ((k0_q16 * p01) >> 16));
+    t->p11 = cap_var(t->p11 - ((k1_q16 * p01) >> 16));
+
+    t->coast_ms = 0U;
+    t->gated_count = 0U;
+    t->status = DISTANCE_TRACKER_STATUS_TRACKING;
+    return t->status;
+}
+
+void distance_tracker_get(const distance_tracker_t *t, distance_tracker_estimate_t *out)
+{
+    if ((t == NULL) || (out == NULL)) {
+        return;
+    }
+
+    out->distance_mm = (t->pos_q8 <= 0) ? 0U : (uint32_t)((t->pos_q8 + 128) >> 8);
+    out->velocity_mm_s = (t->vel_q8 < 0) ? -(int32_t)(((uint32_t)(-t->vel_q8) + 128U) >> 8)
+                                         : (int32_t)(((uint32_t)t->vel_q8 + 128U) >> 8);
+    out->distance_var_mm2 = var_to_u32(t->p00);
+    out->velocity_var_mm2_s2 = var_to_u32(t->p11);
+    out->innovation_mm = t->innovation_mm;
+    out->innovation_var_mm2 = t->innovation_var_mm2;
+    out->status = t->status;
+}
+
+uint8_t distance_tracker_is_moving(const distance_tracker_t *t, uint32_t min_mm_s, uint8_t sigma)
+{
+    int64_t vel_q8;
+    int64_t min_q8;
+
+    if ((t == NULL) ||
+        (t->status == DISTANCE_TRACKER_STATUS_NOT_INIT) ||
+        (t->status == DISTANCE_TRACKER_STATUS_LOST)) {
+        return 0U;
+    }
+
+    vel_q8 = (t->vel_q8 < 0) ? -(int64_t)t->vel_q8 : (int64_t)t->vel_q8;
+    min_q8 = (int64_t)min_mm_s << 8;
+    if (vel_q8 < min_q8) {
+        return 0U;
+    }
+
+    /* Significance: v^2 > sigma^2 * P11, compared in Q16 (mm/s)^2. */
+    return ((vel_q8 * vel_q8) > (((int64_t)sigma * sigma * t->p11) << 16)) ? 1U : 0U;
+}
+
+const char *distance_tracker_status_to_string(distance_tracker_status_t status)
+{
+    switch (status) {
+        case DISTANCE_TRACKER_STATUS_NOT_INIT:
+            return "not_init";
+        case DISTANCE_TRACKER_STATUS_TRACKING:
+            return "tracking";
+        case DISTANCE_TRACKER_STATUS_COASTING:
+            return "coasting";
+        case DISTANCE_TRACKER_STATUS_GATED:
+            return "gated";
+        case DISTANCE_TRACKER_STATUS_REINIT:
+            return "reinit";
+        case DISTANCE_TRACKER_STATUS_LOST:
+            return "lost";
+        default:
+            return "unknown";
+    }
+}
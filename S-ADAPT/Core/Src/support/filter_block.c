@@ -0,0 +1,370 @@
+#include "support/filter_block.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#if FILTER_BLOCK_USE_SIMD
+#include "stm32l4xx_hal.h"
+#endif
+#if FILTER_BLOCK_BENCH
+#include "support/cycle_counter.h"
+#endif
+
+static int16_t round_sat_q15(int32_t acc)
+{
+    int32_t value = (acc + (1L << 14)) >> 15;
+
+    if (value > 32767) {
+        return 32767;
+    }
+    if (value < -32768) {
+        return -32768;
+    }
+
+    return (int16_t)value;
+}
+
+static int32_t fir_point_ref(const int16_t *in, const int16_t *coeffs, uint16_t taps)
+{
+    int32_t acc = 0;
+    uint16_t k;
+
+    for (k = 0U; k < taps; k++) {
+        acc += (int32_t)coeffs[k] * in[k];
+    }
+
+    return acc;
+}
+
+int32_t filter_block_sum_q15_ref(const int16_t *in, uint16_t len)
+{
+    int32_t sum = 0;
+    uint16_t i;
+
+    if (in == NULL) {
+        return 0;
+    }
+
+    for (i = 0U; i < len; i++) {
+        sum += in[i];
+    }
+
+    return sum;
+}
+
+void filter_block_fir_q15_ref(const int16_t *in, uint16_t len, const int16_t *coeffs, uint16_t taps, int16_t *out)
+{
+    uint16_t n;
+
+    if ((in == NULL) || (coeffs == NULL) || (out == NULL) || (taps == 0U)) {
+        return;
+    }
+
+    for (n = 0U; n < len; n++) {
+        out[n] = round_sat_q15(fir_point_ref(&in[n], coeffs, taps));
+    }
+}
+
+void filter_block_fir_decimate_q15_ref(const int16_t *in,
+                                       uint16_t out_len,
+                                       uint8_t factor,
+                                       const int16_t *coeffs,
+                                       uint16_t taps,
+                                       int16_t *out)
+{
+    uint16_t m;
+
+    if ((in == NULL) || (coeffs == NULL) || (out == NULL) || (taps == 0U) || (factor == 0U)) {
+        return;
+    }
+
+    for (m = 0U; m < out_len; m++) {
+        out[m] = round_sat_q15(fir_point_ref(&in[(uint32_t)m * factor], coeffs, taps));
+    }
+}
+
+void filter_block_moving_sum_q15_ref(const int16_t *in, uint16_t len, uint16_t window, int32_t *out)
+{
+    int32_t sum;
+    uint16_t n;
+
+    if ((in == NULL) || (out == NULL) || (window == 0U) || (len == 0U)) {
+        return;
+    }
+
+    sum = filter_block_sum_q15_ref(in, window);
+    out[0] = sum;
+    for (n = 1U; n < len; n++) {
+        sum += (int32_t)in[n + window - 1U] - in[n - 1U];
+        out[n] = sum;
+    }
+}
+
+#if FILTER_BLOCK_USE_SIMD
+
+/* Two Q15 samples as one word; memcpy lets the compiler emit a single (unaligned-capable) LDR. */
+static uint32_t load_q15x2(const int16_t *p)
+{
+    uint32_t word;
+
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+/* Pairs of taps through SMLAD: acc += a.lo * b.lo + a.hi * b.hi, one cycle per two MACs. */
+static int32_t fir_point_simd(const int16_t *in, const int16_t *coeffs, uint16_t taps)
+{
+    uint32_t acc = 0U;
+    uint16_t k = 0U;
+
+    for (; (uint16_t)(k + 1U) < taps; k = (uint16_t)(k + 2U)) {
+        acc = __SMLAD(load_q15x2(&in[k]), load_q15x2(&coeffs[k]), acc);
+    }
+    if (k < taps) {
+        acc += (uint32_t)((int32_t)coeffs[k] * in[k]);
+    }
+
+    return (int32_t)acc;
+}
+
+int32_t filter_block_sum_q15(const int16_t *in, uint16_t len)
+{
+    uint32_t acc = 0U;
+    uint16_t i = 0U;
+
+    if (in == NULL) {
+        return 0;
+    }
+
+    /* Multiply-by-one MAC: both halfwords added into the 32-bit accumulator per instruction. */
+    for (; (uint16_t)(i + 1U) < len; i = (uint16_t)(i + 2U)) {
+        acc = __SMLAD(load_q15x2(&in[i]), 0x00010001UL, acc);
+    }
+    if (i < len) {
+        acc += (uint32_t)(int32_t)in[i];
+    }
+
+    return (int32_t)acc;
+}
+
+void filter_block_fir_q15(const int16_t *in, uint16_t len, const int16_t *coeffs, uint16_t taps, int16_t *out)
+{
+    uint16_t n;
+
+    if ((in == NULL) || (coeffs == NULL) || (out == NULL) || (taps == 0U)) {
+        return;
+    }
+
+    for (n = 0U; n < len; n++) {
+        out[n] = (int16_t)__SSAT((fir_point_simd(&in[n], coeffs, taps) + (1L << 14)) >> 15, 16);
+    }
+}
+
+void filter_block_fir_decimate_q15(const int16_t *in,
+                                   uint16_t out_len,
+                                   uint8_t factor,
+                                   const int16_t *coeffs,
+                                   uint16_t taps,
+                                   int16_t *out)
+{
+    uint16_t m;
+
+    if ((in == NULL) || (coeffs == NULL) || (out == NULL) || (taps == 0U) || (factor == 0U)) {
+        return;
+    }
+
+    /* Only the kept outputs are computed; decimation costs taps MACs per output, not per input. */
+    for (m = 0U; m < out_len; m++) {
+        out[m] = (int16_t)__SSAT((fir_point_simd(&in[(uint32_t)m * factor], coeffs, taps) + (1L << 14)) >> 15, 16);
+    }
+}
+
+void filter_block_moving_sum_q15(const int16_t *in, uint16_t len, uint16_t window, int32_t *out)
+{
+    int32_t sum;
+    uint16_t n = 1U;
+
+    if ((in == NULL) || (out == NULL) || (window == 0U) || (len == 0U)) {
+        return;
+    }
+
+    sum = filter_block_sum_q15(in, window);
+    out[0] = sum;
+
+    /* Entering minus leaving sample for two outputs per SSUB16; the range contract keeps each difference
+     * inside 16 bits. */
+    for (; (uint16_t)(n + 1U) < len; n = (uint16_t)(n + 2U)) {
+        uint32_t diff = __SSUB16(load_q15x2(&in[n + window - 1U]), load_q15x2(&in[n - 1U]));
+
+        sum += (int16_t)(diff & 0xFFFFU);
+        out[n] = sum;
+        sum += (int16_t)(diff >> 16);
+        out[n + 1U] = sum;
+    }
+    if (n < len) {
+        sum += (int32_t)in[n + window - 1U] - in[n - 1U];
+        out[n] = sum;
+    }
+}
+
+#else
+
+int32_t filter_block_sum_q15(const int16_t *in, uint16_t len)
+{
+    return filter_block_sum_q15_ref(in, len);
+}
+
+void filter_block_fir_q15(const int16_t *in, uint16_t len, const int16_t *coeffs, uint16_t taps, int16_t *out)
+{
+    filter_block_fir_q15_ref(in, len, coeffs, taps, out);
+}
+
+void filter_block_fir_decimate_q15(const int16_t *in,
+                                   uint16_t out_len,
+                                   uint8_t factor,
+                                   const int16_t *coeffs,
+                                   uint16_t taps,
+                                   int16_t *out)
+{
+    filter_block_fir_decimate_q15_ref(in, out_len, factor, coeffs, taps, out);
+}
+
+void filter_block_moving_sum_q15(const int16_t *in, uint16_t len, uint16_t window, int32_t *out)
+{
+    filter_block_moving_sum_q15_ref(in, len, window, out);
+}
+
+#endif /* FILTER_BLOCK_USE_SIMD */
+
+#if FILTER_BLOCK_BENCH
+
+#define FILTER_BLOCK_BENCH_RUNS     3U
+#define FILTER_BLOCK_BENCH_DECIMATE 4U
+
+static int16_t s_bench_in[FILTER_BLOCK_BENCH_LEN + FILTER_BLOCK_BENCH_TAPS];
+static int16_t s_bench_out_simd[FILTER_BLOCK_BENCH_LEN];
+static int16_t s_bench_out_ref[FILTER_BLOCK_BENCH_LEN];
+static int32_t s_bench_sum_simd[FILTER_BLOCK_BENCH_LEN];
+static int32_t s_bench_sum_ref[FILTER_BLOCK_BENCH_LEN];
+static int16_t s_bench_coeffs[FILTER_BLOCK_BENCH_TAPS];
+
+static uint32_t bench_min(uint32_t current, uint32_t start)
+{
+    uint32_t cycles = cycle_counter_now() - start;
+
+    return (cycles < current) ? cycles : current;
+}
+
+static void bench_kernel(filter_block_bench_kernel_t kernel, uint8_t use_ref, uint32_t *out_cycles)
+{
+    const uint16_t dec_len = FILTER_BLOCK_BENCH_LEN / FILTER_BLOCK_BENCH_DECIMATE;
+    volatile int32_t sink = 0;
+    uint32_t best = 0xFFFFFFFFUL;
+    uint8_t run;
+
+    for (run = 0U; run < FILTER_BLOCK_BENCH_RUNS; run++) {
+        uint32_t start = cycle_counter_now();
+
+        switch (kernel) {
+            case FILTER_BLOCK_BENCH_SUM:
+                sink = (use_ref != 0U) ? filter_block_sum_q15_ref(s_bench_in, FILTER_BLOCK_BENCH_LEN)
+                                       : filter_block_sum_q15(s_bench_in, FILTER_BLOCK_BENCH_LEN);
+                break;
+            case FILTER_BLOCK_BENCH_FIR:
+                if (use_ref != 0U) {
+                    filter_block_fir_q15_ref(s_bench_in, FILTER_BLOCK_BENCH_LEN, s_bench_coeffs,
+                                             FILTER_BLOCK_BENCH_TAPS, s_bench_out_ref);
+                } else {
+                    filter_block_fir_q15(s_bench_in, FILTER_BLOCK_BENCH_LEN, s_bench_coeffs,
+                                         FILTER_BLOCK_BENCH_TAPS, s_bench_out_simd);
+                }
+                break;
+            case FILTER_BLOCK_BENCH_FIR_DECIMATE4:
+                if (use_ref != 0U) {
+                    filter_block_fir_decimate_q15_ref(s_bench_in, dec_len, FILTER_BLOCK_BENCH_DECIMATE, s_bench_coeffs,
+                                                      FILTER_BLOCK_BENCH_TAPS, s_bench_out_ref);
+                } else {
+                    filter_block_fir_decimate_q15(s_bench_in, dec_len, FILTER_BLOCK_BENCH_DECIMATE, s_bench_coeffs,
+                                                  FILTER_BLOCK_BENCH_TAPS, s_bench_out_simd);
+                }
+                break;
+            case FILTER_BLOCK_BENCH_MOVING_SUM:
+            default:
+                if (use_ref != 0U) {
+                    filter_block_moving_sum_q15_ref(s_bench_in, FILTER_BLOCK_BENCH_LEN, FILTER_BLOCK_BENCH_TAPS,
+                                                    s_bench_sum_ref);
+                } else {
+                    filter_block_moving_sum_q15(s_bench_in, FILTER_BLOCK_BENCH_LEN, FILTER_BLOCK_BENCH_TAPS,
+                                                s_bench_sum_simd);
+                }
+                break;
+        }
+        best = bench_min(best, start);
+    }
+
+    (void)sink;
+    *out_cycles = best;
+}
+
+void filter_block_bench_run(filter_block_bench_result_t *out)
+{
+    uint32_t seed = 0x12345678UL;
+    uint16_t i;
+    uint8_t kernel;
+
+    if (out == NULL) {
+        return;
+    }
+
+    /* 12-bit ADC-like noise around mid-scale and a 16-tap boxcar (sum of coefficients = 1.0 in Q15). */
+    for (i = 0U; i < (FILTER_BLOCK_BENCH_LEN + FILTER_BLOCK_BENCH_TAPS); i++) {
+        seed = (seed * 1664525UL) + 1013904223UL;
+        s_bench_in[i] = (int16_t)(2048 + (int16_t)((seed >> 20) & 0x1FFU) - 256);
+    }
+    for (i = 0U; i < FILTER_BLOCK_BENCH_TAPS; i++) {
+        s_bench_coeffs[i] = (int16_t)(32768U / FILTER_BLOCK_BENCH_TAPS);
+    }
+
+    cycle_counter_init();
+    for (kernel = 0U; kernel < FILTER_BLOCK_BENCH_COUNT; kernel++) {
+        bench_kernel((filter_block_bench_kernel_t)kernel, 0U, &out->simd_cycles[kernel]);
+        bench_kernel((filter_block_bench_kernel_t)kernel, 1U, &out->ref_cycles[kernel]);
+    }
+
+    out->bit_exact[FILTER_BLOCK_BENCH_SUM] =
+        (filter_block_sum_q15(s_bench_in, FILTER_BLOCK_BENCH_LEN) ==
+         filter_block_sum_q15_ref(s_bench_in, FILTER_BLOCK_BENCH_LEN)) ? 1U : 0U;
+    filter_block_fir_q15(s_bench_in, FILTER_BLOCK_BENCH_LEN, s_bench_coeffs, FILTER_BLOCK_BENCH_TAPS, s_bench_out_simd);
+    filter_block_fir_q15_ref(s_bench_in, FILTER_BLOCK_BENCH_LEN, s_bench_coeffs, FILTER_BLOCK_BENCH_TAPS, s_bench_out_ref);
+    out->bit_exact[FILTER_BLOCK_BENCH_FIR] =
+        (memcmp(s_bench_out_simd, s_bench_out_ref, sizeof(s_bench_out_ref)) == 0) ? 1U : 0U;
+    filter_block_fir_decimate_q15(s_bench_in, FILTER_BLOCK_BENCH_LEN / FILTER_BLOCK_BENCH_DECIMATE,
+                                  FILTER_BLOCK_BENCH_DECIMATE, s_bench_coeffs, FILTER_BLOCK_BENCH_TAPS, s_bench_out_simd);
+    filter_block_fir_decimate_q15_ref(s_bench_in, FILTER_BLOCK_BENCH_LEN / FILTER_BLOCK_BENCH_DECIMATE,
+                                      FILTER_BLOCK_BENCH_DECIMATE, s_bench_coeffs, FILTER_BLOCK_BENCH_TAPS, s_bench_out_ref);
+    out->bit_exact[FILTER_BLOCK_BENCH_FIR_DECIMATE4] =
+        (memcmp(s_bench_out_simd, s_bench_out_ref,
+                (FILTER_BLOCK_BENCH_LEN / FILTER_BLOCK_BENCH_DECIMATE) * sizeof(int16_t)) == 0) ? 1U : 0U;
+    filter_block_moving_sum_q15(s_bench_in, FILTER_BLOCK_BENCH_LEN, FILTER_BLOCK_BENCH_TAPS, s_bench_sum_simd);
+    filter_block_moving_sum_q15_ref(s_bench_in, FILTER_BLOCK_BENCH_LEN, FILTER_BLOCK_BENCH_TAPS, s_bench_sum_ref);
+    out->bit_exact[FILTER_BLOCK_BENCH_MOVING_SUM] =
+        (memcmp(s_bench_sum_simd, s_bench_sum_ref, sizeof(s_bench_sum_ref)) == 0) ? 1U : 0U;
+}
+
+const char *filter_block_bench_kernel_to_string(filter_block_bench_kernel_t kernel)
+{
+    switch (kernel) {
+        case FILTER_BLOCK_BENCH_SUM:
+            return "sum";
+        case FILTER_BLOCK_BENCH_FIR:
+            return "fir16";
+        case FILTER_BLOCK_BENCH_FIR_DECIMATE4:
+            return "fir16_dec4";
+        case FILTER_BLOCK_BENCH_MOVING_SUM:
+            return "moving_sum16";
+        default:
+            return "unknown";
+    }
+}
+
+#endif /* FILTER_BLOCK_BENCH */
@@ -1,25 +1,5 @@
 #include "support/filter_utils.h"
 
-static uint32_t median3_u32(uint32_t a, uint32_t b, uint32_t c)
-{
-    if (a > b) {
-        uint32_t t = a;
-        a = b;
-        b = t;
-    }
-    if (b > c) {
-        uint32_t t = b;
-        b = c;
-        c = t;
-    }
-    if (a > b) {
-        uint32_t t = a;
-        a = b;
-        b = t;
-    }
-    return b;
-}
-
 void filter_moving_average_u16_init(filter_moving_average_u16_t *f, uint8_t window_size)
 {
     uint8_t i;
@@ -79,54 +59,287 @@ uint8_t filter_moving_average_u16_is_ready(const filter_moving_average_u16_t *f)
     return (f->count >= f->window_size) ? 1U : 0U;
 }
 
-void filter_median3_u32_init(filter_median3_u32_t *f)
+/* Arithmetic right shift that rounds toward zero for both signs, so EMA state converges from below and above alike. */
+static int32_t shift_toward_zero_i32(int32_t value, uint8_t shift)
+{
+    if (value < 0) {
+        return -(int32_t)((uint32_t)(-value) >> shift);
+    }
+
+    return (int32_t)((uint32_t)value >> shift);
+}
+
+static uint16_t q8_to_u16(int32_t value_q8)
+{
+    if (value_q8 <= 0) {
+        return 0U;
+    }
+    if (value_q8 >= (int32_t)(0xFFFFUL << 8)) {
+        return 0xFFFFU;
+    }
+
+    return (uint16_t)(((uint32_t)value_q8 + 128U) >> 8);
+}
+
+void filter_ema_u16_init(filter_ema_u16_t *f, uint8_t shift)
+{
+    if (f == NULL) {
+        return;
+    }
+
+    if (shift > FILTER_EMA_MAX_SHIFT) {
+        shift = FILTER_EMA_MAX_SHIFT;
+    }
+
+    f->acc_q8 = 0;
+    f->shift = shift;
+    f->initialized = 0U;
+}
+
+uint16_t filter_ema_u16_push(filter_ema_u16_t *f, uint16_t sample)
 {
+    int32_t sample_q8 = (int32_t)((uint32_t)sample << 8);
+
     if (f == NULL) {
+        return sample;
+    }
+
+    if (f->initialized == 0U) {
+        f->acc_q8 = sample_q8;
+        f->initialized = 1U;
+        return sample;
+    }
+
+    f->acc_q8 += shift_toward_zero_i32(sample_q8 - f->acc_q8, f->shift);
+    return q8_to_u16(f->acc_q8);
+}
+
+uint16_t filter_ema_u16_get(const filter_ema_u16_t *f)
+{
+    if ((f == NULL) || (f->initialized == 0U)) {
+        return 0U;
+    }
+
+    return q8_to_u16(f->acc_q8);
+}
+
+void filter_one_euro_u16_init(filter_one_euro_u16_t *f, const filter_one_euro_cfg_t *cfg)
+{
+    if ((f == NULL) || (cfg == NULL)) {
         return;
     }
 
-    f->samples[0] = 0U;
-    f->samples[1] = 0U;
-    f->samples[2] = 0U;
+    f->cfg = *cfg;
+    if (f->cfg.derivative_shift > FILTER_EMA_MAX_SHIFT) {
+        f->cfg.derivative_shift = FILTER_EMA_MAX_SHIFT;
+    }
+    f->value_q8 = 0;
+    f->speed_q8 = 0;
+    f->last_sample = 0U;
+    f->alpha_q16 = cfg->min_alpha_q16;
+    f->initialized = 0U;
+}
+
+uint16_t filter_one_euro_u16_push(filter_one_euro_u16_t *f, uint16_t sample)
+{
+    int32_t sample_q8 = (int32_t)((uint32_t)sample << 8);
+    int32_t delta_q8;
+    uint32_t abs_speed_q8;
+    uint64_t alpha_q16;
+
+    if (f == NULL) {
+        return sample;
+    }
+
+    if (f->initialized == 0U) {
+        f->value_q8 = sample_q8;
+        f->speed_q8 = 0;
+        f->last_sample = sample;
+        f->alpha_q16 = f->cfg.min_alpha_q16;
+        f->initialized = 1U;
+        return sample;
+    }
+
+    /* Rate of change of the raw input, smoothed so single noisy samples do not open the filter. */
+    delta_q8 = sample_q8 - (int32_t)((uint32_t)f->last_sample << 8);
+    f->last_sample = sample;
+    f->speed_q8 += shift_toward_zero_i32(delta_q8 - f->speed_q8, f->cfg.derivative_shift);
+
+    abs_speed_q8 = (f->speed_q8 < 0) ? (uint32_t)(-f->speed_q8) : (uint32_t)f->speed_q8;
+    alpha_q16 = (uint64_t)f->cfg.min_alpha_q16 + (((uint64_t)f->cfg.beta_q16 * abs_speed_q8) >> 8);
+    if (alpha_q16 > 65536U) {
+        alpha_q16 = 65536U;
+    }
+    f->alpha_q16 = (alpha_q16 >= 65535U) ? 65535U : (uint16_t)alpha_q16;
+
+    f->value_q8 += (int32_t)(((int64_t)(sample_q8 - f->value_q8) * (int64_t)alpha_q16) >> 16);
+    return q8_to_u16(f->value_q8);
+}
+
+uint16_t filter_one_euro_u16_get(const filter_one_euro_u16_t *f)
+{
+    if ((f == NULL) || (f->initialized == 0U)) {
+        return 0U;
+    }
+
+    return q8_to_u16(f->value_q8);
+}
+
+/* First sorted slot holding a value >= value (the sorted prefix is count long). */
+static uint8_t median_lower_bound(const filter_median_u32_t *f, uint32_t value)
+{
+    uint8_t lo = 0U;
+    uint8_t hi = f->count;
+
+    while (lo < hi) {
+        uint8_t mid = (uint8_t)((lo + hi) / 2U);
+
+        if (f->sorted[mid] < value) {
+            lo = (uint8_t)(mid + 1U);
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+void filter_median_u32_init(filter_median_u32_t *f, uint8_t window_size, filter_median_warmup_t warmup)
+{
+    uint8_t i;
+
+    if (f == NULL) {
+        return;
+    }
+
+    if ((window_size == 0U) || (window_size > FILTER_MEDIAN_MAX_WINDOW)) {
+        window_size = 1U;
+    }
+
+    f->window_size = window_size;
     f->count = 0U;
     f->index = 0U;
+    f->warmup = warmup;
+
+    for (i = 0U; i < FILTER_MEDIAN_MAX_WINDOW; i++) {
+        f->ring[i] = 0U;
+        f->sorted[i] = 0U;
+    }
 }
 
-void filter_median3_u32_push(filter_median3_u32_t *f, uint32_t sample)
+uint32_t filter_median_u32_push(filter_median_u32_t *f, uint32_t sample)
 {
+    uint8_t pos;
+
     if (f == NULL) {
-        return;
+        return sample;
+    }
+
+    if ((f->count == 0U) && (f->warmup == FILTER_MEDIAN_WARMUP_PREFILL)) {
+        for (pos = 0U; pos < f->window_size; pos++) {
+            f->ring[pos] = sample;
+            f->sorted[pos] = sample;
+        }
+        f->count = f->window_size;
+        f->index = (f->window_size > 1U) ? 1U : 0U;
+        return sample;
     }
 
-    f->samples[f->index] = sample;
-    f->index = (uint8_t)((f->index + 1U) % 3U);
-    if (f->count < 3U) {
+    if (f->count < f->window_size) {
+        /* Filling: shift the larger values up one slot and drop the sample into the gap. */
+        pos = f->count;
+        while ((pos > 0U) && (f->sorted[pos - 1U] > sample)) {
+            f->sorted[pos] = f->sorted[pos - 1U];
+            pos--;
+        }
         f->count++;
+    } else {
+        /* Full: the evicted sample's slot slides toward the new sample's rank. */
+        pos = median_lower_bound(f, f->ring[f->index]);
+        if (sample > f->sorted[pos]) {
+            while (((uint8_t)(pos + 1U) < f->count) && (f->sorted[pos + 1U] < sample)) {
+                f->sorted[pos] = f->sorted[pos + 1U];
+                pos++;
+            }
+        } else {
+            while ((pos > 0U) && (f->sorted[pos - 1U] > sample)) {
+                f->sorted[pos] = f->sorted[pos - 1U];
+                pos--;
+            }
+        }
+    }
+
+    f->sorted[pos] = sample;
+    f->ring[f->index] = sample;
+    f->index++;
+    if (f->index >= f->window_size) {
+        f->index = 0U;
     }
+
+    return filter_median_u32_get(f);
 }
 
-uint32_t filter_median3_u32_get(const filter_median3_u32_t *f)
+uint32_t filter_median_u32_get(const filter_median_u32_t *f)
 {
-    if (f == NULL || f->count == 0U) {
+    uint8_t half;
+
+    if ((f == NULL) || (f->count == 0U)) {
         return 0U;
     }
 
-    if (f->count == 1U) {
-        return f->samples[0];
+    if ((f->warmup == FILTER_MEDIAN_WARMUP_PASSTHROUGH) && (f->count < f->window_size)) {
+        return f->ring[f->count - 1U];
+    }
+
+    half = (uint8_t)(f->count / 2U);
+    if ((f->count & 1U) != 0U) {
+        return f->sorted[half];
+    }
+
+    return f->sorted[half - 1U] + ((f->sorted[half] - f->sorted[half - 1U]) / 2U);
+}
+
+uint8_t filter_median_u32_is_ready(const filter_median_u32_t *f)
+{
+    if (f == NULL) {
+        return 0U;
     }
 
-    if (f->count == 2U) {
-        return (f->samples[0] + f->samples[1]) / 2U;
+    return (f->count >= f->window_size) ? 1U : 0U;
+}
+
+void filter_median_u16_init(filter_median_u16_t *f, uint8_t window_size, filter_median_warmup_t warmup)
+{
+    if (f == NULL) {
+        return;
+    }
+
+    filter_median_u32_init(&f->core, window_size, warmup);
+}
+
+uint16_t filter_median_u16_push(filter_median_u16_t *f, uint16_t sample)
+{
+    if (f == NULL) {
+        return sample;
+    }
+
+    return (uint16_t)filter_median_u32_push(&f->core, sample);
+}
+
+uint16_t filter_median_u16_get(const filter_median_u16_t *f)
+{
+    if (f == NULL) {
+        return 0U;
     }
 
-    return median3_u32(f->samples[0], f->samples[1], f->samples[2]);
+    return (uint16_t)filter_median_u32_get(&f->core);
 }
 
-uint8_t filter_median3_u32_is_ready(const filter_median3_u32_t *f)
+uint8_t filter_median_u16_is_ready(const filter_median_u16_t *f)
 {
     if (f == NULL) {
         return 0U;
     }
 
-    return (f->count >= 3U) ? 1U : 0U;
+    return filter_median_u32_is_ready(&f->core);
 }
@@ -0,0 +1,94 @@
+#include "support/lux_curve.h"
+
+#include <stddef.h>
+
+/* Rounded linear interpolation of y over ascending x breakpoints, clamped to the end values. */
+static uint32_t interp_points_u16(uint32_t x, const uint16_t *xs, const uint16_t *ys, uint8_t count)
+{
+    uint8_t i;
+
+    if (x <= xs[0]) {
+        return ys[0];
+    }
+    if (x >= xs[count - 1U]) {
+        return ys[count - 1U];
+    }
+
+    for (i = 1U; i < count; i++) {
+        if (x <= xs[i]) {
+            uint32_t span = (uint32_t)xs[i] - xs[i - 1U];
+            uint32_t offset = x - xs[i - 1U];
+
+            if (ys[i] >= ys[i - 1U]) {
+                return ys[i - 1U] + ((((uint32_t)ys[i] - ys[i - 1U]) * offset) + (span / 2U)) / span;
+            }
+            return ys[i - 1U] - ((((uint32_t)ys[i - 1U] - ys[i]) * offset) + (span / 2U)) / span;
+        }
+    }
+
+    return ys[count - 1U];
+}
+
+void lux_curve_build(lux_curve_t *curve, const app_ldr_cal_t *cal)
+{
+    uint16_t percent_q8[APP_LUX_TRANSFER_POINTS];
+    uint32_t k;
+
+    if ((curve == NULL) || (cal == NULL)) {
+        return;
+    }
+
+    for (k = 0U; k < LUX_CURVE_RAW_ENTRIES; k++) {
+        uint32_t raw = k << LUX_CURVE_RAW_SHIFT;
+
+        if (raw > 4095U) {
+            raw = 4095U;
+        }
+        curve->log_lux_mdec[k] = (uint16_t)interp_points_u16(raw, cal->raw, cal->log_lux_mdec, APP_LDR_CAL_POINTS);
+    }
+
+    for (k = 0U; k < APP_LUX_TRANSFER_POINTS; k++) {
+        percent_q8[k] = (uint16_t)((uint32_t)cal->transfer_percent[k] << 8);
+    }
+    for (k = 0U; k < LUX_CURVE_LOG_ENTRIES; k++) {
+        curve->percent_q8[k] = (uint16_t)interp_points_u16(k << LUX_CURVE_LOG_SHIFT,
+                                                           cal->transfer_log_lux_mdec,
+                                                           percent_q8,
+                                                           APP_LUX_TRANSFER_POINTS);
+    }
+}
+
+uint16_t lux_curve_raw_to_log_lux(const lux_curve_t *curve, uint16_t raw)
+{
+    uint32_t index;
+    uint32_t frac;
+
+    if (raw > 4095U) {
+        raw = 4095U;
+    }
+
+    index = (uint32_t)raw >> LUX_CURVE_RAW_SHIFT;
+    frac = (uint32_t)raw & ((1UL << LUX_CURVE_RAW_SHIFT) - 1UL);
+    return (uint16_t)((((uint32_t)curve->log_lux_mdec[index] * ((1UL << LUX_CURVE_RAW_SHIFT) - frac)) +
+                       ((uint32_t)curve->log_lux_mdec[index + 1U] * frac)) >> LUX_CURVE_RAW_SHIFT);
+}
+
+uint16_t lux_curve_log_lux_to_percent_q8(const lux_curve_t *curve, uint16_t log_lux_mdec)
+{
+    uint32_t index;
+    uint32_t frac;
+
+    if (log_lux_mdec > APP_LDR_LOG_LUX_MAX_MDEC) {
+        log_lux_mdec = APP_LDR_LOG_LUX_MAX_MDEC;
+    }
+
+    index = (uint32_t)log_lux_mdec >> LUX_CURVE_LOG_SHIFT;
+    frac = (uint32_t)log_lux_mdec & ((1UL << LUX_CURVE_LOG_SHIFT) - 1UL);
+    return (uint16_t)((((uint32_t)curve->percent_q8[index] * ((1UL << LUX_CURVE_LOG_SHIFT) - frac)) +
+                       ((uint32_t)curve->percent_q8[index + 1U] * frac)) >> LUX_CURVE_LOG_SHIFT);
+}
+
+uint8_t lux_curve_log_lux_to_percent(const lux_curve_t *curve, uint16_t log_lux_mdec)
+{
+    return (uint8_t)(((uint32_t)lux_curve_log_lux_to_percent_q8(curve, log_lux_mdec) + 128U) >> 8);
+}
@@ -2,6 +2,8 @@
 
 #include "stm32l4xx_hal.h"
 
+#include "support/cie_lightness.h"
+
 #include <stddef.h>
 #include <string.h>
 
@@ -12,7 +14,13 @@
 #define SETTINGS_FLASH_PAGE_INDEX  ((SETTINGS_FLASH_BASE_ADDR - FLASH_BASE) / FLASH_PAGE_SIZE)
 
 #define SETTINGS_RECORD_MAGIC      0x53414450UL
-#define SETTINGS_RECORD_VERSION    1U
+#define SETTINGS_RECORD_VERSION    4U
+
+/* Record = 12-byte header, payload, padding to a word, crc32 + reserved word, padding to a doubleword.
+ * The crc covers everything before the crc word. */
+#define SETTINGS_RECORD_HEADER_SIZE        12U
+#define SETTINGS_RECORD_CRC_OFFSET(len)    ((SETTINGS_RECORD_HEADER_SIZE + (uint32_t)(len) + 3U) & ~3UL)
+#define SETTINGS_RECORD_SIZE(len)          ((SETTINGS_RECORD_CRC_OFFSET(len) + 8U + 7U) & ~7UL)
 
 typedef struct
 {
@@ -25,6 +33,22 @@ typedef struct
     uint32_t reserved;
 } settings_record_t;
 
+/* Older record versions, newest first. Fields are only ever appended to app_settings_t, so an old payload is
+ * a byte prefix of the current one; the missing tail keeps its defaults. Before version 4 output percentages
+ * were PWM duty; they are now perceived lightness. */
+typedef struct
+{
+    uint16_t version;
+    uint16_t payload_len;
+    uint8_t output_as_duty;
+} settings_legacy_layout_t;
+
+static const settings_legacy_layout_t s_legacy_layouts[] = {
+    {3U, (uint16_t)sizeof(app_settings_t), 1U},                 /* before perceptual (CIE lightness) output */
+    {2U, (uint16_t)offsetof(app_settings_t, lamp_comp), 1U},    /* before the lamp self-illumination model */
+    {1U, (uint16_t)offsetof(app_settings_t, ldr_cal), 0U},      /* before the LDR calibration */
+};
+
 typedef struct
 {
     uint8_t has_valid;
@@ -35,6 +59,10 @@ typedef struct
 } settings_scan_result_t;
 
 _Static_assert((sizeof(settings_record_t) % 8U) == 0U, "settings_record_t must align to doubleword");
+_Static_assert(sizeof(settings_record_t) == SETTINGS_RECORD_SIZE(sizeof(app_settings_t)),
+               "settings_record_t must match the generic record layout");
+_Static_assert(offsetof(settings_record_t, crc32) == SETTINGS_RECORD_CRC_OFFSET(sizeof(app_settings_t)),
+               "settings_record_t crc offset must match the generic record layout");
 
 static uint8_t settings_is_in_range(const app_settings_t *cfg)
 {
@@ -65,6 +93,12 @@ static uint8_t settings_is_in_range(const app_settings_t *cfg)
         (((cfg->return_band_cm - APP_SETTINGS_RETURN_BAND_CM_MIN) % APP_SETTINGS_RETURN_BAND_CM_STEP) != 0U)) {
         return 0U;
     }
+    if (app_settings_ldr_cal_is_valid(&cfg->ldr_cal) == 0U) {
+        return 0U;
+    }
+    if (app_settings_lamp_comp_is_valid(&cfg->lamp_comp) == 0U) {
+        return 0U;
+    }
 
     return 1U;
 }
@@ -128,6 +162,65 @@ static uint8_t settings_record_is_valid(const settings_record_t *record)
     return 1U;
 }
 
+/* Newest valid record of one legacy layout, scanned at that layout's own stride. Records of other versions
+ * never match at those slots because of the version check. */
+static uint8_t settings_load_legacy(const settings_legacy_layout_t *layout, app_settings_t *out_cfg)
+{
+    uint32_t record_size = SETTINGS_RECORD_SIZE(layout->payload_len);
+    uint32_t crc_offset = SETTINGS_RECORD_CRC_OFFSET(layout->payload_len);
+    uint32_t address;
+    uint32_t latest_addr = 0U;
+    uint32_t max_seq = 0U;
+    uint8_t found = 0U;
+
+    for (address = SETTINGS_FLASH_BASE_ADDR;
+         (address + record_size) <= SETTINGS_FLASH_END_ADDR;
+         address += record_size) {
+        const uint8_t *record = (const uint8_t *)(uintptr_t)address;
+        uint32_t magic;
+        uint16_t version;
+        uint16_t payload_len;
+        uint32_t seq;
+        uint32_t crc32;
+
+        memcpy(&magic, record + offsetof(settings_record_t, magic), sizeof(magic));
+        memcpy(&version, record + offsetof(settings_record_t, version), sizeof(version));
+        memcpy(&payload_len, record + offsetof(settings_record_t, payload_len), sizeof(payload_len));
+        memcpy(&seq, record + offsetof(settings_record_t, seq), sizeof(seq));
+        memcpy(&crc32, record + crc_offset, sizeof(crc32));
+        if ((magic != SETTINGS_RECORD_MAGIC) || (version != layout->version) ||
+            (payload_len != layout->payload_len) || (settings_crc32_compute(record, crc_offset) != crc32)) {
+            continue;
+        }
+        if ((found == 0U) || (seq > max_seq)) {
+            found = 1U;
+            max_seq = seq;
+            latest_addr = address;
+        }
+    }
+
+    if (found == 0U) {
+        return 0U;
+    }
+
+    app_settings_set_defaults(out_cfg);
+    memcpy(out_cfg, (const void *)(uintptr_t)(latest_addr + SETTINGS_RECORD_HEADER_SIZE), layout->payload_len);
+    return 1U;
+}
+
+/* Keeps the lamp's light output at each transfer anchor by converting duty to lightness. The lamp model
+ * was swept at duty steps and cannot be re-indexed from six points, so it is dropped until the next
+ * Lamp Cal. */
+static void settings_migrate_duty_output(app_settings_t *cfg)
+{
+    uint8_t i;
+
+    for (i = 0U; i < APP_LUX_TRANSFER_POINTS; i++) {
+        cfg->ldr_cal.transfer_percent[i] = cie_lightness_percent_from_luminance(cfg->ldr_cal.transfer_percent[i]);
+    }
+    memset(&cfg->lamp_comp, 0, sizeof(cfg->lamp_comp));
+}
+
 static void settings_scan_records(settings_scan_result_t *out_scan)
 {
     uint32_t address;
@@ -216,6 +309,20 @@ settings_store_status_t settings_store_load(app_settings_t *out_cfg, uint8_t *us
     }
 
     settings_scan_records(&scan);
+    if (scan.has_valid == 0U) {
+        size_t i;
+
+        for (i = 0U; i < (sizeof(s_legacy_layouts) / sizeof(s_legacy_layouts[0])); i++) {
+            if (settings_load_legacy(&s_legacy_layouts[i], out_cfg) != 0U) {
+                /* Migrated in RAM; the next save appends a current-version record. */
+                if (s_legacy_layouts[i].output_as_duty != 0U) {
+                    settings_migrate_duty_output(out_cfg);
+                }
+                (void)app_settings_validate(out_cfg);
+                return SETTINGS_STORE_OK;
+            }
+        }
+    }
     if (scan.has_valid == 0U) {
         app_settings_set_defaults(out_cfg);
         if (used_defaults != NULL) {
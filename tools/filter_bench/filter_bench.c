@@ -0,0 +1,603 @@
+/* Host benchmark and accuracy suite for the firmware filters (support/filter_utils.c, support/filter_block.c).
+ *
+ * Every filter runs over the same synthetic traces (step, ramp, spike train, 100 Hz ripple) and any recorded
+ * traces given on the command line. Results are printed as JSON:
+ * - ns_per_sample: host push cost, best of several passes (compare filters relative to each other; absolute
+ *   numbers are not Cortex-M4 cycles).
+ * - rms_error: output against the noise-free trace (recorded traces: against their reference column, if any),
+ *   after the first warmup samples.
+ * - group_delay_samples: mean lag behind the ramp while it is rising (ramp trace only).
+ * - settling_samples: samples after the step until the output stays within 2 % of the step height of the
+ *   new level (step trace only).
+ * The block kernels report bit-exactness of the SIMD path (emulated intrinsics) against _ref, and _ref cost.
+ *
+ * Usage:
+ *     make && ./filter_bench [--rate HZ] [--samples N] [--seed N] [--trace name=file.csv ...] [--out file.json]
+ *
+ * Recorded traces are CSV, one "sample[,reference]" per line (ADC counts), '#' lines are comments; log the
+ * firmware's ldr_raw to get one. */
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "support/filter_block.h"
+#include "support/filter_utils.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BENCH_MAX_SAMPLES   20000U
+#define BENCH_MAX_TRACES    12U
+#define BENCH_WARMUP        50U
+#define BENCH_TIMING_NS     20000000LL
+#define BENCH_TIMING_PASSES 5U
+#define BENCH_SETTLE_PERMIL 20
+
+#define BENCH_BASE_RAW      2000.0
+#define BENCH_NOISE_RAW     4.0
+#define BENCH_STEP_RAW      800.0
+#define BENCH_RAMP_RAW      2000.0
+#define BENCH_SPIKE_RAW     900.0
+#define BENCH_RIPPLE_RAW    60.0
+#define BENCH_RIPPLE_HZ     100.0
+#define BENCH_JITTER_MS     2.0
+
+typedef enum
+{
+    TRACE_KIND_STEP = 0,
+    TRACE_KIND_RAMP,
+    TRACE_KIND_OTHER
+} trace_kind_t;
+
+typedef struct
+{
+    char name[32];
+    trace_kind_t kind;
+    uint32_t len;
+    uint32_t event_index;   /* step or ramp start */
+    uint32_t event_end;     /* ramp end */
+    double slope;           /* ramp counts per sample */
+    uint8_t has_reference;
+    uint16_t *input;
+    double *reference;
+} trace_t;
+
+/* Filter configurations mirror the firmware defaults in app/app.c (keep in sync). */
+typedef union
+{
+    filter_moving_average_u16_t ma;
+    filter_ema_u16_t ema;
+    filter_one_euro_u16_t one_euro;
+    filter_median_u16_t median;
+} bench_state_t;
+
+typedef struct
+{
+    const char *name;
+    void (*init)(bench_state_t *s);
+    uint16_t (*push)(bench_state_t *s, uint16_t sample);
+} bench_filter_t;
+
+static const filter_one_euro_cfg_t s_one_euro_cfg = {
+    .min_alpha_q16 = 5640U,
+    .beta_q16 = 1311U,
+    .derivative_shift = 1U,
+};
+
+static void init_ma2(bench_state_t *s) { filter_moving_average_u16_init(&s->ma, 2U); }
+static void init_ma8(bench_state_t *s) { filter_moving_average_u16_init(&s->ma, 8U); }
+static void init_ema3(bench_state_t *s) { filter_ema_u16_init(&s->ema, 3U); }
+static void init_one_euro(bench_state_t *s) { filter_one_euro_u16_init(&s->one_euro, &s_one_euro_cfg); }
+static void init_median3(bench_state_t *s) { filter_median_u16_init(&s->median, 3U, FILTER_MEDIAN_WARMUP_PARTIAL); }
+static void init_median5(bench_state_t *s) { filter_median_u16_init(&s->median, 5U, FILTER_MEDIAN_WARMUP_PARTIAL); }
+static void init_median15(bench_state_t *s) { filter_median_u16_init(&s->median, 15U, FILTER_MEDIAN_WARMUP_PARTIAL); }
+
+static uint16_t push_ma(bench_state_t *s, uint16_t x) { return filter_moving_average_u16_push(&s->ma, x); }
+static uint16_t push_ema(bench_state_t *s, uint16_t x) { return filter_ema_u16_push(&s->ema, x); }
+static uint16_t push_one_euro(bench_state_t *s, uint16_t x) { return filter_one_euro_u16_push(&s->one_euro, x); }
+static uint16_t push_median(bench_state_t *s, uint16_t x) { return filter_median_u16_push(&s->median, x); }
+
+static const bench_filter_t s_filters[] = {
+    { "moving_average_2", init_ma2, push_ma },
+    { "moving_average_8", init_ma8, push_ma },
+    { "ema_shift3", init_ema3, push_ema },
+    { "one_euro", init_one_euro, push_one_euro },
+    { "median_3", init_median3, push_median },
+    { "median_5", init_median5, push_median },
+    { "median_15", init_median15, push_median },
+};
+
+static trace_t s_traces[BENCH_MAX_TRACES];
+static uint32_t s_trace_count;
+static uint16_t s_output[BENCH_MAX_SAMPLES];
+static uint32_t s_rng_state;
+
+static uint32_t rng_next(void)
+{
+    s_rng_state = (s_rng_state * 1664525U) + 1013904223U;
+    return s_rng_state;
+}
+
+static double rng_uniform(void)
+{
+    return ((double)(rng_next() >> 8) + 0.5) / 16777216.0;
+}
+
+static double rng_gauss(void)
+{
+    return sqrt(-2.0 * log(rng_uniform())) * cos(2.0 * M_PI * rng_uniform());
+}
+
+static uint16_t to_raw(double value)
+{
+    if (value < 0.0) {
+        return 0U;
+    }
+    if (value > 4095.0) {
+        return 4095U;
+    }
+
+    return (uint16_t)lround(value);
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+static trace_t *trace_alloc(const char *name, trace_kind_t kind, uint32_t len)
+{
+    trace_t *t;
+
+    if (s_trace_count >= BENCH_MAX_TRACES) {
+        fprintf(stderr, "too many traces (max %u)\n", (unsigned int)BENCH_MAX_TRACES);
+        exit(1);
+    }
+
+    t = &s_traces[s_trace_count++];
+    memset(t, 0, sizeof(*t));
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->kind = kind;
+    t->len = len;
+    t->input = calloc(len, sizeof(*t->input));
+    t->reference = calloc(len, sizeof(*t->reference));
+    if ((t->input == NULL) || (t->reference == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    return t;
+}
+
+static void build_synthetic(uint32_t len, double rate_hz)
+{
+    trace_t *t;
+    uint32_t i;
+
+    t = trace_alloc("step", TRACE_KIND_STEP, len);
+    t->has_reference = 1U;
+    t->event_index = len / 4U;
+    for (i = 0U; i < len; i++) {
+        t->reference[i] = BENCH_BASE_RAW + ((i >= t->event_index) ? BENCH_STEP_RAW : 0.0);
+        t->input[i] = to_raw(t->reference[i] + (BENCH_NOISE_RAW * rng_gauss()));
+    }
+
+    t = trace_alloc("ramp", TRACE_KIND_RAMP, len);
+    t->has_reference = 1U;
+    t->event_index = len / 4U;
+    t->event_end = (len * 3U) / 4U;
+    t->slope = BENCH_RAMP_RAW / (double)(t->event_end - t->event_index);
+    for (i = 0U; i < len; i++) {
+        uint32_t k = (i < t->event_index) ? 0U : (((i < t->event_end) ? i : t->event_end) - t->event_index);
+
+        t->reference[i] = (BENCH_BASE_RAW - 1000.0) + (t->slope * k);
+        t->input[i] = to_raw(t->reference[i] + (BENCH_NOISE_RAW * rng_gauss()));
+    }
+
+    /* Single-sample spikes at irregular spacing plus an occasional two-sample burst. */
+    t = trace_alloc("spike_train", TRACE_KIND_OTHER, len);
+    t->has_reference = 1U;
+    for (i = 0U; i < len; i++) {
+        t->reference[i] = BENCH_BASE_RAW;
+        t->input[i] = to_raw(BENCH_BASE_RAW + (BENCH_NOISE_RAW * rng_gauss()));
+    }
+    for (i = 10U; i < len; i += 20U + (rng_next() % 30U)) {
+        t->input[i] = to_raw(BENCH_BASE_RAW + BENCH_SPIKE_RAW);
+        if (((rng_next() % 5U) == 0U) && ((i + 1U) < len)) {
+            t->input[i + 1U] = to_raw(BENCH_BASE_RAW + BENCH_SPIKE_RAW);
+        }
+    }
+
+    /* Mains ripple seen by a single conversion per sample: the main loop's timing jitter scatters the phase,
+     * so the ripple aliases into broadband noise instead of a clean beat. */
+    t = trace_alloc("ripple_100hz", TRACE_KIND_OTHER, len);
+    t->has_reference = 1U;
+    for (i = 0U; i < len; i++) {
+        double t_s = ((double)i / rate_hz) + ((rng_uniform() - 0.5) * 2.0 * BENCH_JITTER_MS * 0.001);
+
+        t->reference[i] = BENCH_BASE_RAW;
+        t->input[i] = to_raw(BENCH_BASE_RAW + (BENCH_RIPPLE_RAW * sin(2.0 * M_PI * BENCH_RIPPLE_HZ * t_s)) +
+                             (BENCH_NOISE_RAW * rng_gauss()));
+    }
+}
+
+static void load_recorded(const char *spec)
+{
+    char name[32];
+    char line[128];
+    const char *eq = strchr(spec, '=');
+    const char *path;
+    FILE *f;
+    trace_t *t;
+    uint32_t len = 0U;
+    uint32_t refs = 0U;
+    size_t name_len;
+
+    if (eq == NULL) {
+        fprintf(stderr, "--trace expects name=file.csv\n");
+        exit(1);
+    }
+    name_len = (size_t)(eq - spec);
+    if (name_len >= sizeof(name)) {
+        name_len = sizeof(name) - 1U;
+    }
+    memcpy(name, spec, name_len);
+    name[name_len] = '\0';
+    path = eq + 1;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        exit(1);
+    }
+
+    t = trace_alloc(name, TRACE_KIND_OTHER, BENCH_MAX_SAMPLES);
+    while ((fgets(line, sizeof(line), f) != NULL) && (len < BENCH_MAX_SAMPLES)) {
+        double sample;
+        double reference;
+        int fields;
+
+        if ((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r')) {
+            continue;
+        }
+        fields = sscanf(line, "%lf , %lf", &sample, &reference);
+        if (fields < 1) {
+            fprintf(stderr, "%s:%u: expected 'sample[,reference]'\n", path, (unsigned int)(len + 1U));
+            exit(1);
+        }
+        t->input[len] = to_raw(sample);
+        t->reference[len] = (fields == 2) ? reference : sample;
+        refs += (fields == 2) ? 1U : 0U;
+        len++;
+    }
+    fclose(f);
+
+    if (len <= BENCH_WARMUP) {
+        fprintf(stderr, "%s: need more than %u samples\n", path, (unsigned int)BENCH_WARMUP);
+        exit(1);
+    }
+    t->len = len;
+    t->has_reference = (refs == len) ? 1U : 0U;
+}
+
+static void run_filter(const bench_filter_t *filter, const trace_t *t, uint16_t *out)
+{
+    bench_state_t state;
+    uint32_t i;
+
+    filter->init(&state);
+    for (i = 0U; i < t->len; i++) {
+        out[i] = filter->push(&state, t->input[i]);
+    }
+}
+
+static double time_filter_ns(const bench_filter_t *filter, const trace_t *t)
+{
+    double best = 1e30;
+    uint32_t pass;
+
+    for (pass = 0U; pass < BENCH_TIMING_PASSES; pass++) {
+        int64_t start = now_ns();
+        int64_t elapsed;
+        uint32_t rounds = 0U;
+
+        do {
+            run_filter(filter, t, s_output);
+            rounds++;
+            elapsed = now_ns() - start;
+        } while (elapsed < (BENCH_TIMING_NS / BENCH_TIMING_PASSES));
+
+        if (((double)elapsed / ((double)rounds * t->len)) < best) {
+            best = (double)elapsed / ((double)rounds * t->len);
+        }
+    }
+
+    return best;
+}
+
+static double rms_error(const trace_t *t, const uint16_t *out)
+{
+    double acc = 0.0;
+    uint32_t i;
+
+    for (i = BENCH_WARMUP; i < t->len; i++) {
+        double e = (double)out[i] - t->reference[i];
+
+        acc += e * e;
+    }
+
+    return sqrt(acc / (double)(t->len - BENCH_WARMUP));
+}
+
+/* Lag over the rising part, skipping the start-up transient of the slowest filter under test. */
+static double group_delay_samples(const trace_t *t, const uint16_t *out)
+{
+    uint32_t from = t->event_index + ((t->event_end - t->event_index) / 4U);
+    double acc = 0.0;
+    uint32_t i;
+
+    for (i = from; i < t->event_end; i++) {
+        acc += t->reference[i] - (double)out[i];
+    }
+
+    return (acc / (double)(t->event_end - from)) / t->slope;
+}
+
+static long settling_samples(const trace_t *t, const uint16_t *out)
+{
+    double final = t->reference[t->len - 1U];
+    double band = (BENCH_STEP_RAW * BENCH_SETTLE_PERMIL) / 1000.0;
+    uint32_t i = t->len;
+
+    while (i > t->event_index) {
+        if (fabs((double)out[i - 1U] - final) > band) {
+            break;
+        }
+        i--;
+    }
+
+    return (i >= t->len) ? -1L : (long)(i - t->event_index);
+}
+
+static void print_filters(FILE *out, double rate_hz)
+{
+    size_t f;
+    uint32_t k;
+
+    fprintf(out, "  \"filters\": [\n");
+    for (f = 0U; f < (sizeof(s_filters) / sizeof(s_filters[0])); f++) {
+        fprintf(out, "    {\n      \"name\": \"%s\",\n      \"traces\": [\n", s_filters[f].name);
+        for (k = 0U; k < s_trace_count; k++) {
+            const trace_t *t = &s_traces[k];
+            double ns = time_filter_ns(&s_filters[f], t);
+
+            run_filter(&s_filters[f], t, s_output);
+            fprintf(out, "        { \"trace\": \"%s\", \"samples\": %u, \"ns_per_sample\": %.2f, \"rms_error\": ",
+                    t->name, (unsigned int)t->len, ns);
+            if (t->has_reference != 0U) {
+                fprintf(out, "%.3f", rms_error(t, s_output));
+            } else {
+                fprintf(out, "null");
+            }
+            if (t->kind == TRACE_KIND_RAMP) {
+                double delay = group_delay_samples(t, s_output);
+
+                fprintf(out, ", \"group_delay_samples\": %.2f, \"group_delay_ms\": %.1f", delay,
+                        (delay * 1000.0) / rate_hz);
+            }
+            if (t->kind == TRACE_KIND_STEP) {
+                long settle = settling_samples(t, s_output);
+
+                if (settle < 0L) {
+                    fprintf(out, ", \"settling_samples\": null, \"settling_ms\": null");
+                } else {
+                    fprintf(out, ", \"settling_samples\": %ld, \"settling_ms\": %.1f", settle,
+                            ((double)settle * 1000.0) / rate_hz);
+                }
+            }
+            fprintf(out, " }%s\n", ((k + 1U) < s_trace_count) ? "," : "");
+        }
+        fprintf(out, "      ]\n    }%s\n", ((f + 1U) < (sizeof(s_filters) / sizeof(s_filters[0]))) ? "," : "");
+    }
+    fprintf(out, "  ],\n");
+}
+
+/* Random Q15 data inside the filter_block range contract, odd and even lengths so the scalar tails of the
+ * paired loops are exercised too. */
+#define BLOCK_MAX_LEN  257U
+#define BLOCK_MAX_TAPS 33U
+
+static int16_t s_block_in[BLOCK_MAX_LEN + BLOCK_MAX_TAPS];
+static int16_t s_block_coeffs[BLOCK_MAX_TAPS];
+static int16_t s_block_out_a[BLOCK_MAX_LEN];
+static int16_t s_block_out_b[BLOCK_MAX_LEN];
+static int32_t s_block_sum_a[BLOCK_MAX_LEN];
+static int32_t s_block_sum_b[BLOCK_MAX_LEN];
+
+static void block_fill(uint16_t taps)
+{
+    int32_t budget = 32768;
+    uint32_t i;
+
+    for (i = 0U; i < (BLOCK_MAX_LEN + BLOCK_MAX_TAPS); i++) {
+        s_block_in[i] = (int16_t)((int32_t)(rng_next() % 32767U) - 16383);
+    }
+    /* Signed coefficients whose magnitudes sum to at most unity gain. */
+    for (i = 0U; i < taps; i++) {
+        int32_t c = (int32_t)(rng_next() % (uint32_t)((budget / (int32_t)(taps - i)) + 1));
+
+        budget -= c;
+        s_block_coeffs[i] = (int16_t)(((rng_next() & 1U) != 0U) ? -c : c);
+    }
+}
+
+static uint8_t block_check(uint16_t len, uint16_t taps, uint8_t factor)
+{
+    uint16_t dec_len = (uint16_t)(len / factor);
+    uint8_t ok = 1U;
+
+    block_fill(taps);
+    if (filter_block_sum_q15(s_block_in, len) != filter_block_sum_q15_ref(s_block_in, len)) {
+        ok = 0U;
+    }
+    filter_block_fir_q15(s_block_in, len, s_block_coeffs, taps, s_block_out_a);
+    filter_block_fir_q15_ref(s_block_in, len, s_block_coeffs, taps, s_block_out_b);
+    if (memcmp(s_block_out_a, s_block_out_b, len * sizeof(int16_t)) != 0) {
+        ok = 0U;
+    }
+    filter_block_fir_decimate_q15(s_block_in, dec_len, factor, s_block_coeffs, taps, s_block_out_a);
+    filter_block_fir_decimate_q15_ref(s_block_in, dec_len, factor, s_block_coeffs, taps, s_block_out_b);
+    if (memcmp(s_block_out_a, s_block_out_b, dec_len * sizeof(int16_t)) != 0) {
+        ok = 0U;
+    }
+    filter_block_moving_sum_q15(s_block_in, len, taps, s_block_sum_a);
+    filter_block_moving_sum_q15_ref(s_block_in, len, taps, s_block_sum_b);
+    if (memcmp(s_block_sum_a, s_block_sum_b, len * sizeof(int32_t)) != 0) {
+        ok = 0U;
+    }
+
+    return ok;
+}
+
+static double block_time_ns(filter_block_bench_kernel_t kernel)
+{
+    const uint16_t len = FILTER_BLOCK_BENCH_LEN;
+    const uint16_t taps = FILTER_BLOCK_BENCH_TAPS;
+    volatile int32_t sink = 0;
+    int64_t start;
+    int64_t elapsed;
+    uint32_t rounds = 0U;
+
+    block_fill(taps);
+    start = now_ns();
+    do {
+        switch (kernel) {
+            case FILTER_BLOCK_BENCH_SUM:
+                sink += filter_block_sum_q15_ref(s_block_in, len);
+                break;
+            case FILTER_BLOCK_BENCH_FIR:
+                filter_block_fir_q15_ref(s_block_in, len, s_block_coeffs, taps, s_block_out_b);
+                break;
+            case FILTER_BLOCK_BENCH_FIR_DECIMATE4:
+                filter_block_fir_decimate_q15_ref(s_block_in, len / 4U, 4U, s_block_coeffs, taps, s_block_out_b);
+                break;
+            case FILTER_BLOCK_BENCH_MOVING_SUM:
+            default:
+                filter_block_moving_sum_q15_ref(s_block_in, len, taps, s_block_sum_b);
+                break;
+        }
+        rounds++;
+        elapsed = now_ns() - start;
+    } while (elapsed < (BENCH_TIMING_NS / 4));
+    (void)sink;
+
+    return (double)elapsed / ((double)rounds * len);
+}
+
+static void print_block_kernels(FILE *out)
+{
+    static const char *const names[FILTER_BLOCK_BENCH_COUNT] = { "sum", "fir16", "fir16_dec4", "moving_sum16" };
+    static const uint16_t lens[] = { 1U, 2U, 7U, 64U, 127U, 128U, 257U };
+    static const uint16_t taps[] = { 1U, 2U, 3U, 16U, 33U };
+    uint8_t exact = 1U;
+    size_t i;
+    size_t j;
+    uint8_t k;
+
+    for (i = 0U; i < (sizeof(lens) / sizeof(lens[0])); i++) {
+        for (j = 0U; j < (sizeof(taps) / sizeof(taps[0])); j++) {
+            uint8_t factor;
+
+            for (factor = 1U; factor <= 4U; factor++) {
+                if (block_check(lens[i], taps[j], factor) == 0U) {
+                    exact = 0U;
+                    fprintf(stderr, "block kernels differ: len=%u taps=%u factor=%u\n",
+                            (unsigned int)lens[i], (unsigned int)taps[j], (unsigned int)factor);
+                }
+            }
+        }
+    }
+
+    fprintf(out, "  \"block_kernels\": {\n    \"simd_bit_exact\": %s,\n    \"ref\": [\n",
+            (exact != 0U) ? "true" : "false");
+    for (k = 0U; k < FILTER_BLOCK_BENCH_COUNT; k++) {
+        fprintf(out, "      { \"kernel\": \"%s\", \"len\": %u, \"ns_per_sample\": %.2f }%s\n", names[k],
+                (unsigned int)FILTER_BLOCK_BENCH_LEN, block_time_ns((filter_block_bench_kernel_t)k),
+                ((k + 1U) < FILTER_BLOCK_BENCH_COUNT) ? "," : "");
+    }
+    fprintf(out, "    ]\n  }\n");
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: filter_bench [--rate HZ] [--samples N] [--seed N] [--trace name=file.csv ...] [--out file]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *recorded[BENCH_MAX_TRACES];
+    uint32_t recorded_count = 0U;
+    const char *out_path = NULL;
+    double rate_hz = 20.0;  /* firmware LDR sample period is 50 ms */
+    unsigned long samples = 2000UL;
+    unsigned long seed = 1UL;
+    FILE *out = stdout;
+    uint32_t i;
+    int a;
+
+    for (a = 1; a < argc; a++) {
+        if ((strcmp(argv[a], "--rate") == 0) && ((a + 1) < argc)) {
+            rate_hz = atof(argv[++a]);
+        } else if ((strcmp(argv[a], "--samples") == 0) && ((a + 1) < argc)) {
+            samples = strtoul(argv[++a], NULL, 0);
+        } else if ((strcmp(argv[a], "--seed") == 0) && ((a + 1) < argc)) {
+            seed = strtoul(argv[++a], NULL, 0);
+        } else if ((strcmp(argv[a], "--trace") == 0) && ((a + 1) < argc) && (recorded_count < 8U)) {
+            recorded[recorded_count++] = argv[++a];
+        } else if ((strcmp(argv[a], "--out") == 0) && ((a + 1) < argc)) {
+            out_path = argv[++a];
+        } else {
+            usage();
+        }
+    }
+    if ((rate_hz <= 0.0) || (samples <= (4UL * BENCH_WARMUP)) || (samples > BENCH_MAX_SAMPLES)) {
+        fprintf(stderr, "need rate > 0 and %u < samples <= %u\n", (unsigned int)(4U * BENCH_WARMUP),
+                (unsigned int)BENCH_MAX_SAMPLES);
+        return 1;
+    }
+
+    s_rng_state = (uint32_t)seed;
+    build_synthetic((uint32_t)samples, rate_hz);
+    for (i = 0U; i < recorded_count; i++) {
+        load_recorded(recorded[i]);
+    }
+
+    if (out_path != NULL) {
+        out = fopen(out_path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "%s: cannot write\n", out_path);
+            return 1;
+        }
+    }
+
+    fprintf(out, "{\n  \"sample_rate_hz\": %.3f,\n  \"seed\": %lu,\n", rate_hz, seed);
+    print_filters(out, rate_hz);
+    print_block_kernels(out);
+    fprintf(out, "}\n");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+/* Host stand-in for the HAL umbrella header: the filter sources only need the fixed-width types, NULL and,
+ * for filter_block.c, the CMSIS DSP intrinsics. The intrinsics are emulated with the Cortex-M4 semantics
+ * (SMLAD wraps modulo 2^32, SSUB16 wraps per halfword, SSAT saturates to a signed bit width), so the SIMD
+ * kernels can be compared with their _ref versions on the host. */
+#ifndef FILTER_BENCH_HAL_SHIM_H
+#define FILTER_BENCH_HAL_SHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc)
+{
+    int32_t lo = (int32_t)(int16_t)(x & 0xFFFFU) * (int16_t)(y & 0xFFFFU);
+    int32_t hi = (int32_t)(int16_t)(x >> 16) * (int16_t)(y >> 16);
+
+    return acc + (uint32_t)lo + (uint32_t)hi;
+}
+
+static inline uint32_t __SSUB16(uint32_t x, uint32_t y)
+{
+    uint16_t lo = (uint16_t)((int16_t)(x & 0xFFFFU) - (int16_t)(y & 0xFFFFU));
+    uint16_t hi = (uint16_t)((int16_t)(x >> 16) - (int16_t)(y >> 16));
+
+    return ((uint32_t)hi << 16) | lo;
+}
+
+static inline int32_t __SSAT(int32_t value, uint32_t bits)
+{
+    int32_t max = (int32_t)((1UL << (bits - 1U)) - 1U);
+    int32_t min = -max - 1;
+
+    if (value > max) {
+        return max;
+    }
+    if (value < min) {
+        return min;
+    }
+
+    return value;
+}
+
+#endif /* FILTER_BENCH_HAL_SHIM_H */
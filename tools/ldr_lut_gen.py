@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Generate the LDR raw -> log-lux calibration for the S-ADAPT firmware.
+
+Input is a CSV of measured points (filtered LDR ADC counts, reference lux), one per line; '#' lines are
+comments. The points are reduced to APP_LDR_CAL_POINTS breakpoints spaced evenly in log-lux and printed as
+an app_ldr_cal_t initializer for S-ADAPT/Core/Src/app/app_settings.c. With --lut the 65-entry table that
+lux_curve_build() derives from those breakpoints on the target is printed too, using the same integer math,
+so the result can be checked against the measurements before flashing.
+
+Usage:
+    tools/ldr_lut_gen.py tools/ldr_cal_points.csv [--points 8] [--transfer 0:100,1000:94,...] [--lut]
+"""
+
+import argparse
+import math
+import sys
+
+# Keep in sync with app/app_settings.h and support/lux_curve.h.
+CAL_POINTS = 8
+TRANSFER_POINTS = 6
+ADC_MAX = 4095
+RAW_SHIFT = 6
+RAW_ENTRIES = (4096 >> RAW_SHIFT) + 1
+LOG_LUX_MAX_MDEC = 5000
+DEFAULT_TRANSFER = "0:100,1000:94,2000:79,2700:52,3000:0,5000:0"
+
+
+def log_lux_mdec(lux):
+    if lux <= 1.0:
+        return 0
+    return min(LOG_LUX_MAX_MDEC, int(round(1000.0 * math.log10(lux))))
+
+
+def load_points(path):
+    by_raw = {}
+    with open(path, "r", encoding="ascii") as handle:
+        for line_no, line in enumerate(handle, 1):
+            line = line.strip()
+            if (not line) or line.startswith("#"):
+                continue
+            fields = [f.strip() for f in line.split(",")]
+            if len(fields) < 2:
+                sys.exit(f"{path}:{line_no}: expected 'raw,lux'")
+            raw = int(fields[0])
+            lux = float(fields[1])
+            if not 0 <= raw <= ADC_MAX or lux <= 0.0:
+                sys.exit(f"{path}:{line_no}: raw must be 0..{ADC_MAX} and lux > 0")
+            by_raw.setdefault(raw, []).append(lux)
+
+    # Repeated readings at one raw value are averaged in the log domain.
+    points = sorted((raw, sum(math.log10(v) for v in lux) / len(lux)) for raw, lux in by_raw.items())
+    if len(points) < 2:
+        sys.exit("need at least two distinct measured points")
+    for (raw_a, log_a), (raw_b, log_b) in zip(points, points[1:]):
+        if log_b < log_a:
+            sys.exit(f"measurements are not monotonic between raw {raw_a} and {raw_b}; "
+                     "the firmware expects lux to rise with ADC counts")
+    return points
+
+
+def interp(x, xs, ys):
+    if x <= xs[0]:
+        return ys[0]
+    if x >= xs[-1]:
+        return ys[-1]
+    for i in range(1, len(xs)):
+        if x <= xs[i]:
+            span = xs[i] - xs[i - 1]
+            if span == 0:
+                return ys[i]
+            return ys[i - 1] + (ys[i] - ys[i - 1]) * (x - xs[i - 1]) / span
+    return ys[-1]
+
+
+def reduce_points(points, count):
+    raws = [float(raw) for raw, _ in points]
+    logs = [log for _, log in points]
+    lo = logs[0]
+    hi = logs[-1]
+    cal_raw = []
+    cal_log = []
+    for i in range(count):
+        target = lo + (hi - lo) * i / (count - 1)
+        raw = int(round(interp(target, logs, raws)))
+        # Breakpoints must be strictly ascending in raw for the firmware validator.
+        if cal_raw and raw <= cal_raw[-1]:
+            raw = cal_raw[-1] + 1
+        cal_raw.append(min(raw, ADC_MAX))
+        cal_log.append(log_lux_mdec(10.0 ** target))
+    if cal_raw[-1] == cal_raw[-2]:
+        sys.exit("measured span is too narrow for the requested number of points")
+    return cal_raw, cal_log
+
+
+def parse_transfer(text):
+    pairs = []
+    for item in text.split(","):
+        log_text, pct_text = item.split(":")
+        pairs.append((int(log_text), int(pct_text)))
+    if len(pairs) != TRANSFER_POINTS:
+        sys.exit(f"--transfer needs exactly {TRANSFER_POINTS} log_lux_mdec:percent pairs")
+    for (log_a, _), (log_b, _) in zip(pairs, pairs[1:]):
+        if log_b <= log_a:
+            sys.exit("--transfer log-lux values must be strictly ascending")
+    if any(not 0 <= pct <= 100 for _, pct in pairs):
+        sys.exit("--transfer percentages must be 0..100")
+    return pairs
+
+
+def firmware_segment(x, xs, ys):
+    """Integer piecewise-linear evaluation as done by lux_curve_build() (build time, divides allowed)."""
+    if x <= xs[0]:
+        return ys[0]
+    if x >= xs[-1]:
+        return ys[-1]
+    for i in range(1, len(xs)):
+        if x <= xs[i]:
+            span = xs[i] - xs[i - 1]
+            if ys[i] >= ys[i - 1]:
+                return ys[i - 1] + ((ys[i] - ys[i - 1]) * (x - xs[i - 1]) + span // 2) // span
+            return ys[i - 1] - ((ys[i - 1] - ys[i]) * (x - xs[i - 1]) + span // 2) // span
+    return ys[-1]
+
+
+def build_raw_lut(cal_raw, cal_log):
+    return [firmware_segment(min(k << RAW_SHIFT, ADC_MAX), cal_raw, cal_log) for k in range(RAW_ENTRIES)]
+
+
+def lookup_raw(lut, raw):
+    index = raw >> RAW_SHIFT
+    frac = raw & ((1 << RAW_SHIFT) - 1)
+    return (lut[index] * ((1 << RAW_SHIFT) - frac) + lut[index + 1] * frac) >> RAW_SHIFT
+
+
+def format_row(values, width):
+    return ", ".join(f"{v}U".rjust(width) for v in values)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("csv", help="measured points: raw,lux per line")
+    parser.add_argument("--points", type=int, default=CAL_POINTS,
+                        help=f"breakpoints to emit (firmware expects {CAL_POINTS})")
+    parser.add_argument("--transfer", default=DEFAULT_TRANSFER,
+                        help="log_lux_mdec:percent pairs for the lux -> output curve")
+    parser.add_argument("--lut", action="store_true", help="also print the derived 65-entry LUT and fit error")
+    args = parser.parse_args()
+
+    if args.points < 2:
+        sys.exit("--points must be at least 2")
+
+    points = load_points(args.csv)
+    cal_raw, cal_log = reduce_points(points, args.points)
+    transfer = parse_transfer(args.transfer)
+
+    print(f"/* Generated by tools/ldr_lut_gen.py from {args.csv} ({len(points)} measured points). */")
+    print("static const app_ldr_cal_t s_ldr_cal_default = {")
+    print(f"    .raw = {{{format_row(cal_raw, 5)}}},")
+    print(f"    .log_lux_mdec = {{{format_row(cal_log, 5)}}},")
+    print(f"    .transfer_log_lux_mdec = {{{format_row([t[0] for t in transfer], 5)}}},")
+    print(f"    .transfer_percent = {{{format_row([t[1] for t in transfer], 4)}}},")
+    print("};")
+
+    if args.lut:
+        lut = build_raw_lut(cal_raw, cal_log)
+        print()
+        print(f"/* raw >> {RAW_SHIFT} -> log_lux_mdec (lux_curve_t.log_lux_mdec) */")
+        for start in range(0, RAW_ENTRIES, 8):
+            print("    " + ", ".join(f"{v:4d}" for v in lut[start:start + 8]) + ",")
+        worst = 0
+        for raw, log in points:
+            err = abs(lookup_raw(lut, raw) - 1000.0 * log)
+            worst = max(worst, err)
+        print(f"/* worst fit error vs measurements: {worst:.0f} mdec ({(10 ** (worst / 1000.0) - 1) * 100:.1f} % lux) */")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,499 @@
+/* Replays ultrasonic distance traces through the firmware presence engine (app/presence_engine.c) on the host.
+ *
+ * Input CSV, one sample per line, '#' lines are comments:
+ *     t_ms,distance_mm,valid[,light[,ldr]]
+ * t_ms counts from the start of the trace; valid is 0 for dropped or low-confidence bursts; light (default 1)
+ * arms and disarms the engine like the light switch does; ldr is the lamp-compensated ambient raw value (the
+ * HMM classifier's shadow evidence, absent = no LDR reading). Without a file, --synthetic SECONDS generates
+ * a seated user who leaves halfway and comes back. --wall-mm sets the synthetic room depth behind the seat
+ * (default 1400); --range-mm models the sensor range: the firmware burst reports anything further as a valid
+ * beyond-range reading at the limit (15 ms ping timeout, ~2575 mm at 20 degC).
+ *
+ * Output is CSV, one decision per sample (t_ms,distance_mm,valid,filtered_mm,velocity_mm_s,track,present,
+ * candidate,reason,p_present,hmm,ref_mm,margin_mm,arrival) on stdout; a summary goes to stderr, including how
+ * many returns were predicted (arrival pre-ramp), how long before the confirmation, and how many predictions
+ * were dropped without a return. --hmm switches from the streak rules to the HMM classifier; --no-learn keeps
+ * the reference captured at turn-on instead of the learned background; --no-arrival turns the prediction off.
+ * --bench N replays the trace N more times and reports samples/s.
+ *
+ * --shadow AWAY_S:STALE_S:RETURN_CM (up to PRESENCE_SHADOW_MAX times, 0 = same as live) runs the on-device
+ * shadow evaluator (app/presence_shadow.c) next to the live settings and prints, per policy, the confirmed
+ * leaves, mean/max time to detect them, false offs (candidates dropped during the pre-off), lamp-on time
+ * and the step cost in nanoseconds.
+ *
+ * Usage:
+ *     make && ./presence_replay [--away-s 30] [--stale-s 120] [--return-cm 10] [--preoff-s 10] [--no-away]
+ *                               [--no-flat] [--step-rules] [--hmm] [--no-learn] [--no-arrival] [--quiet]
+ *                               [--bench N] [--shadow A:S:R ...] [--wall-mm MM] [--range-mm MM]
+ *                               (trace.csv | --synthetic S) */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app/presence_engine.h"
+#include "app/presence_shadow.h"
+
+#define REPLAY_MAX_SAMPLES 2000000UL
+
+typedef struct
+{
+    presence_timed_sample_t *samples;
+    uint8_t *light;
+    uint32_t count;
+} replay_trace_t;
+
+/* Mirrors the build defaults in app/app.c (s_policy_cfg) and app/app_settings.h; keep in sync. */
+static presence_engine_cfg_t s_cfg = {
+    .distance_error_mm = 9990U,
+    .median_window_size = 5U,
+    .median_warmup = FILTER_MEDIAN_WARMUP_PARTIAL,
+    .tracker = {
+        .accel_noise_mm_s2 = 400U,
+        .meas_noise_mm = 8U,
+        .init_velocity_mm_s = 300U,
+        .gate_sigma = 4U,
+        .max_gated = 2U,
+        .max_coast_ms = 3000U,
+    },
+    .use_tracker = 1U,
+    .flat_velocity_mm_s = 25U,
+    .motion_velocity_mm_s = 60U,
+    .motion_sigma = 2U,
+    .flat_band_mm = 6U,
+    .motion_delta_mm = 15U,
+    .ref_fallback_mm = 600U,
+    .body_margin_mm = 200U,
+    .return_confirm_ms = 1500U,
+    .streak_max_dt_ms = 500U,
+    .classifier = PRESENCE_CLASSIFIER_RULES,
+    .hmm = PRESENCE_HMM_MODEL_DEFAULTS,
+    .hmm_candidate_permille = 750U,
+    .hmm_clear_permille = 500U,
+    .hmm_recover_permille = 700U,
+    .ldr_shadow_delta_raw = 24U,
+    .learn_background = 1U,
+    .background = {
+        .bin_mm = 25U,
+        .decay_period_ms = 10000U,
+        .decay_shift = 5U,
+        .sample_max_dt_ms = 500U,
+        .user_min_ms = 30000U,
+        .scene_min_ms = 10000U,
+    },
+    .min_away_margin_mm = 80U,
+    .arrival_velocity_mm_s = 150U,
+    .arrival_horizon_ms = 1000U,
+    .arrival_confirm_ms = 300U,
+};
+
+static uint32_t s_rng_state = 1U;
+static uint32_t s_wall_mm = 1400U;
+static uint32_t s_range_mm = 0U;
+
+static uint32_t rng_next(void)
+{
+    s_rng_state = (s_rng_state * 1664525U) + 1013904223U;
+    return s_rng_state;
+}
+
+static void trace_alloc(replay_trace_t *trace, uint32_t capacity)
+{
+    trace->samples = calloc(capacity, sizeof(*trace->samples));
+    trace->light = calloc(capacity, sizeof(*trace->light));
+    trace->count = 0U;
+    if ((trace->samples == NULL) || (trace->light == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+}
+
+static void trace_load(replay_trace_t *trace, const char *path)
+{
+    char line[128];
+    FILE *f = fopen(path, "r");
+    uint32_t line_no = 0U;
+
+    if (f == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        exit(1);
+    }
+
+    trace_alloc(trace, REPLAY_MAX_SAMPLES);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        unsigned long t_ms;
+        unsigned long distance_mm;
+        unsigned int valid;
+        unsigned int light = 1U;
+        unsigned int ldr = 0U;
+        int fields;
+
+        line_no++;
+        if ((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r')) {
+            continue;
+        }
+        fields = sscanf(line, "%lu , %lu , %u , %u , %u", &t_ms, &distance_mm, &valid, &light, &ldr);
+        if (fields < 3) {
+            fprintf(stderr, "%s:%u: expected 't_ms,distance_mm,valid[,light[,ldr]]'\n", path,
+                    (unsigned int)line_no);
+            exit(1);
+        }
+        if (trace->count >= REPLAY_MAX_SAMPLES) {
+            fprintf(stderr, "%s: more than %lu samples\n", path, REPLAY_MAX_SAMPLES);
+            exit(1);
+        }
+        trace->samples[trace->count].t_ms = (uint32_t)t_ms;
+        trace->samples[trace->count].sample.distance_mm = (uint32_t)distance_mm;
+        trace->samples[trace->count].sample.valid = (valid != 0U) ? 1U : 0U;
+        trace->samples[trace->count].sample.ldr_raw = (uint16_t)ldr;
+        trace->samples[trace->count].sample.ldr_valid = (fields >= 5) ? 1U : 0U;
+        trace->light[trace->count] = (light != 0U) ? 1U : 0U;
+        trace->count++;
+    }
+    fclose(f);
+}
+
+/* Seated user at ~550 mm with small sway and a 150 mm lean forward and back every 40 s, 5 % dropped bursts, a fixed 200 ms cadence
+ * (the target alternates 100 and 250 ms). The user walks out at the midpoint (distance ramps to the wall
+ * behind the chair, s_wall_mm, over 2 s) and comes back 60 s later, sitting down over another 2 s. Readings past
+ * s_range_mm (when set) come back at the limit, as the firmware's beyond-range bursts do. Ambient sits at 2000
+ * counts; leans and the walk out and back shade the sensor by 40 counts. */
+static void trace_synthetic(replay_trace_t *trace, uint32_t seconds)
+{
+    const uint32_t period_ms = 200U;
+    uint32_t count = (seconds * 1000U) / period_ms;
+    const uint32_t away_ms = 60000U;
+    const uint32_t walk_ms = 2000U;
+    uint32_t leave_ms = (seconds * 1000U) / 2U;
+    uint32_t i;
+
+    if (count > REPLAY_MAX_SAMPLES) {
+        count = REPLAY_MAX_SAMPLES;
+    }
+    trace_alloc(trace, count);
+    for (i = 0U; i < count; i++) {
+        uint32_t t_ms = i * period_ms;
+        uint32_t phase_ms = t_ms % 40000U;
+        int32_t distance = 550 + (int32_t)(rng_next() % 9U) - 4;
+        int32_t ldr = 2000 + (int32_t)(rng_next() % 5U) - 2;
+
+        uint32_t since_leave_ms = t_ms - leave_ms;
+
+        if ((t_ms >= leave_ms) && (since_leave_ms < (away_ms + walk_ms))) {
+            uint32_t walked_ms = (since_leave_ms < walk_ms) ? since_leave_ms
+                                 : (since_leave_ms >= away_ms) ? ((away_ms + walk_ms) - since_leave_ms) : walk_ms;
+
+            distance += (int32_t)((walked_ms * (s_wall_mm - 550U)) / walk_ms);
+            if ((since_leave_ms < walk_ms) || (since_leave_ms >= away_ms)) {
+                ldr -= 40;
+            }
+        } else if (phase_ms < 3000U) {
+            distance -= (int32_t)((((phase_ms < 1500U) ? phase_ms : (3000U - phase_ms)) * 150U) / 1500U);
+            ldr -= 40;
+        }
+        if ((s_range_mm != 0U) && ((uint32_t)distance > s_range_mm)) {
+            distance = (int32_t)s_range_mm;
+        }
+        trace->samples[i].t_ms = t_ms;
+        trace->samples[i].sample.distance_mm = (uint32_t)distance;
+        trace->samples[i].sample.valid = ((rng_next() % 20U) != 0U) ? 1U : 0U;
+        trace->samples[i].sample.ldr_raw = (uint16_t)ldr;
+        trace->samples[i].sample.ldr_valid = 1U;
+        trace->light[i] = 1U;
+    }
+    trace->count = count;
+}
+
+/* Light switch edges split the trace into batches; each batch is one presence_engine_replay call. */
+static uint32_t replay(presence_engine_t *e,
+                       const replay_trace_t *trace,
+                       const presence_engine_settings_t *settings,
+                       presence_decision_t *decisions)
+{
+    uint32_t transitions = 0U;
+    uint32_t start = 0U;
+
+    presence_engine_init(e, &s_cfg);
+    while (start < trace->count) {
+        uint32_t end = start + 1U;
+
+        while ((end < trace->count) && (trace->light[end] == trace->light[start])) {
+            end++;
+        }
+        if (trace->light[start] != 0U) {
+            presence_engine_arm(e);
+        } else {
+            presence_engine_disarm(e);
+        }
+        transitions += presence_engine_replay(e, &trace->samples[start], end - start, settings,
+                                              (decisions != NULL) ? &decisions[start] : NULL);
+        start = end;
+    }
+
+    return transitions;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+static uint32_t clock_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec);
+}
+
+static void print_shadow_stats(const char *name, const presence_shadow_stats_t *stats)
+{
+    fprintf(stderr, "shadow %s leaves=%lu detect_avg_ms=%lu detect_max_ms=%lu false_offs=%lu on_s=%lu",
+            name,
+            (unsigned long)stats->leaves,
+            (unsigned long)presence_shadow_detect_avg_ms(stats),
+            (unsigned long)stats->detect_max_ms,
+            (unsigned long)stats->false_offs,
+            (unsigned long)(stats->on_ms / 1000U));
+}
+
+/* Steps the live settings and every shadow policy sample by sample, as the target does. */
+static void replay_shadow(const replay_trace_t *trace,
+                          const presence_engine_settings_t *settings,
+                          const presence_shadow_policy_t *policies,
+                          uint8_t policy_count)
+{
+    static presence_shadow_set_t set;
+    presence_engine_t live;
+    presence_shadow_track_t live_track;
+    uint32_t i;
+    uint8_t p;
+
+    presence_engine_init(&live, &s_cfg);
+    presence_shadow_track_reset(&live_track, &live);
+    presence_shadow_init(&set, &s_cfg, policies, policy_count);
+    for (i = 0U; i < trace->count; i++) {
+        uint32_t dt_ms = trace->samples[i].t_ms - live.now_ms;
+
+        if ((int32_t)dt_ms < 0) {
+            dt_ms = 0U;
+        }
+        if ((i == 0U) || (trace->light[i] != trace->light[i - 1U])) {
+            if (trace->light[i] != 0U) {
+                presence_engine_arm(&live);
+                presence_shadow_arm(&set);
+            } else {
+                presence_engine_disarm(&live);
+                presence_shadow_disarm(&set);
+            }
+            presence_shadow_track_sync(&live_track, &live);
+        }
+        presence_engine_step(&live, &trace->samples[i].sample, dt_ms, settings, NULL);
+        if ((live.present != 0U) && (live.candidate_no_user != 0U) &&
+            ((live.now_ms - live.candidate_since_ms) >= settings->preoff_dim_ms)) {
+            presence_engine_confirm_no_user(&live);
+        }
+        presence_shadow_track_update(&live_track, &live, dt_ms);
+        presence_shadow_step(&set, &trace->samples[i].sample, dt_ms, settings, clock_ns);
+    }
+
+    print_shadow_stats("live", &live_track.stats);
+    fprintf(stderr, "\n");
+    for (p = 0U; p < set.count; p++) {
+        char name[16];
+
+        snprintf(name, sizeof(name), "%u", (unsigned int)p);
+        print_shadow_stats(name, &set.slot[p].track.stats);
+        fprintf(stderr, " step_ns_avg=%lu step_ns_max=%lu\n",
+                (unsigned long)((set.slot[p].cost.count != 0U) ? (set.slot[p].cost.sum / set.slot[p].cost.count) : 0U),
+                (unsigned long)set.slot[p].cost.max);
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: presence_replay [--away-s S] [--stale-s S] [--return-cm CM] [--preoff-s S] [--no-away] [--no-flat]\n"
+            "                       [--step-rules] [--hmm] [--no-learn] [--no-arrival] [--quiet] [--bench N]\n"
+            "                       [--shadow A:S:R ...] [--wall-mm MM] [--range-mm MM]\n"
+            "                       (trace.csv | --synthetic SECONDS)\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    presence_engine_settings_t settings = {
+        .away_mode_enabled = 1U,
+        .flat_mode_enabled = 1U,
+        .away_timeout_ms = 30000U,
+        .stale_timeout_ms = 120000U,
+        .return_band_mm = 100U,
+        .preoff_dim_ms = 10000U,
+    };
+    replay_trace_t trace = { 0 };
+    presence_shadow_policy_t policies[PRESENCE_SHADOW_MAX] = { 0 };
+    uint8_t policy_count = 0U;
+    presence_decision_t *decisions;
+    presence_engine_t engine;
+    const char *path = NULL;
+    unsigned long synthetic_s = 0UL;
+    unsigned long bench = 0UL;
+    uint8_t quiet = 0U;
+    uint32_t transitions;
+    uint32_t present_samples = 0U;
+    uint32_t predicted_since_ms = UINT32_MAX;
+    uint32_t returns = 0U;
+    uint32_t predicted_returns = 0U;
+    uint32_t arrival_aborts = 0U;
+    uint32_t lead_sum_ms = 0U;
+    uint32_t i;
+    int a;
+
+    for (a = 1; a < argc; a++) {
+        if ((strcmp(argv[a], "--away-s") == 0) && ((a + 1) < argc)) {
+            settings.away_timeout_ms = (uint32_t)strtoul(argv[++a], NULL, 0) * 1000U;
+        } else if ((strcmp(argv[a], "--stale-s") == 0) && ((a + 1) < argc)) {
+            settings.stale_timeout_ms = (uint32_t)strtoul(argv[++a], NULL, 0) * 1000U;
+        } else if ((strcmp(argv[a], "--return-cm") == 0) && ((a + 1) < argc)) {
+            settings.return_band_mm = (uint32_t)strtoul(argv[++a], NULL, 0) * 10U;
+        } else if ((strcmp(argv[a], "--preoff-s") == 0) && ((a + 1) < argc)) {
+            settings.preoff_dim_ms = (uint32_t)strtoul(argv[++a], NULL, 0) * 1000U;
+        } else if (strcmp(argv[a], "--no-away") == 0) {
+            settings.away_mode_enabled = 0U;
+        } else if (strcmp(argv[a], "--no-flat") == 0) {
+            settings.flat_mode_enabled = 0U;
+        } else if (strcmp(argv[a], "--step-rules") == 0) {
+            s_cfg.use_tracker = 0U;
+        } else if (strcmp(argv[a], "--hmm") == 0) {
+            s_cfg.classifier = PRESENCE_CLASSIFIER_HMM;
+        } else if (strcmp(argv[a], "--no-learn") == 0) {
+            s_cfg.learn_background = 0U;
+        } else if (strcmp(argv[a], "--no-arrival") == 0) {
+            s_cfg.arrival_velocity_mm_s = 0U;
+        } else if (strcmp(argv[a], "--quiet") == 0) {
+            quiet = 1U;
+        } else if ((strcmp(argv[a], "--bench") == 0) && ((a + 1) < argc)) {
+            bench = strtoul(argv[++a], NULL, 0);
+        } else if ((strcmp(argv[a], "--shadow") == 0) && ((a + 1) < argc) && (policy_count < PRESENCE_SHADOW_MAX)) {
+            unsigned long away_s = 0UL;
+            unsigned long stale_s = 0UL;
+            unsigned long return_cm = 0UL;
+
+            if (sscanf(argv[++a], "%lu:%lu:%lu", &away_s, &stale_s, &return_cm) < 1) {
+                usage();
+            }
+            policies[policy_count].away_timeout_ms = (uint32_t)away_s * 1000U;
+            policies[policy_count].stale_timeout_ms = (uint32_t)stale_s * 1000U;
+            policies[policy_count].return_band_mm = (uint32_t)return_cm * 10U;
+            policy_count++;
+        } else if ((strcmp(argv[a], "--wall-mm") == 0) && ((a + 1) < argc)) {
+            s_wall_mm = (uint32_t)strtoul(argv[++a], NULL, 0);
+            if (s_wall_mm < 600U) {
+                usage();
+            }
+        } else if ((strcmp(argv[a], "--range-mm") == 0) && ((a + 1) < argc)) {
+            s_range_mm = (uint32_t)strtoul(argv[++a], NULL, 0);
+        } else if ((strcmp(argv[a], "--synthetic") == 0) && ((a + 1) < argc)) {
+            synthetic_s = strtoul(argv[++a], NULL, 0);
+        } else if ((argv[a][0] != '-') && (path == NULL)) {
+            path = argv[a];
+        } else {
+            usage();
+        }
+    }
+
+    if (path != NULL) {
+        trace_load(&trace, path);
+    } else if (synthetic_s != 0UL) {
+        trace_synthetic(&trace, (uint32_t)synthetic_s);
+    } else {
+        usage();
+    }
+    if (trace.count == 0U) {
+        fprintf(stderr, "empty trace\n");
+        return 1;
+    }
+
+    decisions = calloc(trace.count, sizeof(*decisions));
+    if (decisions == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    transitions = replay(&engine, &trace, &settings, decisions);
+    if (quiet == 0U) {
+        printf("t_ms,distance_mm,valid,filtered_mm,velocity_mm_s,track,present,candidate,reason,p_present,hmm,ref_mm,margin_mm,arrival\n");
+    }
+    for (i = 0U; i < trace.count; i++) {
+        uint8_t was_present = (i != 0U) ? decisions[i - 1U].present : decisions[i].present;
+
+        present_samples += decisions[i].present;
+        if ((decisions[i].arrival_predicted != 0U) && (predicted_since_ms == UINT32_MAX)) {
+            predicted_since_ms = trace.samples[i].t_ms;
+        }
+        if ((was_present == 0U) && (decisions[i].present != 0U)) {
+            returns++;
+            if (predicted_since_ms != UINT32_MAX) {
+                predicted_returns++;
+                lead_sum_ms += trace.samples[i].t_ms - predicted_since_ms;
+            }
+            predicted_since_ms = UINT32_MAX;
+        } else if ((decisions[i].arrival_predicted == 0U) && (predicted_since_ms != UINT32_MAX)) {
+            arrival_aborts++;
+            predicted_since_ms = UINT32_MAX;
+        }
+        if (quiet != 0U) {
+            continue;
+        }
+        printf("%lu,%lu,%u,%lu,%ld,%s,%u,%u,%s,%u,%s,%lu,%lu,%u\n",
+               (unsigned long)trace.samples[i].t_ms,
+               (unsigned long)trace.samples[i].sample.distance_mm,
+               (unsigned int)trace.samples[i].sample.valid,
+               (unsigned long)decisions[i].distance_mm,
+               (long)decisions[i].velocity_mm_s,
+               distance_tracker_status_to_string(decisions[i].track_status),
+               (unsigned int)decisions[i].present,
+               (unsigned int)decisions[i].candidate_no_user,
+               presence_no_user_reason_to_string(decisions[i].no_user_reason),
+               (unsigned int)decisions[i].present_permille,
+               presence_hmm_state_to_string(decisions[i].hmm_state),
+               (unsigned long)decisions[i].ref_distance_mm,
+               (unsigned long)decisions[i].away_margin_mm,
+               (unsigned int)decisions[i].arrival_predicted);
+    }
+    fprintf(stderr, "samples=%lu transitions=%lu present_samples=%lu\n",
+            (unsigned long)trace.count, (unsigned long)transitions, (unsigned long)present_samples);
+    fprintf(stderr, "returns=%lu predicted=%lu lead_avg_ms=%lu arrival_aborts=%lu\n",
+            (unsigned long)returns, (unsigned long)predicted_returns,
+            (unsigned long)((predicted_returns != 0U) ? (lead_sum_ms / predicted_returns) : 0U),
+            (unsigned long)arrival_aborts);
+
+    if (policy_count != 0U) {
+        replay_shadow(&trace, &settings, policies, policy_count);
+    }
+
+    if (bench != 0UL) {
+        double start = now_s();
+        double elapsed;
+        volatile uint32_t sink = 0U;
+        unsigned long r;
+
+        for (r = 0UL; r < bench; r++) {
+            sink += replay(&engine, &trace, &settings, NULL);
+        }
+        elapsed = now_s() - start;
+        (void)sink;
+        fprintf(stderr, "bench: %lu replays, %.1f M samples/s\n", bench,
+                ((double)trace.count * (double)bench) / (elapsed * 1e6));
+    }
+
+    free(decisions);
+    free(trace.samples);
+    free(trace.light);
+    return 0;
+}
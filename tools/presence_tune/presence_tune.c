@@ -0,0 +1,956 @@
+/* Searches presence parameters over a corpus of labelled traces with the firmware presence engine
+ * (app/presence_engine.c) compiled for the host, spread over all cores.
+ *
+ * Input CSV, one sample per line, '#' lines are comments:
+ *     t_ms,distance_mm,valid,light,ldr,truth
+ * as for presence_replay, plus the ground truth: 1 while someone is seated, 0 while the seat is empty (spans
+ * are runs of equal values). ldr may be left empty. --synthetic N generates N labelled traces instead: users
+ * working, reading still for minutes, leaning, leaving for short and long breaks, walking back or stepping
+ * straight in, and people passing the desk.
+ *
+ * Each candidate is a set of values for the tuned parameters (user settings from app_settings_t and policy
+ * constants from s_policy_cfg, see s_params); the rest stays at the firmware defaults. Every trace is replayed
+ * as the target runs it (arm/disarm on the light column, no-user confirmed after the pre-off time) and scored:
+ * - false_offs: the lamp switched off (no-user confirmed) while the user was seated.
+ * - latency: seat emptied -> no-user confirmed, plus user seated again -> lamp coming back (present or arrival
+ *   pre-ramp); a span that ends undetected counts its whole length.
+ * - energy: lamp time weighted by level (100 % present, 15 % pre-off dim, 35 % arrival pre-ramp).
+ * cost = w_false_off * false_offs + w_latency * latency_s + w_energy * energy_s; lower is better.
+ *
+ * The search is a full grid over the tuned ranges or --random N draws from it. Candidates are index ranges
+ * handed out to one deque per worker thread; an idle worker steals half of the range left on another deque.
+ * Results do not depend on the thread count.
+ *
+ * Output is CSV on stdout: the firmware defaults as rank 0, then the --top best candidates; a summary with
+ * timing and steals goes to stderr.
+ *
+ * Usage:
+ *     make && ./presence_tune [--param NAME=MIN:MAX:STEP ...] [--random N] [--seed N] [--threads N] [--top N]
+ *                             [--weights FALSE_OFF:LATENCY:ENERGY] [--hmm] [--minutes M]
+ *                             (trace.csv ... | --synthetic N) */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "app/presence_engine.h"
+
+#define TUNE_MAX_SAMPLES    2000000UL
+#define TUNE_MAX_TRACES     64U
+#define TUNE_MAX_THREADS    256U
+#define TUNE_MAX_CANDIDATES 100000000ULL
+/* Lamp levels of app_update_output_control, in percent. */
+#define TUNE_PREOFF_PERCENT  15U
+#define TUNE_PRERAMP_PERCENT 35U
+
+typedef struct
+{
+    presence_timed_sample_t *samples;
+    uint8_t *light;
+    uint8_t *truth;
+    uint32_t count;
+    uint32_t capacity;
+} tune_trace_t;
+
+typedef struct
+{
+    presence_engine_cfg_t cfg;
+    presence_engine_settings_t settings;
+} tune_candidate_t;
+
+typedef struct
+{
+    const char *name;
+    uint32_t min;
+    uint32_t max;
+    uint32_t step;
+    uint8_t tuned;
+    void (*set)(tune_candidate_t *c, uint32_t value);
+    uint32_t (*get)(const tune_candidate_t *c);
+} tune_param_t;
+
+typedef struct
+{
+    double cost;
+    uint32_t false_offs;
+    uint32_t leaves;
+    uint32_t missed_leaves;
+    uint32_t returns;
+    uint32_t missed_returns;
+    uint64_t leave_latency_ms;
+    uint64_t return_latency_ms;
+    uint64_t energy_ms;
+    uint64_t index;
+} tune_result_t;
+
+/* Candidate indices [head, tail). The owner pops from the tail; thieves take the front half. */
+typedef struct
+{
+    pthread_mutex_t lock;
+    uint64_t head;
+    uint64_t tail;
+} tune_deque_t;
+
+typedef struct
+{
+    uint32_t id;
+    uint32_t steals;
+    uint64_t done;
+} tune_worker_t;
+
+/* Mirrors the build defaults in app/app.c (s_policy_cfg) and app/app_settings.h; keep in sync. */
+static presence_engine_cfg_t s_cfg = {
+    .distance_error_mm = 9990U,
+    .median_window_size = 5U,
+    .median_warmup = FILTER_MEDIAN_WARMUP_PARTIAL,
+    .tracker = {
+        .accel_noise_mm_s2 = 400U,
+        .meas_noise_mm = 8U,
+        .init_velocity_mm_s = 300U,
+        .gate_sigma = 4U,
+        .max_gated = 2U,
+        .max_coast_ms = 3000U,
+    },
+    .use_tracker = 1U,
+    .flat_velocity_mm_s = 25U,
+    .motion_velocity_mm_s = 60U,
+    .motion_sigma = 2U,
+    .flat_band_mm = 6U,
+    .motion_delta_mm = 15U,
+    .ref_fallback_mm = 600U,
+    .body_margin_mm = 200U,
+    .return_confirm_ms = 1500U,
+    .streak_max_dt_ms = 500U,
+    .classifier = PRESENCE_CLASSIFIER_RULES,
+    .hmm = PRESENCE_HMM_MODEL_DEFAULTS,
+    .hmm_candidate_permille = 750U,
+    .hmm_clear_permille = 500U,
+    .hmm_recover_permille = 700U,
+    .ldr_shadow_delta_raw = 24U,
+    .learn_background = 1U,
+    .background = {
+        .bin_mm = 25U,
+        .decay_period_ms = 10000U,
+        .decay_shift = 5U,
+        .sample_max_dt_ms = 500U,
+        .user_min_ms = 30000U,
+        .scene_min_ms = 10000U,
+    },
+    .min_away_margin_mm = 80U,
+    .arrival_velocity_mm_s = 150U,
+    .arrival_horizon_ms = 1000U,
+    .arrival_confirm_ms = 300U,
+};
+
+static presence_engine_settings_t s_settings = {
+    .away_mode_enabled = 1U,
+    .flat_mode_enabled = 1U,
+    .away_timeout_ms = 30000U,
+    .stale_timeout_ms = 120000U,
+    .return_band_mm = 100U,
+    .preoff_dim_ms = 10000U,
+};
+
+static void set_away_timeout_s(tune_candidate_t *c, uint32_t v)
+{
+    c->settings.away_timeout_ms = v * 1000U;
+}
+
+static uint32_t get_away_timeout_s(const tune_candidate_t *c)
+{
+    return c->settings.away_timeout_ms / 1000U;
+}
+
+static void set_stale_timeout_s(tune_candidate_t *c, uint32_t v)
+{
+    c->settings.stale_timeout_ms = v * 1000U;
+}
+
+static uint32_t get_stale_timeout_s(const tune_candidate_t *c)
+{
+    return c->settings.stale_timeout_ms / 1000U;
+}
+
+static void set_return_band_cm(tune_candidate_t *c, uint32_t v)
+{
+    c->settings.return_band_mm = v * 10U;
+}
+
+static uint32_t get_return_band_cm(const tune_candidate_t *c)
+{
+    return c->settings.return_band_mm / 10U;
+}
+
+static void set_preoff_dim_s(tune_candidate_t *c, uint32_t v)
+{
+    c->settings.preoff_dim_ms = v * 1000U;
+}
+
+static uint32_t get_preoff_dim_s(const tune_candidate_t *c)
+{
+    return c->settings.preoff_dim_ms / 1000U;
+}
+
+static void set_body_margin_mm(tune_candidate_t *c, uint32_t v)
+{
+    c->cfg.body_margin_mm = v;
+}
+
+static uint32_t get_body_margin_mm(const tune_candidate_t *c)
+{
+    return c->cfg.body_margin_mm;
+}
+
+static void set_return_confirm_ms(tune_candidate_t *c, uint32_t v)
+{
+    c->cfg.return_confirm_ms = v;
+}
+
+static uint32_t get_return_confirm_ms(const tune_candidate_t *c)
+{
+    return c->cfg.return_confirm_ms;
+}
+
+static void set_flat_velocity_mm_s(tune_candidate_t *c, uint32_t v)
+{
+    c->cfg.flat_velocity_mm_s = v;
+}
+
+static uint32_t get_flat_velocity_mm_s(const tune_candidate_t *c)
+{
+    return c->cfg.flat_velocity_mm_s;
+}
+
+static void set_motion_velocity_mm_s(tune_candidate_t *c, uint32_t v)
+{
+    c->cfg.motion_velocity_mm_s = v;
+}
+
+static uint32_t get_motion_velocity_mm_s(const tune_candidate_t *c)
+{
+    return c->cfg.motion_velocity_mm_s;
+}
+
+static void set_median_window(tune_candidate_t *c, uint32_t v)
+{
+    c->cfg.median_window_size = (uint8_t)v;
+}
+
+static uint32_t get_median_window(const tune_candidate_t *c)
+{
+    return c->cfg.median_window_size;
+}
+
+static void set_arrival_velocity_mm_s(tune_candidate_t *c, uint32_t v)
+{
+    c->cfg.arrival_velocity_mm_s = v;
+}
+
+static uint32_t get_arrival_velocity_mm_s(const tune_candidate_t *c)
+{
+    return c->cfg.arrival_velocity_mm_s;
+}
+
+/* Names follow app_settings_t (first four) and s_policy_cfg without the presence_ prefix. The tuned ones
+ * span the default grid; --param tunes any of them over its own range. */
+static tune_param_t s_params[] = {
+    { "away_timeout_s", 10U, 90U, 20U, 1U, set_away_timeout_s, get_away_timeout_s },
+    { "stale_timeout_s", 60U, 600U, 60U, 1U, set_stale_timeout_s, get_stale_timeout_s },
+    { "return_band_cm", 5U, 25U, 5U, 1U, set_return_band_cm, get_return_band_cm },
+    { "preoff_dim_s", 5U, 20U, 5U, 0U, set_preoff_dim_s, get_preoff_dim_s },
+    { "body_margin_mm", 100U, 300U, 50U, 1U, set_body_margin_mm, get_body_margin_mm },
+    { "return_confirm_ms", 500U, 2000U, 500U, 1U, set_return_confirm_ms, get_return_confirm_ms },
+    { "flat_velocity_mm_s", 15U, 45U, 10U, 0U, set_flat_velocity_mm_s, get_flat_velocity_mm_s },
+    { "motion_velocity_mm_s", 40U, 100U, 20U, 0U, set_motion_velocity_mm_s, get_motion_velocity_mm_s },
+    { "median_window", 3U, 9U, 2U, 0U, set_median_window, get_median_window },
+    { "arrival_velocity_mm_s", 0U, 300U, 100U, 0U, set_arrival_velocity_mm_s, get_arrival_velocity_mm_s },
+};
+#define TUNE_PARAM_COUNT (sizeof(s_params) / sizeof(s_params[0]))
+
+static tune_trace_t s_traces[TUNE_MAX_TRACES];
+static uint32_t s_trace_count;
+static double s_w_false_off = 120.0;
+static double s_w_latency = 1.0;
+static double s_w_energy = 0.05;
+static uint64_t s_random_count;
+static uint64_t s_seed = 1U;
+static uint64_t s_candidate_count;
+static tune_result_t *s_results;
+static tune_deque_t s_deques[TUNE_MAX_THREADS];
+static uint32_t s_thread_count;
+
+static uint32_t s_rng_state = 1U;
+
+static uint32_t rng_next(void)
+{
+    s_rng_state = (s_rng_state * 1664525U) + 1013904223U;
+    return s_rng_state;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi)
+{
+    return lo + ((rng_next() >> 8) % ((hi - lo) + 1U));
+}
+
+/* Stateless per-candidate generator, so a random draw depends on its index only. */
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static void trace_alloc(tune_trace_t *trace, uint32_t capacity)
+{
+    trace->samples = calloc(capacity, sizeof(*trace->samples));
+    trace->light = calloc(capacity, sizeof(*trace->light));
+    trace->truth = calloc(capacity, sizeof(*trace->truth));
+    trace->count = 0U;
+    trace->capacity = capacity;
+    if ((trace->samples == NULL) || (trace->light == NULL) || (trace->truth == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+}
+
+static void trace_push(tune_trace_t *trace, uint32_t t_ms, uint32_t distance_mm, uint8_t valid, uint8_t light,
+                       int32_t ldr, uint8_t truth)
+{
+    presence_timed_sample_t *s;
+
+    /* The synthetic generator finishes its last span past the end; those samples are dropped. */
+    if (trace->count >= trace->capacity) {
+        return;
+    }
+    s = &trace->samples[trace->count];
+    s->t_ms = t_ms;
+    s->sample.distance_mm = distance_mm;
+    s->sample.valid = valid;
+    s->sample.ldr_raw = (uint16_t)((ldr < 0) ? 0 : ldr);
+    s->sample.ldr_valid = (ldr >= 0) ? 1U : 0U;
+    trace->light[trace->count] = light;
+    trace->truth[trace->count] = truth;
+    trace->count++;
+}
+
+/* Splits one CSV line in place; empty fields stay empty. Returns the field count. */
+static uint32_t split_fields(char *line, char **fields, uint32_t max)
+{
+    uint32_t n = 0U;
+    char *p = line;
+
+    while (n < max) {
+        fields[n++] = p;
+        p = strchr(p, ',');
+        if (p == NULL) {
+            break;
+        }
+        *p++ = '\0';
+    }
+
+    return n;
+}
+
+static void trace_load(tune_trace_t *trace, const char *path)
+{
+    char line[160];
+    FILE *f = fopen(path, "r");
+    uint32_t line_no = 0U;
+
+    if (f == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        exit(1);
+    }
+
+    trace_alloc(trace, TUNE_MAX_SAMPLES);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *fields[6];
+        int32_t ldr = -1;
+
+        line_no++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if ((line[0] == '#') || (line[0] == '\0')) {
+            continue;
+        }
+        if (split_fields(line, fields, 6U) != 6U) {
+            fprintf(stderr, "%s:%u: expected 't_ms,distance_mm,valid,light,ldr,truth'\n", path,
+                    (unsigned int)line_no);
+            exit(1);
+        }
+        if (trace->count >= TUNE_MAX_SAMPLES) {
+            fprintf(stderr, "%s: more than %lu samples\n", path, TUNE_MAX_SAMPLES);
+            exit(1);
+        }
+        if (fields[4][0] != '\0') {
+            ldr = (int32_t)strtol(fields[4], NULL, 0);
+        }
+        trace_push(trace,
+                   (uint32_t)strtoul(fields[0], NULL, 0),
+                   (uint32_t)strtoul(fields[1], NULL, 0),
+                   (strtoul(fields[2], NULL, 0) != 0UL) ? 1U : 0U,
+                   (strtoul(fields[3], NULL, 0) != 0UL) ? 1U : 0U,
+                   ldr,
+                   (strtoul(fields[5], NULL, 0) != 0UL) ? 1U : 0U);
+    }
+    fclose(f);
+}
+
+/* One synthetic desk session of the given length, 200 ms per sample. The seat is at 500..650 mm and the
+ * room behind it at 1300..1800 mm. Seated spans mix typing (small sway, a lean now and then) with reading
+ * still for up to 6 minutes; breaks last 20 s .. 6 min, sometimes with someone walking past; returns are a
+ * walk back over 1.5..3 s or a step straight into the cone. 5 % of the bursts drop out. */
+static void trace_synthetic(tune_trace_t *trace, uint32_t minutes, uint32_t seed)
+{
+    const uint32_t period_ms = 200U;
+    uint32_t count = (minutes * 60000U) / period_ms;
+    int32_t seat_mm;
+    int32_t room_mm;
+    uint32_t t_ms = 0U;
+    uint8_t seated = 1U;
+
+    s_rng_state = seed * 2654435761U + 1U;
+    seat_mm = (int32_t)rng_range(500U, 650U);
+    room_mm = (int32_t)rng_range(1300U, 1800U);
+    trace_alloc(trace, count);
+
+    while (trace->count < count) {
+        uint32_t span_ms;
+        uint32_t start_ms = t_ms;
+
+        if (seated != 0U) {
+            uint8_t reading = (rng_range(0U, 2U) == 0U) ? 1U : 0U;
+
+            span_ms = reading ? rng_range(60000U, 360000U) : rng_range(30000U, 600000U);
+            while ((t_ms - start_ms) < span_ms) {
+                uint32_t phase_ms = (t_ms - start_ms) % 45000U;
+                int32_t d = seat_mm + (int32_t)(rng_next() % 9U) - 4;
+                int32_t ldr = 2000 + (int32_t)(rng_next() % 5U) - 2;
+
+                if ((reading == 0U) && (phase_ms < 3000U)) {
+                    d -= (int32_t)((((phase_ms < 1500U) ? phase_ms : (3000U - phase_ms)) * 120U) / 1500U);
+                    ldr -= 40;
+                } else if (reading == 0U) {
+                    d += (int32_t)(rng_next() % 31U) - 15;
+                }
+                trace_push(trace, t_ms, (uint32_t)d, ((rng_next() % 20U) != 0U) ? 1U : 0U, 1U, ldr, 1U);
+                t_ms += period_ms;
+            }
+            /* Standing up and walking off: the seat is empty from the first step. */
+            span_ms = rng_range(1500U, 3000U);
+            start_ms = t_ms;
+            while ((t_ms - start_ms) < span_ms) {
+                int32_t d = seat_mm + (int32_t)(((t_ms - start_ms) * (uint32_t)(room_mm - seat_mm)) / span_ms);
+
+                trace_push(trace, t_ms, (uint32_t)(d + (int32_t)(rng_next() % 9U) - 4),
+                           ((rng_next() % 20U) != 0U) ? 1U : 0U, 1U, 1960, 0U);
+                t_ms += period_ms;
+            }
+            seated = 0U;
+        } else {
+            uint32_t passer_ms = 0xFFFFFFFFUL;
+            uint8_t step_in = (rng_range(0U, 3U) == 0U) ? 1U : 0U;
+            uint32_t walk_ms = rng_range(1500U, 3000U);
+
+            span_ms = (rng_range(0U, 2U) == 0U) ? rng_range(120000U, 360000U) : rng_range(20000U, 120000U);
+            if ((span_ms > 40000U) && (rng_range(0U, 2U) == 0U)) {
+                passer_ms = rng_range(10000U, span_ms - 20000U);
+            }
+            while ((t_ms - start_ms) < span_ms) {
+                uint32_t since_ms = t_ms - start_ms;
+                int32_t d = room_mm + (int32_t)(rng_next() % 9U) - 4;
+
+                /* Someone walking up to the desk and away again over 2.4 s. */
+                if ((since_ms >= passer_ms) && (since_ms < (passer_ms + 2400U))) {
+                    uint32_t x = since_ms - passer_ms;
+
+                    d -= (int32_t)((((x < 1200U) ? x : (2400U - x)) * 450U) / 1200U);
+                }
+                trace_push(trace, t_ms, (uint32_t)d, ((rng_next() % 20U) != 0U) ? 1U : 0U, 1U,
+                           2000 + (int32_t)(rng_next() % 5U) - 2, 0U);
+                t_ms += period_ms;
+            }
+            /* Coming back: seated (truth 1) once the walk ends. */
+            start_ms = t_ms;
+            while ((step_in == 0U) && ((t_ms - start_ms) < walk_ms)) {
+                int32_t d = room_mm - (int32_t)(((t_ms - start_ms) * (uint32_t)(room_mm - seat_mm)) / walk_ms);
+
+                trace_push(trace, t_ms, (uint32_t)(d + (int32_t)(rng_next() % 9U) - 4),
+                           ((rng_next() % 20U) != 0U) ? 1U : 0U, 1U, 1960, 0U);
+                t_ms += period_ms;
+            }
+            seated = 1U;
+        }
+    }
+}
+
+static uint32_t param_steps(const tune_param_t *p)
+{
+    return ((p->max - p->min) / p->step) + 1U;
+}
+
+/* Grid: mixed-radix digits of the index. Random: each digit from the index's own generator. */
+static void candidate_build(uint64_t index, tune_candidate_t *c)
+{
+    uint64_t rest = index;
+    uint64_t rng = splitmix64(s_seed ^ splitmix64(index));
+    uint32_t i;
+
+    c->cfg = s_cfg;
+    c->settings = s_settings;
+    for (i = 0U; i < TUNE_PARAM_COUNT; i++) {
+        const tune_param_t *p = &s_params[i];
+        uint32_t steps;
+        uint32_t digit;
+
+        if (p->tuned == 0U) {
+            continue;
+        }
+        steps = param_steps(p);
+        if (s_random_count != 0U) {
+            rng = splitmix64(rng);
+            digit = (uint32_t)(rng % steps);
+        } else {
+            digit = (uint32_t)(rest % steps);
+            rest /= steps;
+        }
+        p->set(c, p->min + (digit * p->step));
+    }
+}
+
+static uint8_t lamp_percent(const presence_engine_t *e)
+{
+    if (e->armed == 0U) {
+        return 0U;
+    }
+    if (e->present != 0U) {
+        return (e->candidate_no_user != 0U) ? TUNE_PREOFF_PERCENT : 100U;
+    }
+    return (e->arrival_predicted != 0U) ? TUNE_PRERAMP_PERCENT : 0U;
+}
+
+static void evaluate_trace(presence_engine_t *e,
+                           const tune_candidate_t *c,
+                           const tune_trace_t *trace,
+                           tune_result_t *r)
+{
+    uint32_t leave_since_ms = 0U;
+    uint32_t return_since_ms = 0U;
+    uint8_t leave_pending = 0U;
+    uint8_t return_pending = 0U;
+    uint32_t i;
+
+    presence_engine_init(e, &c->cfg);
+    for (i = 0U; i < trace->count; i++) {
+        const presence_timed_sample_t *s = &trace->samples[i];
+        uint8_t was_present = e->present;
+        uint8_t truth = trace->truth[i];
+
+        if ((i == 0U) || (trace->light[i] != trace->light[i - 1U])) {
+            if (trace->light[i] != 0U) {
+                presence_engine_arm(e);
+            } else {
+                presence_engine_disarm(e);
+            }
+            was_present = e->present;
+            leave_pending = 0U;
+            return_pending = 0U;
+        }
+        if (i != 0U) {
+            r->energy_ms += ((uint64_t)(s->t_ms - trace->samples[i - 1U].t_ms) * lamp_percent(e)) / 100U;
+        }
+        /* One sample at a time through the batch API: it confirms no-user after the pre-off time like the
+         * output control does. */
+        (void)presence_engine_replay(e, s, 1U, &c->settings, NULL);
+        if (trace->light[i] == 0U) {
+            continue;
+        }
+
+        if ((i != 0U) && (trace->light[i - 1U] != 0U) && (truth != trace->truth[i - 1U])) {
+            if (truth == 0U) {
+                if (return_pending != 0U) {
+                    r->missed_returns++;
+                    r->return_latency_ms += s->t_ms - return_since_ms;
+                    return_pending = 0U;
+                }
+                leave_pending = 1U;
+                leave_since_ms = s->t_ms;
+            } else {
+                if (leave_pending != 0U) {
+                    r->missed_leaves++;
+                    r->leave_latency_ms += s->t_ms - leave_since_ms;
+                    leave_pending = 0U;
+                }
+                if (e->present == 0U) {
+                    return_pending = 1U;
+                    return_since_ms = s->t_ms;
+                }
+            }
+        }
+
+        if ((was_present != 0U) && (e->present == 0U)) {
+            if (leave_pending != 0U) {
+                r->leaves++;
+                r->leave_latency_ms += s->t_ms - leave_since_ms;
+                leave_pending = 0U;
+            } else if (truth != 0U) {
+                r->false_offs++;
+            }
+        }
+        if ((return_pending != 0U) && ((e->present != 0U) || (e->arrival_predicted != 0U))) {
+            r->returns++;
+            r->return_latency_ms += s->t_ms - return_since_ms;
+            return_pending = 0U;
+        }
+    }
+
+    if (trace->count != 0U) {
+        uint32_t end_ms = trace->samples[trace->count - 1U].t_ms;
+
+        if (leave_pending != 0U) {
+            r->missed_leaves++;
+            r->leave_latency_ms += end_ms - leave_since_ms;
+        }
+        if (return_pending != 0U) {
+            r->missed_returns++;
+            r->return_latency_ms += end_ms - return_since_ms;
+        }
+    }
+}
+
+static void evaluate(presence_engine_t *e, const tune_candidate_t *c, uint64_t index, tune_result_t *r)
+{
+    uint32_t t;
+
+    memset(r, 0, sizeof(*r));
+    r->index = index;
+    for (t = 0U; t < s_trace_count; t++) {
+        evaluate_trace(e, c, &s_traces[t], r);
+    }
+    r->cost = (s_w_false_off * (double)r->false_offs) +
+              (s_w_latency * ((double)(r->leave_latency_ms + r->return_latency_ms) / 1000.0)) +
+              (s_w_energy * ((double)r->energy_ms / 1000.0));
+}
+
+static uint8_t deque_pop(tune_deque_t *d, uint64_t *index)
+{
+    uint8_t ok = 0U;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail) {
+        *index = --d->tail;
+        ok = 1U;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return ok;
+}
+
+/* Moves the front half of a victim's range into the thief's (empty) deque. */
+static uint8_t deque_steal(tune_deque_t *victim, tune_deque_t *thief)
+{
+    uint64_t head = 0U;
+    uint64_t take = 0U;
+
+    pthread_mutex_lock(&victim->lock);
+    if (victim->head < victim->tail) {
+        take = (victim->tail - victim->head + 1U) / 2U;
+        head = victim->head;
+        victim->head += take;
+    }
+    pthread_mutex_unlock(&victim->lock);
+    if (take == 0U) {
+        return 0U;
+    }
+
+    pthread_mutex_lock(&thief->lock);
+    thief->head = head;
+    thief->tail = head + take;
+    pthread_mutex_unlock(&thief->lock);
+
+    return 1U;
+}
+
+static void *worker_main(void *arg)
+{
+    tune_worker_t *w = arg;
+    tune_deque_t *own = &s_deques[w->id];
+    presence_engine_t *engine = malloc(sizeof(*engine));
+    uint32_t victim_seed = w->id + 1U;
+
+    if (engine == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    for (;;) {
+        uint64_t index;
+        uint32_t tries;
+        uint8_t stolen = 0U;
+
+        while (deque_pop(own, &index) != 0U) {
+            tune_candidate_t c;
+
+            candidate_build(index, &c);
+            evaluate(engine, &c, index, &s_results[index]);
+            w->done++;
+        }
+
+        /* Nothing left here: scan the others from a rotating start. No new work is ever created, so one
+         * full scan finding every deque empty means the search is done. */
+        victim_seed = (victim_seed * 1664525U) + 1013904223U;
+        for (tries = 0U; (tries < s_thread_count) && (stolen == 0U); tries++) {
+            uint32_t v = ((victim_seed >> 8) + tries) % s_thread_count;
+
+            if (v != w->id) {
+                stolen = deque_steal(&s_deques[v], own);
+            }
+        }
+        if (stolen == 0U) {
+            break;
+        }
+        w->steals++;
+    }
+
+    free(engine);
+    return NULL;
+}
+
+static int result_compare(const void *a, const void *b)
+{
+    const tune_result_t *ra = a;
+    const tune_result_t *rb = b;
+
+    if (ra->cost != rb->cost) {
+        return (ra->cost < rb->cost) ? -1 : 1;
+    }
+    return (ra->index < rb->index) ? -1 : ((ra->index > rb->index) ? 1 : 0);
+}
+
+static void print_header(void)
+{
+    uint32_t i;
+
+    printf("rank,cost,false_offs,leaves,missed_leaves,leave_lat_avg_ms,returns,missed_returns,return_lat_avg_ms,energy_s");
+    for (i = 0U; i < TUNE_PARAM_COUNT; i++) {
+        printf(",%s", s_params[i].name);
+    }
+    printf("\n");
+}
+
+static void print_result(uint32_t rank, const tune_result_t *r, const tune_candidate_t *c)
+{
+    uint32_t leaves = r->leaves + r->missed_leaves;
+    uint32_t returns = r->returns + r->missed_returns;
+    uint32_t i;
+
+    printf("%u,%.1f,%u,%u,%u,%llu,%u,%u,%llu,%llu",
+           (unsigned int)rank,
+           r->cost,
+           (unsigned int)r->false_offs,
+           (unsigned int)r->leaves,
+           (unsigned int)r->missed_leaves,
+           (unsigned long long)((leaves != 0U) ? (r->leave_latency_ms / leaves) : 0U),
+           (unsigned int)r->returns,
+           (unsigned int)r->missed_returns,
+           (unsigned long long)((returns != 0U) ? (r->return_latency_ms / returns) : 0U),
+           (unsigned long long)(r->energy_ms / 1000U));
+    for (i = 0U; i < TUNE_PARAM_COUNT; i++) {
+        printf(",%u", (unsigned int)s_params[i].get(c));
+    }
+    printf("\n");
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: presence_tune [--param NAME=MIN:MAX:STEP ...] [--random N] [--seed N] [--threads N] [--top N]\n"
+            "                     [--weights FALSE_OFF:LATENCY:ENERGY] [--hmm] [--minutes M]\n"
+            "                     (trace.csv ... | --synthetic N)\n"
+            "params:");
+    for (uint32_t i = 0U; i < TUNE_PARAM_COUNT; i++) {
+        fprintf(stderr, " %s", s_params[i].name);
+    }
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static void parse_param(const char *arg)
+{
+    char name[48];
+    unsigned long min;
+    unsigned long max;
+    unsigned long step;
+    uint32_t i;
+
+    if ((sscanf(arg, "%47[^=]=%lu:%lu:%lu", name, &min, &max, &step) != 4) || (step == 0UL) || (max < min)) {
+        usage();
+    }
+    for (i = 0U; i < TUNE_PARAM_COUNT; i++) {
+        if (strcmp(s_params[i].name, name) == 0) {
+            s_params[i].min = (uint32_t)min;
+            s_params[i].max = (uint32_t)max;
+            s_params[i].step = (uint32_t)step;
+            s_params[i].tuned = 1U;
+            return;
+        }
+    }
+    usage();
+}
+
+int main(int argc, char **argv)
+{
+    static tune_worker_t workers[TUNE_MAX_THREADS];
+    pthread_t threads[TUNE_MAX_THREADS];
+    presence_engine_t *engine;
+    tune_candidate_t baseline;
+    tune_result_t baseline_result;
+    unsigned long synthetic = 0UL;
+    unsigned long minutes = 30UL;
+    unsigned long top = 10UL;
+    long threads_arg = 0L;
+    uint64_t per_thread;
+    uint64_t steps_total = 0U;
+    uint32_t steals = 0U;
+    uint64_t r;
+    double start;
+    double elapsed;
+    uint32_t i;
+    int a;
+
+    for (a = 1; a < argc; a++) {
+        if ((strcmp(argv[a], "--param") == 0) && ((a + 1) < argc)) {
+            parse_param(argv[++a]);
+        } else if ((strcmp(argv[a], "--random") == 0) && ((a + 1) < argc)) {
+            s_random_count = strtoull(argv[++a], NULL, 0);
+        } else if ((strcmp(argv[a], "--seed") == 0) && ((a + 1) < argc)) {
+            s_seed = strtoull(argv[++a], NULL, 0);
+        } else if ((strcmp(argv[a], "--threads") == 0) && ((a + 1) < argc)) {
+            threads_arg = strtol(argv[++a], NULL, 0);
+        } else if ((strcmp(argv[a], "--top") == 0) && ((a + 1) < argc)) {
+            top = strtoul(argv[++a], NULL, 0);
+        } else if ((strcmp(argv[a], "--weights") == 0) && ((a + 1) < argc)) {
+            if (sscanf(argv[++a], "%lf:%lf:%lf", &s_w_false_off, &s_w_latency, &s_w_energy) != 3) {
+                usage();
+            }
+        } else if (strcmp(argv[a], "--hmm") == 0) {
+            s_cfg.classifier = PRESENCE_CLASSIFIER_HMM;
+        } else if ((strcmp(argv[a], "--minutes") == 0) && ((a + 1) < argc)) {
+            minutes = strtoul(argv[++a], NULL, 0);
+        } else if ((strcmp(argv[a], "--synthetic") == 0) && ((a + 1) < argc)) {
+            synthetic = strtoul(argv[++a], NULL, 0);
+        } else if ((argv[a][0] != '-') && (s_trace_count < TUNE_MAX_TRACES)) {
+            trace_load(&s_traces[s_trace_count++], argv[a]);
+        } else {
+            usage();
+        }
+    }
+
+    for (i = 0U; (i < synthetic) && (s_trace_count < TUNE_MAX_TRACES); i++) {
+        trace_synthetic(&s_traces[s_trace_count++], (uint32_t)minutes, i + 1U);
+    }
+    if (s_trace_count == 0U) {
+        usage();
+    }
+    for (i = 0U; i < s_trace_count; i++) {
+        steps_total += s_traces[i].count;
+    }
+
+    /* Random search draws each parameter independently, so only the sample count is bounded; the grid size
+     * matters for exhaustive search alone. */
+    if (s_random_count != 0U) {
+        if (s_random_count > TUNE_MAX_CANDIDATES) {
+            fprintf(stderr, "--random larger than %llu candidates\n", TUNE_MAX_CANDIDATES);
+            return 1;
+        }
+        s_candidate_count = s_random_count;
+    } else {
+        s_candidate_count = 1U;
+        for (i = 0U; i < TUNE_PARAM_COUNT; i++) {
+            if (s_params[i].tuned != 0U) {
+                s_candidate_count *= param_steps(&s_params[i]);
+                if (s_candidate_count > TUNE_MAX_CANDIDATES) {
+                    fprintf(stderr, "grid larger than %llu candidates, use --random\n", TUNE_MAX_CANDIDATES);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    s_thread_count = (threads_arg > 0L) ? (uint32_t)threads_arg : (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (s_thread_count == 0U) {
+        s_thread_count = 1U;
+    }
+    if (s_thread_count > TUNE_MAX_THREADS) {
+        s_thread_count = TUNE_MAX_THREADS;
+    }
+
+    s_results = calloc(s_candidate_count, sizeof(*s_results));
+    engine = malloc(sizeof(*engine));
+    if ((s_results == NULL) || (engine == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    /* Firmware defaults first, on this thread, as the reference row. */
+    baseline.cfg = s_cfg;
+    baseline.settings = s_settings;
+    evaluate(engine, &baseline, 0U, &baseline_result);
+
+    start = now_s();
+    per_thread = s_candidate_count / s_thread_count;
+    for (i = 0U; i < s_thread_count; i++) {
+        pthread_mutex_init(&s_deques[i].lock, NULL);
+        s_deques[i].head = i * per_thread;
+        s_deques[i].tail = (i == (s_thread_count - 1U)) ? s_candidate_count : ((i + 1U) * per_thread);
+        workers[i].id = i;
+    }
+    for (i = 0U; i < s_thread_count; i++) {
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "cannot start worker %u\n", (unsigned int)i);
+            return 1;
+        }
+    }
+    for (i = 0U; i < s_thread_count; i++) {
+        pthread_join(threads[i], NULL);
+        steals += workers[i].steals;
+    }
+    elapsed = now_s() - start;
+
+    qsort(s_results, s_candidate_count, sizeof(*s_results), result_compare);
+
+    print_header();
+    print_result(0U, &baseline_result, &baseline);
+    for (r = 0U; (r < top) && (r < s_candidate_count); r++) {
+        tune_candidate_t c;
+
+        candidate_build(s_results[r].index, &c);
+        print_result((uint32_t)(r + 1U), &s_results[r], &c);
+    }
+
+    fprintf(stderr, "traces=%u samples=%llu candidates=%llu threads=%u steals=%u elapsed_s=%.2f candidates_s=%.0f M_samples_s=%.1f\n",
+            (unsigned int)s_trace_count,
+            (unsigned long long)steps_total,
+            (unsigned long long)s_candidate_count,
+            (unsigned int)s_thread_count,
+            (unsigned int)steals,
+            elapsed,
+            (double)s_candidate_count / elapsed,
+            ((double)s_candidate_count * (double)steps_total) / (elapsed * 1e6));
+
+    free(engine);
+    free(s_results);
+    return 0;
+}
@@ -0,0 +1,45 @@
+/* Host stand-in for the HAL umbrella header: the zone scheduler only needs the handle types named in
+ * ultrasonic.h and the PRIMASK helpers used by input_utils.h. */
+#ifndef ZONES_CHECK_HAL_SHIM_H
+#define ZONES_CHECK_HAL_SHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t unused;
+} TIM_HandleTypeDef;
+
+typedef struct
+{
+    uint32_t unused;
+} GPIO_TypeDef;
+
+typedef enum
+{
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+static inline uint32_t __get_PRIMASK(void)
+{
+    return 0U;
+}
+
+static inline void __disable_irq(void)
+{
+}
+
+static inline void __enable_irq(void)
+{
+}
+
+static inline GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin)
+{
+    (void)port;
+    (void)pin;
+    return GPIO_PIN_RESET;
+}
+
+#endif /* ZONES_CHECK_HAL_SHIM_H */
@@ -0,0 +1,167 @@
+/* Host check of the ultrasonic zone scheduler (sensors/ultrasonic_zones.c, unmodified): the bursts are
+ * replaced by stubs that take a fixed time per zone, rounds are started back to back on a 1 ms clock, and
+ * every burst start is checked against the end of the previous burst. A different zone must wait at least
+ * guard_ms; the same zone may re-fire at once. Exits non-zero on the first violation.
+ *
+ *   ./zones_check [--guard 10] [--rounds 500]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sensors/ultrasonic_zones.h"
+
+#define CHECK_ZONES 3U
+
+typedef struct
+{
+    uint32_t duration_ms;
+    uint8_t busy;
+    uint32_t start_ms;
+} stub_burst_t;
+
+static stub_burst_t s_stub[CHECK_ZONES];
+static ultrasonic_burst_t s_bursts[CHECK_ZONES];
+static uint32_t s_now_ms;
+static uint8_t s_fail_zone = ULTRASONIC_ZONES_NONE;
+
+static uint8_t stub_index(const ultrasonic_burst_t *b)
+{
+    return (uint8_t)(b - s_bursts);
+}
+
+ultrasonic_status_t ultrasonic_burst_start(ultrasonic_burst_t *b, int32_t temp_deci_c)
+{
+    stub_burst_t *stub = &s_stub[stub_index(b)];
+
+    (void)temp_deci_c;
+    if (stub_index(b) == s_fail_zone) {
+        return ULTRASONIC_STATUS_NOT_INIT;
+    }
+    stub->busy = 1U;
+    stub->start_ms = s_now_ms;
+    return ULTRASONIC_STATUS_OK;
+}
+
+uint8_t ultrasonic_burst_poll(ultrasonic_burst_t *b, uint32_t now_ms, ultrasonic_burst_result_t *out_result)
+{
+    stub_burst_t *stub = &s_stub[stub_index(b)];
+
+    if ((stub->busy == 0U) || ((now_ms - stub->start_ms) < stub->duration_ms)) {
+        return 0U;
+    }
+    stub->busy = 0U;
+    if (out_result != NULL) {
+        memset(out_result, 0, sizeof(*out_result));
+        out_result->status = ULTRASONIC_STATUS_OK;
+        out_result->valid_pings = 1U;
+    }
+    return 1U;
+}
+
+/* One scenario: count zones, rounds fired with the given masks in turn. Returns the number of violations. */
+static uint32_t run_scenario(const char *name,
+                             uint8_t count,
+                             const uint8_t *masks,
+                             uint8_t mask_count,
+                             uint32_t guard_ms,
+                             uint32_t rounds)
+{
+    ultrasonic_zones_t zones;
+    uint8_t last_zone = ULTRASONIC_ZONES_NONE;
+    uint32_t last_end_ms = 0U;
+    uint32_t round = 0U;
+    uint32_t bursts = 0U;
+    uint32_t violations = 0U;
+    uint32_t min_gap_ms = 0xFFFFFFFFU;
+    uint8_t i;
+
+    memset(s_stub, 0, sizeof(s_stub));
+    for (i = 0U; i < CHECK_ZONES; i++) {
+        s_stub[i].duration_ms = 40U + (7U * i);
+    }
+    s_now_ms = 0U;
+    ultrasonic_zones_init(&zones, s_bursts, count, guard_ms);
+
+    while (round < rounds) {
+        uint8_t zone;
+        ultrasonic_burst_result_t result;
+
+        if (ultrasonic_zones_is_busy(&zones) == 0U) {
+            (void)ultrasonic_zones_start_round(&zones, masks[round % mask_count], 0);
+            round++;
+        }
+        if (ultrasonic_zones_poll(&zones, s_now_ms, &zone, &result) != 0U) {
+            if (result.status == ULTRASONIC_STATUS_OK) {
+                last_zone = zone;
+                last_end_ms = s_now_ms;
+            }
+        }
+        for (i = 0U; i < count; i++) {
+            if ((s_stub[i].busy != 0U) && (s_stub[i].start_ms == s_now_ms)) {
+                bursts++;
+                if ((last_zone != ULTRASONIC_ZONES_NONE) && (last_zone != i)) {
+                    uint32_t gap_ms = s_now_ms - last_end_ms;
+
+                    if (gap_ms < min_gap_ms) {
+                        min_gap_ms = gap_ms;
+                    }
+                    if (gap_ms < guard_ms) {
+                        if (violations == 0U) {
+                            fprintf(stderr, "%s: zone %u fired %lu ms after zone %u (guard %lu ms) at t=%lu\n",
+                                    name, (unsigned int)i, (unsigned long)gap_ms, (unsigned int)last_zone,
+                                    (unsigned long)guard_ms, (unsigned long)s_now_ms);
+                        }
+                        violations++;
+                    }
+                }
+            }
+        }
+        s_now_ms++;
+    }
+
+    printf("%-12s zones=%u bursts=%lu min_cross_gap_ms=%ld violations=%lu\n",
+           name,
+           (unsigned int)count,
+           (unsigned long)bursts,
+           (min_gap_ms == 0xFFFFFFFFU) ? -1L : (long)min_gap_ms,
+           (unsigned long)violations);
+    return violations;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint8_t all2[] = {0x3U};
+    static const uint8_t all3[] = {0x7U};
+    static const uint8_t mixed[] = {0x1U, 0x3U, 0x2U, 0x1U, 0x6U, 0x5U};
+    uint32_t guard_ms = 10U;
+    uint32_t rounds = 500U;
+    uint32_t violations = 0U;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--guard") == 0) && ((i + 1) < argc)) {
+            guard_ms = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if ((strcmp(argv[i], "--rounds") == 0) && ((i + 1) < argc)) {
+            rounds = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--guard ms] [--rounds n]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    violations += run_scenario("two_zones", 2U, all2, 1U, guard_ms, rounds);
+    violations += run_scenario("three_zones", 3U, all3, 1U, guard_ms, rounds);
+    violations += run_scenario("mixed_masks", 3U, mixed, (uint8_t)sizeof(mixed), guard_ms, rounds);
+    /* A zone that cannot start must not reset the guard owed to the zone that last pinged. */
+    s_fail_zone = 1U;
+    violations += run_scenario("failed_start", 3U, all3, 1U, guard_ms, rounds);
+    s_fail_zone = ULTRASONIC_ZONES_NONE;
+
+    if (violations != 0U) {
+        fprintf(stderr, "FAIL: %lu guard violations\n", (unsigned long)violations);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}